@@ -34,6 +34,7 @@
 #include <cstdlib>
 
 #include "benchmark_time.hpp"
+#include "latency_hist.hpp"
 #include "os.h"
 #include "rand.h"
 #include "util.h"
@@ -69,6 +70,12 @@ struct benchmark_args {
 	unsigned seed;		 /* PRNG seed */
 	unsigned repeats;	 /* number of repeats of one scenario */
 	unsigned min_exe_time;	 /* minimal execution time */
+	size_t rate;		 /* target rate of operations per second,
+				    0 means closed-loop mode */
+	char *arrival;		 /* distribution of operations arrival times
+				    in open-loop mode */
+	char *latency_hist;	 /* file to which latency histograms are
+				    appended in open-loop mode */
 	bool help;		 /* print help for benchmark */
 	void *opts;		 /* benchmark specific arguments */
 };
@@ -112,6 +119,7 @@ struct latency {
 struct thread_results {
 	benchmark_time_t beg;
 	benchmark_time_t end;
+	benchmark_time_t *start_op; /* intended start, open-loop mode only */
 	benchmark_time_t end_op[];
 };
 
@@ -132,6 +140,7 @@ struct total_results {
 	double nopsps;
 	struct results total;
 	struct latency latency;
+	struct latency_hist *hist; /* open-loop mode only */
 	struct bench_results *res;
 };
 
@@ -235,6 +244,7 @@ struct operation_info {
 	struct worker_info *worker;  /* worker's info */
 	struct benchmark_args *args; /* benchmark arguments */
 	size_t index;		     /* operation's index */
+	benchmark_time_t start;	     /* operation's intended start time */
 	benchmark_time_t end;	     /* operation's end time */
 };
 
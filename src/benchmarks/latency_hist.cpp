@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * latency_hist.cpp -- latency_hist module definitions
+ */
+#include "latency_hist.hpp"
+#include "util.h"
+#include <cassert>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+
+/* each power of two range is split into 2^(SUB_BITS - 1) sub-buckets */
+#define SUB_BITS 7
+#define SUB_COUNT (1U << SUB_BITS)
+#define SUB_HALF (SUB_COUNT / 2)
+
+/* values below SUB_COUNT are exact, 57 ranges cover the rest of uint64_t */
+#define NBUCKETS (SUB_COUNT + (64 - SUB_BITS + 1) * SUB_HALF)
+
+struct latency_hist {
+	uint64_t count;
+	uint64_t max;
+	uint64_t buckets[NBUCKETS];
+};
+
+/*
+ * hist_index -- (internal) return index of the bucket for given value
+ */
+static size_t
+hist_index(uint64_t value)
+{
+	if (value < SUB_COUNT)
+		return (size_t)value;
+
+	unsigned shift = util_mssb_index64(value) - (SUB_BITS - 1);
+
+	return SUB_COUNT + (shift - 1) * SUB_HALF +
+		(size_t)((value >> shift) - SUB_HALF);
+}
+
+/*
+ * hist_highest -- (internal) return the highest value which falls into the
+ * bucket with given index
+ */
+static uint64_t
+hist_highest(size_t idx)
+{
+	if (idx < SUB_COUNT)
+		return idx;
+
+	unsigned shift = (unsigned)((idx - SUB_COUNT) / SUB_HALF) + 1;
+	uint64_t sub = (idx - SUB_COUNT) % SUB_HALF + SUB_HALF;
+
+	return ((sub + 1) << shift) - 1;
+}
+
+/*
+ * latency_hist_alloc -- allocate an empty histogram
+ */
+struct latency_hist *
+latency_hist_alloc(void)
+{
+	auto *h = (struct latency_hist *)calloc(1, sizeof(struct latency_hist));
+	assert(h != nullptr);
+
+	return h;
+}
+
+/*
+ * latency_hist_free -- release histogram
+ */
+void
+latency_hist_free(struct latency_hist *h)
+{
+	free(h);
+}
+
+/*
+ * latency_hist_reset -- remove all recorded values
+ */
+void
+latency_hist_reset(struct latency_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+/*
+ * latency_hist_record -- record a single value
+ */
+void
+latency_hist_record(struct latency_hist *h, uint64_t value)
+{
+	h->buckets[hist_index(value)]++;
+	h->count++;
+	if (value > h->max)
+		h->max = value;
+}
+
+/*
+ * latency_hist_merge -- add all values recorded in src to dst
+ */
+void
+latency_hist_merge(struct latency_hist *dst, const struct latency_hist *src)
+{
+	for (size_t i = 0; i < NBUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/*
+ * latency_hist_percentile -- return the value below which pctl percent of
+ * recorded values fall, with the precision of the histogram
+ */
+uint64_t
+latency_hist_percentile(const struct latency_hist *h, double pctl)
+{
+	if (h->count == 0)
+		return 0;
+
+	/* same rank as used for percentiles of sorted latencies */
+	auto target = (uint64_t)((double)h->count * pctl / 100.0) + 1;
+	if (target > h->count)
+		target = h->count;
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < NBUCKETS; i++) {
+		total += h->buckets[i];
+		if (total >= target) {
+			uint64_t value = hist_highest(i);
+			return value < h->max ? value : h->max;
+		}
+	}
+
+	return h->max;
+}
+
+/*
+ * latency_hist_print -- print the percentile distribution of recorded values,
+ * one line per non-empty bucket
+ */
+void
+latency_hist_print(const struct latency_hist *h, FILE *out)
+{
+	fprintf(out, "value[nsec];percentile;total-count\n");
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < NBUCKETS; i++) {
+		if (h->buckets[i] == 0)
+			continue;
+
+		total += h->buckets[i];
+		uint64_t value = hist_highest(i);
+		fprintf(out, "%" PRIu64 ";%f;%" PRIu64 "\n",
+			value < h->max ? value : h->max,
+			100.0 * (double)total / (double)h->count, total);
+	}
+}
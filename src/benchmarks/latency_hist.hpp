@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2020, Intel Corporation */
+/*
+ * latency_hist.hpp -- declarations of latency_hist module
+ *
+ * Log-linear (HDR-style) histogram of latencies. Values are grouped in
+ * power of two ranges, each of which is split into a constant number of
+ * equally sized sub-buckets, so the relative error of the recorded values
+ * is bounded regardless of their magnitude.
+ */
+#ifndef LATENCY_HIST_HPP
+#define LATENCY_HIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+struct latency_hist;
+
+struct latency_hist *latency_hist_alloc(void);
+void latency_hist_free(struct latency_hist *h);
+void latency_hist_reset(struct latency_hist *h);
+void latency_hist_record(struct latency_hist *h, uint64_t value);
+void latency_hist_merge(struct latency_hist *dst,
+			const struct latency_hist *src);
+uint64_t latency_hist_percentile(const struct latency_hist *h, double pctl);
+void latency_hist_print(const struct latency_hist *h, FILE *out);
+
+#endif /* LATENCY_HIST_HPP */
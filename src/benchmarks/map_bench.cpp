@@ -1,10 +1,12 @@
 // SPDX-License-Identifier: BSD-3-Clause
 /* Copyright 2015-2018, Intel Corporation */
 /*
- * map_bench.cpp -- benchmarks for: ctree, btree, rtree, rbtree, hashmap_atomic
- * and hashmap_tx from examples.
+ * map_bench.cpp -- benchmarks for: ctree, btree, rtree, rbtree, hashmap_atomic,
+ * hashmap_tx, hashmap_rp and skiplist from examples.
  */
 #include <cassert>
+#include <cinttypes>
+#include <cmath>
 
 #include "benchmark.hpp"
 #include "file.h"
@@ -20,6 +22,7 @@
 #include "map_hashmap_tx.h"
 #include "map_rbtree.h"
 #include "map_rtree.h"
+#include "map_skiplist.h"
 
 /* Values less than 3 is not suitable for current rtree implementation */
 #define FACTOR 3
@@ -50,21 +53,69 @@ static const struct {
 	{"ctree", MAP_CTREE},		{"btree", MAP_BTREE},
 	{"rtree", MAP_RTREE},		{"rbtree", MAP_RBTREE},
 	{"hashmap_tx", MAP_HASHMAP_TX}, {"hashmap_atomic", MAP_HASHMAP_ATOMIC},
-	{"hashmap_rp", MAP_HASHMAP_RP}};
+	{"hashmap_rp", MAP_HASHMAP_RP}, {"skiplist", MAP_SKIPLIST}};
 
 #define MAP_TYPES_NUM (sizeof(map_types) / sizeof(map_types[0]))
 
+/* operations of map_mixed benchmark */
+enum mixed_op {
+	MIXED_READ,
+	MIXED_UPDATE,
+	MIXED_INSERT,
+	MIXED_SCAN,
+
+	MAX_MIXED_OP
+};
+
+static const char *mixed_op_names[MAX_MIXED_OP] = {"read", "update",
+						    "insert", "scan"};
+
+/* distributions of records accessed by map_mixed benchmark */
+enum mixed_dist {
+	MIXED_DIST_UNIFORM,
+	MIXED_DIST_ZIPFIAN,
+	MIXED_DIST_LATEST,
+};
+
+/* skew of the zipfian distribution, the same as the YCSB default */
+#define ZIPF_THETA 0.99
+
+/*
+ * zipf -- state of the zipfian distribution generator over n items, as
+ * described in "Quickly Generating Billion-Record Synthetic Databases"
+ * by Gray et al.
+ */
+struct zipf {
+	uint64_t n;
+	double zetan;
+	double zeta2;
+	double alpha;
+	double eta;
+};
+
 struct map_bench_args {
 	unsigned seed;
 	uint64_t max_key;
 	char *type;
 	bool ext_tx;
 	bool alloc;
+	size_t records;	    /* number of records loaded by map_mixed */
+	unsigned ratio[MAX_MIXED_OP]; /* percentage of each operation */
+	size_t scan_len;    /* number of records read by a scan */
+	char *distribution; /* distribution of accessed records */
 };
 
 struct map_bench_worker {
 	uint64_t *keys;
 	size_t nkeys;
+
+	/* map_mixed only */
+	rng_t rng;
+	struct zipf zipf;
+	char *value;
+	uint64_t nops[MAX_MIXED_OP];
+	uint64_t lat_sum[MAX_MIXED_OP];
+	struct latency_hist *hist[MAX_MIXED_OP];
 };
 
 struct map_bench {
@@ -76,6 +127,12 @@ struct map_bench {
 	size_t nkeys;
 	size_t init_nkeys;
 	uint64_t *keys;
+
+	/* map_mixed only */
+	uint64_t nrecords; /* number of records in the map */
+	enum mixed_dist dist;
+	struct zipf zipf; /* zipfian generator for the loaded records */
+
 	struct benchmark_args *args;
 	struct map_bench_args *margs;
 
@@ -507,7 +564,8 @@ map_common_init(struct benchmark *bench, struct benchmark_args *args)
 		map_bench->get = map_get_root_op;
 	}
 
-	map_bench->nkeys = args->n_threads * args->n_ops_per_thread;
+	map_bench->nkeys = args->n_threads * args->n_ops_per_thread +
+		map_bench->margs->records;
 	map_bench->init_nkeys = map_bench->nkeys;
 	size_per_key = map_bench->margs->alloc
 		? SIZE_PER_KEY + map_bench->args->dsize + ALLOC_OVERHEAD
@@ -733,11 +791,419 @@ map_get_exit(struct benchmark *bench, struct benchmark_args *args)
 	return map_common_exit(bench, args);
 }
 
+/*
+ * zipf_zeta -- (internal) add the terms for items from, ..., to - 1 to the
+ * zeta sum
+ */
+static double
+zipf_zeta(double sum, uint64_t from, uint64_t to)
+{
+	for (uint64_t i = from; i < to; i++)
+		sum += 1.0 / pow((double)(i + 1), ZIPF_THETA);
+
+	return sum;
+}
+
+/*
+ * zipf_grow -- (internal) update the zipfian generator constants for n items
+ */
+static void
+zipf_grow(struct zipf *z, uint64_t n)
+{
+	assert(n > z->n);
+
+	z->zetan = zipf_zeta(z->zetan, z->n, n);
+	z->n = n;
+	z->eta = (1.0 - pow(2.0 / (double)n, 1.0 - ZIPF_THETA)) /
+		(1.0 - z->zeta2 / z->zetan);
+}
+
+/*
+ * zipf_init -- initialize the zipfian generator for n items
+ */
+static void
+zipf_init(struct zipf *z, uint64_t n)
+{
+	z->n = 0;
+	z->zetan = 0;
+	z->zeta2 = zipf_zeta(0, 0, 2);
+	z->alpha = 1.0 / (1.0 - ZIPF_THETA);
+	z->eta = 0;
+
+	if (n)
+		zipf_grow(z, n);
+}
+
+/*
+ * zipf_next -- return the next item from 0, ..., n - 1, where lower numbered
+ * items are more popular; the number of items may only grow between calls
+ */
+static uint64_t
+zipf_next(struct zipf *z, uint64_t n, double u)
+{
+	if (n != z->n)
+		zipf_grow(z, n);
+
+	double uz = u * z->zetan;
+	if (uz < 1.0)
+		return 0;
+	if (uz < 1.0 + pow(0.5, ZIPF_THETA))
+		return n > 1 ? 1 : 0;
+
+	auto ret = (uint64_t)((double)n *
+			      pow(z->eta * u - z->eta + 1.0, z->alpha));
+
+	return ret < n ? ret : n - 1;
+}
+
+/*
+ * mixed_key -- return the key of the record with given index; records are
+ * scattered over the key space, so the popular ones are not adjacent
+ */
+static uint64_t
+mixed_key(uint64_t index)
+{
+	return hash64(index);
+}
+
+/*
+ * mixed_next_index -- return the index of the next accessed record
+ */
+static uint64_t
+mixed_next_index(struct map_bench *map_bench, struct map_bench_worker *tworker)
+{
+	uint64_t n = map_bench->nrecords;
+	uint64_t r = rnd64_r(&tworker->rng);
+	/* uniformly distributed in [0, 1) */
+	double u = (double)(r >> 11) / (double)(1ULL << 53);
+
+	switch (map_bench->dist) {
+		case MIXED_DIST_UNIFORM:
+			return r % n;
+		case MIXED_DIST_ZIPFIAN:
+			return zipf_next(&tworker->zipf, n, u);
+		case MIXED_DIST_LATEST:
+			return n - 1 - zipf_next(&tworker->zipf, n, u);
+	}
+
+	assert(0);
+	return 0;
+}
+
+/*
+ * mixed_read -- read the value of the record with given index
+ */
+static int
+mixed_read(struct map_bench *map_bench, struct map_bench_worker *tworker,
+	   uint64_t index)
+{
+	PMEMoid val = map_get(map_bench->mapc, map_bench->map,
+			      mixed_key(index));
+	if (OID_IS_NULL(val))
+		return -1;
+
+	memcpy(tworker->value, pmemobj_direct(val), map_bench->args->dsize);
+
+	return 0;
+}
+
+/*
+ * mixed_update -- overwrite the value of the record with given index
+ */
+static int
+mixed_update(struct map_bench *map_bench, struct map_bench_worker *tworker,
+	     uint64_t index)
+{
+	PMEMoid val = map_get(map_bench->mapc, map_bench->map,
+			      mixed_key(index));
+	if (OID_IS_NULL(val))
+		return -1;
+
+	memset(tworker->value, (int)index, map_bench->args->dsize);
+
+	int ret = 0;
+	TX_BEGIN(map_bench->pop)
+	{
+		pmemobj_tx_add_range(val, 0, map_bench->args->dsize);
+		memcpy(pmemobj_direct(val), tworker->value,
+		       map_bench->args->dsize);
+	}
+	TX_ONABORT
+	{
+		ret = -1;
+	}
+	TX_END
+
+	return ret;
+}
+
+/*
+ * mixed_scan -- read values of a number of consecutive records, starting
+ * from the one with given index
+ */
+static int
+mixed_scan(struct map_bench *map_bench, struct map_bench_worker *tworker,
+	   uint64_t index)
+{
+	uint64_t end = index + map_bench->margs->scan_len;
+	if (end > map_bench->nrecords)
+		end = map_bench->nrecords;
+
+	for (uint64_t i = index; i < end; i++) {
+		if (mixed_read(map_bench, tworker, i))
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * map_mixed_op -- main operation for map_mixed benchmark
+ */
+static int
+map_mixed_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	auto *tworker = (struct map_bench_worker *)info->worker->priv;
+
+	/* pick the operation according to the configured ratios */
+	unsigned r = (unsigned)(rnd64_r(&tworker->rng) % 100);
+	unsigned op = 0;
+	while (r >= map_bench->margs->ratio[op]) {
+		r -= map_bench->margs->ratio[op];
+		op++;
+	}
+	assert(op < MAX_MIXED_OP);
+
+	/* in open-loop mode include the time spent in the queue */
+	benchmark_time_t beg, end;
+	if (info->args->rate)
+		beg = info->start;
+	else
+		benchmark_time_get(&beg);
+
+	int ret = 0;
+
+	mutex_lock_nofail(&map_bench->lock);
+
+	switch (op) {
+		case MIXED_READ:
+			ret = mixed_read(map_bench, tworker,
+					 mixed_next_index(map_bench, tworker));
+			break;
+		case MIXED_UPDATE:
+			ret = mixed_update(
+				map_bench, tworker,
+				mixed_next_index(map_bench, tworker));
+			break;
+		case MIXED_INSERT:
+			ret = map_insert_alloc_op(
+				map_bench, mixed_key(map_bench->nrecords));
+			if (ret == 0)
+				map_bench->nrecords++;
+			break;
+		case MIXED_SCAN:
+			ret = mixed_scan(map_bench, tworker,
+					 mixed_next_index(map_bench, tworker));
+			break;
+	}
+
+	mutex_unlock_nofail(&map_bench->lock);
+
+	benchmark_time_get(&end);
+
+	benchmark_time_t lat;
+	benchmark_time_diff(&lat, &beg, &end);
+	uint64_t nsecs = benchmark_time_get_nsecs(&lat);
+
+	tworker->nops[op]++;
+	tworker->lat_sum[op] += nsecs;
+	latency_hist_record(tworker->hist[op], nsecs);
+
+	return ret;
+}
+
+/*
+ * per operation latencies of map_mixed benchmark, accumulated over all
+ * workers and repeats until they are printed
+ */
+static uint64_t Mixed_nops[MAX_MIXED_OP];
+static uint64_t Mixed_lat_sum[MAX_MIXED_OP];
+static struct latency_hist *Mixed_hist[MAX_MIXED_OP];
+
+/*
+ * map_mixed_init_worker -- init worker function for map_mixed benchmark
+ */
+static int
+map_mixed_init_worker(struct benchmark *bench, struct benchmark_args *args,
+		      struct worker_info *worker)
+{
+	int ret = map_common_init_worker(bench, args, worker);
+	if (ret)
+		return ret;
+
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	auto *targs = (struct map_bench_args *)args->opts;
+	auto *tworker = (struct map_bench_worker *)worker->priv;
+
+	tworker->value = (char *)malloc(args->dsize);
+	if (!tworker->value) {
+		perror("malloc");
+		map_common_free_worker(bench, args, worker);
+		return -1;
+	}
+
+	randomize_r(&tworker->rng, targs->seed + worker->index);
+	tworker->zipf = map_bench->zipf;
+	for (unsigned i = 0; i < MAX_MIXED_OP; i++)
+		tworker->hist[i] = latency_hist_alloc();
+
+	return 0;
+}
+
+/*
+ * map_mixed_free_worker -- cleanup worker function for map_mixed benchmark
+ */
+static void
+map_mixed_free_worker(struct benchmark *bench, struct benchmark_args *args,
+		      struct worker_info *worker)
+{
+	auto *tworker = (struct map_bench_worker *)worker->priv;
+
+	for (unsigned i = 0; i < MAX_MIXED_OP; i++) {
+		if (!Mixed_hist[i])
+			Mixed_hist[i] = latency_hist_alloc();
+		latency_hist_merge(Mixed_hist[i], tworker->hist[i]);
+		Mixed_nops[i] += tworker->nops[i];
+		Mixed_lat_sum[i] += tworker->lat_sum[i];
+
+		latency_hist_free(tworker->hist[i]);
+	}
+	free(tworker->value);
+
+	map_common_free_worker(bench, args, worker);
+}
+
+/*
+ * map_mixed_load -- insert the initial records to the map
+ */
+static int
+map_mixed_load(struct map_bench *map_bench)
+{
+	for (uint64_t i = 0; i < map_bench->margs->records; i++) {
+		if (map_insert_alloc_op(map_bench, mixed_key(i))) {
+			fprintf(stderr, "loading record %" PRIu64 " failed\n",
+				i);
+			return -1;
+		}
+	}
+	map_bench->nrecords = map_bench->margs->records;
+
+	return 0;
+}
+
+/*
+ * map_mixed_init -- init function for map_mixed benchmark
+ */
+static int
+map_mixed_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *margs = (struct map_bench_args *)args->opts;
+
+	unsigned total = 0;
+	for (unsigned i = 0; i < MAX_MIXED_OP; i++)
+		total += margs->ratio[i];
+	if (total != 100) {
+		fprintf(stderr, "operation ratios must sum up to 100\n");
+		return -1;
+	}
+
+	enum mixed_dist dist;
+	if (strcmp(margs->distribution, "uniform") == 0) {
+		dist = MIXED_DIST_UNIFORM;
+	} else if (strcmp(margs->distribution, "zipfian") == 0) {
+		dist = MIXED_DIST_ZIPFIAN;
+	} else if (strcmp(margs->distribution, "latest") == 0) {
+		dist = MIXED_DIST_LATEST;
+	} else {
+		fprintf(stderr, "invalid distribution -- '%s'\n",
+			margs->distribution);
+		return -1;
+	}
+
+	/* records always have values, so they can be read and updated */
+	margs->alloc = true;
+
+	int ret = map_common_init(bench, args);
+	if (ret)
+		return ret;
+
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	map_bench->dist = dist;
+
+	if (map_mixed_load(map_bench)) {
+		map_common_exit(bench, args);
+		return -1;
+	}
+
+	/* precompute the zeta sum of loaded records for all workers */
+	zipf_init(&map_bench->zipf, map_bench->nrecords);
+
+	return 0;
+}
+
+/*
+ * map_mixed_print_extra_headers -- print names of per operation columns
+ */
+static void
+map_mixed_print_extra_headers()
+{
+	for (unsigned i = 0; i < MAX_MIXED_OP; i++) {
+		const char *name = mixed_op_names[i];
+		printf(";%s-ops;%s-latency-avg[nsec]"
+		       ";%s-latency-pctl-50.0%%[nsec]"
+		       ";%s-latency-pctl-99.0%%[nsec]"
+		       ";%s-latency-pctl-99.9%%[nsec]",
+		       name, name, name, name, name);
+	}
+}
+
+/*
+ * map_mixed_print_extra_values -- print per operation latencies and reset
+ * them for the next set of arguments
+ */
+static void
+map_mixed_print_extra_values(struct benchmark *bench,
+			     struct benchmark_args *args,
+			     struct total_results *res)
+{
+	for (unsigned i = 0; i < MAX_MIXED_OP; i++) {
+		uint64_t nops = Mixed_nops[i];
+		uint64_t avg = nops ? Mixed_lat_sum[i] / nops : 0;
+		uint64_t p50 = 0, p99 = 0, p999 = 0;
+		if (Mixed_hist[i]) {
+			p50 = latency_hist_percentile(Mixed_hist[i], 50.0);
+			p99 = latency_hist_percentile(Mixed_hist[i], 99.0);
+			p999 = latency_hist_percentile(Mixed_hist[i], 99.9);
+			latency_hist_free(Mixed_hist[i]);
+			Mixed_hist[i] = nullptr;
+		}
+		printf(";%" PRIu64 ";%" PRIu64 ";%" PRIu64 ";%" PRIu64
+		       ";%" PRIu64,
+		       nops, avg, p50, p99, p999);
+
+		Mixed_nops[i] = 0;
+		Mixed_lat_sum[i] = 0;
+	}
+}
+
 static struct benchmark_clo map_bench_clos[5];
+static struct benchmark_clo map_mixed_clos[9];
 
 static struct benchmark_info map_insert_info;
 static struct benchmark_info map_remove_info;
 static struct benchmark_info map_get_info;
+static struct benchmark_info map_mixed_info;
 
 CONSTRUCTOR(map_bench_constructor)
 void
@@ -747,7 +1213,8 @@ map_bench_constructor(void)
 	map_bench_clos[0].opt_long = "type";
 	map_bench_clos[0].descr =
 		"Type of container "
-		"[ctree|btree|rtree|rbtree|hashmap_tx|hashmap_atomic]";
+		"[ctree|btree|rtree|rbtree|hashmap_tx|hashmap_atomic|"
+		"hashmap_rp|skiplist]";
 
 	map_bench_clos[0].off = clo_field_offset(struct map_bench_args, type);
 	map_bench_clos[0].type = CLO_TYPE_STR;
@@ -793,6 +1260,63 @@ map_bench_constructor(void)
 	map_bench_clos[4].off = clo_field_offset(struct map_bench_args, alloc);
 	map_bench_clos[4].type = CLO_TYPE_FLAG;
 
+	/* map_mixed shares type and seed, the rest is workload specific */
+	map_mixed_clos[0] = map_bench_clos[0];
+	map_mixed_clos[1] = map_bench_clos[1];
+
+	map_mixed_clos[2].opt_long = "records";
+	map_mixed_clos[2].descr = "Number of records loaded before the run";
+	map_mixed_clos[2].off =
+		clo_field_offset(struct map_bench_args, records);
+	map_mixed_clos[2].type = CLO_TYPE_UINT;
+	map_mixed_clos[2].def = "10000";
+	map_mixed_clos[2].type_uint.size =
+		clo_field_size(struct map_bench_args, records);
+	map_mixed_clos[2].type_uint.base = CLO_INT_BASE_DEC;
+	map_mixed_clos[2].type_uint.min = 1;
+	map_mixed_clos[2].type_uint.max = SIZE_MAX;
+
+	static const char *const ratio_clos[MAX_MIXED_OP][3] = {
+		{"read-ratio", "Percentage of reads", "50"},
+		{"update-ratio", "Percentage of updates", "50"},
+		{"insert-ratio", "Percentage of inserts", "0"},
+		{"scan-ratio", "Percentage of scans", "0"},
+	};
+	for (unsigned i = 0; i < MAX_MIXED_OP; i++) {
+		struct benchmark_clo *clo = &map_mixed_clos[3 + i];
+		clo->opt_long = ratio_clos[i][0];
+		clo->descr = ratio_clos[i][1];
+		clo->off = clo_field_offset(struct map_bench_args, ratio) +
+			i * sizeof(unsigned);
+		clo->type = CLO_TYPE_UINT;
+		clo->def = ratio_clos[i][2];
+		clo->type_uint.size = sizeof(unsigned);
+		clo->type_uint.base = CLO_INT_BASE_DEC;
+		clo->type_uint.min = 0;
+		clo->type_uint.max = 100;
+	}
+
+	map_mixed_clos[7].opt_long = "scan-length";
+	map_mixed_clos[7].descr = "Number of consecutive records read by "
+				  "a scan";
+	map_mixed_clos[7].off =
+		clo_field_offset(struct map_bench_args, scan_len);
+	map_mixed_clos[7].type = CLO_TYPE_UINT;
+	map_mixed_clos[7].def = "100";
+	map_mixed_clos[7].type_uint.size =
+		clo_field_size(struct map_bench_args, scan_len);
+	map_mixed_clos[7].type_uint.base = CLO_INT_BASE_DEC;
+	map_mixed_clos[7].type_uint.min = 1;
+	map_mixed_clos[7].type_uint.max = SIZE_MAX;
+
+	map_mixed_clos[8].opt_long = "distribution";
+	map_mixed_clos[8].descr = "Distribution of accessed records "
+				  "[uniform|zipfian|latest]";
+	map_mixed_clos[8].off =
+		clo_field_offset(struct map_bench_args, distribution);
+	map_mixed_clos[8].type = CLO_TYPE_STR;
+	map_mixed_clos[8].def = "zipfian";
+
 	map_insert_info.name = "map_insert";
 	map_insert_info.brief = "Inserting to tree map";
 	map_insert_info.init = map_common_init;
@@ -843,4 +1367,24 @@ map_bench_constructor(void)
 	map_get_info.rm_file = true;
 	map_get_info.allow_poolset = true;
 	REGISTER_BENCHMARK(map_get_info);
+
+	map_mixed_info.name = "map_mixed";
+	map_mixed_info.brief = "Mixed workload of reads, updates, inserts "
+			       "and scans";
+	map_mixed_info.init = map_mixed_init;
+	map_mixed_info.exit = map_common_exit;
+	map_mixed_info.multithread = true;
+	map_mixed_info.multiops = true;
+	map_mixed_info.init_worker = map_mixed_init_worker;
+	map_mixed_info.free_worker = map_mixed_free_worker;
+	map_mixed_info.operation = map_mixed_op;
+	map_mixed_info.measure_time = true;
+	map_mixed_info.clos = map_mixed_clos;
+	map_mixed_info.nclos = ARRAY_SIZE(map_mixed_clos);
+	map_mixed_info.opts_size = sizeof(struct map_bench_args);
+	map_mixed_info.rm_file = true;
+	map_mixed_info.allow_poolset = true;
+	map_mixed_info.print_extra_headers = map_mixed_print_extra_headers;
+	map_mixed_info.print_extra_values = map_mixed_print_extra_values;
+	REGISTER_BENCHMARK(map_mixed_info);
 }
@@ -94,7 +94,7 @@ static struct version_s {
 static struct bench_list benchmarks;
 
 /* common arguments for benchmarks */
-static struct benchmark_clo pmembench_clos[13];
+static struct benchmark_clo pmembench_clos[16];
 
 /* list of arguments for pmembench */
 static struct benchmark_clo pmembench_opts[2];
@@ -265,6 +265,38 @@ pmembench_constructor(void)
 	pmembench_clos[12].off =
 		clo_field_offset(struct benchmark_args, is_dynamic_poolset);
 	pmembench_clos[12].ignore_in_res = true;
+
+	pmembench_clos[13].opt_long = "rate";
+	pmembench_clos[13].type = CLO_TYPE_UINT;
+	pmembench_clos[13].descr =
+		"Target number of operations per second of all threads, "
+		"0 runs operations back-to-back (closed-loop)";
+	pmembench_clos[13].off = clo_field_offset(struct benchmark_args, rate);
+	pmembench_clos[13].def = "0";
+	pmembench_clos[13].type_uint.size =
+		clo_field_size(struct benchmark_args, rate);
+	pmembench_clos[13].type_uint.base = CLO_INT_BASE_DEC;
+	pmembench_clos[13].type_uint.min = 0;
+	pmembench_clos[13].type_uint.max = ULONG_MAX;
+
+	pmembench_clos[14].opt_long = "arrival";
+	pmembench_clos[14].type = CLO_TYPE_STR;
+	pmembench_clos[14].descr =
+		"Distribution of intervals between operations when rate is "
+		"set: fixed, poisson";
+	pmembench_clos[14].off =
+		clo_field_offset(struct benchmark_args, arrival);
+	pmembench_clos[14].def = "fixed";
+
+	pmembench_clos[15].opt_long = "latency-hist";
+	pmembench_clos[15].type = CLO_TYPE_STR;
+	pmembench_clos[15].descr =
+		"File to which latency histograms are appended when rate is "
+		"set";
+	pmembench_clos[15].off =
+		clo_field_offset(struct benchmark_args, latency_hist);
+	pmembench_clos[15].def = "";
+	pmembench_clos[15].ignore_in_res = true;
 }
 
 /*
@@ -362,12 +394,73 @@ pmembench_merge_clos(struct benchmark *bench)
 	bench->args_size = size;
 }
 
+/*
+ * pmembench_next_arrival -- return the interval in nanoseconds between
+ * intended starts of two consecutive operations of a worker in open-loop mode
+ */
+static double
+pmembench_next_arrival(bool poisson, double interval, rng_t *rng)
+{
+	if (!poisson)
+		return interval;
+
+	/* uniformly distributed in (0, 1] */
+	double u = (double)((rnd64_r(rng) >> 11) + 1) / (double)(1ULL << 53);
+
+	return -log(u) * interval;
+}
+
+/*
+ * pmembench_run_worker_open_loop -- run worker with benchmark operation
+ * issued at the target rate, regardless of how long previous operations took
+ */
+static int
+pmembench_run_worker_open_loop(struct benchmark *bench,
+			       struct worker_info *winfo)
+{
+	struct benchmark_args *args = winfo->opinfo[0].args;
+	double interval = 1e9 * args->n_threads / (double)args->rate;
+	bool poisson = strcmp(args->arrival, "poisson") == 0;
+
+	rng_t rng;
+	randomize_r(&rng, args->seed ? args->seed + winfo->index : 0);
+
+	benchmark_time_get(&winfo->beg);
+	unsigned long long beg = benchmark_time_get_nsecs(&winfo->beg);
+	double offset = 0;
+	benchmark_time_t now;
+	for (size_t i = 0; i < winfo->nops; i++) {
+		struct operation_info *info = &winfo->opinfo[i];
+		benchmark_time_set(&info->start,
+				   beg + (unsigned long long)offset);
+
+		/* operations behind the schedule are issued right away */
+		benchmark_time_get(&now);
+		while (benchmark_time_compare(&now, &info->start) < 0) {
+			sched_yield();
+			benchmark_time_get(&now);
+		}
+
+		if (bench->info->operation(bench, info))
+			return -1;
+		benchmark_time_get(&info->end);
+
+		offset += pmembench_next_arrival(poisson, interval, &rng);
+	}
+	benchmark_time_get(&winfo->end);
+
+	return 0;
+}
+
 /*
  * pmembench_run_worker -- run worker with benchmark operation
  */
 static int
 pmembench_run_worker(struct benchmark *bench, struct worker_info *winfo)
 {
+	if (winfo->nops != 0 && winfo->opinfo[0].args->rate != 0)
+		return pmembench_run_worker_open_loop(bench, winfo);
+
 	benchmark_time_get(&winfo->beg);
 	for (size_t i = 0; i < winfo->nops; i++) {
 		if (bench->info->operation(bench, &winfo->opinfo[i]))
@@ -454,6 +547,32 @@ pmembench_print_results(struct benchmark *bench, struct benchmark_args *args,
 	printf("\n");
 }
 
+/*
+ * pmembench_print_latency_hist -- append latency histogram of open-loop run
+ * to the file given by latency-hist argument
+ */
+static int
+pmembench_print_latency_hist(struct pmembench *pb, struct benchmark *bench,
+			     struct benchmark_args *args,
+			     struct total_results *res)
+{
+	FILE *out = os_fopen(args->latency_hist, "a");
+	if (out == nullptr) {
+		perror(args->latency_hist);
+		return -1;
+	}
+
+	fprintf(out, "%s: %s rate=%zu arrival=%s threads=%u\n",
+		pb->scenario ? pb->scenario->name : "", bench->info->name,
+		args->rate, args->arrival, args->n_threads);
+	latency_hist_print(res->hist, out);
+	fprintf(out, "\n");
+
+	fclose(out);
+
+	return 0;
+}
+
 /*
  * pmembench_parse_clos -- parse command line arguments for benchmark
  */
@@ -626,6 +745,12 @@ results_store(struct bench_results *res, struct benchmark_worker **workers,
 			res->thres[i]->end_op[j] =
 				workers[i]->info.opinfo[j].end;
 		}
+		if (res->thres[i]->start_op) {
+			for (size_t j = 0; j < nops; j++) {
+				res->thres[i]->start_op[j] =
+					workers[i]->info.opinfo[j].start;
+			}
+		}
 	}
 }
 
@@ -675,6 +800,7 @@ results_alloc(struct benchmark_args *args)
 	total->nrepeats = args->repeats;
 	total->nthreads = args->n_threads;
 	total->nops = args->n_ops_per_thread;
+	total->hist = args->rate ? latency_hist_alloc() : nullptr;
 	total->res = (struct bench_results *)malloc(args->repeats *
 						    sizeof(*total->res));
 	assert(total->res != nullptr);
@@ -691,6 +817,15 @@ results_alloc(struct benchmark_args *args)
 				args->n_ops_per_thread *
 					sizeof(benchmark_time_t));
 			assert(res->thres[j] != nullptr);
+
+			res->thres[j]->start_op = nullptr;
+			if (args->rate) {
+				res->thres[j]->start_op =
+					(benchmark_time_t *)malloc(
+						args->n_ops_per_thread *
+						sizeof(benchmark_time_t));
+				assert(res->thres[j]->start_op != nullptr);
+			}
 		}
 	}
 
@@ -704,14 +839,38 @@ static void
 results_free(struct total_results *total)
 {
 	for (size_t i = 0; i < total->nrepeats; i++) {
-		for (size_t j = 0; j < total->nthreads; j++)
+		for (size_t j = 0; j < total->nthreads; j++) {
+			free(total->res[i].thres[j]->start_op);
 			free(total->res[i].thres[j]);
+		}
 		free(total->res[i].thres);
 	}
 	free(total->res);
+	if (total->hist)
+		latency_hist_free(total->hist);
 	free(total);
 }
 
+/*
+ * op_latency -- return latency of an operation; in open-loop mode it is
+ * measured from the intended start of the operation, so it includes the time
+ * the operation was queued behind the previous ones
+ */
+static uint64_t
+op_latency(struct thread_results *thres, size_t o)
+{
+	benchmark_time_t *beg;
+	if (thres->start_op)
+		beg = &thres->start_op[o];
+	else
+		beg = o == 0 ? &thres->beg : &thres->end_op[o - 1];
+
+	benchmark_time_t lat;
+	benchmark_time_diff(&lat, beg, &thres->end_op[o]);
+
+	return benchmark_time_get_nsecs(&lat);
+}
+
 /*
  * get_total_results -- return results of all repeats of scenario
  */
@@ -812,16 +971,15 @@ get_total_results(struct total_results *tres)
 	tres->total.std_dev = sqrt(tres->total.std_dev / tres->nrepeats);
 
 	/* latency */
+	if (tres->hist)
+		latency_hist_reset(tres->hist);
+
 	for (size_t i = 0; i < tres->nrepeats; i++) {
 		struct bench_results *res = &tres->res[i];
 		for (size_t j = 0; j < tres->nthreads; j++) {
 			struct thread_results *thres = res->thres[j];
-			benchmark_time_t *beg = &thres->beg;
 			for (size_t o = 0; o < tres->nops; o++) {
-				benchmark_time_t lat;
-				benchmark_time_diff(&lat, beg,
-						    &thres->end_op[o]);
-				uint64_t nsecs = benchmark_time_get_nsecs(&lat);
+				uint64_t nsecs = op_latency(thres, o);
 
 				/* min, max latency */
 				if (nsecs > tres->latency.max)
@@ -831,7 +989,8 @@ get_total_results(struct total_results *tres)
 
 				tres->latency.avg += nsecs;
 
-				beg = &thres->end_op[o];
+				if (tres->hist)
+					latency_hist_record(tres->hist, nsecs);
 			}
 		}
 	}
@@ -841,8 +1000,12 @@ get_total_results(struct total_results *tres)
 	assert(count > 0);
 	tres->latency.avg /= count;
 
-	auto *ntotals = (uint64_t *)calloc(count, sizeof(uint64_t));
-	assert(ntotals != nullptr);
+	/* the histogram is used instead of sorting all latencies */
+	uint64_t *ntotals = nullptr;
+	if (!tres->hist) {
+		ntotals = (uint64_t *)calloc(count, sizeof(uint64_t));
+		assert(ntotals != nullptr);
+	}
 	count = 0;
 
 	/* std deviation of latency and percentiles */
@@ -850,21 +1013,16 @@ get_total_results(struct total_results *tres)
 		struct bench_results *res = &tres->res[i];
 		for (size_t j = 0; j < tres->nthreads; j++) {
 			struct thread_results *thres = res->thres[j];
-			benchmark_time_t *beg = &thres->beg;
 			for (size_t o = 0; o < tres->nops; o++) {
-				benchmark_time_t lat;
-				benchmark_time_diff(&lat, beg,
-						    &thres->end_op[o]);
-				uint64_t nsecs = benchmark_time_get_nsecs(&lat);
+				uint64_t nsecs = op_latency(thres, o);
 
 				uint64_t dev = (nsecs - tres->latency.avg);
 				dev *= dev;
 
 				tres->latency.std_dev += dev;
 
-				beg = &thres->end_op[o];
-
-				ntotals[count] = nsecs;
+				if (ntotals)
+					ntotals[count] = nsecs;
 				++count;
 			}
 		}
@@ -873,14 +1031,23 @@ get_total_results(struct total_results *tres)
 	tres->latency.std_dev = sqrt(tres->latency.std_dev / count);
 
 	/* find 50%, 99.0% and 99.9% percentiles */
-	qsort(ntotals, count, sizeof(uint64_t), compare_uint64t);
-	uint64_t p50_0 = count * 50 / 100;
-	uint64_t p99_0 = count * 99 / 100;
-	uint64_t p99_9 = count * 999 / 1000;
-	tres->latency.pctl50_0p = ntotals[p50_0];
-	tres->latency.pctl99_0p = ntotals[p99_0];
-	tres->latency.pctl99_9p = ntotals[p99_9];
-	free(ntotals);
+	if (tres->hist) {
+		tres->latency.pctl50_0p =
+			latency_hist_percentile(tres->hist, 50.0);
+		tres->latency.pctl99_0p =
+			latency_hist_percentile(tres->hist, 99.0);
+		tres->latency.pctl99_9p =
+			latency_hist_percentile(tres->hist, 99.9);
+	} else {
+		qsort(ntotals, count, sizeof(uint64_t), compare_uint64t);
+		uint64_t p50_0 = count * 50 / 100;
+		uint64_t p99_0 = count * 99 / 100;
+		uint64_t p99_9 = count * 999 / 1000;
+		tres->latency.pctl50_0p = ntotals[p50_0];
+		tres->latency.pctl99_0p = ntotals[p99_0];
+		tres->latency.pctl99_9p = ntotals[p99_9];
+		free(ntotals);
+	}
 
 	free(totals);
 	free(tend);
@@ -1359,6 +1526,14 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 		args->opts = (void *)((uintptr_t)args +
 				      sizeof(struct benchmark_args));
 
+		if (strcmp(args->arrival, "fixed") != 0 &&
+		    strcmp(args->arrival, "poisson") != 0) {
+			fprintf(stderr, "invalid arrival distribution: %s\n",
+				args->arrival);
+			ret = -1;
+			goto out;
+		}
+
 		if (args->is_dynamic_poolset) {
 			if (!bench->info->allow_poolset) {
 				fprintf(stderr,
@@ -1431,6 +1606,14 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 		get_total_results(total_res);
 		pmembench_print_results(bench, args, total_res);
 
+		if (total_res->hist && args->latency_hist &&
+		    *args->latency_hist != '\0') {
+			ret = pmembench_print_latency_hist(
+				pb, bench, args, total_res);
+			if (ret != 0)
+				goto out;
+		}
+
 		args->n_ops_per_thread = n_ops_per_thread_copy;
 		args->n_threads = n_threads_copy;
 
@@ -7,6 +7,7 @@
  */
 #include <cassert>
 #include <cerrno>
+#include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -27,6 +28,9 @@
  */
 #define MAX_OPS 10000
 
+/* size of a field modified in range-persist mode of obj_tx_add_range */
+#define SPARSE_FIELD_SIZE 8
+
 TOID_DECLARE(struct item, 0);
 
 struct obj_tx_bench;
@@ -56,6 +60,7 @@ enum op_mode {
 	OP_MODE_ONE_OBJ_NESTED,
 	OP_MODE_ONE_OBJ_RANGE,
 	OP_MODE_ONE_OBJ_NESTED_RANGE,
+	OP_MODE_ONE_OBJ_RANGE_PERSIST,
 	OP_MODE_ALL_OBJ,
 	OP_MODE_ALL_OBJ_NESTED,
 	OP_MODE_UNKNOWN
@@ -83,7 +88,11 @@ enum nesting_mode {
 /*
  * add_range_mode -- operation type for obj_add_range benchmark
  */
-enum add_range_mode { ADD_RANGE_MODE_ONE_TX, ADD_RANGE_MODE_NESTED_TX };
+enum add_range_mode {
+	ADD_RANGE_MODE_ONE_TX,
+	ADD_RANGE_MODE_NESTED_TX,
+	ADD_RANGE_MODE_PERSIST_TX
+};
 
 /*
  * parse_mode -- parsing function type
@@ -129,6 +138,9 @@ struct obj_tx_args {
 	 *		  times in many nested transactions.
 	 *		- all-obj-nested - all objects are added to undo log in
 	 *		  many separate, nested transactions.
+	 *		- range-persist - every other 8-byte field of one
+	 *		  object is added to undo log, modified and persisted
+	 *		  in one transaction.
 	 */
 	char *operation;
 
@@ -155,6 +167,8 @@ struct obj_tx_args {
 	unsigned min_rsize; /* minimum reallocation size */
 	unsigned rsize;	    /* reallocation size */
 	bool change_type;   /* change type number in reallocation */
+	bool persist_stats; /* report flush and fence counters */
+	bool flush_dedup;   /* flush dirty lines once, at commit */
 	size_t obj_size;    /* size of each allocated object */
 	size_t n_ops;	    /* number of operations */
 	int parse_mode;	    /* type of parsing function */
@@ -198,6 +212,13 @@ static struct obj_tx_bench {
 	fn_op_t *fn_op;
 } obj_bench;
 
+/*
+ * Flush and fence counters of the measured operations, accumulated over all
+ * repeats until they are printed.
+ */
+static struct pobj_persist_stats Persist_stats;
+static uint64_t Persist_nops;
+
 /*
  * item -- TOID's structure
  */
@@ -444,6 +465,40 @@ add_range_tx(struct obj_tx_bench *obj_bench, struct worker_info *worker,
 	return ret;
 }
 
+/*
+ * add_range_persist_tx -- main operations of the obj_tx_add_range in
+ * range-persist mode, every range is modified and persisted after it is added.
+ */
+static int
+add_range_persist_tx(struct obj_tx_bench *obj_bench, struct worker_info *worker,
+		     size_t idx)
+{
+	int ret = 0;
+	size_t i = 0;
+	auto *obj_worker = (struct obj_tx_worker *)worker->priv;
+	size_t nfields = obj_bench->sizes[0] / (2 * SPARSE_FIELD_SIZE);
+	TX_BEGIN(obj_bench->pop)
+	{
+		for (i = 0; i < nfields; i++) {
+			size_t n_oid = obj_bench->n_oid(i);
+			struct offset offset = obj_bench->fn_off(obj_bench, i);
+			PMEMoid oid = obj_worker->oids[n_oid].oid;
+			ret = pmemobj_tx_add_range(oid, offset.off,
+						   offset.size);
+			char *ptr = (char *)pmemobj_direct(oid) + offset.off;
+			memset(ptr, (int)i, offset.size);
+			pmemobj_persist(obj_bench->pop, ptr, offset.size);
+		}
+	}
+	TX_ONABORT
+	{
+		fprintf(stderr, "transaction failed\n");
+		ret = -1;
+	}
+	TX_END
+	return ret;
+}
+
 /*
  * obj_op_sim -- main function for benchmarks which simulates nested
  * transactions on dram or pmemobj atomic API by calling function recursively.
@@ -546,6 +601,8 @@ parse_op_mode_add_range(const char *arg)
 		return OP_MODE_ONE_OBJ_RANGE;
 	else if (strcmp(arg, "range-nested") == 0)
 		return OP_MODE_ONE_OBJ_NESTED_RANGE;
+	else if (strcmp(arg, "range-persist") == 0)
+		return OP_MODE_ONE_OBJ_RANGE_PERSIST;
 	else if (strcmp(arg, "all-obj") == 0)
 		return OP_MODE_ALL_OBJ;
 	else if (strcmp(arg, "all-obj-nested") == 0)
@@ -577,7 +634,8 @@ static fn_op_t free_op[] = {free_dram, free_tx, free_pmem, no_free};
 
 static fn_op_t realloc_op[] = {realloc_dram, realloc_tx, realloc_pmem};
 
-static fn_op_t add_range_op[] = {add_range_tx, add_range_nested_tx};
+static fn_op_t add_range_op[] = {add_range_tx, add_range_nested_tx,
+				  add_range_persist_tx};
 
 static fn_parse_t parse_op[] = {parse_op_mode, parse_op_mode_add_range};
 
@@ -660,6 +718,19 @@ off_range(struct obj_tx_bench *obj_bench, size_t idx)
 	return offset;
 }
 
+/*
+ * off_range_sparse -- returns offset for field in object, leaving a gap of the
+ * same size after every field.
+ */
+static struct offset
+off_range_sparse(struct obj_tx_bench *obj_bench, size_t idx)
+{
+	struct offset offset;
+	offset.size = SPARSE_FIELD_SIZE;
+	offset.off = 2 * SPARSE_FIELD_SIZE * idx;
+	return offset;
+}
+
 /*
  * rand_values -- allocates array and if range mode calculates random
  * values as allocation sizes for each object otherwise populates whole array
@@ -718,6 +789,77 @@ obj_tx_op(struct benchmark *bench, struct operation_info *info)
 	return ret;
 }
 
+/*
+ * obj_tx_persist_stats_reset -- zero the flush and fence counters of the pool,
+ * so that only the writes made by the measured operations are accounted
+ */
+static void
+obj_tx_persist_stats_reset(struct obj_tx_bench *obj_bench)
+{
+	if (!obj_bench->obj_args->persist_stats ||
+	    obj_bench->lib_mode == LIB_MODE_DRAM)
+		return;
+
+	if (pmemobj_ctl_exec(obj_bench->pop, "stats.persist.reset", nullptr))
+		fprintf(stderr, "cannot reset flush and fence counters\n");
+}
+
+/*
+ * obj_tx_persist_stats_collect -- add the flush and fence counters of the
+ * finished repeat to the accumulated ones
+ */
+static void
+obj_tx_persist_stats_collect(struct obj_tx_bench *obj_bench,
+			     struct benchmark_args *args)
+{
+	if (!obj_bench->obj_args->persist_stats ||
+	    obj_bench->lib_mode == LIB_MODE_DRAM)
+		return;
+
+	struct pobj_persist_stats stats;
+	if (pmemobj_ctl_get(obj_bench->pop, "stats.persist.total", &stats)) {
+		fprintf(stderr, "cannot read flush and fence counters\n");
+		return;
+	}
+
+	Persist_stats.flushed_lines += stats.flushed_lines;
+	Persist_stats.redundant_lines += stats.redundant_lines;
+	Persist_stats.fences += stats.fences;
+	Persist_stats.temporal_bytes += stats.temporal_bytes;
+	Persist_stats.nontemporal_bytes += stats.nontemporal_bytes;
+	Persist_nops += args->n_ops_per_thread * args->n_threads;
+}
+
+/*
+ * obj_tx_print_extra_headers -- print names of flush and fence columns
+ */
+static void
+obj_tx_print_extra_headers()
+{
+	printf(";flushed-lines/op;redundant-lines/op;fences/op"
+	       ";temporal-bytes/op;nontemporal-bytes/op");
+}
+
+/*
+ * obj_tx_print_extra_values -- print average flush and fence counters per
+ * operation and reset them for the next set of arguments
+ */
+static void
+obj_tx_print_extra_values(struct benchmark *bench, struct benchmark_args *args,
+			  struct total_results *res)
+{
+	double nops = Persist_nops ? (double)Persist_nops : 1.0;
+
+	printf(";%f;%f;%f;%f;%f", (double)Persist_stats.flushed_lines / nops,
+	       (double)Persist_stats.redundant_lines / nops,
+	       (double)Persist_stats.fences / nops,
+	       (double)Persist_stats.temporal_bytes / nops,
+	       (double)Persist_stats.nontemporal_bytes / nops);
+
+	memset(&Persist_stats, 0, sizeof(Persist_stats));
+	Persist_nops = 0;
+}
+
 /*
  * obj_tx_init_worker -- common part for the worker initialization functions
  * for transactional benchmarks.
@@ -747,6 +889,8 @@ obj_tx_init_worker(struct benchmark *bench, struct benchmark_args *args,
 		perror("calloc");
 		return -1;
 	}
+
+	obj_tx_persist_stats_reset(obj_bench);
 	return 0;
 }
 
@@ -770,6 +914,8 @@ obj_tx_init_worker_alloc_obj(struct benchmark *bench,
 		if (alloc_op[obj_bench->lib_mode](obj_bench, worker, i) != 0)
 			goto out;
 	}
+
+	obj_tx_persist_stats_reset(obj_bench);
 	return 0;
 out:
 	for (; i > 0; i--)
@@ -791,6 +937,11 @@ obj_tx_exit_worker(struct benchmark *bench, struct benchmark_args *args,
 {
 	auto *obj_bench = (struct obj_tx_bench *)pmembench_get_priv(bench);
 	auto *obj_worker = (struct obj_tx_worker *)worker->priv;
+
+	/* all workers have finished, collect before any object is freed */
+	if (worker->index == 0)
+		obj_tx_persist_stats_collect(obj_bench, args);
+
 	for (unsigned i = 0; i < obj_bench->n_objs; i++)
 		free_op[obj_bench->lib_op_free](obj_bench, worker, i);
 
@@ -831,10 +982,19 @@ obj_tx_add_range_init(struct benchmark *bench, struct benchmark_args *args)
 
 		obj_bench->sizes[0] = args->dsize;
 	}
+	if (obj_bench->op_mode == OP_MODE_ONE_OBJ_RANGE_PERSIST) {
+		obj_bench->fn_off = off_range_sparse;
+		if (args->dsize < 2 * SPARSE_FIELD_SIZE)
+			args->dsize = 2 * SPARSE_FIELD_SIZE;
+
+		obj_bench->sizes[0] = args->dsize;
+	}
 	obj_bench->lib_op = (obj_bench->op_mode == OP_MODE_ONE_OBJ ||
 			     obj_bench->op_mode == OP_MODE_ALL_OBJ)
 		? ADD_RANGE_MODE_ONE_TX
 		: ADD_RANGE_MODE_NESTED_TX;
+	if (obj_bench->op_mode == OP_MODE_ONE_OBJ_RANGE_PERSIST)
+		obj_bench->lib_op = ADD_RANGE_MODE_PERSIST_TX;
 	return 0;
 }
 
@@ -1030,6 +1190,26 @@ obj_tx_init(struct benchmark *bench, struct benchmark_args *args)
 		goto free_all;
 	}
 
+	if (obj_bench.obj_args->persist_stats) {
+		int enabled = 1;
+		if (pmemobj_ctl_set(obj_bench.pop, "stats.persist.enabled",
+				    &enabled)) {
+			perror("pmemobj_ctl_set");
+			pmemobj_close(obj_bench.pop);
+			goto free_all;
+		}
+	}
+
+	if (obj_bench.obj_args->flush_dedup) {
+		int enabled = 1;
+		if (pmemobj_ctl_set(obj_bench.pop, "tx.flush.dedup",
+				    &enabled)) {
+			perror("pmemobj_ctl_set");
+			pmemobj_close(obj_bench.pop);
+			goto free_all;
+		}
+	}
+
 	return 0;
 free_all:
 	free(obj_bench.sizes);
@@ -1069,7 +1249,7 @@ obj_tx_realloc_exit(struct benchmark *bench, struct benchmark_args *args)
 }
 
 /* Array defining common command line arguments. */
-static struct benchmark_clo obj_tx_clo[8];
+static struct benchmark_clo obj_tx_clo[10];
 
 static struct benchmark_info obj_tx_alloc;
 static struct benchmark_info obj_tx_free;
@@ -1080,85 +1260,96 @@ CONSTRUCTOR(pmemobj_tx_constructor)
 void
 pmemobj_tx_constructor(void)
 {
-	obj_tx_clo[0].opt_short = 'T';
-	obj_tx_clo[0].opt_long = "type-number";
-	obj_tx_clo[0].descr = "Type number - one, rand, per-thread";
-	obj_tx_clo[0].def = "one";
-	obj_tx_clo[0].type = CLO_TYPE_STR;
-	obj_tx_clo[0].off = clo_field_offset(struct obj_tx_args, type_num);
-
-	obj_tx_clo[1].opt_short = 'O';
-	obj_tx_clo[1].opt_long = "operation";
-	obj_tx_clo[1].descr = "Type of operation";
-	obj_tx_clo[1].def = "basic";
-	obj_tx_clo[1].off = clo_field_offset(struct obj_tx_args, operation);
-	obj_tx_clo[1].type = CLO_TYPE_STR;
-
-	obj_tx_clo[2].opt_short = 'm';
-	obj_tx_clo[2].opt_long = "min-size";
-	obj_tx_clo[2].type = CLO_TYPE_UINT;
-	obj_tx_clo[2].descr = "Minimum allocation size";
-	obj_tx_clo[2].off = clo_field_offset(struct obj_tx_args, min_size);
-	obj_tx_clo[2].def = "0";
-	obj_tx_clo[2].type_uint.size =
-		clo_field_size(struct obj_tx_args, min_size);
-	obj_tx_clo[2].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
-	obj_tx_clo[2].type_uint.min = 0;
-	obj_tx_clo[2].type_uint.max = UINT_MAX;
-	/*
-	 * nclos field in benchmark_info structures is decremented to make this
-	 * options available only for obj_tx_alloc, obj_tx_free and
-	 * obj_tx_realloc benchmarks.
-	 */
-	obj_tx_clo[3].opt_short = 'L';
-	obj_tx_clo[3].opt_long = "lib";
-	obj_tx_clo[3].descr = "Type of library";
-	obj_tx_clo[3].def = "tx";
-	obj_tx_clo[3].off = clo_field_offset(struct obj_tx_args, lib);
+	obj_tx_clo[0].opt_long = "persist-stats";
+	obj_tx_clo[0].descr = "Report flush and fence counters per operation";
+	obj_tx_clo[0].type = CLO_TYPE_FLAG;
+	obj_tx_clo[0].off = clo_field_offset(struct obj_tx_args, persist_stats);
+
+	obj_tx_clo[1].opt_long = "flush-dedup";
+	obj_tx_clo[1].descr = "Flush every dirty cache line of a transaction "
+			      "once, at commit";
+	obj_tx_clo[1].type = CLO_TYPE_FLAG;
+	obj_tx_clo[1].off = clo_field_offset(struct obj_tx_args, flush_dedup);
+
+	obj_tx_clo[2].opt_short = 'T';
+	obj_tx_clo[2].opt_long = "type-number";
+	obj_tx_clo[2].descr = "Type number - one, rand, per-thread";
+	obj_tx_clo[2].def = "one";
+	obj_tx_clo[2].type = CLO_TYPE_STR;
+	obj_tx_clo[2].off = clo_field_offset(struct obj_tx_args, type_num);
+
+	obj_tx_clo[3].opt_short = 'O';
+	obj_tx_clo[3].opt_long = "operation";
+	obj_tx_clo[3].descr = "Type of operation";
+	obj_tx_clo[3].def = "basic";
+	obj_tx_clo[3].off = clo_field_offset(struct obj_tx_args, operation);
 	obj_tx_clo[3].type = CLO_TYPE_STR;
 
-	obj_tx_clo[4].opt_short = 'N';
-	obj_tx_clo[4].opt_long = "nestings";
+	obj_tx_clo[4].opt_short = 'm';
+	obj_tx_clo[4].opt_long = "min-size";
 	obj_tx_clo[4].type = CLO_TYPE_UINT;
-	obj_tx_clo[4].descr = "Number of nested transactions";
-	obj_tx_clo[4].off = clo_field_offset(struct obj_tx_args, nested);
+	obj_tx_clo[4].descr = "Minimum allocation size";
+	obj_tx_clo[4].off = clo_field_offset(struct obj_tx_args, min_size);
 	obj_tx_clo[4].def = "0";
 	obj_tx_clo[4].type_uint.size =
-		clo_field_size(struct obj_tx_args, nested);
+		clo_field_size(struct obj_tx_args, min_size);
 	obj_tx_clo[4].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
 	obj_tx_clo[4].type_uint.min = 0;
-	obj_tx_clo[4].type_uint.max = MAX_OPS;
-
-	obj_tx_clo[5].opt_short = 'r';
-	obj_tx_clo[5].opt_long = "min-rsize";
-	obj_tx_clo[5].type = CLO_TYPE_UINT;
-	obj_tx_clo[5].descr = "Minimum reallocation size";
-	obj_tx_clo[5].off = clo_field_offset(struct obj_tx_args, min_rsize);
-	obj_tx_clo[5].def = "0";
-	obj_tx_clo[5].type_uint.size =
-		clo_field_size(struct obj_tx_args, min_rsize);
-	obj_tx_clo[5].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
-	obj_tx_clo[5].type_uint.min = 0;
-	obj_tx_clo[5].type_uint.max = UINT_MAX;
-
-	obj_tx_clo[6].opt_short = 'R';
-	obj_tx_clo[6].opt_long = "realloc-size";
+	obj_tx_clo[4].type_uint.max = UINT_MAX;
+	/*
+	 * nclos field in benchmark_info structures is decremented to make this
+	 * options available only for obj_tx_alloc, obj_tx_free and
+	 * obj_tx_realloc benchmarks.
+	 */
+	obj_tx_clo[5].opt_short = 'L';
+	obj_tx_clo[5].opt_long = "lib";
+	obj_tx_clo[5].descr = "Type of library";
+	obj_tx_clo[5].def = "tx";
+	obj_tx_clo[5].off = clo_field_offset(struct obj_tx_args, lib);
+	obj_tx_clo[5].type = CLO_TYPE_STR;
+
+	obj_tx_clo[6].opt_short = 'N';
+	obj_tx_clo[6].opt_long = "nestings";
 	obj_tx_clo[6].type = CLO_TYPE_UINT;
-	obj_tx_clo[6].descr = "Reallocation size";
-	obj_tx_clo[6].off = clo_field_offset(struct obj_tx_args, rsize);
-	obj_tx_clo[6].def = "1";
+	obj_tx_clo[6].descr = "Number of nested transactions";
+	obj_tx_clo[6].off = clo_field_offset(struct obj_tx_args, nested);
+	obj_tx_clo[6].def = "0";
 	obj_tx_clo[6].type_uint.size =
-		clo_field_size(struct obj_tx_args, rsize);
+		clo_field_size(struct obj_tx_args, nested);
 	obj_tx_clo[6].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
-	obj_tx_clo[6].type_uint.min = 1;
-	obj_tx_clo[6].type_uint.max = ULONG_MAX;
+	obj_tx_clo[6].type_uint.min = 0;
+	obj_tx_clo[6].type_uint.max = MAX_OPS;
+
+	obj_tx_clo[7].opt_short = 'r';
+	obj_tx_clo[7].opt_long = "min-rsize";
+	obj_tx_clo[7].type = CLO_TYPE_UINT;
+	obj_tx_clo[7].descr = "Minimum reallocation size";
+	obj_tx_clo[7].off = clo_field_offset(struct obj_tx_args, min_rsize);
+	obj_tx_clo[7].def = "0";
+	obj_tx_clo[7].type_uint.size =
+		clo_field_size(struct obj_tx_args, min_rsize);
+	obj_tx_clo[7].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
+	obj_tx_clo[7].type_uint.min = 0;
+	obj_tx_clo[7].type_uint.max = UINT_MAX;
+
+	obj_tx_clo[8].opt_short = 'R';
+	obj_tx_clo[8].opt_long = "realloc-size";
+	obj_tx_clo[8].type = CLO_TYPE_UINT;
+	obj_tx_clo[8].descr = "Reallocation size";
+	obj_tx_clo[8].off = clo_field_offset(struct obj_tx_args, rsize);
+	obj_tx_clo[8].def = "1";
+	obj_tx_clo[8].type_uint.size =
+		clo_field_size(struct obj_tx_args, rsize);
+	obj_tx_clo[8].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
+	obj_tx_clo[8].type_uint.min = 1;
+	obj_tx_clo[8].type_uint.max = ULONG_MAX;
 
-	obj_tx_clo[7].opt_short = 'c';
-	obj_tx_clo[7].opt_long = "changed-type";
-	obj_tx_clo[7].descr = "Use another type number in "
+	obj_tx_clo[9].opt_short = 'c';
+	obj_tx_clo[9].opt_long = "changed-type";
+	obj_tx_clo[9].descr = "Use another type number in "
 			      "reallocation than in allocation";
-	obj_tx_clo[7].type = CLO_TYPE_FLAG;
-	obj_tx_clo[7].off = clo_field_offset(struct obj_tx_args, change_type);
+	obj_tx_clo[9].type = CLO_TYPE_FLAG;
+	obj_tx_clo[9].off = clo_field_offset(struct obj_tx_args, change_type);
 
 	obj_tx_alloc.name = "obj_tx_alloc";
 	obj_tx_alloc.brief = "pmemobj_tx_alloc() benchmark";
@@ -1175,6 +1366,8 @@ pmemobj_tx_constructor(void)
 	obj_tx_alloc.opts_size = sizeof(struct obj_tx_args);
 	obj_tx_alloc.rm_file = true;
 	obj_tx_alloc.allow_poolset = true;
+	obj_tx_alloc.print_extra_headers = obj_tx_print_extra_headers;
+	obj_tx_alloc.print_extra_values = obj_tx_print_extra_values;
 	REGISTER_BENCHMARK(obj_tx_alloc);
 
 	obj_tx_free.name = "obj_tx_free";
@@ -1192,6 +1385,8 @@ pmemobj_tx_constructor(void)
 	obj_tx_free.opts_size = sizeof(struct obj_tx_args);
 	obj_tx_free.rm_file = true;
 	obj_tx_free.allow_poolset = true;
+	obj_tx_free.print_extra_headers = obj_tx_print_extra_headers;
+	obj_tx_free.print_extra_values = obj_tx_print_extra_values;
 	REGISTER_BENCHMARK(obj_tx_free);
 
 	obj_tx_realloc.name = "obj_tx_realloc";
@@ -1209,6 +1404,8 @@ pmemobj_tx_constructor(void)
 	obj_tx_realloc.opts_size = sizeof(struct obj_tx_args);
 	obj_tx_realloc.rm_file = true;
 	obj_tx_realloc.allow_poolset = true;
+	obj_tx_realloc.print_extra_headers = obj_tx_print_extra_headers;
+	obj_tx_realloc.print_extra_values = obj_tx_print_extra_values;
 	REGISTER_BENCHMARK(obj_tx_realloc);
 
 	obj_tx_add_range.name = "obj_tx_add_range";
@@ -1226,5 +1423,7 @@ pmemobj_tx_constructor(void)
 	obj_tx_add_range.opts_size = sizeof(struct obj_tx_args);
 	obj_tx_add_range.rm_file = true;
 	obj_tx_add_range.allow_poolset = true;
+	obj_tx_add_range.print_extra_headers = obj_tx_print_extra_headers;
+	obj_tx_add_range.print_extra_values = obj_tx_print_extra_values;
 	REGISTER_BENCHMARK(obj_tx_add_range);
 }
@@ -0,0 +1,801 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * pool_open.cpp -- benchmarks for opening pmemobj, pmemblk and pmemlog pools,
+ * including the recovery of pmemobj pools left in a crash state
+ */
+#include <cassert>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmark.hpp"
+#include "file.h"
+#include "libpmemblk.h"
+#include "libpmemlog.h"
+#include "libpmemobj.h"
+#include "os.h"
+
+/* an internal libpmemobj code */
+#include "lane.h"
+#include "obj.h"
+#include "ulog.h"
+
+#define LAYOUT_NAME "pool_open"
+
+/* size of the object modified by the in-flight logs */
+#define VICTIM_SIZE LANE_UNDO_SIZE
+
+/*
+ * crash_log -- type of the in-flight log left in the crashed lanes
+ */
+enum crash_log {
+	CRASH_LOG_UNDO, /* snapshots of an unfinished transaction */
+	CRASH_LOG_REDO, /* committed, but not yet applied redo log */
+};
+
+/*
+ * open_phase -- measured phases of a single pool restart
+ */
+enum open_phase {
+	PHASE_CLEAN_OPEN, /* open of a cleanly closed pool (obj only) */
+	PHASE_OPEN,	  /* open, including recovery of crashed lanes */
+	PHASE_FIRST_OP,	  /* first allocation, write or append */
+	PHASE_CLOSE,	  /* close of the pool */
+
+	MAX_PHASE
+};
+
+/*
+ * pool_open_args -- benchmark specific command line options
+ */
+struct pool_open_args {
+	size_t psize;	      /* requested pool size */
+	unsigned fill;	      /* percentage of the pool filled with data */
+	unsigned frag;	      /* percentage of allocated objects freed */
+	unsigned lanes;	      /* number of lanes available at runtime */
+	unsigned crash_lanes; /* number of lanes with in-flight logs */
+	char *crash_log;      /* type of in-flight logs */
+};
+
+/*
+ * pool_open_bench -- benchmark context
+ */
+struct pool_open_bench {
+	struct pool_open_args *pargs;
+	enum crash_log crash_log;
+	uint64_t victim_off; /* object modified by the in-flight logs */
+	size_t nblocks;	     /* number of blocks in pmemblk pool */
+	char *buf;	     /* data of the first write or append */
+	char *nlanes_env;    /* saved value of PMEMOBJ_NLANES */
+};
+
+/*
+ * times of each phase, accumulated over all operations and repeats until
+ * they are printed
+ */
+static uint64_t Phase_nops;
+static uint64_t Phase_time[MAX_PHASE];
+
+/*
+ * phase_record -- (internal) add the time elapsed since *beg to the given
+ * phase and restart the measurement
+ */
+static void
+phase_record(enum open_phase phase, benchmark_time_t *beg)
+{
+	benchmark_time_t end, diff;
+	benchmark_time_get(&end);
+	benchmark_time_diff(&diff, beg, &end);
+
+	Phase_time[phase] += benchmark_time_get_nsecs(&diff);
+	*beg = end;
+}
+
+/*
+ * pool_size -- (internal) return size of the pool to create
+ */
+static size_t
+pool_size(struct benchmark_args *args, size_t min)
+{
+	enum file_type type = util_file_get_type(args->fname);
+	if (type == OTHER_ERROR) {
+		fprintf(stderr, "could not check type of file %s\n",
+			args->fname);
+		return SIZE_MAX;
+	}
+
+	if (args->is_poolset || type == TYPE_DEVDAX)
+		return 0;
+
+	auto *pargs = (struct pool_open_args *)args->opts;
+
+	return pargs->psize < min ? min : pargs->psize;
+}
+
+/*
+ * pool_open_init -- (internal) common part of the initialization
+ */
+static struct pool_open_bench *
+pool_open_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != nullptr);
+	assert(args != nullptr);
+	assert(args->opts != nullptr);
+
+	if (args->is_dynamic_poolset) {
+		fprintf(stderr, "dynamic poolsets are not supported\n");
+		return nullptr;
+	}
+
+	auto *pb = (struct pool_open_bench *)calloc(
+		1, sizeof(struct pool_open_bench));
+	if (pb == nullptr) {
+		perror("calloc");
+		return nullptr;
+	}
+
+	pb->pargs = (struct pool_open_args *)args->opts;
+
+	pb->buf = (char *)malloc(args->dsize);
+	if (pb->buf == nullptr) {
+		perror("malloc");
+		free(pb);
+		return nullptr;
+	}
+	memset(pb->buf, 0xc5, args->dsize);
+
+	pmembench_set_priv(bench, pb);
+
+	return pb;
+}
+
+/*
+ * pool_open_exit -- common cleanup function for all benchmarks
+ */
+static int
+pool_open_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *pb = (struct pool_open_bench *)pmembench_get_priv(bench);
+
+	free(pb->buf);
+	free(pb);
+
+	return 0;
+}
+
+/*
+ * obj_fill -- (internal) allocate objects until the requested part of the
+ * pool is used and free the requested percentage of them at random
+ */
+static int
+obj_fill(PMEMobjpool *pop, struct benchmark_args *args, size_t psize)
+{
+	auto *pargs = (struct pool_open_args *)args->opts;
+
+	size_t nobjs = psize / 100 * pargs->fill / args->dsize;
+	nobjs = nobjs * 100 / (100 - pargs->frag);
+	if (nobjs == 0)
+		return 0;
+
+	auto *oids = (PMEMoid *)malloc(nobjs * sizeof(PMEMoid));
+	if (oids == nullptr) {
+		perror("malloc");
+		return -1;
+	}
+
+	size_t n;
+	for (n = 0; n < nobjs; n++) {
+		if (pmemobj_alloc(pop, &oids[n], args->dsize, 0, nullptr,
+				  nullptr)) {
+			if (errno != ENOMEM) {
+				perror("pmemobj_alloc");
+				free(oids);
+				return -1;
+			}
+			/* the pool is full, leave room for the first alloc */
+			if (n > 0)
+				pmemobj_free(&oids[--n]);
+			break;
+		}
+	}
+
+	rng_t rng;
+	randomize_r(&rng, args->seed);
+
+	for (size_t i = 0; i < n; i++) {
+		if (rnd64_r(&rng) % 100 < pargs->frag)
+			pmemobj_free(&oids[i]);
+	}
+
+	free(oids);
+
+	return 0;
+}
+
+/*
+ * obj_crash_redo -- (internal) leave a committed, but not yet applied redo
+ * log in the lane, as if the process crashed right after the commit
+ */
+static void
+obj_crash_redo(PMEMobjpool *pop, struct pool_open_bench *pb,
+	       struct lane_layout *layout)
+{
+	auto *ulog = (struct ulog *)&layout->external;
+
+	/* the header of an applied redo log is zeroed, including capacity */
+	ulog->capacity = LANE_REDO_EXTERNAL_SIZE;
+
+	/* the entry following the last one must stay invalid */
+	size_t nentries = ulog->capacity / sizeof(struct ulog_entry_val) - 1;
+	size_t nwords = VICTIM_SIZE / sizeof(uint64_t);
+
+	auto *e = (struct ulog_entry_val *)ulog->data;
+	for (size_t i = 0; i < nentries; i++) {
+		e[i].base.offset = (pb->victim_off +
+				    (i % nwords) * sizeof(uint64_t)) |
+			ULOG_OPERATION_SET;
+		e[i].value = i;
+	}
+	e[nentries].base.offset = 0;
+
+	util_checksum(ulog, SIZEOF_ULOG(nentries * sizeof(*e)),
+		      &ulog->checksum, 1, 0);
+
+	pmemobj_persist(pop, ulog, SIZEOF_ULOG(ulog->capacity));
+}
+
+/*
+ * obj_crash_undo -- (internal) leave snapshots of an unfinished transaction
+ * in the lane, as if the process crashed before the commit
+ */
+static void
+obj_crash_undo(PMEMobjpool *pop, struct pool_open_bench *pb,
+	       struct lane_layout *layout)
+{
+	auto *ulog = (struct ulog *)&layout->undo;
+
+	/* one snapshot over the whole log, followed by an invalid entry */
+	size_t esize = ulog->capacity - CACHELINE_SIZE;
+	size_t dsize = esize - sizeof(struct ulog_entry_buf);
+	assert(dsize <= VICTIM_SIZE);
+
+	auto *e = (struct ulog_entry_buf *)ulog->data;
+	e->base.offset = pb->victim_off | ULOG_OPERATION_BUF_CPY;
+	e->size = dsize;
+	memcpy(e->data, (char *)pop + pb->victim_off, dsize);
+
+	uint64_t csum = util_checksum_compute(e, esize, &e->checksum, 0);
+	e->checksum = util_checksum_seq(&ulog->gen_num, sizeof(ulog->gen_num),
+					csum);
+
+	auto *next = (struct ulog_entry_base *)(ulog->data + esize);
+	next->offset = 0;
+
+	pmemobj_persist(pop, ulog, SIZEOF_ULOG(ulog->capacity));
+}
+
+/*
+ * obj_crash -- (internal) write in-flight logs to the requested number of
+ * lanes; the lanes are not used by anyone, so it is safe to do directly
+ */
+static void
+obj_crash(PMEMobjpool *pop, struct pool_open_bench *pb)
+{
+	for (unsigned i = 0; i < pb->pargs->crash_lanes; i++) {
+		size_t off = pop->lanes_offset + i * sizeof(struct lane_layout);
+		auto *layout = (struct lane_layout *)((char *)pop + off);
+
+		if (pb->crash_log == CRASH_LOG_REDO)
+			obj_crash_redo(pop, pb, layout);
+		else
+			obj_crash_undo(pop, pb, layout);
+	}
+}
+
+/*
+ * obj_open_exit -- cleanup function for obj_open benchmark
+ */
+static int
+obj_open_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *pb = (struct pool_open_bench *)pmembench_get_priv(bench);
+
+	if (pb->pargs->lanes) {
+		if (pb->nlanes_env)
+			os_setenv("PMEMOBJ_NLANES", pb->nlanes_env, 1);
+		else
+			os_unsetenv("PMEMOBJ_NLANES");
+		free(pb->nlanes_env);
+	}
+
+	return pool_open_exit(bench, args);
+}
+
+/*
+ * obj_open_init -- initialization function for obj_open benchmark
+ */
+static int
+obj_open_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *pargs = (struct pool_open_args *)args->opts;
+	enum crash_log crash_log;
+
+	if (strcmp(pargs->crash_log, "undo") == 0) {
+		crash_log = CRASH_LOG_UNDO;
+	} else if (strcmp(pargs->crash_log, "redo") == 0) {
+		crash_log = CRASH_LOG_REDO;
+	} else {
+		fprintf(stderr, "invalid crash-log value -- '%s'\n",
+			pargs->crash_log);
+		return -1;
+	}
+
+	if (pargs->crash_lanes > OBJ_NLANES) {
+		fprintf(stderr, "crash-lanes must not exceed %u\n",
+			OBJ_NLANES);
+		return -1;
+	}
+
+	size_t psize = pool_size(args, PMEMOBJ_MIN_POOL);
+	if (psize == SIZE_MAX)
+		return -1;
+
+	struct pool_open_bench *pb = pool_open_init(bench, args);
+	if (pb == nullptr)
+		return -1;
+
+	pb->crash_log = crash_log;
+
+	/* the number of lanes is read from the environment on each open */
+	if (pargs->lanes) {
+		char *env = os_getenv("PMEMOBJ_NLANES");
+		if (env)
+			pb->nlanes_env = strdup(env);
+
+		char nlanes[16];
+		snprintf(nlanes, sizeof(nlanes), "%u", pargs->lanes);
+		os_setenv("PMEMOBJ_NLANES", nlanes, 1);
+	}
+
+	PMEMobjpool *pop =
+		pmemobj_create(args->fname, LAYOUT_NAME, psize, args->fmode);
+	if (pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err;
+	}
+
+	PMEMoid victim;
+	if (pmemobj_zalloc(pop, &victim, VICTIM_SIZE, 0)) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err_close;
+	}
+	pb->victim_off = victim.off;
+
+	if (obj_fill(pop, args, psize ? psize : args->fsize))
+		goto err_close;
+
+	pmemobj_close(pop);
+
+	return 0;
+
+err_close:
+	pmemobj_close(pop);
+err:
+	obj_open_exit(bench, args);
+	return -1;
+}
+
+/*
+ * obj_open_op -- open a cleanly closed pool, leave it in a crash state and
+ * measure the open with recovery, the first allocation and close
+ */
+static int
+obj_open_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *pb = (struct pool_open_bench *)pmembench_get_priv(bench);
+	const char *path = info->args->fname;
+	benchmark_time_t t;
+
+	benchmark_time_get(&t);
+	PMEMobjpool *pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+	phase_record(PHASE_CLEAN_OPEN, &t);
+
+	obj_crash(pop, pb);
+	pmemobj_close(pop);
+
+	benchmark_time_get(&t);
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+	phase_record(PHASE_OPEN, &t);
+
+	PMEMoid oid;
+	if (pmemobj_alloc(pop, &oid, info->args->dsize, 0, nullptr, nullptr)) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		pmemobj_close(pop);
+		return -1;
+	}
+	phase_record(PHASE_FIRST_OP, &t);
+
+	/* keep the fill level constant across operations */
+	pmemobj_free(&oid);
+
+	benchmark_time_get(&t);
+	pmemobj_close(pop);
+	phase_record(PHASE_CLOSE, &t);
+
+	Phase_nops++;
+
+	return 0;
+}
+
+/*
+ * blk_open_init -- initialization function for blk_open benchmark
+ */
+static int
+blk_open_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	size_t psize = pool_size(args, PMEMBLK_MIN_POOL);
+	if (psize == SIZE_MAX)
+		return -1;
+
+	struct pool_open_bench *pb = pool_open_init(bench, args);
+	if (pb == nullptr)
+		return -1;
+
+	PMEMblkpool *pbp =
+		pmemblk_create(args->fname, args->dsize, psize, args->fmode);
+	if (pbp == nullptr) {
+		fprintf(stderr, "%s\n", pmemblk_errormsg());
+		goto err;
+	}
+
+	pb->nblocks = pmemblk_nblock(pbp);
+
+	/* blocks which were never written are not mapped in the BTT */
+	for (size_t i = 0; i < pb->nblocks / 100 * pb->pargs->fill; i++) {
+		if (pmemblk_write(pbp, pb->buf, (long long)i)) {
+			fprintf(stderr, "%s\n", pmemblk_errormsg());
+			pmemblk_close(pbp);
+			goto err;
+		}
+	}
+
+	pmemblk_close(pbp);
+
+	return 0;
+
+err:
+	pool_open_exit(bench, args);
+	return -1;
+}
+
+/*
+ * blk_open_op -- measure open, the first write and close of pmemblk pool
+ */
+static int
+blk_open_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *pb = (struct pool_open_bench *)pmembench_get_priv(bench);
+	benchmark_time_t t;
+
+	benchmark_time_get(&t);
+	PMEMblkpool *pbp = pmemblk_open(info->args->fname, info->args->dsize);
+	if (pbp == nullptr) {
+		fprintf(stderr, "%s\n", pmemblk_errormsg());
+		return -1;
+	}
+	phase_record(PHASE_OPEN, &t);
+
+	auto blockno = (long long)(info->index % pb->nblocks);
+	if (pmemblk_write(pbp, pb->buf, blockno)) {
+		fprintf(stderr, "%s\n", pmemblk_errormsg());
+		pmemblk_close(pbp);
+		return -1;
+	}
+	phase_record(PHASE_FIRST_OP, &t);
+
+	pmemblk_close(pbp);
+	phase_record(PHASE_CLOSE, &t);
+
+	Phase_nops++;
+
+	return 0;
+}
+
+/*
+ * log_open_init -- initialization function for log_open benchmark
+ */
+static int
+log_open_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	size_t psize = pool_size(args, PMEMLOG_MIN_POOL);
+	if (psize == SIZE_MAX)
+		return -1;
+
+	struct pool_open_bench *pb = pool_open_init(bench, args);
+	if (pb == nullptr)
+		return -1;
+
+	PMEMlogpool *plp = pmemlog_create(args->fname, psize, args->fmode);
+	if (plp == nullptr) {
+		fprintf(stderr, "%s\n", pmemlog_errormsg());
+		goto err;
+	}
+
+	{
+		/* each operation appends once, leave enough space for it */
+		size_t nbyte = pmemlog_nbyte(plp);
+		size_t reserved = args->n_ops_per_thread * args->dsize;
+		if (reserved > nbyte) {
+			fprintf(stderr, "too small pool size\n");
+			pmemlog_close(plp);
+			goto err;
+		}
+
+		size_t filled = nbyte / 100 * pb->pargs->fill;
+		if (filled > nbyte - reserved)
+			filled = nbyte - reserved;
+
+		for (size_t i = 0; i < filled / args->dsize; i++) {
+			if (pmemlog_append(plp, pb->buf, args->dsize)) {
+				fprintf(stderr, "%s\n", pmemlog_errormsg());
+				pmemlog_close(plp);
+				goto err;
+			}
+		}
+	}
+
+	pmemlog_close(plp);
+
+	return 0;
+
+err:
+	pool_open_exit(bench, args);
+	return -1;
+}
+
+/*
+ * log_open_op -- measure open, the first append and close of pmemlog pool
+ */
+static int
+log_open_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *pb = (struct pool_open_bench *)pmembench_get_priv(bench);
+	benchmark_time_t t;
+
+	benchmark_time_get(&t);
+	PMEMlogpool *plp = pmemlog_open(info->args->fname);
+	if (plp == nullptr) {
+		fprintf(stderr, "%s\n", pmemlog_errormsg());
+		return -1;
+	}
+	phase_record(PHASE_OPEN, &t);
+
+	if (pmemlog_append(plp, pb->buf, info->args->dsize)) {
+		fprintf(stderr, "%s\n", pmemlog_errormsg());
+		pmemlog_close(plp);
+		return -1;
+	}
+	phase_record(PHASE_FIRST_OP, &t);
+
+	pmemlog_close(plp);
+	phase_record(PHASE_CLOSE, &t);
+
+	Phase_nops++;
+
+	return 0;
+}
+
+/*
+ * phase_avg -- (internal) return the average time of the phase
+ */
+static uint64_t
+phase_avg(enum open_phase phase)
+{
+	return Phase_nops ? Phase_time[phase] / Phase_nops : 0;
+}
+
+/*
+ * phase_reset -- (internal) reset times for the next set of arguments
+ */
+static void
+phase_reset(void)
+{
+	Phase_nops = 0;
+	for (unsigned i = 0; i < MAX_PHASE; i++)
+		Phase_time[i] = 0;
+}
+
+/*
+ * obj_open_print_extra_headers -- print names of per phase columns
+ */
+static void
+obj_open_print_extra_headers()
+{
+	printf(";clean-open-avg[nsec];open-avg[nsec];recovery-avg[nsec]"
+	       ";first-alloc-avg[nsec];close-avg[nsec]");
+}
+
+/*
+ * obj_open_print_extra_values -- print average time of each phase; the
+ * recovery time is the difference between opening a crashed and a cleanly
+ * closed pool
+ */
+static void
+obj_open_print_extra_values(struct benchmark *bench,
+			    struct benchmark_args *args,
+			    struct total_results *res)
+{
+	uint64_t clean = phase_avg(PHASE_CLEAN_OPEN);
+	uint64_t open = phase_avg(PHASE_OPEN);
+
+	printf(";%" PRIu64 ";%" PRIu64 ";%" PRIu64 ";%" PRIu64 ";%" PRIu64,
+	       clean, open, open > clean ? open - clean : 0,
+	       phase_avg(PHASE_FIRST_OP), phase_avg(PHASE_CLOSE));
+
+	phase_reset();
+}
+
+/*
+ * pool_open_print_extra_headers -- print names of per phase columns
+ */
+static void
+pool_open_print_extra_headers()
+{
+	printf(";open-avg[nsec];first-op-avg[nsec];close-avg[nsec]");
+}
+
+/*
+ * pool_open_print_extra_values -- print average time of each phase
+ */
+static void
+pool_open_print_extra_values(struct benchmark *bench,
+			     struct benchmark_args *args,
+			     struct total_results *res)
+{
+	printf(";%" PRIu64 ";%" PRIu64 ";%" PRIu64, phase_avg(PHASE_OPEN),
+	       phase_avg(PHASE_FIRST_OP), phase_avg(PHASE_CLOSE));
+
+	phase_reset();
+}
+
+static struct benchmark_clo pool_open_clo[6];
+
+static struct benchmark_info obj_open_info;
+static struct benchmark_info blk_open_info;
+static struct benchmark_info log_open_info;
+
+CONSTRUCTOR(pool_open_constructor)
+void
+pool_open_constructor(void)
+{
+	pool_open_clo[0].opt_long = "pool-size";
+	pool_open_clo[0].descr = "Requested pool size in bytes - 0 means "
+				 "minimum";
+	pool_open_clo[0].off = clo_field_offset(struct pool_open_args, psize);
+	pool_open_clo[0].type = CLO_TYPE_UINT;
+	pool_open_clo[0].def = "67108864";
+	pool_open_clo[0].type_uint.size =
+		clo_field_size(struct pool_open_args, psize);
+	pool_open_clo[0].type_uint.base = CLO_INT_BASE_DEC;
+	pool_open_clo[0].type_uint.min = 0;
+	pool_open_clo[0].type_uint.max = SIZE_MAX;
+
+	pool_open_clo[1].opt_long = "fill";
+	pool_open_clo[1].descr = "Percentage of the pool filled with data";
+	pool_open_clo[1].off = clo_field_offset(struct pool_open_args, fill);
+	pool_open_clo[1].type = CLO_TYPE_UINT;
+	pool_open_clo[1].def = "50";
+	pool_open_clo[1].type_uint.size =
+		clo_field_size(struct pool_open_args, fill);
+	pool_open_clo[1].type_uint.base = CLO_INT_BASE_DEC;
+	pool_open_clo[1].type_uint.min = 0;
+	pool_open_clo[1].type_uint.max = 100;
+
+	pool_open_clo[2].opt_long = "fragmentation";
+	pool_open_clo[2].descr = "Percentage of allocated objects freed "
+				 "at random (obj_open only)";
+	pool_open_clo[2].off = clo_field_offset(struct pool_open_args, frag);
+	pool_open_clo[2].type = CLO_TYPE_UINT;
+	pool_open_clo[2].def = "0";
+	pool_open_clo[2].type_uint.size =
+		clo_field_size(struct pool_open_args, frag);
+	pool_open_clo[2].type_uint.base = CLO_INT_BASE_DEC;
+	pool_open_clo[2].type_uint.min = 0;
+	pool_open_clo[2].type_uint.max = 90;
+
+	pool_open_clo[3].opt_long = "lanes";
+	pool_open_clo[3].descr = "Number of lanes available at runtime - "
+				 "0 means default (obj_open only)";
+	pool_open_clo[3].off = clo_field_offset(struct pool_open_args, lanes);
+	pool_open_clo[3].type = CLO_TYPE_UINT;
+	pool_open_clo[3].def = "0";
+	pool_open_clo[3].type_uint.size =
+		clo_field_size(struct pool_open_args, lanes);
+	pool_open_clo[3].type_uint.base = CLO_INT_BASE_DEC;
+	pool_open_clo[3].type_uint.min = 0;
+	pool_open_clo[3].type_uint.max = OBJ_NLANES;
+
+	pool_open_clo[4].opt_long = "crash-lanes";
+	pool_open_clo[4].descr = "Number of lanes left with in-flight logs "
+				 "(obj_open only)";
+	pool_open_clo[4].off =
+		clo_field_offset(struct pool_open_args, crash_lanes);
+	pool_open_clo[4].type = CLO_TYPE_UINT;
+	pool_open_clo[4].def = "0";
+	pool_open_clo[4].type_uint.size =
+		clo_field_size(struct pool_open_args, crash_lanes);
+	pool_open_clo[4].type_uint.base = CLO_INT_BASE_DEC;
+	pool_open_clo[4].type_uint.min = 0;
+	pool_open_clo[4].type_uint.max = OBJ_NLANES;
+
+	pool_open_clo[5].opt_long = "crash-log";
+	pool_open_clo[5].descr = "Type of in-flight logs [undo|redo] "
+				 "(obj_open only)";
+	pool_open_clo[5].off =
+		clo_field_offset(struct pool_open_args, crash_log);
+	pool_open_clo[5].type = CLO_TYPE_STR;
+	pool_open_clo[5].def = "undo";
+
+	obj_open_info.name = "obj_open";
+	obj_open_info.brief = "Benchmark for pmemobj_open() with recovery";
+	obj_open_info.init = obj_open_init;
+	obj_open_info.exit = obj_open_exit;
+	obj_open_info.multithread = false;
+	obj_open_info.multiops = true;
+	obj_open_info.operation = obj_open_op;
+	obj_open_info.measure_time = true;
+	obj_open_info.clos = pool_open_clo;
+	obj_open_info.nclos = ARRAY_SIZE(pool_open_clo);
+	obj_open_info.opts_size = sizeof(struct pool_open_args);
+	obj_open_info.rm_file = true;
+	obj_open_info.allow_poolset = true;
+	obj_open_info.print_extra_headers = obj_open_print_extra_headers;
+	obj_open_info.print_extra_values = obj_open_print_extra_values;
+	REGISTER_BENCHMARK(obj_open_info);
+
+	blk_open_info.name = "blk_open";
+	blk_open_info.brief = "Benchmark for pmemblk_open()";
+	blk_open_info.init = blk_open_init;
+	blk_open_info.exit = pool_open_exit;
+	blk_open_info.multithread = false;
+	blk_open_info.multiops = true;
+	blk_open_info.operation = blk_open_op;
+	blk_open_info.measure_time = true;
+	blk_open_info.clos = pool_open_clo;
+	blk_open_info.nclos = ARRAY_SIZE(pool_open_clo);
+	blk_open_info.opts_size = sizeof(struct pool_open_args);
+	blk_open_info.rm_file = true;
+	blk_open_info.allow_poolset = true;
+	blk_open_info.print_extra_headers = pool_open_print_extra_headers;
+	blk_open_info.print_extra_values = pool_open_print_extra_values;
+	REGISTER_BENCHMARK(blk_open_info);
+
+	log_open_info.name = "log_open";
+	log_open_info.brief = "Benchmark for pmemlog_open()";
+	log_open_info.init = log_open_init;
+	log_open_info.exit = pool_open_exit;
+	log_open_info.multithread = false;
+	log_open_info.multiops = true;
+	log_open_info.operation = log_open_op;
+	log_open_info.measure_time = true;
+	log_open_info.clos = pool_open_clo;
+	log_open_info.nclos = ARRAY_SIZE(pool_open_clo);
+	log_open_info.opts_size = sizeof(struct pool_open_args);
+	log_open_info.rm_file = true;
+	log_open_info.allow_poolset = true;
+	log_open_info.print_extra_headers = pool_open_print_extra_headers;
+	log_open_info.print_extra_values = pool_open_print_extra_values;
+	REGISTER_BENCHMARK(log_open_info);
+}
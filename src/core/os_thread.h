@@ -152,6 +152,12 @@ int os_cond_timedwait(os_cond_t *__restrict cond,
 int os_cond_wait(os_cond_t *__restrict cond,
 	os_mutex_t *__restrict mutex);
 
+/* address-based waiting */
+
+int os_futex_wait(volatile uint32_t *addr, uint32_t val,
+	const struct timespec *abstime);
+void os_futex_wake(volatile uint32_t *addr, int all);
+
 /* threading */
 
 int os_thread_create(os_thread_t *thread, const os_thread_attr_t *attr,
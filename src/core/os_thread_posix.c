@@ -11,6 +11,16 @@
 #include <pthread_np.h>
 #endif
 #include <semaphore.h>
+#ifdef __FreeBSD__
+#include <sys/types.h>
+#include <sys/umtx.h>
+#else
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <limits.h>
 
 #include "os_thread.h"
 #include "util.h"
@@ -311,6 +321,63 @@ os_cond_wait(os_cond_t *__restrict cond,
 		(pthread_mutex_t *)mutex);
 }
 
+/*
+ * os_futex_wait -- blocks the calling thread as long as *addr is equal to val,
+ *	futex(2)/_umtx_op(2) abstraction layer
+ *
+ * Returns 0 when woken up (possibly spuriously) or when *addr did not hold
+ * val, ETIMEDOUT when abstime (CLOCK_REALTIME, may be NULL) has passed.
+ */
+int
+os_futex_wait(volatile uint32_t *addr, uint32_t val,
+	const struct timespec *abstime)
+{
+#ifdef __FreeBSD__
+	struct _umtx_time ut;
+	void *uaddr = NULL;
+	void *uaddr2 = NULL;
+	if (abstime != NULL) {
+		ut._timeout = *abstime;
+		ut._flags = UMTX_ABSTIME;
+		ut._clockid = CLOCK_REALTIME;
+		uaddr = (void *)(uintptr_t)sizeof(ut);
+		uaddr2 = &ut;
+	}
+	int ret = _umtx_op((void *)addr, UMTX_OP_WAIT_UINT_PRIVATE, val,
+		uaddr, uaddr2);
+#else
+	/* unlike FUTEX_WAIT, FUTEX_WAIT_BITSET takes an absolute timeout */
+	long ret = syscall(SYS_futex, addr,
+		FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG | FUTEX_CLOCK_REALTIME,
+		val, abstime, NULL, FUTEX_BITSET_MATCH_ANY);
+#endif
+	if (ret == 0)
+		return 0;
+
+	switch (errno) {
+	case EAGAIN:
+	case EINTR:
+		return 0;
+	default:
+		return errno;
+	}
+}
+
+/*
+ * os_futex_wake -- wakes up one or all threads waiting on addr
+ */
+void
+os_futex_wake(volatile uint32_t *addr, int all)
+{
+#ifdef __FreeBSD__
+	_umtx_op((void *)addr, UMTX_OP_WAKE_PRIVATE, all ? INT_MAX : 1,
+		NULL, NULL);
+#else
+	syscall(SYS_futex, addr, FUTEX_WAKE | FUTEX_PRIVATE_FLAG,
+		all ? INT_MAX : 1, NULL, NULL, 0);
+#endif
+}
+
 /*
  * os_thread_create -- pthread_create abstraction layer
  */
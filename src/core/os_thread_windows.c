@@ -392,6 +392,43 @@ os_cond_wait(os_cond_t *__restrict cond,
 	return (ret == FALSE) ? EINVAL : 0;
 }
 
+/*
+ * os_futex_wait -- blocks the calling thread as long as *addr is equal to val
+ *
+ * Returns 0 when woken up (possibly spuriously) or when *addr did not hold
+ * val, ETIMEDOUT when abstime (may be NULL) has passed.
+ */
+int
+os_futex_wait(volatile uint32_t *addr, uint32_t val,
+	const struct timespec *abstime)
+{
+	DWORD ms = INFINITE;
+	if (abstime != NULL) {
+		ms = get_rel_wait(abstime);
+		if ((LONG)ms < 0)
+			return ETIMEDOUT;
+	}
+
+#pragma comment(lib, "Synchronization.lib")
+	if (WaitOnAddress(addr, &val, sizeof(val), ms) == FALSE &&
+			GetLastError() == ERROR_TIMEOUT)
+		return ETIMEDOUT;
+
+	return 0;
+}
+
+/*
+ * os_futex_wake -- wakes up one or all threads waiting on addr
+ */
+void
+os_futex_wake(volatile uint32_t *addr, int all)
+{
+	if (all)
+		WakeByAddressAll((PVOID)addr);
+	else
+		WakeByAddressSingle((PVOID)addr);
+}
+
 /*
  * os_once -- once-only function call
  */
@@ -253,6 +253,14 @@ typedef enum {
 #define util_atomic_store_explicit32 __atomic_store_n
 #define util_atomic_store_explicit64 __atomic_store_n
 
+/*
+ * ISO C11 -- 7.17.4.1 The atomic_thread_fence function
+ *
+ * #include <stdatomic.h>
+ * void atomic_thread_fence(memory_order order);
+ */
+#define util_atomic_thread_fence __atomic_thread_fence
+
 /*
  * https://gcc.gnu.org/onlinedocs/gcc/_005f_005fsync-Builtins.html
  * https://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
@@ -371,6 +379,21 @@ typedef enum {
 		}\
 	} while (0)
 
+/*
+ * ISO C11 -- 7.17.4.1 The atomic_thread_fence function
+ *
+ * On x86_64 only the seq_cst fence requires a hardware barrier, all the
+ * other orderings are guaranteed by the memory model, so it's enough to
+ * prevent the compiler from reordering the accesses.
+ */
+#define util_atomic_thread_fence(order)\
+	do {\
+		if (order == memory_order_seq_cst)\
+			MemoryBarrier();\
+		else\
+			_ReadWriteBarrier();\
+	} while (0)
+
 /*
  * https://msdn.microsoft.com/en-us/library/hh977022.aspx
  */
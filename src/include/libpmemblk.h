@@ -123,6 +123,10 @@ size_t pmemblk_bsize(PMEMblkpool *pbp);
 size_t pmemblk_nblock(PMEMblkpool *pbp);
 int pmemblk_read(PMEMblkpool *pbp, void *buf, long long blockno);
 int pmemblk_write(PMEMblkpool *pbp, const void *buf, long long blockno);
+int pmemblk_readv(PMEMblkpool *pbp, void *buf, const long long *blocknos,
+		size_t nblocks);
+int pmemblk_writev(PMEMblkpool *pbp, const void *buf,
+		const long long *blocknos, size_t nblocks);
 int pmemblk_set_zero(PMEMblkpool *pbp, long long blockno);
 int pmemblk_set_error(PMEMblkpool *pbp, long long blockno);
 
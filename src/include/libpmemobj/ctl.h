@@ -39,9 +39,16 @@ extern "C" {
  * These are the CTL entry points that control allocation classes:
  * - heap.alloc_class.[class_id].desc
  *	Creates/retrieves allocation class information
+ * - heap.alloc_class.histogram
+ *	Enables/disables recording of the sizes of default allocations
+ * - heap.alloc_class.propose
+ *	Proposes (and optionally creates) allocation classes for the recorded
+ *	allocation sizes
  *
  * It's VERY important to remember that the allocation classes are a RUNTIME
  * property of the allocator - they are NOT stored persistently in the pool.
+ * The only exception are the classes created by applying a proposal, which
+ * are recreated each time the pool is opened.
  * It's recommended to always create custom allocation classes immediately after
  * creating or opening the pool, before any use.
  * If there are existing objects created using a class that is no longer stored
@@ -137,6 +144,49 @@ struct pobj_alloc_class_desc {
 	unsigned class_id;
 };
 
+/*
+ * Maximum number of allocation classes in a single proposal.
+ */
+#define POBJ_ALLOC_CLASS_PROPOSAL_MAX 8
+
+/*
+ * Allocation classes proposed for the allocation sizes recorded since
+ * the histogram was enabled, see heap.alloc_class.propose entry point.
+ *
+ * The recorded sizes are rounded up to 16 bytes and the wasted bytes do not
+ * include the allocation headers.
+ */
+struct pobj_alloc_class_proposal {
+	/*
+	 * If non-zero, the proposed classes are created and used for the
+	 * default allocations from now on. They are also stored in the pool,
+	 * so that they are created again each time the pool is opened.
+	 */
+	int apply;
+
+	unsigned nclasses; /* number of the proposed classes */
+
+	uint64_t requested_bytes; /* bytes requested by the allocations */
+	uint64_t wasted_bytes; /* bytes wasted with the current classes */
+	uint64_t proposed_wasted_bytes; /* bytes wasted with the proposal */
+
+	/*
+	 * The proposed classes, in the order of decreasing gain. If the
+	 * proposal is applied, class_id is set to the identifier of the
+	 * created class.
+	 */
+	struct pobj_alloc_class_desc desc[POBJ_ALLOC_CLASS_PROPOSAL_MAX];
+};
+
+/*
+ * Range of heap zones bound to an arena, see heap.arena.[arena_id].zones
+ * entry point. A zone spans up to about 16 gigabytes of the heap.
+ */
+struct pobj_arena_zones {
+	unsigned first; /* index of the first zone */
+	unsigned count; /* number of zones, 0 if the arena isn't bound */
+};
+
 enum pobj_stats_enabled {
 	POBJ_STATS_ENABLED_TRANSIENT,
 	POBJ_STATS_ENABLED_BOTH,
@@ -144,6 +194,61 @@ enum pobj_stats_enabled {
 	POBJ_STATS_DISABLED,
 };
 
+#define POBJ_LOCK_STATS_HIST_SIZE 32
+
+/* number of locks of a pool that can be individually accounted */
+#define POBJ_LOCK_STATS_MAX_LOCKS 128
+
+/* types of locks for which contention statistics are collected */
+enum pobj_lock_type {
+	POBJ_LOCK_TYPE_MUTEX, /* PMEMmutex */
+	POBJ_LOCK_TYPE_RWLOCK, /* PMEMrwlock */
+	POBJ_LOCK_TYPE_LWLOCK, /* PMEMlwmutex and PMEMlwrwlock */
+	POBJ_LOCK_TYPE_BUCKET, /* heap bucket locks */
+	POBJ_LOCK_TYPE_RUN, /* heap run locks */
+};
+
+/*
+ * Contention statistics of a group of locks, see stats.locks.* entry points.
+ */
+struct pobj_lock_stats {
+	uint64_t acquired; /* number of acquisitions */
+	uint64_t contended; /* number of acquisitions that had to wait */
+	uint64_t wait_ns; /* total time spent waiting for the locks */
+	uint64_t max_wait_ns; /* longest wait */
+	uint64_t hold_ns; /* total time the locks were held */
+	uint64_t max_hold_ns; /* longest hold */
+
+	/*
+	 * Wait time histogram, wait_hist[i] is the number of contended
+	 * acquisitions that waited for less than 2^(i + 1) nanoseconds
+	 * (and at least 2^i, for i > 0). The last bucket has no upper bound.
+	 */
+	uint64_t wait_hist[POBJ_LOCK_STATS_HIST_SIZE];
+};
+
+/*
+ * Contention statistics of a single lock, see stats.locks.lock.[lock_id].stats
+ * entry point.
+ */
+struct pobj_lock_instance_stats {
+	const void *lock; /* address of the lock, NULL if the slot is unused */
+	enum pobj_lock_type type;
+	struct pobj_lock_stats stats;
+};
+
+/*
+ * Flush and fence accounting of persistent writes, see stats.persist.*
+ * entry points.
+ */
+struct pobj_persist_stats {
+	uint64_t flushed_lines; /* cache lines flushed */
+	uint64_t redundant_lines; /* lines flushed again before a fence */
+	uint64_t fences; /* store fences (drains) issued */
+	uint64_t temporal_bytes; /* bytes written with regular stores */
+	uint64_t nontemporal_bytes; /* bytes written with non-temporal stores */
+};
+
 #ifndef _WIN32
 /* EXPERIMENTAL */
 int pmemobj_ctl_get(PMEMobjpool *pop, const char *name, void *arg);
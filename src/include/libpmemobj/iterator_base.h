@@ -32,6 +32,33 @@ PMEMoid pmemobj_first(PMEMobjpool *pop);
  */
 PMEMoid pmemobj_next(PMEMoid oid);
 
+/*
+ * Returns the first object of the specified type number.
+ *
+ * Only the objects of the given type are visited if the type index is
+ * enabled (heap.type_index.enabled CTL), otherwise all the objects are.
+ */
+PMEMoid pmemobj_first_type(PMEMobjpool *pop, uint64_t type_num);
+
+/*
+ * Returns the next object of the same type number.
+ */
+PMEMoid pmemobj_next_type(PMEMoid oid);
+
+/*
+ * Callback of pmemobj_foreach_parallel, non-zero return value terminates
+ * the iteration.
+ */
+typedef int (*pmemobj_foreach_cb)(PMEMoid oid, void *arg);
+
+/*
+ * Calls the callback for every object in the pool. The heap is split among
+ * up to nthreads threads (one per online processor if 0), so the callback
+ * is called concurrently and in no particular order.
+ */
+int pmemobj_foreach_parallel(PMEMobjpool *pop, unsigned nthreads,
+	pmemobj_foreach_cb cb, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
@@ -65,6 +65,13 @@ int pmemobj_checkW(const wchar_t *path, const wchar_t *layout);
 #endif
 
 void pmemobj_close(PMEMobjpool *pop);
+
+/*
+ * Writes the modifications of a pool opened in the copy-on-write mode back
+ * to the pool. No other thread may modify the pool in the meantime.
+ */
+int pmemobj_checkpoint(PMEMobjpool *pop);
+
 /*
  * If called for the first time on a newly created pool, the root object
  * of given size is allocated.  Otherwise, it returns the existing root object.
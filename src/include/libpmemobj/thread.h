@@ -35,6 +35,19 @@ typedef union {
 	char padding[_POBJ_CL_SIZE];
 } PMEMcond;
 
+/*
+ * Lightweight locks -- a single word each, never reinitialized on pool open.
+ */
+typedef union {
+	long long align;
+	char padding[8];
+} PMEMlwmutex;
+
+typedef union {
+	long long align;
+	char padding[8];
+} PMEMlwrwlock;
+
 void pmemobj_mutex_zero(PMEMobjpool *pop, PMEMmutex *mutexp);
 int pmemobj_mutex_lock(PMEMobjpool *pop, PMEMmutex *mutexp);
 int pmemobj_mutex_timedlock(PMEMobjpool *pop, PMEMmutex *__restrict mutexp,
@@ -64,6 +77,27 @@ int pmemobj_cond_timedwait(PMEMobjpool *pop, PMEMcond *__restrict condp,
 int pmemobj_cond_wait(PMEMobjpool *pop, PMEMcond *condp,
 	PMEMmutex *__restrict mutexp);
 
+void pmemobj_lwmutex_zero(PMEMobjpool *pop, PMEMlwmutex *mutexp);
+int pmemobj_lwmutex_lock(PMEMobjpool *pop, PMEMlwmutex *mutexp);
+int pmemobj_lwmutex_timedlock(PMEMobjpool *pop,
+	PMEMlwmutex *__restrict mutexp,
+	const struct timespec *__restrict abs_timeout);
+int pmemobj_lwmutex_trylock(PMEMobjpool *pop, PMEMlwmutex *mutexp);
+int pmemobj_lwmutex_unlock(PMEMobjpool *pop, PMEMlwmutex *mutexp);
+
+void pmemobj_lwrwlock_zero(PMEMobjpool *pop, PMEMlwrwlock *rwlockp);
+int pmemobj_lwrwlock_rdlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp);
+int pmemobj_lwrwlock_wrlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp);
+int pmemobj_lwrwlock_timedrdlock(PMEMobjpool *pop,
+	PMEMlwrwlock *__restrict rwlockp,
+	const struct timespec *__restrict abs_timeout);
+int pmemobj_lwrwlock_timedwrlock(PMEMobjpool *pop,
+	PMEMlwrwlock *__restrict rwlockp,
+	const struct timespec *__restrict abs_timeout);
+int pmemobj_lwrwlock_tryrdlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp);
+int pmemobj_lwrwlock_trywrlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp);
+int pmemobj_lwrwlock_unlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp);
+
 #ifdef __cplusplus
 }
 #endif
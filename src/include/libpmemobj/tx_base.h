@@ -242,6 +242,30 @@ int pmemobj_tx_xadd_range(PMEMoid oid, uint64_t off, size_t size,
  */
 int pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags);
 
+/*
+ * Writes 'size' bytes from 'src' to the persistent memory at 'dest' when the
+ * transaction commits. The data is kept in a volatile buffer until then and
+ * applied through the redo log, so the range does not have to be added to
+ * the transaction. Use pmemobj_tx_read to read the buffered data back.
+ *
+ * If successful, returns zero.
+ * Otherwise, stage changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_write(void *dest, const void *src, size_t size);
+
+/*
+ * Copies 'size' bytes of persistent memory from 'src' to 'dest', including the
+ * data written by pmemobj_tx_write in the current transaction.
+ *
+ * If successful, returns zero.
+ * Otherwise, stage changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_read(void *dest, const void *src, size_t size);
+
 /*
  * Transactionally allocates a new object.
  *
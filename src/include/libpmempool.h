@@ -141,6 +141,11 @@ enum pmempool_check_result pmempool_check_end(PMEMpoolcheck *ppc);
  * do not apply changes, only check if operation is viable
  */
 #define PMEMPOOL_SYNC_DRY_RUN		(1U << 1)
+/*
+ * report progress and throughput of copying the data, see
+ * pmempool_set_progress_func()
+ */
+#define PMEMPOOL_SYNC_PROGRESS		(1U << 2)
 
 /*
  * LIBPMEMPOOL TRANSFORM
@@ -150,6 +155,32 @@ enum pmempool_check_result pmempool_check_end(PMEMpoolcheck *ppc);
  * do not apply changes, only check if operation is viable
  */
 #define PMEMPOOL_TRANSFORM_DRY_RUN	(1U << 1)
+/*
+ * report progress and throughput of copying the data, see
+ * pmempool_set_progress_func()
+ */
+#define PMEMPOOL_TRANSFORM_PROGRESS	(1U << 2)
+
+/*
+ * progress of copying the data of a part of a pool set
+ */
+struct pmempool_progress {
+	const char *desc;	/* what is copied, e.g. "replica 1 part 0" */
+	size_t done;		/* bytes copied or skipped so far */
+	size_t skipped;		/* bytes not copied because they hold no data */
+	size_t total;		/* bytes to be copied or skipped */
+	uint64_t elapsed_ns;	/* time since the copying started */
+	int final;		/* whether it is the summary of the part */
+};
+
+typedef void pmempool_progress_func(const struct pmempool_progress *progress,
+		void *arg);
+
+/*
+ * set the function called to report progress of pmempool_sync() and
+ * pmempool_transform() invoked with the PROGRESS flag, NULL disables it
+ */
+void pmempool_set_progress_func(pmempool_progress_func *func, void *arg);
 
 /*
  * PMEMPOOL_MAJOR_VERSION and PMEMPOOL_MINOR_VERSION provide the current version
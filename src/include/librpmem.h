@@ -65,6 +65,14 @@ int rpmem_read(RPMEMpool *rpp, void *buff, size_t offset, size_t length,
 int rpmem_deep_persist(RPMEMpool *rpp, size_t offset, size_t length,
 		unsigned lane);
 
+struct rpmem_range {
+	size_t offset; /* offset in pool */
+	size_t length; /* length of range */
+};
+
+int rpmem_persist_v(RPMEMpool *rpp, const struct rpmem_range *ranges,
+		unsigned nranges, unsigned lane, unsigned flags);
+
 #define RPMEM_REMOVE_FORCE 0x1
 #define RPMEM_REMOVE_POOL_SET 0x2
 
@@ -95,13 +95,15 @@ nsread(void *ns, unsigned lane, void *buf, size_t count, uint64_t off)
 }
 
 /*
- * nswrite -- (internal) write data to the namespace encapsulating the BTT
+ * nswrite_nodrain -- (internal) write data to the namespace encapsulating
+ *	the BTT, without waiting for the data to become durable
  *
  * This routine is provided to btt_init() to allow the btt module to
- * do I/O on the memory pool containing the BTT layout.
+ * do I/O on the memory pool containing the BTT layout.  The write is
+ * complete after a subsequent call to nsdrain().
  */
 static int
-nswrite(void *ns, unsigned lane, const void *buf, size_t count,
+nswrite_nodrain(void *ns, unsigned lane, const void *buf, size_t count,
 		uint64_t off)
 {
 	struct pmemblk *pbp = (struct pmemblk *)ns;
@@ -138,10 +140,43 @@ nswrite(void *ns, unsigned lane, const void *buf, size_t count,
 	util_mutex_unlock(&pbp->write_lock);
 #endif
 
+	if (!pbp->is_pmem)
+		pmem_msync(dest, count);
+
+	return 0;
+}
+
+/*
+ * nsdrain -- (internal) wait for nswrite_nodrain() writes to complete
+ *
+ * This routine is provided to btt_init() to allow the btt module to
+ * do I/O on the memory pool containing the BTT layout.
+ */
+static void
+nsdrain(void *ns, unsigned lane)
+{
+	struct pmemblk *pbp = (struct pmemblk *)ns;
+
+	LOG(13, "pbp %p lane %u", pbp, lane);
+
 	if (pbp->is_pmem)
 		pmem_drain();
-	else
-		pmem_msync(dest, count);
+}
+
+/*
+ * nswrite -- (internal) write data to the namespace encapsulating the BTT
+ *
+ * This routine is provided to btt_init() to allow the btt module to
+ * do I/O on the memory pool containing the BTT layout.
+ */
+static int
+nswrite(void *ns, unsigned lane, const void *buf, size_t count,
+		uint64_t off)
+{
+	if (nswrite_nodrain(ns, lane, buf, count, off) < 0)
+		return -1;
+
+	nsdrain(ns, lane);
 
 	return 0;
 }
@@ -244,6 +279,8 @@ nszero(void *ns, unsigned lane, size_t count, uint64_t off)
 static struct ns_callback ns_cb = {
 	.nsread = nsread,
 	.nswrite = nswrite,
+	.nswrite_nodrain = nswrite_nodrain,
+	.nsdrain = nsdrain,
 	.nszero = nszero,
 	.nsmap = nsmap,
 	.nssync = nssync,
@@ -700,6 +737,85 @@ pmemblk_write(PMEMblkpool *pbp, const void *buf, long long blockno)
 	return err;
 }
 
+/*
+ * blk_blocknos_check -- (internal) validate block numbers of a batch
+ */
+static int
+blk_blocknos_check(const long long *blocknos, size_t nblocks)
+{
+	for (size_t i = 0; i < nblocks; i++) {
+		if (blocknos[i] < 0) {
+			ERR("negative block number");
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * pmemblk_readv -- read a batch of blocks in a block memory pool
+ */
+int
+pmemblk_readv(PMEMblkpool *pbp, void *buf, const long long *blocknos,
+		size_t nblocks)
+{
+	LOG(3, "pbp %p buf %p blocknos %p nblocks %zu",
+			pbp, buf, blocknos, nblocks);
+
+	if (blk_blocknos_check(blocknos, nblocks))
+		return -1;
+
+	/* the layout of long long and uint64_t is the same */
+	COMPILE_ERROR_ON(sizeof(long long) != sizeof(uint64_t));
+
+	unsigned lane;
+
+	lane_enter(pbp, &lane);
+
+	int err = btt_readv(pbp->bttp, lane, (const uint64_t *)blocknos,
+			nblocks, buf);
+
+	lane_exit(pbp, lane);
+
+	return err;
+}
+
+/*
+ * pmemblk_writev -- write a batch of blocks in a block memory pool, each
+ *	block is written atomically
+ */
+int
+pmemblk_writev(PMEMblkpool *pbp, const void *buf, const long long *blocknos,
+		size_t nblocks)
+{
+	LOG(3, "pbp %p buf %p blocknos %p nblocks %zu",
+			pbp, buf, blocknos, nblocks);
+
+	if (pbp->rdonly) {
+		ERR("EROFS (pool is read-only)");
+		errno = EROFS;
+		return -1;
+	}
+
+	if (blk_blocknos_check(blocknos, nblocks))
+		return -1;
+
+	COMPILE_ERROR_ON(sizeof(long long) != sizeof(uint64_t));
+
+	unsigned lane;
+
+	lane_enter(pbp, &lane);
+
+	int err = btt_writev(pbp->bttp, lane, (const uint64_t *)blocknos,
+			nblocks, buf);
+
+	lane_exit(pbp, lane);
+
+	return err;
+}
+
 /*
  * pmemblk_set_zero -- zero a block in a block memory pool
  */
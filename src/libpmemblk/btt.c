@@ -23,6 +23,13 @@
  * (made durable) when the call returns.  Data written directly via
  * the nsmap callback must be flushed explicitly using nssync.
  *
+ * Two more callbacks are optional and only used by the batched entry
+ * points, to combine several ordering points into a single drain:
+ *
+ *	nswrite_nodrain	Like nswrite, but the data is only guaranteed to
+ *			be durable after a subsequent call to nsdrain
+ *	nsdrain		Wait for all nswrite_nodrain writes to complete
+ *
  * The caller passes these callbacks, along with information such as
  * namespace size and UUID to btt_init() and gets back an opaque handle
  * which is then used with the rest of the entry points.
@@ -37,6 +44,10 @@
  *
  *	btt_write	Writes a single block (atomically) at a given LBA
  *
+ *	btt_readv	Reads a batch of blocks at the given LBAs
+ *
+ *	btt_writev	Writes a batch of blocks, each one atomically
+ *
  *	btt_set_zero	Sets a block to read back as zeros
  *
  *	btt_set_error	Sets a block to return error on read
@@ -66,6 +77,10 @@
  *			the same helper functions above to construct the
  *			run-time state.
  *
+ *	arenas_foreach	Runs a per-arena task (reading or writing the layout
+ *			of an arena) for all arenas, spread across up to
+ *			btt_nlane() threads.  The tasks share the caller's lane.
+ *
  *	invalid_lba	Range check done by each entry point that takes
  *			an LBA.
  *
@@ -79,8 +94,10 @@
  *			logic that makes writes powerfail atomic.
  *
  *	map_lock	These routines provide atomic access to the BTT map
- *	map_unlock	data structure in an area.
- *	map_abort
+ *	map_unlock	data structure in an area.  Each map lock also carries
+ *	map_abort	a sequence counter, which lets the read path validate
+ *			the map entry and the data it read without taking
+ *			any locks (see read_premap).
  *
  *	map_entry_setf	Common code for btt_set_zero() and btt_set_error().
  *
@@ -88,8 +105,8 @@
  *			doing a read), when the metadata indicates the
  *			block should read as zeros.
  *
- *	build_rtt	These routines construct the run-time tracking
- *	build_map_locks	data structures used during I/O.
+ *	build_map_locks	This routine constructs the run-time map locks used
+ *			during I/O.
  */
 
 #include <inttypes.h>
@@ -99,6 +116,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdint.h>
+#include <limits.h>
 #include <endian.h>
 
 #include "out.h"
@@ -147,6 +165,9 @@ struct btt {
 	uint64_t nlba;			/* total number of external LBAs */
 	unsigned narena;		/* number of arenas */
 
+	/* max number of threads processing arenas during initialization */
+	unsigned max_workers;
+
 	/* run-time state kept for each arena */
 	struct arena {
 		uint32_t flags;		/* arena flags (btt_info) */
@@ -184,21 +205,27 @@ struct btt {
 		} *flogs;
 
 		/*
-		 * Read tracking table.  Indexed by lane.
+		 * Map locking.  Indexed by the map cache line of a pre-map
+		 * LBA modulo nmap_locks, see get_map_lock_num().
 		 *
-		 * Before using a free block found in the flog, the write path
-		 * scans the rtt to see if there are any outstanding reads on
-		 * that block (reads that started before the block was freed by
-		 * a concurrent write).  Unused slots in the rtt are indicated
-		 * by setting the error bit, BTT_MAP_ENTRY_ERROR, so that the
-		 * entry won't match any post-map LBA when checked.
+		 * The sequence number of a map lock is odd while one of the
+		 * map entries it covers is being updated.  Reads don't take
+		 * the map locks, instead they check that the sequence number
+		 * didn't change while reading the map entry and the data
+		 * block.  If it did, the block might have been freed and
+		 * reused by a concurrent write, so the read is retried.  This
+		 * way the read path doesn't write to any shared cache line.
 		 */
-		uint32_t volatile *rtt;
+		struct map_lock {
+			os_mutex_t lock;
+			uint64_t seq;
 
-		/*
-		 * Map locking.  Indexed by pre-map LBA modulo nlane.
-		 */
-		os_mutex_t *map_locks;
+			/* each map lock lives in its own cache line(s) */
+			uint8_t padding[CACHELINE_SIZE -
+				(sizeof(os_mutex_t) + sizeof(uint64_t)) %
+				CACHELINE_SIZE];
+		} *map_locks;
+		uint32_t nmap_locks;
 
 		/*
 		 * Arena info block locking.
@@ -241,24 +268,35 @@ static const struct btt_flog Zflog;
 static const unsigned Nseq[] = { 0, 2, 3, 1 };
 #define NSEQ(seq) (Nseq[(seq) & 3])
 
+/*
+ * Size of the buffer for error messages passed between threads.
+ */
+#define BTT_ERRORMSG_MAX 256
+
+/*
+ * Number of map locks per lane.  With only one lock per lane, unrelated
+ * LBAs end up sharing a map lock (and its sequence number) too often.
+ */
+#define BTT_MAP_LOCKS_PER_LANE 16
+
 /*
  * get_map_lock_num -- (internal) Calculate offset into map_locks[]
  *
- * map_locks[] contains nfree locks which are used to protect the map
+ * map_locks[] contains nmap_locks locks which are used to protect the map
  * from concurrent access to the same cache line.  The index into
  * map_locks[] is calculated by looking at the byte offset into the map
  * (premap_lba * BTT_MAP_ENTRY_SIZE), figuring out how many cache lines
  * that is into the map that is (dividing by BTT_MAP_LOCK_ALIGN), and
- * then selecting one of nfree locks (the modulo at the end).
+ * then selecting one of nmap_locks locks (the modulo at the end).
  *
  * The extra cast is to keep gcc from generating a false positive
  * 64-32 bit conversion error when -fsanitize is set.
  */
 static inline uint32_t
-get_map_lock_num(uint32_t premap_lba, uint32_t nfree)
+get_map_lock_num(uint32_t premap_lba, uint32_t nmap_locks)
 {
 	return (uint32_t)(premap_lba * BTT_MAP_ENTRY_SIZE / BTT_MAP_LOCK_ALIGN)
-		% nfree;
+		% nmap_locks;
 }
 
 /*
@@ -408,6 +446,24 @@ btt_flog_get_valid(struct btt_flog *flog_pair, int *next)
 	}
 }
 
+/*
+ * ns_write -- (internal) write to the namespace, skipping the drain if batched
+ *
+ * The batched write path is only used when the namespace provides both
+ * nswrite_nodrain and nsdrain; the caller is then responsible for calling
+ * nsdrain before anything that depends on this write being durable.
+ */
+static inline int
+ns_write(struct btt *bttp, unsigned lane, const void *buf, size_t count,
+		uint64_t off, int batched)
+{
+	if (batched)
+		return (*bttp->ns_cbp->nswrite_nodrain)(bttp->ns, lane, buf,
+				count, off);
+
+	return (*bttp->ns_cbp->nswrite)(bttp->ns, lane, buf, count, off);
+}
+
 /*
  * read_flog_pair -- (internal) load up a single flog pair
  *
@@ -550,10 +606,11 @@ read_flog_pair(struct btt *bttp, unsigned lane, struct arena *arenap,
  */
 static int
 flog_update(struct btt *bttp, unsigned lane, struct arena *arenap,
-		uint32_t lba, uint32_t old_map, uint32_t new_map)
+		uint32_t lba, uint32_t old_map, uint32_t new_map, int batched)
 {
-	LOG(3, "bttp %p lane %u arenap %p lba %u old_map %u new_map %u",
-			bttp, lane, arenap, lba, old_map, new_map);
+	LOG(3, "bttp %p lane %u arenap %p lba %u old_map %u new_map %u "
+			"batched %d", bttp, lane, arenap, lba, old_map, new_map,
+			batched);
 
 	/* construct new flog entry in little-endian byte order */
 	struct btt_flog new_flog;
@@ -566,10 +623,16 @@ flog_update(struct btt *bttp, unsigned lane, struct arena *arenap,
 	uint64_t new_flog_off =
 		arenap->flogs[lane].entries[arenap->flogs[lane].next];
 
-	/* write out first two fields first */
-	if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &new_flog,
-				sizeof(uint32_t) * 2, new_flog_off) < 0)
+	/*
+	 * Write out first two fields first.  In batched mode this also
+	 * drains the data block (and the previous map update) written
+	 * without a drain by the caller.
+	 */
+	if (ns_write(bttp, lane, &new_flog, sizeof(uint32_t) * 2,
+				new_flog_off, batched) < 0)
 		return -1;
+	if (batched)
+		(*bttp->ns_cbp->nsdrain)(bttp->ns, lane);
 	new_flog_off += sizeof(uint32_t) * 2;
 
 	/* write out new_map and seq field to make it active */
@@ -705,47 +768,55 @@ read_flogs(struct btt *bttp, unsigned lane, struct arena *arenap)
 }
 
 /*
- * build_rtt -- (internal) construct a read tracking table for an arena
+ * build_map_locks -- (internal) construct map locks
  *
- * Zero is returned on success, otherwise -1/errno.
+ * There are BTT_MAP_LOCKS_PER_LANE locks for each free block (nfree),
+ * but no more than there are cache lines in the map, since entries from
+ * the same cache line always share a lock anyway.
  *
- * The rtt is big enough to hold an entry for each free block (nfree)
- * since nlane can't be bigger than nfree.  nlane may end up smaller,
- * in which case some of the high rtt entries will be unused.
+ * Zero is returned on success, otherwise -1/errno.
  */
 static int
-build_rtt(struct btt *bttp, struct arena *arenap)
+build_map_locks(struct btt *bttp, struct arena *arenap)
 {
-	if ((arenap->rtt = Malloc(bttp->nfree * sizeof(uint32_t)))
+	uint64_t nmap_lines = howmany((uint64_t)arenap->external_nlba *
+			BTT_MAP_ENTRY_SIZE, BTT_MAP_LOCK_ALIGN);
+	uint64_t nmap_locks = (uint64_t)bttp->nfree * BTT_MAP_LOCKS_PER_LANE;
+	if (nmap_locks > nmap_lines)
+		nmap_locks = nmap_lines;
+	if (nmap_locks == 0)
+		nmap_locks = 1;
+
+	arenap->nmap_locks = (uint32_t)nmap_locks;
+
+	if ((arenap->map_locks = util_aligned_malloc(CACHELINE_SIZE,
+			arenap->nmap_locks * sizeof(*arenap->map_locks)))
 							== NULL) {
-		ERR("!Malloc for %d rtt entries", bttp->nfree);
+		ERR("!Malloc for %u map_lock entries", arenap->nmap_locks);
 		return -1;
 	}
-	for (uint32_t lane = 0; lane < bttp->nfree; lane++)
-		arenap->rtt[lane] = BTT_MAP_ENTRY_ERROR;
-	util_synchronize();
+	for (uint32_t i = 0; i < arenap->nmap_locks; i++) {
+		util_mutex_init(&arenap->map_locks[i].lock);
+		arenap->map_locks[i].seq = 0;
+	}
 
 	return 0;
 }
 
 /*
- * build_map_locks -- (internal) construct map locks
- *
- * Zero is returned on success, otherwise -1/errno.
+ * free_map_locks -- (internal) destroy map locks
  */
-static int
-build_map_locks(struct btt *bttp, struct arena *arenap)
+static void
+free_map_locks(struct arena *arenap)
 {
-	if ((arenap->map_locks =
-			Malloc(bttp->nfree * sizeof(*arenap->map_locks)))
-							== NULL) {
-		ERR("!Malloc for %d map_lock entries", bttp->nfree);
-		return -1;
-	}
-	for (uint32_t lane = 0; lane < bttp->nfree; lane++)
-		util_mutex_init(&arenap->map_locks[lane]);
+	if (arenap->map_locks == NULL)
+		return;
 
-	return 0;
+	for (uint32_t i = 0; i < arenap->nmap_locks; i++)
+		util_mutex_destroy(&arenap->map_locks[i].lock);
+
+	util_aligned_free(arenap->map_locks);
+	arenap->map_locks = NULL;
 }
 
 /*
@@ -779,9 +850,6 @@ read_arena(struct btt *bttp, unsigned lane, uint64_t arena_off,
 	if (read_flogs(bttp, lane, arenap) < 0)
 		return -1;
 
-	if (build_rtt(bttp, arenap) < 0)
-		return -1;
-
 	if (build_map_locks(bttp, arenap) < 0)
 		return -1;
 
@@ -859,6 +927,165 @@ btt_flog_convert2le(struct btt_flog *flogp)
 	flogp->seq = htole32(flogp->seq);
 }
 
+/*
+ * arena_task_fn -- (internal) a per-arena step of the btt initialization
+ */
+typedef int (*arena_task_fn)(struct btt *bttp, unsigned lane,
+		unsigned arena, void *arg);
+
+/*
+ * Shared state of the workers running an arena_task_fn on all arenas.
+ */
+struct arena_tasks {
+	struct btt *bttp;
+	unsigned lane;
+	arena_task_fn fn;
+	void *arg;
+
+	unsigned next;		/* next arena to be picked up by a worker */
+	unsigned ndone;		/* number of arenas completed so far */
+
+	int failed;		/* set by the first task that fails */
+	int error;		/* errno of the failed task */
+	char errormsg[BTT_ERRORMSG_MAX]; /* error message of the failed task */
+};
+
+/*
+ * A thread running arena tasks.
+ */
+struct arena_worker {
+	struct arena_tasks *tasks;
+	os_thread_t thread;
+	int failed;		/* this worker ran the first failed task */
+};
+
+/*
+ * arena_tasks_worker -- (internal) run the task on arenas until none is left
+ */
+static void *
+arena_tasks_worker(void *arg)
+{
+	struct arena_worker *worker = arg;
+	struct arena_tasks *tasks = worker->tasks;
+	struct btt *bttp = tasks->bttp;
+
+	unsigned arena;
+	while ((arena = util_fetch_and_add32(&tasks->next, 1)) <
+			bttp->narena) {
+		int failed;
+		util_atomic_load_explicit32(&tasks->failed, &failed,
+				memory_order_acquire);
+		if (failed)
+			break;
+
+		if (tasks->fn(bttp, tasks->lane, arena, tasks->arg) < 0) {
+			if (util_bool_compare_and_swap32(&tasks->failed,
+					0, 1)) {
+				tasks->error = errno;
+				worker->failed = 1;
+				strncpy(tasks->errormsg, out_get_errormsg(),
+						sizeof(tasks->errormsg) - 1);
+			}
+			break;
+		}
+
+		unsigned ndone = util_fetch_and_add32(&tasks->ndone, 1) + 1;
+		LOG(3, "arena %u ready, %u of %u arenas done",
+				arena, ndone, bttp->narena);
+	}
+
+	return NULL;
+}
+
+/*
+ * arenas_foreach -- (internal) run a task on each arena of the btt
+ *
+ * The arenas are independent of each other, so for multi-arena
+ * namespaces the tasks run on up to max_workers threads (including the
+ * calling thread), which bounds the time it takes to get a large namespace
+ * ready by the time it takes to process a single arena.  All the workers
+ * act on behalf of the calling thread, so they share its lane.
+ *
+ * Returns 0 on success, otherwise -1/errno.
+ */
+static int
+arenas_foreach(struct btt *bttp, unsigned lane, arena_task_fn fn, void *arg)
+{
+	LOG(3, "bttp %p lane %u narena %u", bttp, lane, bttp->narena);
+
+	struct arena_tasks tasks;
+	memset(&tasks, 0, sizeof(tasks));
+	tasks.bttp = bttp;
+	tasks.lane = lane;
+	tasks.fn = fn;
+	tasks.arg = arg;
+
+	unsigned nworkers = bttp->narena;
+	if (nworkers > bttp->max_workers)
+		nworkers = bttp->max_workers;
+
+	/* the calling thread is one of the workers */
+	struct arena_worker self;
+	memset(&self, 0, sizeof(self));
+	self.tasks = &tasks;
+	struct arena_worker *workers = NULL;
+	unsigned nthreads = 0;
+	if (nworkers > 1) {
+		workers = Zalloc((nworkers - 1) * sizeof(*workers));
+		if (workers == NULL)
+			LOG(2, "!Malloc for %u workers", nworkers - 1);
+	}
+
+	if (workers != NULL) {
+		for (; nthreads < nworkers - 1; nthreads++) {
+			struct arena_worker *w = &workers[nthreads];
+			w->tasks = &tasks;
+			if (os_thread_create(&w->thread, NULL,
+					arena_tasks_worker, w) != 0) {
+				/* not fatal, the other workers will cope */
+				LOG(2, "cannot create arena worker thread");
+				break;
+			}
+		}
+	}
+
+	LOG(4, "processing %u arenas using %u threads",
+			bttp->narena, nthreads + 1);
+
+	arena_tasks_worker(&self);
+
+	for (unsigned i = 0; i < nthreads; i++)
+		os_thread_join(&workers[i].thread, NULL);
+
+	if (workers)
+		Free(workers);
+
+	if (tasks.failed) {
+		/* propagate the error message of other threads */
+		if (!self.failed)
+			ERR("%s", tasks.errormsg);
+
+		errno = tasks.error;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * read_arena_task -- (internal) load up an arena, arena_task_fn
+ *
+ * read_layout() verifies that all arenas but the last one are of
+ * BTT_MAX_ARENA size, which makes it possible to find an arena without
+ * reading the info blocks of the preceding ones.
+ */
+static int
+read_arena_task(struct btt *bttp, unsigned lane, unsigned arena, void *arg)
+{
+	return read_arena(bttp, lane, (uint64_t)arena * BTT_MAX_ARENA,
+			&bttp->arenas[arena]);
+}
+
 /*
  * read_arenas -- (internal) load up all arenas and build run-time state
  *
@@ -875,17 +1102,10 @@ read_arenas(struct btt *bttp, unsigned lane, unsigned narena)
 		goto err;
 	}
 
-	uint64_t arena_off = 0;
-	struct arena *arenap = bttp->arenas;
-	for (unsigned i = 0; i < narena; i++) {
-
-		if (read_arena(bttp, lane, arena_off, arenap) < 0)
-			goto err;
+	ASSERTeq(narena, bttp->narena);
 
-		/* prepare for next time around the loop */
-		arena_off = arenap->nextoff;
-		arenap++;
-	}
+	if (arenas_foreach(bttp, lane, read_arena_task, NULL) < 0)
+		goto err;
 
 	bttp->laidout = 1;
 
@@ -898,10 +1118,7 @@ err:
 		for (unsigned i = 0; i < bttp->narena; i++) {
 			if (bttp->arenas[i].flogs)
 				Free(bttp->arenas[i].flogs);
-			if (bttp->arenas[i].rtt)
-				Free((void *)bttp->arenas[i].rtt);
-			if (bttp->arenas[i].map_locks)
-				Free((void *)bttp->arenas[i].map_locks);
+			free_map_locks(&bttp->arenas[i]);
 		}
 		Free(bttp->arenas);
 		bttp->arenas = NULL;
@@ -1051,6 +1268,94 @@ btt_info_set(struct btt_info *info, uint32_t external_lbasize,
 	return 0;
 }
 
+/*
+ * Metadata of a single arena to be written out by write_arena_task().
+ */
+struct arena_layout {
+	uint64_t off;		/* offset of the arena in the namespace */
+	struct btt_info info;	/* info block, in host byte order */
+};
+
+/*
+ * write_arena_task -- (internal) write out the initial metadata layout of
+ *	an arena, arena_task_fn
+ */
+static int
+write_arena_task(struct btt *bttp, unsigned lane, unsigned arena, void *arg)
+{
+	struct arena_layout *layout = &((struct arena_layout *)arg)[arena];
+	struct btt_info info = layout->info;
+	uint64_t arena_off = layout->off;
+
+	LOG(4, "write layout of arena %u", arena);
+
+	/* zero map if ns is not zero-initialized */
+	if (!bttp->ns_cbp->ns_is_zeroed) {
+		uint64_t mapsize = btt_map_size(info.external_nlba);
+		if ((*bttp->ns_cbp->nszero)(bttp->ns, lane, mapsize,
+				arena_off + info.mapoff) < 0)
+			return -1;
+	}
+
+	/* write out the initial flog */
+	uint64_t flog_entry_off = arena_off + info.flogoff;
+	uint32_t next_free_lba = info.external_nlba;
+	for (uint32_t i = 0; i < bttp->nfree; i++) {
+		struct btt_flog flog;
+		flog.lba = htole32(i);
+		flog.old_map = flog.new_map =
+			htole32(next_free_lba | BTT_MAP_ENTRY_ZERO);
+		flog.seq = htole32(1);
+
+		/*
+		 * Write both btt_flog structs in the pair, writing
+		 * the second one as all zeros.
+		 */
+		LOG(6, "flog[%u] entry off %" PRIu64
+				" initial %u + zero = %u",
+				i, flog_entry_off,
+				next_free_lba,
+				next_free_lba | BTT_MAP_ENTRY_ZERO);
+		if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &flog,
+				sizeof(flog), flog_entry_off) < 0)
+			return -1;
+		flog_entry_off += sizeof(flog);
+
+		LOG(6, "flog[%u] entry off %" PRIu64 " zeros",
+				i, flog_entry_off);
+		if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &Zflog,
+				sizeof(Zflog), flog_entry_off) < 0)
+			return -1;
+		flog_entry_off += sizeof(flog);
+		flog_entry_off = roundup(flog_entry_off,
+				BTT_FLOG_PAIR_ALIGN);
+
+		next_free_lba++;
+	}
+
+	/*
+	 * Construct the BTT info block and write it out
+	 * at both the beginning and end of the arena.
+	 */
+	memcpy(info.sig, Sig, BTTINFO_SIG_LEN);
+	memcpy(info.uuid, bttp->uuid, BTTINFO_UUID_LEN);
+	memcpy(info.parent_uuid, bttp->parent_uuid, BTTINFO_UUID_LEN);
+	info.major = BTTINFO_MAJOR_VERSION;
+	info.minor = BTTINFO_MINOR_VERSION;
+	btt_info_convert2le(&info);
+
+	util_checksum(&info, sizeof(info), &info.checksum, 1, 0);
+
+	if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &info,
+			sizeof(info), arena_off) < 0)
+		return -1;
+	if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &info,
+			sizeof(info), arena_off + info.infooff) < 0)
+		return -1;
+
+	return 0;
+}
+
 /*
  * write_layout -- (internal) write out the initial btt metadata layout
  *
@@ -1107,6 +1412,19 @@ write_layout(struct btt *bttp, unsigned lane, int write)
 	unsigned arena_num = 0;
 	uint64_t arena_off = 0;
 
+	/*
+	 * When writing, the metadata of each arena is calculated here and
+	 * then written out by write_arena_task(), for all arenas in parallel.
+	 */
+	struct arena_layout *layouts = NULL;
+	if (write) {
+		layouts = Malloc(bttp->narena * sizeof(*layouts));
+		if (layouts == NULL) {
+			ERR("!Malloc for %u arena layouts", bttp->narena);
+			return -1;
+		}
+	}
+
 	/*
 	 * for each arena...
 	 */
@@ -1123,8 +1441,12 @@ write_layout(struct btt *bttp, unsigned lane, int write)
 		struct btt_info info;
 		memset(&info, '\0', sizeof(info));
 		if (btt_info_set_params(&info, bttp->lbasize,
-				internal_lba_size, bttp->nfree, arena_rawsize))
+				internal_lba_size, bttp->nfree,
+				arena_rawsize)) {
+			if (layouts)
+				Free(layouts);
 			return -1;
+		}
 
 		LOG(4, "internal_nlba %u external_nlba %u",
 			info.internal_nlba, info.external_nlba);
@@ -1147,69 +1469,8 @@ write_layout(struct btt *bttp, unsigned lane, int write)
 		LOG(4, "flogoff 0x%016" PRIx64, info.flogoff);
 		LOG(4, "infooff 0x%016" PRIx64, info.infooff);
 
-		/* zero map if ns is not zero-initialized */
-		if (!bttp->ns_cbp->ns_is_zeroed) {
-			uint64_t mapsize = btt_map_size(info.external_nlba);
-			if ((*bttp->ns_cbp->nszero)(bttp->ns, lane, mapsize,
-					info.mapoff) < 0)
-				return -1;
-		}
-
-		/* write out the initial flog */
-		uint64_t flog_entry_off = arena_off + info.flogoff;
-		uint32_t next_free_lba = info.external_nlba;
-		for (uint32_t i = 0; i < bttp->nfree; i++) {
-			struct btt_flog flog;
-			flog.lba = htole32(i);
-			flog.old_map = flog.new_map =
-				htole32(next_free_lba | BTT_MAP_ENTRY_ZERO);
-			flog.seq = htole32(1);
-
-			/*
-			 * Write both btt_flog structs in the pair, writing
-			 * the second one as all zeros.
-			 */
-			LOG(6, "flog[%u] entry off %" PRIu64
-					" initial %u + zero = %u",
-					i, flog_entry_off,
-					next_free_lba,
-					next_free_lba | BTT_MAP_ENTRY_ZERO);
-			if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &flog,
-					sizeof(flog), flog_entry_off) < 0)
-				return -1;
-			flog_entry_off += sizeof(flog);
-
-			LOG(6, "flog[%u] entry off %" PRIu64 " zeros",
-					i, flog_entry_off);
-			if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &Zflog,
-					sizeof(Zflog), flog_entry_off) < 0)
-				return -1;
-			flog_entry_off += sizeof(flog);
-			flog_entry_off = roundup(flog_entry_off,
-					BTT_FLOG_PAIR_ALIGN);
-
-			next_free_lba++;
-		}
-
-		/*
-		 * Construct the BTT info block and write it out
-		 * at both the beginning and end of the arena.
-		 */
-		memcpy(info.sig, Sig, BTTINFO_SIG_LEN);
-		memcpy(info.uuid, bttp->uuid, BTTINFO_UUID_LEN);
-		memcpy(info.parent_uuid, bttp->parent_uuid, BTTINFO_UUID_LEN);
-		info.major = BTTINFO_MAJOR_VERSION;
-		info.minor = BTTINFO_MINOR_VERSION;
-		btt_info_convert2le(&info);
-
-		util_checksum(&info, sizeof(info), &info.checksum, 1, 0);
-
-		if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &info,
-				sizeof(info), arena_off) < 0)
-			return -1;
-		if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &info,
-				sizeof(info), arena_off + info.infooff) < 0)
-			return -1;
+		layouts[arena_num - 1].off = arena_off;
+		layouts[arena_num - 1].info = info;
 
 		arena_off += info.nextoff;
 	}
@@ -1219,6 +1480,12 @@ write_layout(struct btt *bttp, unsigned lane, int write)
 	bttp->nlba = total_nlba;
 
 	if (write) {
+		int ret = arenas_foreach(bttp, lane, write_arena_task,
+				layouts);
+		Free(layouts);
+		if (ret < 0)
+			return -1;
+
 		/*
 		 * The layout is written now, so load up the arenas.
 		 */
@@ -1427,6 +1694,9 @@ btt_init(uint64_t rawsize, uint32_t lbasize, uint8_t parent_uuid[],
 	bttp->ns = ns;
 	bttp->ns_cbp = ns_cbp;
 
+	/* arenas are set up using as many threads as there may be lanes */
+	bttp->max_workers = maxlane ? maxlane : UINT_MAX;
+
 	/*
 	 * Load up layout, if it exists.
 	 *
@@ -1482,111 +1752,145 @@ btt_nlba(struct btt *bttp)
 }
 
 /*
- * btt_read -- read a block from a btt namespace
+ * map_read_begin -- (internal) start a lock-free read of the map
  *
- * Returns 0 on success, otherwise -1/errno.
+ * Returns the (even) sequence number to be validated by map_read_retry().
  */
-int
-btt_read(struct btt *bttp, unsigned lane, uint64_t lba, void *buf)
+static inline uint64_t
+map_read_begin(struct map_lock *ml)
 {
-	LOG(3, "bttp %p lane %u lba %" PRIu64, bttp, lane, lba);
+	uint64_t seq;
 
-	if (invalid_lba(bttp, lba))
-		return -1;
+	/* wait for the update in progress, if any, to finish */
+	do {
+		util_atomic_load_explicit64(&ml->seq, &seq,
+				memory_order_acquire);
+	} while (seq & 1);
 
-	/* if there's no layout written yet, all reads come back as zeros */
-	if (!bttp->laidout)
-		return zero_block(bttp, buf);
+	return seq;
+}
 
-	/* find which arena LBA lives in, and the offset to the map entry */
-	struct arena *arenap;
-	uint32_t premap_lba;
-	uint64_t map_entry_off;
-	if (lba_to_arena_lba(bttp, lba, &arenap, &premap_lba) < 0)
-		return -1;
+/*
+ * map_read_retry -- (internal) check whether a lock-free read has to be
+ *	retried, because the map was modified since map_read_begin()
+ */
+static inline int
+map_read_retry(struct map_lock *ml, uint64_t seq)
+{
+	/* the reads from the namespace can't be moved past the check */
+	util_atomic_thread_fence(memory_order_acquire);
 
-	/* convert pre-map LBA into an offset into the map */
-	map_entry_off = arenap->mapoff + BTT_MAP_ENTRY_SIZE * premap_lba;
+	uint64_t latest_seq;
+	util_atomic_load_explicit64(&ml->seq, &latest_seq,
+			memory_order_relaxed);
 
-	/*
-	 * Read the current map entry to get the post-map LBA for the data
-	 * block read.
-	 */
-	uint32_t entry;
+	return latest_seq != seq;
+}
 
-	if ((*bttp->ns_cbp->nsread)(bttp->ns, lane, &entry,
-				sizeof(entry), map_entry_off) < 0)
-		return -1;
+/*
+ * read_premap -- (internal) read a block given its arena and pre-map LBA
+ *
+ * Returns 0 on success, otherwise -1/errno.
+ */
+static int
+read_premap(struct btt *bttp, unsigned lane, struct arena *arenap,
+		uint32_t premap_lba, void *buf)
+{
+	LOG(3, "bttp %p lane %u arenap %p premap_lba %u",
+			bttp, lane, arenap, premap_lba);
 
-	entry = le32toh(entry);
+	/* convert pre-map LBA into an offset into the map */
+	uint64_t map_entry_off =
+			arenap->mapoff + BTT_MAP_ENTRY_SIZE * premap_lba;
+
+	struct map_lock *ml = &arenap->map_locks[
+			get_map_lock_num(premap_lba, arenap->nmap_locks)];
 
 	/*
 	 * Retries come back to the top of this loop (for a rare case where
-	 * the map is changed by another thread doing writes to the same LBA).
+	 * the map is changed by another thread doing writes to the same map
+	 * lock while the block is being read).
 	 */
 	while (1) {
-		if (map_entry_is_error(entry)) {
-			ERR("EIO due to map entry error flag");
-			errno = EIO;
-			return -1;
-		}
-
-		if (map_entry_is_zero_or_initial(entry))
-			return zero_block(bttp, buf);
-
-		/*
-		 * Record the post-map LBA in the read tracking table during
-		 * the read.  The write will check entries in the read tracking
-		 * table before allocating a block for a write, waiting for
-		 * outstanding reads on that block to complete.
-		 *
-		 * Since we already checked for error, zero, and initial
-		 * states above, the entry must have both error and zero
-		 * bits set at this point (BTT_MAP_ENTRY_NORMAL).  We store
-		 * the entry that way, with those bits set, in the rtt and
-		 * btt_write() will check for it the same way, with the bits
-		 * both set.
-		 */
-		arenap->rtt[lane] = entry;
-		util_synchronize();
+		uint64_t seq = map_read_begin(ml);
 
 		/*
-		 * In case this thread was preempted between reading entry and
-		 * storing it in the rtt, check to see if the map changed.  If
-		 * it changed, the block about to be read is at least free now
-		 * (in the flog, but that's okay since the data will still be
-		 * undisturbed) and potentially allocated and being used for
-		 * another write (data disturbed, so not okay to continue).
+		 * Read the current map entry to get the post-map LBA for
+		 * the data block read.
 		 */
-		uint32_t latest_entry;
-		if ((*bttp->ns_cbp->nsread)(bttp->ns, lane, &latest_entry,
-				sizeof(latest_entry), map_entry_off) < 0) {
-			arenap->rtt[lane] = BTT_MAP_ENTRY_ERROR;
+		uint32_t entry;
+		if ((*bttp->ns_cbp->nsread)(bttp->ns, lane, &entry,
+					sizeof(entry), map_entry_off) < 0)
 			return -1;
+
+		entry = le32toh(entry);
+
+		int ret = 0;
+		if (map_entry_is_error(entry)) {
+			ret = -1;
+		} else if (map_entry_is_zero_or_initial(entry)) {
+			zero_block(bttp, buf);
+		} else {
+			/*
+			 * The block might be freed and reused by a
+			 * concurrent write while it's being read, in
+			 * which case the map lock sequence number changes
+			 * and the read is retried below.
+			 */
+			uint64_t data_block_off = arenap->dataoff +
+				(uint64_t)(entry & BTT_MAP_ENTRY_LBA_MASK) *
+				arenap->internal_lbasize;
+			if ((*bttp->ns_cbp->nsread)(bttp->ns, lane, buf,
+					bttp->lbasize, data_block_off) < 0)
+				return -1;
 		}
 
-		latest_entry = le32toh(latest_entry);
+		if (map_read_retry(ml, seq))
+			continue;
 
-		if (entry == latest_entry)
-			break;			/* map stayed the same */
-		else
-			entry = latest_entry;	/* try again */
+		if (ret < 0) {
+			ERR("EIO due to map entry error flag");
+			errno = EIO;
+		}
+
+		return ret;
 	}
+}
 
-	/*
-	 * It is safe to read the block now, since the rtt protects the
-	 * block from getting re-allocated to something else by a write.
-	 */
-	uint64_t data_block_off =
-		arenap->dataoff + (uint64_t)(entry & BTT_MAP_ENTRY_LBA_MASK) *
-		arenap->internal_lbasize;
-	int readret = (*bttp->ns_cbp->nsread)(bttp->ns, lane, buf,
-					bttp->lbasize, data_block_off);
+/*
+ * btt_read -- read a block from a btt namespace
+ *
+ * Returns 0 on success, otherwise -1/errno.
+ */
+int
+btt_read(struct btt *bttp, unsigned lane, uint64_t lba, void *buf)
+{
+	LOG(3, "bttp %p lane %u lba %" PRIu64, bttp, lane, lba);
+
+	if (invalid_lba(bttp, lba))
+		return -1;
+
+	/* if there's no layout written yet, all reads come back as zeros */
+	if (!bttp->laidout)
+		return zero_block(bttp, buf);
+
+	/* find which arena LBA lives in, and the offset to the map entry */
+	struct arena *arenap;
+	uint32_t premap_lba;
+	if (lba_to_arena_lba(bttp, lba, &arenap, &premap_lba) < 0)
+		return -1;
 
-	/* done with read, so clear out rtt entry */
-	arenap->rtt[lane] = BTT_MAP_ENTRY_ERROR;
+	return read_premap(bttp, lane, arenap, premap_lba, buf);
+}
 
-	return readret;
+/*
+ * map_release -- (internal) make the sequence number even and drop the lock
+ */
+static inline void
+map_release(struct map_lock *ml)
+{
+	util_fetch_and_add64(&ml->seq, 1);
+	util_mutex_unlock(&ml->lock);
 }
 
 /*
@@ -1601,14 +1905,21 @@ map_lock(struct btt *bttp, unsigned lane, struct arena *arenap,
 
 	uint64_t map_entry_off =
 			arenap->mapoff + BTT_MAP_ENTRY_SIZE * premap_lba;
-	uint32_t map_lock_num = get_map_lock_num(premap_lba, bttp->nfree);
+	struct map_lock *ml = &arenap->map_locks[
+			get_map_lock_num(premap_lba, arenap->nmap_locks)];
 
-	util_mutex_lock(&arenap->map_locks[map_lock_num]);
+	util_mutex_lock(&ml->lock);
+
+	/*
+	 * Make the sequence number odd before anything covered by this map
+	 * lock is modified, this invalidates all the reads in progress.
+	 */
+	util_fetch_and_add64(&ml->seq, 1);
 
 	/* read the old map entry */
 	if ((*bttp->ns_cbp->nsread)(bttp->ns, lane, entryp,
 				sizeof(uint32_t), map_entry_off) < 0) {
-		util_mutex_unlock(&arenap->map_locks[map_lock_num]);
+		map_release(ml);
 		return -1;
 	}
 
@@ -1634,29 +1945,32 @@ map_abort(struct btt *bttp, unsigned lane, struct arena *arenap,
 	LOG(3, "bttp %p lane %u arenap %p premap_lba %u",
 			bttp, lane, arenap, premap_lba);
 
-	util_mutex_unlock(&arenap->map_locks[get_map_lock_num(premap_lba,
-				bttp->nfree)]);
+	map_release(&arenap->map_locks[get_map_lock_num(premap_lba,
+				arenap->nmap_locks)]);
 }
 
 /*
  * map_unlock -- (internal) update the map and drop the map_lock
+ *
+ * In batched mode the map update is not drained here, the next ordering
+ * point of the batch (or the final drain) makes it durable.
  */
 static int
 map_unlock(struct btt *bttp, unsigned lane, struct arena *arenap,
-		uint32_t entry, uint32_t premap_lba)
+		uint32_t entry, uint32_t premap_lba, int batched)
 {
-	LOG(3, "bttp %p lane %u arenap %p entry %u premap_lba %u",
-			bttp, lane, arenap, entry, premap_lba);
+	LOG(3, "bttp %p lane %u arenap %p entry %u premap_lba %u batched %d",
+			bttp, lane, arenap, entry, premap_lba, batched);
 
 	uint64_t map_entry_off =
 			arenap->mapoff + BTT_MAP_ENTRY_SIZE * premap_lba;
 
 	/* write the new map entry */
-	int err = (*bttp->ns_cbp->nswrite)(bttp->ns, lane, &entry,
-				sizeof(uint32_t), map_entry_off);
+	int err = ns_write(bttp, lane, &entry, sizeof(uint32_t),
+				map_entry_off, batched);
 
-	util_mutex_unlock(&arenap->map_locks[get_map_lock_num(premap_lba,
-				bttp->nfree)]);
+	map_release(&arenap->map_locks[get_map_lock_num(premap_lba,
+				arenap->nmap_locks)]);
 
 	LOG(9, "unlocked map[%d]: %u%s%s", premap_lba,
 			entry & BTT_MAP_ENTRY_LBA_MASK,
@@ -1667,38 +1981,39 @@ map_unlock(struct btt *bttp, unsigned lane, struct arena *arenap,
 }
 
 /*
- * btt_write -- write a block to a btt namespace
+ * layout_write_once -- (internal) write out the metadata layout if needed
  *
  * Returns 0 on success, otherwise -1/errno.
  */
-int
-btt_write(struct btt *bttp, unsigned lane, uint64_t lba, const void *buf)
+static int
+layout_write_once(struct btt *bttp, unsigned lane)
 {
-	LOG(3, "bttp %p lane %u lba %" PRIu64, bttp, lane, lba);
+	if (bttp->laidout)
+		return 0;
 
-	if (invalid_lba(bttp, lba))
-		return -1;
+	int err = 0;
 
-	/* first write through here will initialize the metadata layout */
-	if (!bttp->laidout) {
-		int err = 0;
+	util_mutex_lock(&bttp->layout_write_mutex);
 
-		util_mutex_lock(&bttp->layout_write_mutex);
-
-		if (!bttp->laidout)
-			err = write_layout(bttp, lane, 1);
+	if (!bttp->laidout)
+		err = write_layout(bttp, lane, 1);
 
-		util_mutex_unlock(&bttp->layout_write_mutex);
+	util_mutex_unlock(&bttp->layout_write_mutex);
 
-		if (err < 0)
-			return err;
-	}
+	return err;
+}
 
-	/* find which arena LBA lives in, and the offset to the map entry */
-	struct arena *arenap;
-	uint32_t premap_lba;
-	if (lba_to_arena_lba(bttp, lba, &arenap, &premap_lba) < 0)
-		return -1;
+/*
+ * write_premap -- (internal) write a block given its arena and pre-map LBA
+ *
+ * Returns 0 on success, otherwise -1/errno.
+ */
+static int
+write_premap(struct btt *bttp, unsigned lane, struct arena *arenap,
+		uint32_t premap_lba, const void *buf, int batched)
+{
+	LOG(3, "bttp %p lane %u arenap %p premap_lba %u batched %d",
+			bttp, lane, arenap, premap_lba, batched);
 
 	/* if the arena is in an error state, writing is not allowed */
 	if (arenap->flags & BTTINFO_FLAG_ERROR_MASK) {
@@ -1713,9 +2028,9 @@ btt_write(struct btt *bttp, unsigned lane, uint64_t lba, const void *buf)
 	 * into the flog.  That means the free block held by flog[lane]
 	 * is assigned to this thread and to no other threads (no additional
 	 * locking required).  So start by performing the write to the
-	 * free block.  It is only safe to write to a free block if it
-	 * doesn't appear in the read tracking table, so scan that first
-	 * and if found, wait for the thread reading from it to finish.
+	 * free block.  Reads which started before the block was freed may
+	 * still be in progress, but the map lock sequence number was bumped
+	 * when the block was freed, so they will notice and retry.
 	 */
 	uint32_t free_entry = (arenap->flogs[lane].flog.old_map &
 			BTT_MAP_ENTRY_LBA_MASK) | BTT_MAP_ENTRY_NORMAL;
@@ -1723,17 +2038,16 @@ btt_write(struct btt *bttp, unsigned lane, uint64_t lba, const void *buf)
 	LOG(3, "free_entry %u (before mask %u)", free_entry,
 				arenap->flogs[lane].flog.old_map);
 
-	/* wait for other threads to finish any reads on free block */
-	for (unsigned i = 0; i < bttp->nlane; i++)
-		while (arenap->rtt[i] == free_entry)
-			;
-
-	/* it is now safe to perform write to the free block */
+	/*
+	 * In batched mode the data block is drained together with the
+	 * first half of the flog update, since both only have to be durable
+	 * before the flog entry is made active.
+	 */
 	uint64_t data_block_off = arenap->dataoff +
 		(uint64_t)(free_entry & BTT_MAP_ENTRY_LBA_MASK) *
 		arenap->internal_lbasize;
-	if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, buf,
-				bttp->lbasize, data_block_off) < 0)
+	if (ns_write(bttp, lane, buf, bttp->lbasize, data_block_off,
+			batched) < 0)
 		return -1;
 
 	/*
@@ -1748,13 +2062,13 @@ btt_write(struct btt *bttp, unsigned lane, uint64_t lba, const void *buf)
 
 	/* update the flog */
 	if (flog_update(bttp, lane, arenap, premap_lba,
-					old_entry, free_entry) < 0) {
+					old_entry, free_entry, batched) < 0) {
 		map_abort(bttp, lane, arenap, premap_lba);
 		return -1;
 	}
 
 	if (map_unlock(bttp, lane, arenap, htole32(free_entry),
-					premap_lba) < 0) {
+					premap_lba, batched) < 0) {
 		/*
 		 * A critical write error occurred, set the arena's
 		 * info block error bit.
@@ -1767,6 +2081,231 @@ btt_write(struct btt *bttp, unsigned lane, uint64_t lba, const void *buf)
 	return 0;
 }
 
+/*
+ * btt_write -- write a block to a btt namespace
+ *
+ * Returns 0 on success, otherwise -1/errno.
+ */
+int
+btt_write(struct btt *bttp, unsigned lane, uint64_t lba, const void *buf)
+{
+	LOG(3, "bttp %p lane %u lba %" PRIu64, bttp, lane, lba);
+
+	if (invalid_lba(bttp, lba))
+		return -1;
+
+	/* first write through here will initialize the metadata layout */
+	int err = layout_write_once(bttp, lane);
+	if (err < 0)
+		return err;
+
+	/* find which arena LBA lives in, and the offset to the map entry */
+	struct arena *arenap;
+	uint32_t premap_lba;
+	if (lba_to_arena_lba(bttp, lba, &arenap, &premap_lba) < 0)
+		return -1;
+
+	return write_premap(bttp, lane, arenap, premap_lba, buf, 0);
+}
+
+/*
+ * batch_entry -- (internal) a single request of a batched read or write
+ */
+struct batch_entry {
+	uint64_t lba;	/* external LBA */
+	size_t idx;	/* position of the block in the caller's buffer */
+};
+
+/*
+ * batch_entry_cmp -- (internal) order batch entries by external LBA
+ */
+static int
+batch_entry_cmp(const void *lhs, const void *rhs)
+{
+	const struct batch_entry *l = lhs;
+	const struct batch_entry *r = rhs;
+
+	if (l->lba < r->lba)
+		return -1;
+	if (l->lba > r->lba)
+		return 1;
+
+	/* keep the requested order of writes to the same LBA */
+	if (l->idx < r->idx)
+		return -1;
+	return l->idx > r->idx;
+}
+
+/*
+ * batch_prepare -- (internal) validate and sort the LBAs of a batch
+ *
+ * Sorting the requests by LBA groups them by arena, which lets the
+ * batch walk the arenas (and the map) only once.  Nothing is read or
+ * written unless all the LBAs in the batch are valid.
+ *
+ * Returns the sorted array on success, otherwise NULL/errno.
+ */
+static struct batch_entry *
+batch_prepare(struct btt *bttp, const uint64_t *lbas, size_t nlba)
+{
+	struct batch_entry *batch = Malloc(nlba * sizeof(*batch));
+	if (batch == NULL) {
+		ERR("!Malloc for %zu batch entries", nlba);
+		return NULL;
+	}
+
+	int sorted = 1;
+	for (size_t i = 0; i < nlba; i++) {
+		if (invalid_lba(bttp, lbas[i])) {
+			Free(batch);
+			return NULL;
+		}
+
+		batch[i].lba = lbas[i];
+		batch[i].idx = i;
+
+		if (i > 0 && lbas[i] < lbas[i - 1])
+			sorted = 0;
+	}
+
+	/* the common case of contiguous requests needs no sorting */
+	if (!sorted)
+		qsort(batch, nlba, sizeof(*batch), batch_entry_cmp);
+
+	return batch;
+}
+
+/*
+ * batch_arena_lba -- (internal) find the arena & pre-map LBA in a batch
+ *
+ * Like lba_to_arena_lba(), but since the batch is sorted, the search
+ * resumes from the arena of the previous request (*arenap) whose first
+ * external LBA is *basep.
+ */
+static void
+batch_arena_lba(struct btt *bttp, uint64_t lba, unsigned *arenap,
+		uint64_t *basep, uint32_t *premap_lbap)
+{
+	ASSERT(bttp->laidout);
+	ASSERT(lba >= *basep);
+
+	while (lba - *basep >= bttp->arenas[*arenap].external_nlba) {
+		*basep += bttp->arenas[*arenap].external_nlba;
+		(*arenap)++;
+		ASSERT(*arenap < bttp->narena);
+	}
+
+	ASSERT(lba - *basep <= UINT32_MAX);
+	*premap_lbap = (uint32_t)(lba - *basep);
+}
+
+/*
+ * btt_readv -- read a batch of blocks from a btt namespace
+ *
+ * The block read from lbas[i] is stored at buf + i * lbasize.
+ *
+ * Returns 0 on success, otherwise -1/errno.
+ */
+int
+btt_readv(struct btt *bttp, unsigned lane, const uint64_t *lbas,
+		size_t nlba, void *buf)
+{
+	LOG(3, "bttp %p lane %u lbas %p nlba %zu", bttp, lane, lbas, nlba);
+
+	if (nlba == 0)
+		return 0;
+
+	struct batch_entry *batch = batch_prepare(bttp, lbas, nlba);
+	if (batch == NULL)
+		return -1;
+
+	int ret = 0;
+	unsigned arena = 0;
+	uint64_t base = 0;
+	for (size_t i = 0; i < nlba; i++) {
+		char *dest = (char *)buf + batch[i].idx * bttp->lbasize;
+
+		/* if there's no layout written yet, all reads return zeros */
+		if (!bttp->laidout) {
+			zero_block(bttp, dest);
+			continue;
+		}
+
+		uint32_t premap_lba;
+		batch_arena_lba(bttp, batch[i].lba, &arena, &base,
+				&premap_lba);
+
+		ret = read_premap(bttp, lane, &bttp->arenas[arena],
+				premap_lba, dest);
+		if (ret < 0)
+			break;
+	}
+
+	Free(batch);
+
+	return ret;
+}
+
+/*
+ * btt_writev -- write a batch of blocks to a btt namespace
+ *
+ * The block written to lbas[i] is taken from buf + i * lbasize.  Each
+ * block is written atomically, but the batch as a whole is not: if an
+ * error is returned, some of the blocks may have already been written.
+ *
+ * If the namespace provides the nswrite_nodrain and nsdrain callbacks,
+ * the ordering points of consecutive writes are combined: the map update
+ * of one block is drained together with the data and the flog update of
+ * the next one, and a single drain completes the batch.
+ *
+ * Returns 0 on success, otherwise -1/errno.
+ */
+int
+btt_writev(struct btt *bttp, unsigned lane, const uint64_t *lbas,
+		size_t nlba, const void *buf)
+{
+	LOG(3, "bttp %p lane %u lbas %p nlba %zu", bttp, lane, lbas, nlba);
+
+	if (nlba == 0)
+		return 0;
+
+	struct batch_entry *batch = batch_prepare(bttp, lbas, nlba);
+	if (batch == NULL)
+		return -1;
+
+	int ret = layout_write_once(bttp, lane);
+	if (ret < 0)
+		goto out;
+
+	int batched = bttp->ns_cbp->nswrite_nodrain != NULL &&
+			bttp->ns_cbp->nsdrain != NULL;
+
+	unsigned arena = 0;
+	uint64_t base = 0;
+	for (size_t i = 0; i < nlba; i++) {
+		const char *src =
+			(const char *)buf + batch[i].idx * bttp->lbasize;
+
+		uint32_t premap_lba;
+		batch_arena_lba(bttp, batch[i].lba, &arena, &base,
+				&premap_lba);
+
+		ret = write_premap(bttp, lane, &bttp->arenas[arena],
+				premap_lba, src, batched);
+		if (ret < 0)
+			break;
+	}
+
+	/* make the last map update(s) durable */
+	if (batched)
+		(*bttp->ns_cbp->nsdrain)(bttp->ns, lane);
+
+out:
+	Free(batch);
+
+	return ret;
+}
+
 /*
  * map_entry_setf -- (internal) set a given flag on a map entry
  *
@@ -1794,14 +2333,7 @@ map_entry_setf(struct btt *bttp, unsigned lane, uint64_t lba, uint32_t setf)
 		 * Treat this like the first write and write out
 		 * the metadata layout at this point.
 		 */
-		int err = 0;
-		util_mutex_lock(&bttp->layout_write_mutex);
-
-		if (!bttp->laidout)
-			err = write_layout(bttp, lane, 1);
-
-		util_mutex_unlock(&bttp->layout_write_mutex);
-
+		int err = layout_write_once(bttp, lane);
 		if (err < 0)
 			return err;
 	}
@@ -1841,7 +2373,8 @@ map_entry_setf(struct btt *bttp, unsigned lane, uint64_t lba, uint32_t setf)
 	/* create the new map entry */
 	new_entry = (old_entry & BTT_MAP_ENTRY_LBA_MASK) | setf;
 
-	if (map_unlock(bttp, lane, arenap, htole32(new_entry), premap_lba) < 0)
+	if (map_unlock(bttp, lane, arenap, htole32(new_entry),
+			premap_lba, 0) < 0)
 		return -1;
 
 	return 0;
@@ -2040,10 +2573,7 @@ btt_fini(struct btt *bttp)
 		for (unsigned i = 0; i < bttp->narena; i++) {
 			if (bttp->arenas[i].flogs)
 				Free(bttp->arenas[i].flogs);
-			if (bttp->arenas[i].rtt)
-				Free((void *)bttp->arenas[i].rtt);
-			if (bttp->arenas[i].rtt)
-				Free((void *)bttp->arenas[i].map_locks);
+			free_map_locks(&bttp->arenas[i]);
 		}
 		Free(bttp->arenas);
 	}
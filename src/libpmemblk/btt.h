@@ -18,6 +18,10 @@ struct ns_callback {
 		void *buf, size_t count, uint64_t off);
 	int (*nswrite)(void *ns, unsigned lane,
 		const void *buf, size_t count, uint64_t off);
+	/* optional, used by the batched entry points if provided */
+	int (*nswrite_nodrain)(void *ns, unsigned lane,
+		const void *buf, size_t count, uint64_t off);
+	void (*nsdrain)(void *ns, unsigned lane);
 	int (*nszero)(void *ns, unsigned lane, size_t count, uint64_t off);
 	ssize_t (*nsmap)(void *ns, unsigned lane, void **addrp,
 			size_t len, uint64_t off);
@@ -34,6 +38,10 @@ unsigned btt_nlane(struct btt *bttp);
 size_t btt_nlba(struct btt *bttp);
 int btt_read(struct btt *bttp, unsigned lane, uint64_t lba, void *buf);
 int btt_write(struct btt *bttp, unsigned lane, uint64_t lba, const void *buf);
+int btt_readv(struct btt *bttp, unsigned lane, const uint64_t *lbas,
+		size_t nlba, void *buf);
+int btt_writev(struct btt *bttp, unsigned lane, const uint64_t *lbas,
+		size_t nlba, const void *buf);
 int btt_set_zero(struct btt *bttp, unsigned lane, uint64_t lba);
 int btt_set_error(struct btt *bttp, unsigned lane, uint64_t lba);
 int btt_check(struct btt *bttp);
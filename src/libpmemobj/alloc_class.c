@@ -6,6 +6,7 @@
  */
 
 #include <float.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "alloc_class.h"
@@ -102,6 +103,12 @@ static const struct {
 
 #define ALLOC_CLASS_DEFAULT_FLAGS CHUNK_FLAG_FLEX_BITMAP
 
+/*
+ * The number of the most frequent allocation sizes from the histogram that
+ * are taken into account when proposing new allocation classes.
+ */
+#define PROPOSAL_MAX_SIZES 256
+
 struct alloc_class_collection {
 	size_t granularity;
 
@@ -121,6 +128,14 @@ struct alloc_class_collection {
 
 	int fail_on_missing_class;
 	int autogenerate_on_missing_class;
+
+	/*
+	 * The number of default allocations of each size, indexed the same
+	 * way as the class_map_by_alloc_size. Allocated when the histogram
+	 * is enabled for the first time.
+	 */
+	uint64_t *histogram;
+	int histogram_enabled;
 };
 
 /*
@@ -527,6 +542,7 @@ alloc_class_collection_delete(struct alloc_class_collection *ac)
 	if (ac->class_map_by_unit_size)
 		critnib_delete(ac->class_map_by_unit_size);
 	Free(ac->class_map_by_alloc_size);
+	Free(ac->histogram);
 	Free(ac);
 }
 
@@ -568,8 +584,12 @@ struct alloc_class *
 alloc_class_by_alloc_size(struct alloc_class_collection *ac, size_t size)
 {
 	if (size < ac->last_run_max_size) {
-		uint8_t class_id = ac->class_map_by_alloc_size[
-			SIZE_TO_CLASS_MAP_INDEX(size, ac->granularity)];
+		size_t map_idx = SIZE_TO_CLASS_MAP_INDEX(size, ac->granularity);
+
+		if (unlikely(ac->histogram_enabled))
+			util_fetch_and_add64(&ac->histogram[map_idx], 1);
+
+		uint8_t class_id = ac->class_map_by_alloc_size[map_idx];
 
 		if (class_id == MAX_ALLOCATION_CLASSES) {
 			if (ac->fail_on_missing_class)
@@ -634,3 +654,314 @@ alloc_class_calc_size_idx(struct alloc_class *c, size_t size)
 
 	return size_idx;
 }
+
+/*
+ * alloc_class_maps_size -- (internal) returns the number of entries in the
+ *	maps indexed by the allocation size
+ */
+static size_t
+alloc_class_maps_size(struct alloc_class_collection *ac)
+{
+	return (MAX_RUN_SIZE / ac->granularity) + 1;
+}
+
+/*
+ * alloc_class_histogram_enable -- starts or stops recording the sizes of the
+ *	default allocations
+ *
+ * Enabling a disabled histogram clears all of the previously recorded sizes.
+ * Disabling it keeps them, so that they can still be used for a proposal.
+ */
+int
+alloc_class_histogram_enable(struct alloc_class_collection *ac, int enable)
+{
+	LOG(10, NULL);
+
+	if (!enable) {
+		ac->histogram_enabled = 0;
+		return 0;
+	}
+
+	if (ac->histogram_enabled)
+		return 0;
+
+	size_t hsize = alloc_class_maps_size(ac) * sizeof(uint64_t);
+
+	/*
+	 * The histogram is never freed before the collection, because the
+	 * allocating threads might still be updating it after it's disabled.
+	 */
+	if (ac->histogram == NULL) {
+		uint64_t *histogram = Zalloc(hsize);
+		if (histogram == NULL)
+			return -1;
+
+		if (!util_bool_compare_and_swap64(&ac->histogram,
+				NULL, histogram))
+			Free(histogram);
+	} else {
+		memset(ac->histogram, 0, hsize);
+	}
+
+	ac->histogram_enabled = 1;
+
+	return 0;
+}
+
+/*
+ * alloc_class_histogram_is_enabled -- returns whether the sizes of the
+ *	default allocations are recorded
+ */
+int
+alloc_class_histogram_is_enabled(struct alloc_class_collection *ac)
+{
+	return ac->histogram_enabled;
+}
+
+/*
+ * alloc_class_size_map_reset -- forgets the classes assigned to the
+ *	allocation sizes, so that they are chosen again among all of the
+ *	currently existing classes
+ */
+void
+alloc_class_size_map_reset(struct alloc_class_collection *ac)
+{
+	LOG(10, NULL);
+
+	/*
+	 * Concurrent allocations might see either the previously assigned
+	 * class or none at all, both of which are valid.
+	 */
+	memset(ac->class_map_by_alloc_size, MAX_ALLOCATION_CLASSES,
+		alloc_class_maps_size(ac));
+}
+
+/* a single allocation size taken into account by the proposal */
+struct proposal_size {
+	uint64_t count; /* number of allocations of this size */
+	size_t size; /* allocation size, including the header */
+	size_t waste; /* wasted bytes of a single allocation */
+};
+
+/* a candidate unit size of a proposed class */
+struct proposal_unit {
+	size_t unit_size;
+	uint32_t size_idx;
+	uint32_t nallocs; /* number of units in a single run */
+	size_t max_units; /* largest number of units in a single allocation */
+	int used;
+};
+
+/*
+ * proposal_size_compare -- (internal) orders the sizes by decreasing
+ *	number of allocations
+ */
+static int
+proposal_size_compare(const void *lhs, const void *rhs)
+{
+	const struct proposal_size *l = lhs;
+	const struct proposal_size *r = rhs;
+
+	if (l->count != r->count)
+		return l->count < r->count ? 1 : -1;
+
+	return 0;
+}
+
+/*
+ * proposal_unit_waste -- (internal) returns the number of bytes wasted by
+ *	an allocation of the given size in a class with the candidate unit size,
+ *	or SIZE_MAX if the class cannot serve the allocation
+ */
+static size_t
+proposal_unit_waste(const struct proposal_unit *u, size_t size)
+{
+	size_t units = CALC_SIZE_IDX(u->unit_size, size);
+	if (units > u->max_units)
+		return SIZE_MAX;
+
+	return u->unit_size * units - size;
+}
+
+/*
+ * alloc_class_run_size_idx -- (internal) returns the number of chunks of the
+ *	runs of a class with the given unit size, same as the one used for the
+ *	generated default classes
+ */
+static uint32_t
+alloc_class_run_size_idx(size_t unit_size)
+{
+	uint64_t required_size_bytes = unit_size * RUN_MIN_NALLOCS;
+	uint32_t required_size_idx = 1;
+	if (required_size_bytes > RUN_DEFAULT_SIZE) {
+		required_size_bytes -= RUN_DEFAULT_SIZE;
+		required_size_idx +=
+			CALC_SIZE_IDX(CHUNKSIZE, required_size_bytes);
+		if (required_size_idx > RUN_SIZE_IDX_CAP)
+			required_size_idx = RUN_SIZE_IDX_CAP;
+	}
+
+	return required_size_idx;
+}
+
+/*
+ * alloc_class_propose -- proposes up to max new allocation classes that
+ *	reduce the internal fragmentation of the recorded default allocations
+ *
+ * The proposal considers the most frequent allocation sizes and greedily
+ * picks the unit sizes (each equal to one of the allocation sizes) that save
+ * the most bytes, taking into account the classes picked so far. Only the
+ * compact header and the default alignment are considered.
+ *
+ * Returns the number of the proposed classes or -1 on error.
+ */
+int
+alloc_class_propose(struct alloc_class_collection *ac,
+	struct alloc_class_proposal *classes, unsigned max,
+	struct alloc_class_waste *waste)
+{
+	LOG(10, NULL);
+
+	memset(waste, 0, sizeof(*waste));
+
+	if (ac->histogram == NULL)
+		return 0;
+
+	size_t maps_size = alloc_class_maps_size(ac);
+
+	size_t nsizes = 0;
+	for (size_t i = 1; i < maps_size; ++i) {
+		if (ac->histogram[i] != 0)
+			nsizes++;
+	}
+
+	if (nsizes == 0)
+		return 0;
+
+	struct proposal_size *sizes = Malloc(nsizes * sizeof(*sizes));
+	if (sizes == NULL)
+		return -1;
+
+	nsizes = 0;
+	for (size_t i = 1; i < maps_size; ++i) {
+		uint64_t count = ac->histogram[i];
+		if (count == 0)
+			continue;
+
+		sizes[nsizes].count = count;
+		/* the largest size that maps to this entry */
+		sizes[nsizes].size = i * ac->granularity;
+		nsizes++;
+	}
+
+	qsort(sizes, nsizes, sizeof(*sizes), proposal_size_compare);
+	if (nsizes > PROPOSAL_MAX_SIZES)
+		nsizes = PROPOSAL_MAX_SIZES;
+
+	struct proposal_unit *units = Malloc(nsizes * sizeof(*units));
+	if (units == NULL) {
+		Free(sizes);
+		return -1;
+	}
+
+	/*
+	 * Calculate the current waste of each size using the class that is
+	 * (or would be) assigned to it and turn the sizes into candidate unit
+	 * sizes of the proposed classes.
+	 */
+	size_t hsize = header_type_to_size[HEADER_COMPACT];
+	for (size_t i = 0; i < nsizes; ++i) {
+		struct proposal_size *ps = &sizes[i];
+
+		uint8_t id = ac->class_map_by_alloc_size[
+			SIZE_TO_CLASS_MAP_INDEX(ps->size, ac->granularity)];
+		struct alloc_class *c = id == MAX_ALLOCATION_CLASSES ?
+			alloc_class_find_min_frag(ac, ps->size) :
+			ac->aclasses[id];
+
+		size_t real_size = ps->size +
+			header_type_to_size[c->header_type];
+		size_t nunits = CALC_SIZE_IDX(c->unit_size, real_size);
+
+		ps->waste = c->unit_size * nunits - real_size;
+
+		waste->requested += ps->count * ps->size;
+		waste->wasted += ps->count * ps->waste;
+
+		/* from now on the size is the one of the proposed classes */
+		ps->size += hsize;
+
+		struct proposal_unit *u = &units[i];
+		u->unit_size = ps->size;
+		u->size_idx = alloc_class_run_size_idx(u->unit_size);
+		u->used = 0;
+
+		struct run_bitmap b;
+		uint32_t size_idx = u->size_idx;
+		memblock_run_bitmap(&size_idx, ALLOC_CLASS_DEFAULT_FLAGS,
+			u->unit_size, 0, NULL, &b);
+		u->nallocs = b.nbits;
+		u->max_units = b.nbits < RUN_UNIT_MAX_ALLOC ?
+			b.nbits : RUN_UNIT_MAX_ALLOC;
+	}
+
+	/* proposed classes cannot use the slots that are already taken */
+	unsigned nfree = 0;
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		if (ac->aclasses[i] == NULL)
+			nfree++;
+	}
+
+	if (max > nfree)
+		max = nfree;
+
+	uint64_t total_gain = 0;
+	unsigned nclasses = 0;
+	while (nclasses < max) {
+		struct proposal_unit *best = NULL;
+		uint64_t best_gain = 0;
+
+		for (size_t i = 0; i < nsizes; ++i) {
+			struct proposal_unit *u = &units[i];
+			if (u->used)
+				continue;
+
+			uint64_t gain = 0;
+			for (size_t j = 0; j < nsizes; ++j) {
+				size_t w = proposal_unit_waste(u,
+					sizes[j].size);
+				if (w < sizes[j].waste)
+					gain += sizes[j].count *
+						(sizes[j].waste - w);
+			}
+
+			if (gain > best_gain) {
+				best = u;
+				best_gain = gain;
+			}
+		}
+
+		if (best == NULL)
+			break;
+
+		best->used = 1;
+		total_gain += best_gain;
+		for (size_t j = 0; j < nsizes; ++j) {
+			size_t w = proposal_unit_waste(best, sizes[j].size);
+			if (w < sizes[j].waste)
+				sizes[j].waste = w;
+		}
+
+		classes[nclasses].unit_size = best->unit_size;
+		classes[nclasses].size_idx = best->size_idx;
+		classes[nclasses].nallocs = best->nallocs;
+		nclasses++;
+	}
+
+	waste->proposed_wasted = waste->wasted - total_gain;
+
+	Free(units);
+	Free(sizes);
+
+	return (int)nclasses;
+}
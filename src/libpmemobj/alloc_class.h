@@ -72,6 +72,30 @@ alloc_class_new(int id, struct alloc_class_collection *ac,
 void alloc_class_delete(struct alloc_class_collection *ac,
 	struct alloc_class *c);
 
+int alloc_class_histogram_enable(struct alloc_class_collection *ac,
+	int enable);
+int alloc_class_histogram_is_enabled(struct alloc_class_collection *ac);
+
+void alloc_class_size_map_reset(struct alloc_class_collection *ac);
+
+/* a class proposed for the recorded allocation sizes */
+struct alloc_class_proposal {
+	size_t unit_size;
+	uint32_t size_idx;
+	uint32_t nallocs; /* number of units in a single run */
+};
+
+/* fragmentation of the recorded allocations, in bytes */
+struct alloc_class_waste {
+	uint64_t requested;
+	uint64_t wasted; /* with the current classes */
+	uint64_t proposed_wasted; /* with the proposed classes */
+};
+
+int alloc_class_propose(struct alloc_class_collection *ac,
+	struct alloc_class_proposal *classes, unsigned max,
+	struct alloc_class_waste *waste);
+
 #ifdef __cplusplus
 }
 #endif
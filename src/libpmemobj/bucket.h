@@ -19,6 +19,8 @@
 extern "C" {
 #endif
 
+struct zone_range;
+
 #define CALC_SIZE_IDX(_unit_size, _size)\
 ((_size) == 0 ? 0 : (uint32_t)((((_size) - 1) / (_unit_size)) + 1))
 
@@ -32,6 +34,9 @@ struct bucket {
 
 	struct memory_block_reserved *active_memory_block;
 	int is_active;
+
+	/* zones bound to the arena of the bucket, NULL if not bound */
+	struct zone_range *zones;
 };
 
 struct bucket *bucket_new(struct block_container *c,
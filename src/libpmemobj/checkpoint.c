@@ -0,0 +1,653 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * checkpoint.c -- writing back the modifications of a pool opened in
+ *	the copy-on-write mode
+ *
+ * A pool opened with copy_on_write.at_open is mapped privately, so a page
+ * written since the pool was opened, or since the last checkpoint, is
+ * the only kind of page which no longer maps its part file. Such pages are
+ * found through /proc/self/pagemap and written back to the part files,
+ * after which they are dropped from the mapping, which makes them map
+ * the part files again.
+ *
+ * The part files are not modified in place until all the modified pages
+ * are stored in a journal next to the pool, so a checkpoint interrupted
+ * by a crash can be replayed the next time the pool is opened. A journal
+ * which is incomplete is discarded, the part files are intact then.
+ */
+
+#include <fcntl.h>
+#include <libgen.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "checkpoint.h"
+#include "file.h"
+#include "mmap.h"
+#include "os.h"
+#include "out.h"
+#include "util.h"
+#include "vec.h"
+
+#define CHECKPOINT_SIG "PMEMCKP"
+#define CHECKPOINT_SIG_LEN 8
+
+/* bits of an entry of /proc/self/pagemap */
+#define PAGEMAP_PRESENT (1ULL << 63)
+#define PAGEMAP_SWAP (1ULL << 62)
+#define PAGEMAP_FILE (1ULL << 61)
+
+/* number of entries of /proc/self/pagemap read at once */
+#define PAGEMAP_BATCH 512
+
+/*
+ * The journal starts with the header, which is followed by nparts paths
+ * of the part files, each one preceded by its padded length, and then by
+ * nranges ranges of the part files, each one followed by its contents.
+ */
+struct checkpoint_hdr {
+	char signature[CHECKPOINT_SIG_LEN];
+	uint64_t nparts;
+	uint64_t nranges;
+	uint64_t size;		/* size of the whole journal */
+	uint64_t checksum;	/* checksum of the whole journal */
+};
+
+struct checkpoint_range {
+	uint64_t part;		/* index of the path of the part file */
+	uint64_t offset;	/* offset of the range in the part file */
+	uint64_t len;
+};
+
+/* a range of the part file and the modified pages which belong there */
+struct checkpoint_dirty {
+	struct checkpoint_range range;
+	char *addr;
+};
+
+VEC(checkpoint_dirty_vec, struct checkpoint_dirty);
+
+/*
+ * checkpoint_path -- (internal) allocates the path of the journal
+ */
+static char *
+checkpoint_path(const char *path)
+{
+	size_t len = strlen(path) + sizeof(CHECKPOINT_SUFFIX);
+
+	char *jpath = Malloc(len);
+	if (jpath == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	strcpy(jpath, path);
+	strcat(jpath, CHECKPOINT_SUFFIX);
+
+	return jpath;
+}
+
+/*
+ * checkpoint_part_offset -- (internal) returns the offset in the part file
+ *	at which the mapping of the part starts
+ */
+static size_t
+checkpoint_part_offset(struct pool_set *set, unsigned p)
+{
+	if (p == 0 || (set->options & (OPTION_SINGLEHDR | OPTION_NOHDRS)))
+		return 0;
+
+	return Mmap_align;
+}
+
+#ifdef __linux__
+/*
+ * checkpoint_scan -- (internal) appends the ranges of the part which were
+ *	modified since it was mapped or last written back
+ *
+ * A modified page of a private mapping is an anonymous one, either present
+ * in memory or swapped out.
+ */
+static int
+checkpoint_scan(int pagemap, struct pool_set_part *part, uint64_t partidx,
+	size_t offset, struct checkpoint_dirty_vec *dirty)
+{
+	uint64_t entries[PAGEMAP_BATCH];
+	size_t npages = part->size / Pagesize;
+	uintptr_t first = (uintptr_t)part->addr / Pagesize;
+	struct checkpoint_dirty *last = NULL;
+
+	for (size_t i = 0; i < npages; i += PAGEMAP_BATCH) {
+		size_t n = MIN(npages - i, PAGEMAP_BATCH);
+		size_t len = n * sizeof(entries[0]);
+		os_off_t off = (os_off_t)((first + i) * sizeof(entries[0]));
+
+		if (pread(pagemap, entries, len, off) != (ssize_t)len) {
+			ERR("!cannot read the page map");
+			return -1;
+		}
+
+		for (size_t j = 0; j < n; ++j) {
+			uint64_t e = entries[j];
+			int modified = (e & PAGEMAP_SWAP) ||
+				((e & PAGEMAP_PRESENT) && !(e & PAGEMAP_FILE));
+			if (!modified) {
+				last = NULL;
+				continue;
+			}
+
+			if (last != NULL) {
+				last->range.len += Pagesize;
+				continue;
+			}
+
+			struct checkpoint_dirty d;
+			d.range.part = partidx;
+			d.range.offset = offset + (i + j) * Pagesize;
+			d.range.len = Pagesize;
+			d.addr = (char *)part->addr + (i + j) * Pagesize;
+
+			if (VEC_PUSH_BACK(dirty, d) != 0)
+				return -1;
+
+			last = &VEC_BACK(dirty);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * checkpoint_find -- (internal) finds the modified ranges of all the parts
+ */
+static int
+checkpoint_find(struct pool_set *set, struct checkpoint_dirty_vec *dirty)
+{
+	int pagemap = os_open("/proc/self/pagemap", O_RDONLY);
+	if (pagemap < 0) {
+		ERR("!cannot open the page map");
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	int ret = 0;
+	uint64_t partidx = 0;
+	for (unsigned r = 0; r < set->nreplicas && ret == 0; ++r) {
+		struct pool_replica *rep = set->replica[r];
+		for (unsigned p = 0; p < rep->nparts; ++p, ++partidx) {
+			ret = checkpoint_scan(pagemap, &rep->part[p], partidx,
+				checkpoint_part_offset(set, p), dirty);
+			if (ret)
+				break;
+		}
+	}
+
+	int oerrno = errno;
+	os_close(pagemap);
+	errno = oerrno;
+
+	return ret;
+}
+
+/*
+ * checkpoint_drop -- (internal) drops the written back pages from
+ *	the mapping, they are read again from the part file when accessed
+ */
+static void
+checkpoint_drop(struct checkpoint_dirty *d)
+{
+	/* the pages still map the part file if this fails */
+	if (madvise(d->addr, d->range.len, MADV_DONTNEED))
+		LOG(2, "!madvise");
+}
+#else
+/*
+ * checkpoint_find -- (internal) finds the modified ranges of all the parts
+ */
+static int
+checkpoint_find(struct pool_set *set, struct checkpoint_dirty_vec *dirty)
+{
+	ERR("tracking of the modified pages is not supported");
+	errno = ENOTSUP;
+	return -1;
+}
+
+/*
+ * checkpoint_drop -- (internal) drops the written back pages from
+ *	the mapping
+ */
+static void
+checkpoint_drop(struct checkpoint_dirty *d)
+{
+}
+#endif
+
+/*
+ * checkpoint_write -- (internal) writes a piece of the journal and updates
+ *	its checksum, the length has to be a multiple of 8
+ */
+static int
+checkpoint_write(int fd, const void *buf, size_t len, uint64_t *csum)
+{
+	*csum = util_checksum_seq(buf, len, *csum);
+
+	if (util_write_all(fd, buf, len) < 0) {
+		ERR("!cannot write the checkpoint journal");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * checkpoint_journal_create -- (internal) stores the modified ranges and
+ *	the paths of the part files in the journal
+ */
+static int
+checkpoint_journal_create(const char *jpath, struct pool_set *set,
+	struct checkpoint_dirty_vec *dirty)
+{
+	int fd = os_open(jpath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		ERR("!cannot create the checkpoint journal %s", jpath);
+		return -1;
+	}
+
+	struct checkpoint_hdr hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.signature, CHECKPOINT_SIG, CHECKPOINT_SIG_LEN);
+	hdr.nranges = VEC_SIZE(dirty);
+	hdr.size = sizeof(hdr);
+
+	for (unsigned r = 0; r < set->nreplicas; ++r)
+		hdr.nparts += set->replica[r]->nparts;
+
+	char **paths = Zalloc(hdr.nparts * sizeof(char *));
+	if (paths == NULL) {
+		ERR("!Zalloc");
+		goto err_close;
+	}
+
+	uint64_t *lens = Malloc(hdr.nparts * sizeof(uint64_t));
+	if (lens == NULL) {
+		ERR("!Malloc");
+		goto err_paths;
+	}
+
+	uint64_t partidx = 0;
+	for (unsigned r = 0; r < set->nreplicas; ++r) {
+		struct pool_replica *rep = set->replica[r];
+		for (unsigned p = 0; p < rep->nparts; ++p, ++partidx) {
+			/* the journal may be replayed from another directory */
+			char *rpath = util_part_realpath(rep->part[p].path);
+			if (rpath == NULL) {
+				ERR("!cannot resolve the path %s",
+					rep->part[p].path);
+				goto err_lens;
+			}
+
+			/* the paths are stored padded with zeroes */
+			lens[partidx] = ALIGN_UP(strlen(rpath) + 1,
+				sizeof(uint64_t));
+			paths[partidx] = Zalloc(lens[partidx]);
+			if (paths[partidx] == NULL) {
+				ERR("!Zalloc");
+				free(rpath);
+				goto err_lens;
+			}
+
+			strcpy(paths[partidx], rpath);
+			free(rpath);
+
+			hdr.size += sizeof(uint64_t) + lens[partidx];
+		}
+	}
+
+	struct checkpoint_dirty *d;
+	VEC_FOREACH_BY_PTR(d, dirty)
+		hdr.size += sizeof(d->range) + d->range.len;
+
+	/* the checksum covers the header with the checksum field zeroed */
+	uint64_t csum = 0;
+	if (checkpoint_write(fd, &hdr, sizeof(hdr), &csum))
+		goto err_lens;
+
+	for (uint64_t i = 0; i < hdr.nparts; ++i) {
+		if (checkpoint_write(fd, &lens[i], sizeof(lens[i]), &csum) ||
+		    checkpoint_write(fd, paths[i], lens[i], &csum))
+			goto err_lens;
+	}
+
+	VEC_FOREACH_BY_PTR(d, dirty) {
+		if (checkpoint_write(fd, &d->range, sizeof(d->range), &csum) ||
+		    checkpoint_write(fd, d->addr, d->range.len, &csum))
+			goto err_lens;
+	}
+
+	/* the journal is complete once the checksum is stored */
+	hdr.checksum = csum;
+	if (pwrite(fd, &hdr.checksum, sizeof(hdr.checksum),
+			offsetof(struct checkpoint_hdr, checksum)) !=
+			sizeof(hdr.checksum)) {
+		ERR("!cannot write the checkpoint journal");
+		goto err_lens;
+	}
+
+	if (os_fsync(fd)) {
+		ERR("!cannot sync the checkpoint journal");
+		goto err_lens;
+	}
+
+	Free(lens);
+	for (uint64_t i = 0; i < hdr.nparts; ++i)
+		Free(paths[i]);
+	Free(paths);
+
+	(void) os_close(fd);
+
+	/* fsync the journal's directory, so that it survives a crash */
+	char *dir = Strdup(jpath);
+	if (dir == NULL) {
+		ERR("!Strdup");
+		return -1;
+	}
+
+	int ret = os_fsync_dir(dirname(dir));
+	if (ret)
+		ERR("!cannot sync the directory of %s", jpath);
+
+	Free(dir);
+
+	return ret;
+
+err_lens:
+	Free(lens);
+err_paths:
+	for (uint64_t i = 0; i < hdr.nparts; ++i)
+		Free(paths[i]);
+	Free(paths);
+err_close:
+	(void) os_close(fd);
+	(void) os_unlink(jpath);
+	return -1;
+}
+
+/*
+ * checkpoint_apply -- (internal) writes the given ranges to the part files
+ *
+ * The part files are identified by their index in the paths array.
+ */
+static int
+checkpoint_apply(char **paths, uint64_t nparts,
+	struct checkpoint_range **ranges, const void **data, uint64_t nranges)
+{
+	int ret = -1;
+
+	int *fds = Malloc(nparts * sizeof(int));
+	if (fds == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	for (uint64_t i = 0; i < nparts; ++i)
+		fds[i] = -1;
+
+	for (uint64_t i = 0; i < nranges; ++i) {
+		struct checkpoint_range *range = ranges[i];
+		int *fd = &fds[range->part];
+
+		if (*fd < 0) {
+			*fd = os_open(paths[range->part], O_RDWR);
+			if (*fd < 0) {
+				ERR("!cannot open %s", paths[range->part]);
+				goto out;
+			}
+		}
+
+		if (pwrite(*fd, data[i], range->len,
+				(os_off_t)range->offset) !=
+				(ssize_t)range->len) {
+			ERR("!cannot write %s", paths[range->part]);
+			goto out;
+		}
+	}
+
+	for (uint64_t i = 0; i < nparts; ++i) {
+		if (fds[i] >= 0 && os_fsync(fds[i])) {
+			ERR("!cannot sync %s", paths[i]);
+			goto out;
+		}
+	}
+
+	ret = 0;
+
+out:
+	for (uint64_t i = 0; i < nparts; ++i) {
+		if (fds[i] >= 0)
+			(void) os_close(fds[i]);
+	}
+	Free(fds);
+
+	return ret;
+}
+
+/*
+ * checkpoint_commit -- writes all the pages modified since the pool set
+ *	was opened, or since the last checkpoint, back to the part files
+ *
+ * No other thread may modify the pool in the meantime.
+ */
+int
+checkpoint_commit(struct pool_set *set)
+{
+	LOG(3, "set %p", set);
+
+	struct checkpoint_dirty_vec dirty = VEC_INITIALIZER;
+	char *jpath = NULL;
+	char **paths = NULL;
+	struct checkpoint_range **ranges = NULL;
+	const void **data = NULL;
+	uint64_t nparts = 0;
+	int ret = -1;
+
+	if (checkpoint_find(set, &dirty))
+		goto out;
+
+	size_t nranges = VEC_SIZE(&dirty);
+	LOG(4, "%zu modified ranges", nranges);
+
+	if (nranges == 0) {
+		ret = 0;
+		goto out;
+	}
+
+	jpath = checkpoint_path(set->path);
+	if (jpath == NULL)
+		goto out;
+
+	if (checkpoint_journal_create(jpath, set, &dirty))
+		goto out;
+
+	for (unsigned r = 0; r < set->nreplicas; ++r)
+		nparts += set->replica[r]->nparts;
+
+	paths = Malloc(nparts * sizeof(char *));
+	ranges = Malloc(nranges * sizeof(*ranges));
+	data = Malloc(nranges * sizeof(*data));
+	if (paths == NULL || ranges == NULL || data == NULL) {
+		ERR("!Malloc");
+		goto out_arrays;
+	}
+
+	uint64_t partidx = 0;
+	for (unsigned r = 0; r < set->nreplicas; ++r) {
+		struct pool_replica *rep = set->replica[r];
+		for (unsigned p = 0; p < rep->nparts; ++p)
+			paths[partidx++] = (char *)rep->part[p].path;
+	}
+
+	for (size_t i = 0; i < nranges; ++i) {
+		struct checkpoint_dirty *d = VEC_GET(&dirty, i);
+		ranges[i] = &d->range;
+		data[i] = d->addr;
+	}
+
+	/* if this fails, the journal is replayed at the next open */
+	if (checkpoint_apply(paths, nparts, ranges, data, nranges))
+		goto out_arrays;
+
+	if (os_unlink(jpath)) {
+		ERR("!cannot remove the checkpoint journal %s", jpath);
+		goto out_arrays;
+	}
+
+	struct checkpoint_dirty *d;
+	VEC_FOREACH_BY_PTR(d, &dirty)
+		checkpoint_drop(d);
+
+	ret = 0;
+
+out_arrays:
+	Free(data);
+	Free(ranges);
+	Free(paths);
+out:
+	Free(jpath);
+	VEC_DELETE(&dirty);
+	return ret;
+}
+
+/*
+ * checkpoint_journal_parse -- (internal) validates the journal and finds
+ *	the paths and the ranges stored in it
+ *
+ * Returns 1 if the journal is incomplete.
+ */
+static int
+checkpoint_journal_parse(char *addr, size_t size, char ***pathsp,
+	struct checkpoint_range ***rangesp, const void ***datap)
+{
+	struct checkpoint_hdr *hdr = (struct checkpoint_hdr *)addr;
+
+	if (size < sizeof(*hdr) || hdr->size != size ||
+	    memcmp(hdr->signature, CHECKPOINT_SIG, CHECKPOINT_SIG_LEN) != 0)
+		return 1;
+
+	uint64_t csum = hdr->checksum;
+	hdr->checksum = 0;
+	uint64_t computed = util_checksum_seq(addr, size, 0);
+	hdr->checksum = csum;
+
+	if (computed != csum)
+		return 1;
+
+	/* a journal with a valid checksum is trusted to be well-formed */
+	char **paths = Malloc(hdr->nparts * sizeof(char *));
+	struct checkpoint_range **ranges =
+		Malloc(hdr->nranges * sizeof(*ranges));
+	const void **data = Malloc(hdr->nranges * sizeof(*data));
+	if (paths == NULL || ranges == NULL || data == NULL) {
+		ERR("!Malloc");
+		Free(paths);
+		Free(ranges);
+		Free(data);
+		return -1;
+	}
+
+	char *p = addr + sizeof(*hdr);
+	for (uint64_t i = 0; i < hdr->nparts; ++i) {
+		uint64_t len = *(uint64_t *)p;
+		paths[i] = p + sizeof(uint64_t);
+		p += sizeof(uint64_t) + len;
+	}
+
+	for (uint64_t i = 0; i < hdr->nranges; ++i) {
+		ranges[i] = (struct checkpoint_range *)p;
+		data[i] = p + sizeof(struct checkpoint_range);
+		p += sizeof(struct checkpoint_range) + ranges[i]->len;
+	}
+
+	*pathsp = paths;
+	*rangesp = ranges;
+	*datap = data;
+
+	return 0;
+}
+
+/*
+ * checkpoint_recover -- completes the checkpoint of the pool interrupted
+ *	by a crash, if any
+ */
+int
+checkpoint_recover(const char *path)
+{
+	LOG(3, "path %s", path);
+
+	char *jpath = checkpoint_path(path);
+	if (jpath == NULL)
+		return -1;
+
+	int ret = util_file_exists(jpath);
+	if (ret <= 0)
+		goto out;
+
+	ret = -1;
+
+	ssize_t size = util_file_get_size(jpath);
+	if (size < 0)
+		goto out;
+
+	if ((size_t)size < sizeof(struct checkpoint_hdr)) {
+		LOG(2, "discarding the incomplete checkpoint journal %s",
+			jpath);
+		goto out_unlink;
+	}
+
+	char *addr = util_file_map_whole(jpath);
+	if (addr == NULL)
+		goto out;
+
+	char **paths;
+	struct checkpoint_range **ranges;
+	const void **data;
+	int parsed = checkpoint_journal_parse(addr, (size_t)size, &paths,
+		&ranges, &data);
+	if (parsed < 0)
+		goto out_unmap;
+
+	if (parsed == 0) {
+		struct checkpoint_hdr *hdr = (struct checkpoint_hdr *)addr;
+		LOG(2, "replaying the checkpoint journal %s", jpath);
+
+		int applied = checkpoint_apply(paths, hdr->nparts, ranges,
+			data, hdr->nranges);
+
+		Free(data);
+		Free(ranges);
+		Free(paths);
+
+		if (applied)
+			goto out_unmap;
+	} else {
+		LOG(2, "discarding the incomplete checkpoint journal %s",
+			jpath);
+	}
+
+	util_unmap(addr, (size_t)size);
+
+out_unlink:
+	ret = os_unlink(jpath);
+	if (ret)
+		ERR("!cannot remove the checkpoint journal %s", jpath);
+	goto out;
+
+out_unmap:
+	util_unmap(addr, (size_t)size);
+out:
+	Free(jpath);
+	return ret;
+}
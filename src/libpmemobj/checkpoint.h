@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * checkpoint.h -- writing back the modifications of a pool opened in
+ *	the copy-on-write mode
+ */
+
+#ifndef LIBPMEMOBJ_CHECKPOINT_H
+#define LIBPMEMOBJ_CHECKPOINT_H 1
+
+#include "set.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* suffix of the journal of a checkpoint, appended to the pool path */
+#define CHECKPOINT_SUFFIX "_checkpoint"
+
+int checkpoint_commit(struct pool_set *set);
+int checkpoint_recover(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,387 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * dirtymap.c -- tracking of the pool regions modified since the last sync
+ *	of the replicas
+ *
+ * The bitmap lives in the pool descriptor, so every replica has its own copy
+ * of it. It is updated in the master replica first and then in all the other
+ * ones, always before the data of a newly marked region is flushed or copied
+ * to the other replicas. This way, whichever replica survives a crash, its
+ * bitmap covers every region in which the replicas might have diverged and
+ * pmempool sync can copy only these regions instead of whole replicas.
+ *
+ * The stores the application makes directly to the master replica are not
+ * intercepted, so they can reach its media before the region is marked.
+ */
+
+#include <string.h>
+
+#include "dirtymap.h"
+#include "obj.h"
+#include "out.h"
+#include "set.h"
+#include "valgrind_internal.h"
+
+/*
+ * dirtymap_shift -- (internal) returns log2 of the region size for which
+ *	the bitmap covers the whole pool
+ */
+static uint64_t
+dirtymap_shift(size_t poolsize)
+{
+	uint64_t shift = DIRTYMAP_MIN_SHIFT;
+	while ((poolsize >> shift) >= DIRTYMAP_NBITS)
+		shift++;
+
+	return shift;
+}
+
+/*
+ * dirtymap_set_shift -- (internal) updates the runtime state after the shift
+ *	has changed
+ */
+static void
+dirtymap_set_shift(struct dirtymap *dmap, uint64_t shift)
+{
+	size_t poolsize = dmap->pop->set->poolsize;
+
+	dmap->shift = shift;
+	dmap->nregions = shift == 0 ? 0 :
+		(size_t)((poolsize + (1ULL << shift) - 1) >> shift);
+}
+
+/*
+ * dirtymap_is_published -- (internal) returns true if the region number n
+ *	is marked in all the replicas
+ */
+static inline int
+dirtymap_is_published(struct dirtymap *dmap, size_t n)
+{
+	uint32_t word;
+	util_atomic_load_explicit32(&dmap->published[n / 32], &word,
+		memory_order_acquire);
+
+	return (word >> (n % 32)) & 1;
+}
+
+/*
+ * dirtymap_publish_all -- (internal) makes the runtime copy of the bitmap
+ *	match the persistent one
+ *
+ * Must be called with the lock held, or before the dirty map is used.
+ */
+static void
+dirtymap_publish_all(struct dirtymap *dmap)
+{
+	for (size_t i = 0; i < DIRTYMAP_NWORDS; ++i) {
+		uint32_t word = 0;
+		for (size_t n = i * 32; n < (i + 1) * 32; ++n) {
+			if (dirtymap_persistent_test(dmap->persistent, n))
+				word |= 1U << (n % 32);
+		}
+		util_atomic_store_explicit32(&dmap->published[i], word,
+			memory_order_release);
+	}
+}
+
+/*
+ * dirtymap_persist -- (internal) stores the given part of the bitmap
+ *	in all the replicas, the master replica goes first
+ */
+static int
+dirtymap_persist(struct dirtymap *dmap, const void *addr, size_t len,
+	unsigned lane)
+{
+	PMEMobjpool *pop = dmap->pop;
+
+	pop->persist_local(addr, len);
+
+	PMEMobjpool *rep = pop->replica;
+	while (rep) {
+		void *raddr = (char *)rep + (uintptr_t)addr - (uintptr_t)pop;
+		if (rep->rpp == NULL) {
+			rep->memcpy_local(raddr, addr, len, 0);
+		} else {
+			if (rep->persist_remote(rep, raddr, len, lane, 0))
+				return -1;
+		}
+		rep = rep->replica;
+	}
+
+	return 0;
+}
+
+/*
+ * dirtymap_mark_range -- (internal) marks the regions covered by the given
+ *	range in all the replicas
+ */
+int
+dirtymap_mark_range(struct dirtymap *dmap, const void *addr, size_t len,
+	unsigned lane)
+{
+	uintptr_t off = (uintptr_t)addr - (uintptr_t)dmap->pop;
+	size_t first = off >> dmap->shift;
+	size_t last = (off + len - 1) >> dmap->shift;
+
+	ASSERT(last < dmap->nregions);
+
+	uint8_t *bits = dmap->persistent->bits;
+
+	/* the fast path, the regions are already marked everywhere */
+	size_t n;
+	for (n = first; n <= last; ++n) {
+		if (!dirtymap_is_published(dmap, n))
+			break;
+	}
+	if (n > last)
+		return 0;
+
+	util_mutex_lock(&dmap->lock);
+
+	for (n = first; n <= last; ++n)
+		bits[n / 8] |= (uint8_t)(1U << (n % 8));
+
+	int ret = dirtymap_persist(dmap, &bits[first / 8],
+		last / 8 - first / 8 + 1, lane);
+
+	/*
+	 * Only now the other writers can skip the marking, a crash before
+	 * the bitmap was stored everywhere would lose their regions.
+	 */
+	if (ret == 0) {
+		for (n = first; n <= last; ++n)
+			util_fetch_and_or32(&dmap->published[n / 32],
+				1U << (n % 32));
+	}
+
+	util_mutex_unlock(&dmap->lock);
+
+	return ret;
+}
+
+/*
+ * dirtymap_enable -- (internal) enables or disables the tracking, both start
+ *	from an empty bitmap
+ */
+static int
+dirtymap_enable(struct dirtymap *dmap, int enable)
+{
+	PMEMobjpool *pop = dmap->pop;
+	struct dirtymap_persistent *dp = dmap->persistent;
+
+	uint64_t shift = enable ? dirtymap_shift(pop->set->poolsize) : 0;
+	if (shift == dmap->shift)
+		return 0;
+
+	unsigned lane = UINT_MAX;
+	if (pop->has_remote_replicas)
+		lane = lane_hold(pop, NULL);
+
+	util_mutex_lock(&dmap->lock);
+
+	/* stop marking before the bitmap is gone */
+	if (!enable)
+		dirtymap_set_shift(dmap, 0);
+
+	dp->shift = shift;
+	memset(dp->bits, 0, sizeof(dp->bits));
+	memset(dmap->at_open, 0, sizeof(dmap->at_open));
+	dirtymap_publish_all(dmap);
+
+	int ret = dirtymap_persist(dmap, dp, sizeof(*dp), lane);
+
+	if (enable)
+		dirtymap_set_shift(dmap, shift);
+
+	util_mutex_unlock(&dmap->lock);
+
+	if (pop->has_remote_replicas)
+		lane_release(pop);
+
+	if (ret) {
+		ERR("cannot store the dirty map in a remote replica");
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * dirtymap_new -- creates the runtime state of the dirty map, the regions
+ *	marked by the previous sessions stay so until the replicas are synced
+ */
+struct dirtymap *
+dirtymap_new(PMEMobjpool *pop)
+{
+	struct dirtymap *dmap = Malloc(sizeof(*dmap));
+	if (dmap == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	dmap->pop = pop;
+	dmap->persistent = &pop->dirtymap_persistent;
+	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(dmap->persistent,
+		sizeof(*dmap->persistent));
+	util_mutex_init(&dmap->lock);
+
+	struct dirtymap_persistent *dp = dmap->persistent;
+	if (dp->shift != 0 && dp->shift != dirtymap_shift(pop->set->poolsize)) {
+		ERR("invalid granularity of the dirty map");
+		errno = EINVAL;
+		goto error_shift;
+	}
+
+	dirtymap_set_shift(dmap, dp->shift);
+	memcpy(dmap->at_open, dp->bits, sizeof(dmap->at_open));
+	dirtymap_publish_all(dmap);
+
+	return dmap;
+
+error_shift:
+	util_mutex_destroy(&dmap->lock);
+	Free(dmap);
+	return NULL;
+}
+
+/*
+ * dirtymap_delete -- deletes the runtime state of the dirty map, without
+ *	touching the bitmap
+ */
+void
+dirtymap_delete(struct dirtymap *dmap)
+{
+	if (dmap == NULL)
+		return;
+
+	util_mutex_destroy(&dmap->lock);
+	Free(dmap);
+}
+
+/*
+ * dirtymap_close -- unmarks the regions modified by this session and deletes
+ *	the dirty map
+ *
+ * Must be called only once no more writes are made to the pool, at which
+ * point all the replicas are known to be identical in these regions.
+ */
+void
+dirtymap_close(struct dirtymap *dmap)
+{
+	if (dmap == NULL)
+		return;
+
+	struct dirtymap_persistent *dp = dmap->persistent;
+
+	if (dmap->shift != 0 &&
+	    memcmp(dp->bits, dmap->at_open, sizeof(dp->bits)) != 0) {
+		memcpy(dp->bits, dmap->at_open, sizeof(dp->bits));
+
+		/* lanes are already gone, nobody else uses the pool */
+		if (dirtymap_persist(dmap, dp->bits, sizeof(dp->bits), 0))
+			ERR("cannot store the dirty map in a remote replica");
+	}
+
+	dirtymap_delete(dmap);
+}
+
+/*
+ * CTL_READ_HANDLER(enabled) -- returns whether the modified regions of the
+ *	pool are tracked
+ */
+static int
+CTL_READ_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->dirtymap->shift != 0;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled) -- enables or disables tracking of the modified
+ *	regions of the pool
+ */
+static int
+CTL_WRITE_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	return dirtymap_enable(pop->dirtymap, arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_READ_HANDLER(granularity) -- returns the size of the region covered
+ *	by a single bit of the dirty map
+ */
+static int
+CTL_READ_HANDLER(granularity)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	size_t *arg_out = arg;
+
+	*arg_out = pop->dirtymap->shift == 0 ? 0 :
+		(size_t)1 << pop->dirtymap->shift;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(regions) -- returns the number of regions marked
+ *	as modified
+ */
+static int
+CTL_READ_HANDLER(regions)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct dirtymap *dmap = pop->dirtymap;
+
+	uint64_t *arg_out = arg;
+
+	uint64_t count = 0;
+	for (size_t n = 0; n < dmap->nregions; ++n)
+		count += (uint64_t)dirtymap_persistent_test(dmap->persistent,
+			n);
+
+	*arg_out = count;
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(dirty)[] = {
+	CTL_LEAF_RW(enabled),
+	CTL_LEAF_RO(granularity),
+	CTL_LEAF_RO(regions),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(replica)[] = {
+	CTL_CHILD(dirty),
+
+	CTL_NODE_END
+};
+
+/*
+ * dirtymap_ctl_register -- registers ctl nodes for the dirty map
+ */
+void
+dirtymap_ctl_register(PMEMobjpool *pop)
+{
+	CTL_REGISTER_MODULE(pop->ctl, replica);
+}
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * dirtymap.h -- tracking of the pool regions modified since the last sync
+ *	of the replicas
+ */
+
+#ifndef LIBPMEMOBJ_DIRTYMAP_H
+#define LIBPMEMOBJ_DIRTYMAP_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "os_thread.h"
+#include "util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* size of the persistent bitmap, each bit covers one region of the pool */
+#define DIRTYMAP_BITMAP_SIZE 448
+#define DIRTYMAP_NBITS (DIRTYMAP_BITMAP_SIZE * 8)
+
+/* the smallest region covered by a single bit of the bitmap (2 megabytes) */
+#define DIRTYMAP_MIN_SHIFT 21
+
+/* number of words of the runtime copy of the bitmap */
+#define DIRTYMAP_NWORDS (DIRTYMAP_NBITS / 32)
+
+/*
+ * Write-intent bitmap stored in the pool descriptor of every replica.
+ *
+ * A bit is set, in all the replicas, before the modifications of the region
+ * it covers are first flushed or copied to the other replicas. Bits set by
+ * a session are cleared again once the pool is closed cleanly, which means
+ * that after a crash the replicas can differ only in the regions marked
+ * here. The shift is zero if the tracking is disabled.
+ */
+struct dirtymap_persistent {
+	uint64_t shift; /* log2 of the size of a region */
+	uint8_t bits[DIRTYMAP_BITMAP_SIZE];
+};
+
+/*
+ * dirtymap_persistent_is_dirty -- returns true if any of the regions
+ *	is marked as modified
+ */
+static inline int
+dirtymap_persistent_is_dirty(const struct dirtymap_persistent *dp)
+{
+	if (dp->shift == 0)
+		return 0;
+
+	return !util_is_zeroed(dp->bits, sizeof(dp->bits));
+}
+
+/*
+ * dirtymap_persistent_test -- returns true if the region number n is marked
+ */
+static inline int
+dirtymap_persistent_test(const struct dirtymap_persistent *dp, size_t n)
+{
+	return (dp->bits[n / 8] >> (n % 8)) & 1;
+}
+
+struct pmemobjpool;
+
+struct dirtymap {
+	struct pmemobjpool *pop;
+	struct dirtymap_persistent *persistent; /* of the master replica */
+
+	uint64_t shift; /* runtime copy of the shift, zero if disabled */
+	size_t nregions; /* number of regions which cover the pool */
+
+	os_mutex_t lock; /* serializes the updates of the bitmap */
+
+	/*
+	 * Regions already marked in all the replicas. The persistent bitmap
+	 * of the master replica can't be used to skip the marking, its bits
+	 * are set before they are stored in the other replicas.
+	 */
+	uint32_t published[DIRTYMAP_NWORDS];
+
+	/* bits which were already set when the pool was opened */
+	uint8_t at_open[DIRTYMAP_BITMAP_SIZE];
+};
+
+struct dirtymap *dirtymap_new(struct pmemobjpool *pop);
+void dirtymap_delete(struct dirtymap *dmap);
+
+int dirtymap_mark_range(struct dirtymap *dmap, const void *addr, size_t len,
+	unsigned lane);
+void dirtymap_close(struct dirtymap *dmap);
+
+void dirtymap_ctl_register(struct pmemobjpool *pop);
+
+/*
+ * dirtymap_mark -- marks the regions covered by the given range as modified,
+ *	returns nonzero if the bitmap could not be stored in a remote replica
+ *
+ * Called by the replicated write functions before the data is flushed in
+ * the master replica and copied to the other ones. Stores made directly to
+ * the master replica may reach the media earlier. Once a region is marked
+ * the only cost is this check.
+ */
+static inline int
+dirtymap_mark(struct dirtymap *dmap, const void *addr, size_t len,
+	unsigned lane)
+{
+	if (likely(dmap == NULL || dmap->shift == 0) || len == 0)
+		return 0;
+
+	return dirtymap_mark_range(dmap, addr, len, lane);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
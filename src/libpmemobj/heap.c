@@ -20,8 +20,10 @@
 #include "container_ravl.h"
 #include "container_seglists.h"
 #include "alloc_class.h"
+#include "critnib.h"
 #include "os_thread.h"
 #include "set.h"
+#include "type_index.h"
 
 #define MAX_RUN_LOCKS MAX_CHUNK
 #define MAX_RUN_LOCKS_VG 1024 /* avoid perf issues /w drd */
@@ -32,6 +34,87 @@
 #define HEAP_DEFAULT_GROW_SIZE (1 << 27) /* 128 megabytes */
 #define MAX_DEFAULT_ARENAS (1 << 10) /* 1024 arenas */
 
+/*
+ * The number of blocks freed in an active run that are remembered for the
+ * refill of its bucket. If more blocks are freed, the run has to be detached
+ * from the bucket and its bitmap scanned again to find them.
+ */
+#define RUN_DELTA_MAX_BLOCKS 32
+#define RUN_DELTA_OVERFLOW UINT32_MAX
+
+#define RUN_DELTA_KEY(m)\
+((uint64_t)(m)->zone_id << 32 | (uint64_t)(m)->chunk_id)
+
+/*
+ * Free huge chunks of up to HUGE_SHARD_MAX_UNITS chunks are cached in the
+ * shard of the arena of the thread that freed them, so that the following
+ * allocations of the same size don't have to go through the default bucket.
+ */
+#define HUGE_SHARD_MAX_UNITS 256 /* 64 megabytes */
+#define HUGE_SHARD_BIN_SIZE 4
+#define HUGE_SHARD_MAX_CACHED (2 * HUGE_SHARD_MAX_UNITS)
+#define MAX_HUGE_SHARDS 64
+
+/*
+ * Changes of a run made since its bitmap was last scanned, tracked for the
+ * runs that are either active in a bucket or stored in a recycler. All of the
+ * fields, except for the key, are protected by the run lock.
+ */
+struct run_delta {
+	uint64_t key;
+
+	int active; /* the run is the active memory block of a bucket */
+
+	/* units freed since the last scan, used for the recycler scores */
+	uint32_t freed_units;
+	uint32_t max_freed; /* the largest freed block */
+
+	/* blocks freed since the last scan, used only for active runs */
+	uint32_t nblocks;
+	struct {
+		uint32_t block_off;
+		uint32_t size_idx;
+	} blocks[RUN_DELTA_MAX_BLOCKS];
+};
+
+/*
+ * A cache of free huge chunks shared by a subset of the arenas. The chunks
+ * are segregated into bins by their size, so that a lookup is an exact match
+ * that needs neither the best-fit container nor the lock of the default
+ * bucket. The number of chunks in a bin is read without the lock to skip
+ * the empty bins.
+ */
+struct huge_shard {
+	os_mutex_t lock;
+	uint32_t nunits; /* total size of the cached chunks */
+
+	/* indexed by the size of the chunks, minus one */
+	struct {
+		uint32_t nchunks;
+		struct {
+			uint32_t zone_id;
+			uint32_t chunk_id;
+		} chunks[HUGE_SHARD_BIN_SIZE];
+	} bins[HUGE_SHARD_MAX_UNITS];
+};
+
+/*
+ * Zones bound to an arena. They have their own free chunks, recyclers and
+ * cache of huge chunks, so that the runs and huge blocks of the arena are
+ * carved out of these zones only, and no other arena allocates from them.
+ */
+struct zone_range {
+	unsigned first;
+	unsigned count;
+
+	/* the number of zones already populated, protected by the bucket */
+	unsigned populated;
+
+	struct bucket *bucket; /* free chunks of the zones */
+	struct recycler *recyclers[MAX_ALLOCATION_CLASSES];
+	struct huge_shard shard;
+};
+
 struct arenas {
 	VEC(, struct arena *) vec;
 	size_t nactive;
@@ -62,6 +145,12 @@ struct arena {
 	int automatic;
 	size_t nthreads;
 	struct arenas *arenas;
+
+	/* free huge chunks recently released by the threads of the arena */
+	struct huge_shard *huge_shard;
+
+	/* zones bound to the arena, NULL if it uses the shared zones */
+	struct zone_range *zones;
 };
 
 struct heap_rt {
@@ -77,6 +166,16 @@ struct heap_rt {
 	os_mutex_t run_locks[MAX_RUN_LOCKS];
 	unsigned nlocks;
 
+	/* changes of the tracked runs, indexed by RUN_DELTA_KEY */
+	struct critnib *run_deltas;
+
+	/* the zone ranges bound to arenas, indexed by the zone id */
+	struct critnib *zone_owners;
+
+	struct huge_shard *huge_shards;
+	unsigned nhuge_shards;
+	unsigned huge_shards_next; /* the shard of the next arena */
+
 	unsigned nzones;
 	unsigned zones_exhausted;
 };
@@ -115,6 +214,102 @@ heap_alloc_classes(struct palloc_heap *heap)
 	return heap->rt ? heap->rt->alloc_classes : NULL;
 }
 
+/*
+ * heap_zone_range_delete -- (internal) destroys the runtime state of zones
+ *	bound to an arena
+ */
+static void
+heap_zone_range_delete(struct zone_range *zones)
+{
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
+		if (zones->recyclers[i] != NULL)
+			recycler_delete(zones->recyclers[i]);
+	if (zones->bucket != NULL)
+		bucket_delete(zones->bucket);
+	util_mutex_destroy(&zones->shard.lock);
+	Free(zones);
+}
+
+/*
+ * heap_zone_range_new -- (internal) creates the runtime state of zones
+ *	that are going to be bound to an arena
+ */
+static struct zone_range *
+heap_zone_range_new(struct palloc_heap *heap, unsigned first, unsigned count)
+{
+	struct heap_rt *rt = heap->rt;
+
+	struct zone_range *zones = Zalloc(sizeof(*zones));
+	if (zones == NULL) {
+		ERR("!heap: zone range malloc error");
+		return NULL;
+	}
+	zones->first = first;
+	zones->count = count;
+	zones->populated = 0;
+	util_mutex_init(&zones->shard.lock);
+
+	zones->bucket = bucket_new(container_new_ravl(heap),
+		alloc_class_by_id(rt->alloc_classes, DEFAULT_ALLOC_CLASS_ID));
+	if (zones->bucket == NULL)
+		goto error;
+	zones->bucket->zones = zones;
+
+	for (uint8_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		struct alloc_class *c =
+			alloc_class_by_id(rt->alloc_classes, i);
+		if (c == NULL || c->type != CLASS_RUN)
+			continue;
+
+		zones->recyclers[i] = recycler_new(heap, c->rdsc.nallocs,
+			&rt->arenas.nactive);
+		if (zones->recyclers[i] == NULL)
+			goto error;
+	}
+
+	return zones;
+
+error:
+	heap_zone_range_delete(zones);
+	return NULL;
+}
+
+/*
+ * heap_zone_owner -- (internal) returns the zone range the zone is bound to,
+ *	or NULL if the zone is shared by the arenas without bound zones
+ */
+static struct zone_range *
+heap_zone_owner(struct palloc_heap *heap, uint32_t zone_id)
+{
+	return critnib_get(heap->rt->zone_owners, zone_id);
+}
+
+/*
+ * heap_zones_bucket_acquire -- (internal) locks and returns the bucket with
+ *	the free chunks of the zone range, the default bucket if NULL
+ */
+static struct bucket *
+heap_zones_bucket_acquire(struct palloc_heap *heap, struct zone_range *zones)
+{
+	if (zones == NULL)
+		return heap_bucket_acquire(heap, DEFAULT_ALLOC_CLASS_ID,
+			HEAP_ARENA_PER_THREAD);
+
+	stats_mutex_lock(heap->stats, STATS_LOCK_BUCKET, &zones->bucket->lock);
+
+	return zones->bucket;
+}
+
+/*
+ * heap_zones_recyclers -- (internal) returns the recyclers of the runs from
+ *	the zone range, the shared recyclers if NULL
+ */
+static struct recycler **
+heap_zones_recyclers(struct palloc_heap *heap, struct zone_range *zones)
+{
+	return zones == NULL ? heap->rt->recyclers : zones->recyclers;
+}
+
 /*
  * heap_arena_delete -- (internal) destroys arena instance
  */
@@ -124,6 +319,8 @@ heap_arena_delete(struct arena *arena)
 	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
 		if (arena->buckets[i] != NULL)
 			bucket_delete(arena->buckets[i]);
+	if (arena->zones != NULL)
+		heap_zone_range_delete(arena->zones);
 	Free(arena);
 }
 
@@ -144,6 +341,9 @@ heap_arena_new(struct palloc_heap *heap, int automatic)
 	arena->automatic = automatic;
 	arena->arenas = &heap->rt->arenas;
 
+	unsigned shard = util_fetch_and_add32(&rt->huge_shards_next, 1);
+	arena->huge_shard = &rt->huge_shards[shard % rt->nhuge_shards];
+
 	COMPILE_ERROR_ON(MAX_ALLOCATION_CLASSES > UINT8_MAX);
 	for (uint8_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
 		struct alloc_class *ac =
@@ -346,7 +546,7 @@ heap_bucket_acquire(struct palloc_heap *heap, uint8_t class_id,
 	}
 
 out:
-	util_mutex_lock(&b->lock);
+	stats_mutex_lock(heap->stats, STATS_LOCK_BUCKET, &b->lock);
 
 	return b;
 }
@@ -357,7 +557,7 @@ out:
 void
 heap_bucket_release(struct palloc_heap *heap, struct bucket *b)
 {
-	util_mutex_unlock(&b->lock);
+	stats_mutex_unlock(heap->stats, STATS_LOCK_BUCKET, &b->lock);
 }
 
 /*
@@ -369,6 +569,112 @@ heap_get_run_lock(struct palloc_heap *heap, uint32_t chunk_id)
 	return &heap->rt->run_locks[chunk_id % heap->rt->nlocks];
 }
 
+/*
+ * heap_run_delta_attach -- (internal) starts tracking the changes of a run
+ *	that was just scanned, or resets the existing tracking
+ *
+ * Must be called with the run lock held. If there's not enough memory, the
+ * run is simply not tracked, which only makes the recycling more expensive.
+ */
+static void
+heap_run_delta_attach(struct palloc_heap *heap, const struct memory_block *m,
+	int active)
+{
+	uint64_t key = RUN_DELTA_KEY(m);
+	struct run_delta *d = critnib_get(heap->rt->run_deltas, key);
+	if (d == NULL) {
+		d = Malloc(sizeof(*d));
+		if (d == NULL)
+			return;
+
+		d->key = key;
+		if (critnib_insert(heap->rt->run_deltas, key, d) != 0) {
+			Free(d);
+			return;
+		}
+	}
+
+	d->active = active;
+	d->freed_units = 0;
+	d->max_freed = 0;
+	d->nblocks = 0;
+}
+
+/*
+ * heap_run_delta_detach -- (internal) stops tracking the changes of a run
+ *
+ * Must be called with the run lock held.
+ */
+static void
+heap_run_delta_detach(struct palloc_heap *heap, const struct memory_block *m)
+{
+	Free(critnib_remove(heap->rt->run_deltas, RUN_DELTA_KEY(m)));
+}
+
+/*
+ * heap_run_delta_reset -- forgets the changes of a run, called after its
+ *	bitmap was scanned
+ *
+ * Must be called with the run lock held.
+ */
+void
+heap_run_delta_reset(struct palloc_heap *heap, const struct memory_block *m)
+{
+	struct run_delta *d = critnib_get(heap->rt->run_deltas,
+		RUN_DELTA_KEY(m));
+	if (d == NULL)
+		return;
+
+	d->freed_units = 0;
+	d->max_freed = 0;
+	d->nblocks = 0;
+}
+
+/*
+ * heap_run_delta_take -- retrieves and forgets the number of units freed in
+ *	a run since its bitmap was last scanned and the largest freed block
+ *
+ * Returns -1 if the run is not tracked.
+ */
+int
+heap_run_delta_take(struct palloc_heap *heap, const struct memory_block *m,
+	uint32_t *freed_units, uint32_t *max_freed)
+{
+	int ret = -1;
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+
+	stats_mutex_lock(heap->stats, STATS_LOCK_RUN, lock);
+
+	struct run_delta *d = critnib_get(heap->rt->run_deltas,
+		RUN_DELTA_KEY(m));
+	if (d != NULL) {
+		*freed_units = d->freed_units;
+		*max_freed = d->max_freed;
+		d->freed_units = 0;
+		d->max_freed = 0;
+		ret = 0;
+	}
+
+	stats_mutex_unlock(heap->stats, STATS_LOCK_RUN, lock);
+
+	return ret;
+}
+
+/*
+ * heap_run_deltas_delete -- (internal) stops tracking all of the runs
+ */
+static void
+heap_run_deltas_delete(struct critnib *deltas)
+{
+	struct run_delta *d;
+	while ((d = critnib_find_le(deltas, UINT64_MAX)) != NULL) {
+		critnib_remove(deltas, d->key);
+		Free(d);
+	}
+
+	critnib_delete(deltas);
+}
+
 /*
  * heap_max_zone -- (internal) calculates how many zones can the heap fit
  */
@@ -458,6 +764,11 @@ heap_run_create(struct palloc_heap *heap, struct bucket *b,
 		return -1;
 	}
 
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+	stats_mutex_lock(heap->stats, STATS_LOCK_RUN, lock);
+	heap_run_delta_attach(heap, m, 1);
+	stats_mutex_unlock(heap->stats, STATS_LOCK_RUN, lock);
+
 	STATS_INC(heap->stats, transient, heap_run_active,
 		m->size_idx * CHUNKSIZE);
 
@@ -476,11 +787,20 @@ heap_run_reuse(struct palloc_heap *heap, struct bucket *b,
 	ASSERTeq(m->type, MEMORY_BLOCK_RUN);
 	os_mutex_t *lock = m->m_ops->get_lock(m);
 
-	util_mutex_lock(lock);
+	stats_mutex_lock(heap->stats, STATS_LOCK_RUN, lock);
 
 	ret = m->m_ops->iterate_free(m, heap_memblock_insert_block, b);
 
-	util_mutex_unlock(lock);
+	/*
+	 * From now on the bucket can be refilled with the blocks freed in
+	 * the run without scanning it again.
+	 */
+	if (ret == 0)
+		heap_run_delta_attach(heap, m, 1);
+	else
+		heap_run_delta_detach(heap, m);
+
+	stats_mutex_unlock(heap->stats, STATS_LOCK_RUN, lock);
 
 	if (ret == 0) {
 		b->active_memory_block->m = *m;
@@ -542,13 +862,15 @@ heap_run_into_free_chunk(struct palloc_heap *heap,
 	 * to establish happens-before relation for the chunk metadata.
 	 */
 	os_mutex_t *lock = m->m_ops->get_lock(m);
-	util_mutex_lock(lock);
+	stats_mutex_lock(heap->stats, STATS_LOCK_RUN, lock);
+
+	heap_run_delta_detach(heap, m);
 
 	*m = memblock_huge_init(heap, m->chunk_id, m->zone_id, m->size_idx);
 
 	heap_free_chunk_reuse(heap, bucket, m);
 
-	util_mutex_unlock(lock);
+	stats_mutex_unlock(heap->stats, STATS_LOCK_RUN, lock);
 }
 
 /*
@@ -566,6 +888,17 @@ heap_reclaim_run(struct palloc_heap *heap, struct memory_block *m, int startup)
 		heap->rt->alloc_classes,
 		run->hdr.block_size, hdr->flags, m->size_idx);
 
+	/*
+	 * The tracking starts before the run is scanned, so that none of the
+	 * concurrent frees is missed by the recycler.
+	 */
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+	if (c != NULL) {
+		stats_mutex_lock(heap->stats, STATS_LOCK_RUN, lock);
+		heap_run_delta_attach(heap, m, 0);
+		stats_mutex_unlock(heap->stats, STATS_LOCK_RUN, lock);
+	}
+
 	struct recycler_element e = recycler_element_new(heap, m);
 	if (c == NULL) {
 		uint32_t size_idx = m->size_idx;
@@ -587,9 +920,16 @@ heap_reclaim_run(struct palloc_heap *heap, struct memory_block *m, int startup)
 			(c->rdsc.nallocs - e.free_space) * run->hdr.block_size);
 	}
 
-	if (recycler_put(heap->rt->recyclers[c->id], m, e) < 0)
+	struct recycler **recyclers =
+		heap_zones_recyclers(heap, heap_zone_owner(heap, m->zone_id));
+	if (recycler_put(recyclers[c->id], m, e) < 0) {
 		ERR("lost runtime tracking info of %u run due to OOM", c->id);
 
+		stats_mutex_lock(heap->stats, STATS_LOCK_RUN, lock);
+		heap_run_delta_detach(heap, m);
+		stats_mutex_unlock(heap->stats, STATS_LOCK_RUN, lock);
+	}
+
 	return 0;
 }
 
@@ -640,12 +980,30 @@ static int
 heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
 {
 	struct heap_rt *h = heap->rt;
+	struct zone_range *zones = bucket->zones;
+	uint32_t zone_id;
 
-	/* at this point we are sure that there's no more memory in the heap */
-	if (h->zones_exhausted == h->nzones)
-		return ENOMEM;
+	if (zones != NULL) {
+		if (zones->populated == zones->count)
+			return ENOMEM;
+
+		zone_id = zones->first + zones->populated++;
+	} else {
+		/* bound zones are populated by the buckets of their arenas */
+		while (h->zones_exhausted != h->nzones &&
+		    heap_zone_owner(heap, h->zones_exhausted) != NULL)
+			h->zones_exhausted++;
+
+		/*
+		 * At this point we are sure that there's no more memory in
+		 * the heap.
+		 */
+		if (h->zones_exhausted == h->nzones)
+			return ENOMEM;
+
+		zone_id = h->zones_exhausted++;
+	}
 
-	uint32_t zone_id = h->zones_exhausted++;
 	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
 
 	/* ignore zone and chunk headers */
@@ -674,14 +1032,14 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
  */
 static int
 heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
-	struct bucket *defb, int force)
+	struct zone_range *zones, struct bucket *defb, int force)
 {
 	struct empty_runs r = recycler_recalc(recycler, force);
 	if (VEC_SIZE(&r) == 0)
 		return ENOMEM;
 
-	struct bucket *nb = defb == NULL ? heap_bucket_acquire(heap,
-		DEFAULT_ALLOC_CLASS_ID, HEAP_ARENA_PER_THREAD) : NULL;
+	struct bucket *nb = defb == NULL ?
+		heap_zones_bucket_acquire(heap, zones) : NULL;
 
 	ASSERT(defb != NULL || nb != NULL);
 
@@ -700,23 +1058,143 @@ heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
 
 /*
  * heap_reclaim_garbage -- (internal) creates volatile state of unused runs
+ *	from the zone range, the bucket must hold the free chunks of the range
+ *	if not NULL
  */
 static int
-heap_reclaim_garbage(struct palloc_heap *heap, struct bucket *bucket)
+heap_reclaim_garbage(struct palloc_heap *heap, struct zone_range *zones,
+	struct bucket *bucket)
 {
+	ASSERT(bucket == NULL || bucket->zones == zones);
+
+	struct recycler **recyclers = heap_zones_recyclers(heap, zones);
+
 	int ret = ENOMEM;
 	struct recycler *r;
 	for (size_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
-		if ((r = heap->rt->recyclers[i]) == NULL)
+		if ((r = recyclers[i]) == NULL)
 			continue;
 
-		if (heap_recycle_unused(heap, r, bucket, 1) == 0)
+		if (heap_recycle_unused(heap, r, zones, bucket, 1) == 0)
 			ret = 0;
 	}
 
 	return ret;
 }
 
+/*
+ * heap_huge_shard_get -- (internal) removes a free chunk of exactly the
+ *	requested size from the shard
+ */
+static int
+heap_huge_shard_get(struct palloc_heap *heap, struct huge_shard *s,
+	struct memory_block *m)
+{
+	if (m->size_idx > HUGE_SHARD_MAX_UNITS)
+		return ENOMEM;
+
+	uint32_t *nchunks = &s->bins[m->size_idx - 1].nchunks;
+
+	uint32_t n;
+	util_atomic_load_explicit32(nchunks, &n, memory_order_acquire);
+	if (n == 0)
+		return ENOMEM;
+
+	util_mutex_lock(&s->lock);
+
+	n = *nchunks;
+	if (n == 0) {
+		util_mutex_unlock(&s->lock);
+		return ENOMEM;
+	}
+
+	m->zone_id = s->bins[m->size_idx - 1].chunks[n - 1].zone_id;
+	m->chunk_id = s->bins[m->size_idx - 1].chunks[n - 1].chunk_id;
+	s->nunits -= m->size_idx;
+	util_atomic_store_explicit32(nchunks, n - 1, memory_order_release);
+
+	util_mutex_unlock(&s->lock);
+
+	m->block_off = 0;
+	memblock_rebuild_state(heap, m);
+
+	return 0;
+}
+
+/*
+ * heap_huge_shard_put -- (internal) caches a free chunk in the shard,
+ *	fails if the bin of the chunk or the entire shard is full
+ */
+static int
+heap_huge_shard_put(struct huge_shard *s, const struct memory_block *m)
+{
+	if (m->size_idx > HUGE_SHARD_MAX_UNITS)
+		return ENOSPC;
+
+	uint32_t *nchunks = &s->bins[m->size_idx - 1].nchunks;
+
+	util_mutex_lock(&s->lock);
+
+	uint32_t n = *nchunks;
+	if (n == HUGE_SHARD_BIN_SIZE ||
+	    s->nunits + m->size_idx > HUGE_SHARD_MAX_CACHED) {
+		util_mutex_unlock(&s->lock);
+		return ENOSPC;
+	}
+
+	s->bins[m->size_idx - 1].chunks[n].zone_id = m->zone_id;
+	s->bins[m->size_idx - 1].chunks[n].chunk_id = m->chunk_id;
+	s->nunits += m->size_idx;
+	util_atomic_store_explicit32(nchunks, n + 1, memory_order_release);
+
+	util_mutex_unlock(&s->lock);
+
+	return 0;
+}
+
+/*
+ * heap_huge_shards_flush -- (internal) moves the chunks cached in all of the
+ *	shards into the default bucket, coalescing them with their neighbours
+ *
+ * Returns 0 if any chunk was moved.
+ */
+static int
+heap_huge_shards_flush(struct palloc_heap *heap, struct bucket *bucket)
+{
+	struct heap_rt *rt = heap->rt;
+	int ret = ENOMEM;
+
+	/* the chunks of bound zones are cached only by their own shard */
+	struct huge_shard *shards = bucket->zones != NULL ?
+		&bucket->zones->shard : rt->huge_shards;
+	unsigned nshards = bucket->zones != NULL ? 1 : rt->nhuge_shards;
+
+	for (unsigned i = 0; i < nshards; ++i) {
+		struct huge_shard *s = &shards[i];
+
+		util_mutex_lock(&s->lock);
+		for (uint32_t u = 0; u < HUGE_SHARD_MAX_UNITS; ++u) {
+			uint32_t n = s->bins[u].nchunks;
+			for (uint32_t c = 0; c < n; ++c) {
+				struct memory_block m = MEMORY_BLOCK_NONE;
+				m.zone_id = s->bins[u].chunks[c].zone_id;
+				m.chunk_id = s->bins[u].chunks[c].chunk_id;
+				m.size_idx = u + 1;
+				memblock_rebuild_state(heap, &m);
+
+				heap_free_chunk_reuse(heap, bucket, &m);
+				ret = 0;
+			}
+			util_atomic_store_explicit32(&s->bins[u].nchunks, 0,
+				memory_order_release);
+		}
+		s->nunits = 0;
+		util_mutex_unlock(&s->lock);
+	}
+
+	return ret;
+}
+
 /*
  * heap_ensure_huge_bucket_filled --
  *	(internal) refills the default bucket if needed
@@ -724,12 +1202,19 @@ heap_reclaim_garbage(struct palloc_heap *heap, struct bucket *bucket)
 static int
 heap_ensure_huge_bucket_filled(struct palloc_heap *heap, struct bucket *bucket)
 {
-	if (heap_reclaim_garbage(heap, bucket) == 0)
+	if (heap_huge_shards_flush(heap, bucket) == 0)
+		return 0;
+
+	if (heap_reclaim_garbage(heap, bucket->zones, bucket) == 0)
 		return 0;
 
 	if (heap_populate_bucket(heap, bucket) == 0)
 		return 0;
 
+	/* only the shared zones grow, the last zone of the heap isn't bound */
+	if (bucket->zones != NULL)
+		return ENOMEM;
+
 	int extend;
 	if ((extend = heap_extend(heap, bucket, heap->growsize)) < 0)
 		return ENOMEM;
@@ -759,6 +1244,13 @@ heap_bucket_deref_active(struct palloc_heap *heap, struct bucket *b)
 
 	if (b->is_active) {
 		b->c_ops->rm_all(b->container);
+
+		struct memory_block *m = &(*active)->m;
+		os_mutex_t *lock = m->m_ops->get_lock(m);
+		stats_mutex_lock(heap->stats, STATS_LOCK_RUN, lock);
+		heap_run_delta_detach(heap, m);
+		stats_mutex_unlock(heap->stats, STATS_LOCK_RUN, lock);
+
 		if (util_fetch_and_sub64(&(*active)->nresv, 1) == 1) {
 			VALGRIND_ANNOTATE_HAPPENS_AFTER(&(*active)->nresv);
 			heap_discard_run(heap, &(*active)->m);
@@ -792,17 +1284,21 @@ heap_force_recycle(struct palloc_heap *heap)
 			struct bucket *b = arenap->buckets[i];
 			if (b == NULL)
 				continue;
-			util_mutex_lock(&b->lock);
+			stats_mutex_lock(heap->stats, STATS_LOCK_BUCKET,
+				&b->lock);
 			/*
 			 * There's no need to check if this fails, as that
 			 * will not prevent progress in this function.
 			 */
 			heap_bucket_deref_active(heap, b);
-			util_mutex_unlock(&b->lock);
+			stats_mutex_unlock(heap->stats, STATS_LOCK_BUCKET,
+				&b->lock);
 		}
+		if (arenap->zones != NULL)
+			heap_reclaim_garbage(heap, arenap->zones, NULL);
 	}
 	util_mutex_unlock(&heap->rt->arenas.lock);
-	heap_reclaim_garbage(heap, NULL);
+	heap_reclaim_garbage(heap, NULL, NULL);
 }
 
 /*
@@ -810,17 +1306,17 @@ heap_force_recycle(struct palloc_heap *heap)
  *	in the recycler
  */
 static int
-heap_reuse_from_recycler(struct palloc_heap *heap,
-	struct bucket *b, uint32_t units, int force)
+heap_reuse_from_recycler(struct palloc_heap *heap, struct bucket *b,
+	struct zone_range *zones, uint32_t units, int force)
 {
 	struct memory_block m = MEMORY_BLOCK_NONE;
 	m.size_idx = units;
 
-	struct recycler *r = heap->rt->recyclers[b->aclass->id];
+	struct recycler *r = heap_zones_recyclers(heap, zones)[b->aclass->id];
 	if (!force && recycler_get(r, &m) == 0)
 		return heap_run_reuse(heap, b, &m);
 
-	heap_recycle_unused(heap, r, NULL, force);
+	heap_recycle_unused(heap, r, zones, NULL, force);
 
 	if (recycler_get(r, &m) == 0)
 		return heap_run_reuse(heap, b, &m);
@@ -835,9 +1331,8 @@ void
 heap_discard_run(struct palloc_heap *heap, struct memory_block *m)
 {
 	if (heap_reclaim_run(heap, m, 0)) {
-		struct bucket *defb =
-			heap_bucket_acquire(heap,
-			DEFAULT_ALLOC_CLASS_ID, 0);
+		struct bucket *defb = heap_zones_bucket_acquire(heap,
+			heap_zone_owner(heap, m->zone_id));
 
 		heap_run_into_free_chunk(heap, defb, m);
 
@@ -846,37 +1341,78 @@ heap_discard_run(struct palloc_heap *heap, struct memory_block *m)
 }
 
 /*
- * heap_ensure_run_bucket_filled -- (internal) refills the bucket if needed
+ * heap_run_refill_from_delta -- (internal) refills the bucket with the blocks
+ *	freed in its active run since the run was scanned
+ *
+ * Returns 0 if any of the blocks is big enough for the request. Otherwise the
+ * run has to be detached and scanned again, which also happens if too many
+ * blocks were freed to remember all of them.
  */
 static int
-heap_ensure_run_bucket_filled(struct palloc_heap *heap, struct bucket *b,
+heap_run_refill_from_delta(struct palloc_heap *heap, struct bucket *b,
 	uint32_t units)
 {
-	ASSERTeq(b->aclass->type, CLASS_RUN);
-	int ret = 0;
-
-	if (heap_bucket_deref_active(heap, b) != 0)
+	if (!b->is_active)
 		return ENOMEM;
 
-	if (heap_reuse_from_recycler(heap, b, units, 0) == 0)
-		goto out;
+	struct memory_block *m = &b->active_memory_block->m;
+	struct run_delta *d;
+	struct memory_block blocks[RUN_DELTA_MAX_BLOCKS];
+	uint32_t nblocks = 0;
+
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+	stats_mutex_lock(heap->stats, STATS_LOCK_RUN, lock);
+
+	d = critnib_get(heap->rt->run_deltas, RUN_DELTA_KEY(m));
+	if (d != NULL && d->nblocks != RUN_DELTA_OVERFLOW) {
+		for (; nblocks < d->nblocks; ++nblocks) {
+			blocks[nblocks] = *m;
+			blocks[nblocks].block_off =
+				d->blocks[nblocks].block_off;
+			blocks[nblocks].size_idx =
+				d->blocks[nblocks].size_idx;
+		}
+		d->nblocks = 0;
+	}
+
+	stats_mutex_unlock(heap->stats, STATS_LOCK_RUN, lock);
+
+	int ret = ENOMEM;
+	for (uint32_t i = 0; i < nblocks; ++i) {
+		/* the blocks not inserted will be found by the next scan */
+		if (bucket_insert_block(b, &blocks[i]) != 0)
+			return ENOMEM;
+
+		if (blocks[i].size_idx >= units)
+			ret = 0;
+	}
+
+	return ret;
+}
+
+/*
+ * heap_run_from_zones -- (internal) makes a run from the zone range, or from
+ *	the shared zones if NULL, active in the bucket
+ */
+static int
+heap_run_from_zones(struct palloc_heap *heap, struct bucket *b,
+	struct zone_range *zones, uint32_t units)
+{
+	if (heap_reuse_from_recycler(heap, b, zones, units, 0) == 0)
+		return 0;
 
 	/* search in the next zone before attempting to create a new run */
-	struct bucket *defb = heap_bucket_acquire(heap,
-		DEFAULT_ALLOC_CLASS_ID,
-		HEAP_ARENA_PER_THREAD);
+	struct bucket *defb = heap_zones_bucket_acquire(heap, zones);
 	heap_populate_bucket(heap, defb);
 	heap_bucket_release(heap, defb);
 
-	if (heap_reuse_from_recycler(heap, b, units, 0) == 0)
-		goto out;
+	if (heap_reuse_from_recycler(heap, b, zones, units, 0) == 0)
+		return 0;
 
 	struct memory_block m = MEMORY_BLOCK_NONE;
 	m.size_idx = b->aclass->rdsc.size_idx;
 
-	defb = heap_bucket_acquire(heap,
-		DEFAULT_ALLOC_CLASS_ID,
-		HEAP_ARENA_PER_THREAD);
+	defb = heap_zones_bucket_acquire(heap, zones);
 	/* cannot reuse an existing run, create a new one */
 	if (heap_get_bestfit_block(heap, defb, &m) == 0) {
 		ASSERTeq(m.block_off, 0);
@@ -892,17 +1428,39 @@ heap_ensure_run_bucket_filled(struct palloc_heap *heap, struct bucket *b,
 
 		heap_bucket_release(heap, defb);
 
-		goto out;
+		return 0;
 	}
 	heap_bucket_release(heap, defb);
 
-	if (heap_reuse_from_recycler(heap, b, units, 0) == 0)
-		goto out;
+	if (heap_reuse_from_recycler(heap, b, zones, units, 0) == 0)
+		return 0;
 
-	ret = ENOMEM;
-out:
+	return ENOMEM;
+}
 
-	return ret;
+/*
+ * heap_ensure_run_bucket_filled -- (internal) refills the bucket if needed
+ */
+static int
+heap_ensure_run_bucket_filled(struct palloc_heap *heap, struct bucket *b,
+	uint32_t units)
+{
+	ASSERTeq(b->aclass->type, CLASS_RUN);
+
+	if (heap_run_refill_from_delta(heap, b, units) == 0)
+		return 0;
+
+	if (heap_bucket_deref_active(heap, b) != 0)
+		return ENOMEM;
+
+	if (heap_run_from_zones(heap, b, b->zones, units) == 0)
+		return 0;
+
+	/* the bound zones are full, fall back to the shared ones */
+	if (b->zones != NULL && heap_run_from_zones(heap, b, NULL, units) == 0)
+		return 0;
+
+	return ENOMEM;
 }
 
 /*
@@ -927,7 +1485,35 @@ heap_memblock_on_free(struct palloc_heap *heap, const struct memory_block *m)
 	if (c == NULL)
 		return;
 
-	recycler_inc_unaccounted(heap->rt->recyclers[c->id], m);
+	/* the run lock is held by the caller */
+	struct run_delta *d = critnib_get(heap->rt->run_deltas,
+		RUN_DELTA_KEY(m));
+	if (d != NULL && d->active) {
+		/*
+		 * The scores of the active runs are calculated when they are
+		 * put into the recycler, so the freed block only needs to be
+		 * remembered for the refill of the bucket.
+		 */
+		if (d->nblocks < RUN_DELTA_MAX_BLOCKS) {
+			d->blocks[d->nblocks].block_off = m->block_off;
+			d->blocks[d->nblocks].size_idx = m->size_idx;
+			d->nblocks++;
+		} else {
+			d->nblocks = RUN_DELTA_OVERFLOW;
+		}
+
+		return;
+	}
+
+	if (d != NULL) {
+		d->freed_units += m->size_idx;
+		if (m->size_idx > d->max_freed)
+			d->max_freed = m->size_idx;
+	}
+
+	struct recycler **recyclers =
+		heap_zones_recyclers(heap, heap_zone_owner(heap, m->zone_id));
+	recycler_inc_unaccounted(recyclers[c->id], m);
 }
 
 /*
@@ -997,6 +1583,76 @@ heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	return 0;
 }
 
+/*
+ * heap_get_huge_block -- extracts a free huge memory block of the requested
+ *	size, from the shard of the arena if possible and otherwise from the
+ *	default bucket
+ */
+int
+heap_get_huge_block(struct palloc_heap *heap, uint16_t arena_id,
+	struct memory_block *m)
+{
+	struct arena *arena = arena_id == HEAP_ARENA_PER_THREAD ?
+		heap_thread_arena(heap) :
+		VEC_ARR(&heap->rt->arenas.vec)[arena_id - 1];
+	struct zone_range *zones = arena->zones;
+
+	struct huge_shard *s = zones ? &zones->shard : arena->huge_shard;
+	if (heap_huge_shard_get(heap, s, m) == 0) {
+		struct alloc_class *c = heap->rt->default_bucket->aclass;
+
+		m->m_ops->ensure_header_type(m, c->header_type);
+		m->header_type = c->header_type;
+
+		return 0;
+	}
+
+	uint32_t units = m->size_idx;
+
+	struct bucket *b = heap_zones_bucket_acquire(heap, zones);
+	int ret = heap_get_bestfit_block(heap, b, m);
+	heap_bucket_release(heap, b);
+
+	/* the bound zones are full, fall back to the shared ones */
+	if (ret != 0 && zones != NULL) {
+		m->size_idx = units;
+		b = heap_zones_bucket_acquire(heap, NULL);
+		ret = heap_get_bestfit_block(heap, b, m);
+		heap_bucket_release(heap, b);
+	}
+
+	return ret;
+}
+
+/*
+ * heap_free_huge_block -- returns a free huge memory block to the shard of
+ *	the thread's arena or, if it doesn't fit there, to the bucket with the
+ *	free chunks of its zone
+ */
+int
+heap_free_huge_block(struct palloc_heap *heap, struct memory_block *m)
+{
+	struct zone_range *owner = heap_zone_owner(heap, m->zone_id);
+
+	/*
+	 * The caller might hold run locks, which are ordered after the arenas
+	 * lock, so an arena cannot be assigned to the thread here.
+	 */
+	struct arena *arena = os_tls_get(heap->rt->arenas.thread);
+	if (arena != NULL && arena->zones == owner) {
+		struct huge_shard *s = owner ? &owner->shard :
+			arena->huge_shard;
+		if (heap_huge_shard_put(s, m) == 0)
+			return 0;
+	}
+
+	struct bucket *b = heap_zones_bucket_acquire(heap, owner);
+	int ret = heap_free_chunk_reuse(heap, b, m);
+	heap_bucket_release(heap, b);
+
+	return ret;
+}
+
 /*
  * heap_get_adjacent_free_block -- locates adjacent free memory block in heap
  */
@@ -1267,6 +1923,110 @@ out:
 
 }
 
+/*
+ * heap_get_arena_zones -- returns the zones bound to the arena, count is 0
+ *	if the arena uses the shared zones
+ */
+void
+heap_get_arena_zones(struct palloc_heap *heap, unsigned arena_id,
+	unsigned *first, unsigned *count)
+{
+	util_mutex_lock(&heap->rt->arenas.lock);
+	struct arena *a = heap_get_arena_by_id(heap, arena_id);
+	*first = a->zones ? a->zones->first : 0;
+	*count = a->zones ? a->zones->count : 0;
+	util_mutex_unlock(&heap->rt->arenas.lock);
+}
+
+/*
+ * heap_set_arena_zones -- binds the arena to a range of zones that aren't yet
+ *	in use, the arena will allocate only from these zones for as long as
+ *	they have free memory, and no other arena will allocate from them
+ *
+ * The last zone of the heap cannot be bound, because it's the one that
+ * grows when the pool is extended.
+ */
+int
+heap_set_arena_zones(struct palloc_heap *heap, unsigned arena_id,
+	unsigned first, unsigned count)
+{
+	struct heap_rt *h = heap->rt;
+
+	if (count == 0) {
+		ERR("empty range of zones");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct zone_range *zones = heap_zone_range_new(heap, first, count);
+	if (zones == NULL)
+		return -1;
+
+	util_mutex_lock(&h->arenas.lock);
+
+	struct arena *a = heap_get_arena_by_id(heap, arena_id);
+	if (a->zones != NULL) {
+		ERR("arena %u is already bound to zones", arena_id);
+		errno = EBUSY;
+		goto error_unlock;
+	}
+
+	/* the zones are populated under the lock of the default bucket */
+	struct bucket *defb = heap_bucket_acquire(heap,
+		DEFAULT_ALLOC_CLASS_ID, HEAP_ARENA_PER_THREAD);
+
+	if (first < h->zones_exhausted || first >= h->nzones - 1 ||
+	    count > h->nzones - 1 - first) {
+		ERR("zones <%u,%u> are in use or outside of <%u,%u>",
+			first, first + count - 1, h->zones_exhausted,
+			h->nzones - 2);
+		errno = EINVAL;
+		goto error_release;
+	}
+
+	unsigned z;
+	for (z = first; z < first + count; ++z) {
+		if (heap_zone_owner(heap, z) != NULL) {
+			ERR("zone %u is already bound to an arena", z);
+			errno = EBUSY;
+			goto error_remove;
+		}
+		int ret = critnib_insert(h->zone_owners, z, zones);
+		if (ret != 0) {
+			errno = ret;
+			ERR("!cannot bind zone %u", z);
+			goto error_remove;
+		}
+	}
+
+	heap_bucket_release(heap, defb);
+
+	a->zones = zones;
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		struct bucket *b = a->buckets[i];
+		if (b == NULL)
+			continue;
+
+		stats_mutex_lock(heap->stats, STATS_LOCK_BUCKET, &b->lock);
+		b->zones = zones;
+		stats_mutex_unlock(heap->stats, STATS_LOCK_BUCKET, &b->lock);
+	}
+
+	util_mutex_unlock(&h->arenas.lock);
+
+	return 0;
+
+error_remove:
+	while (z-- != first)
+		critnib_remove(h->zone_owners, z);
+error_release:
+	heap_bucket_release(heap, defb);
+error_unlock:
+	util_mutex_unlock(&h->arenas.lock);
+	heap_zone_range_delete(zones);
+	return -1;
+}
+
 /*
  * heap_set_arena_thread -- assign arena with given id to the current thread
  */
@@ -1315,11 +2075,22 @@ heap_create_alloc_class_buckets(struct palloc_heap *heap, struct alloc_class *c)
 	struct arena *arena;
 	VEC_FOREACH_BY_POS(i, &h->arenas.vec) {
 		arena = VEC_ARR(&h->arenas.vec)[i];
+
+		struct zone_range *zones = arena->zones;
+		if (zones != NULL && c->type == CLASS_RUN &&
+		    zones->recyclers[c->id] == NULL) {
+			zones->recyclers[c->id] = recycler_new(heap,
+				c->rdsc.nallocs, &heap->rt->arenas.nactive);
+			if (zones->recyclers[c->id] == NULL)
+				goto error_cache_bucket_new;
+		}
+
 		if (arena->buckets[c->id] == NULL)
 			arena->buckets[c->id] = bucket_new(
 				container_new_seglists(heap), c);
 		if (arena->buckets[c->id] == NULL)
 			goto error_cache_bucket_new;
+		arena->buckets[c->id]->zones = zones;
 	}
 
 	return 0;
@@ -1476,6 +2247,12 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 		goto error_alloc_classes_new;
 	}
 
+	heap->type_index = type_index_new();
+	if (heap->type_index == NULL) {
+		err = ENOMEM;
+		goto error_type_index_new;
+	}
+
 	unsigned narenas_default = heap_get_procs();
 
 	if (heap_arenas_init(&h->arenas) != 0) {
@@ -1487,6 +2264,28 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 
 	h->zones_exhausted = 0;
 
+	h->run_deltas = critnib_new();
+	if (h->run_deltas == NULL) {
+		err = ENOMEM;
+		goto error_run_deltas_new;
+	}
+
+	h->zone_owners = critnib_new();
+	if (h->zone_owners == NULL) {
+		err = ENOMEM;
+		goto error_zone_owners_new;
+	}
+
+	h->nhuge_shards = MIN(narenas_default, MAX_HUGE_SHARDS);
+	h->huge_shards = Zalloc(sizeof(struct huge_shard) * h->nhuge_shards);
+	if (h->huge_shards == NULL) {
+		err = ENOMEM;
+		goto error_huge_shards_new;
+	}
+	for (unsigned i = 0; i < h->nhuge_shards; ++i)
+		util_mutex_init(&h->huge_shards[i].lock);
+	h->huge_shards_next = 0;
+
 	h->nlocks = On_valgrind ? MAX_RUN_LOCKS_VG : MAX_RUN_LOCKS;
 	for (unsigned i = 0; i < h->nlocks; ++i)
 		util_mutex_init(&h->run_locks[i]);
@@ -1519,8 +2318,21 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	return 0;
 
 error_vec_reserve:
+	for (unsigned i = 0; i < h->nlocks; ++i)
+		util_mutex_destroy(&h->run_locks[i]);
+	for (unsigned i = 0; i < h->nhuge_shards; ++i)
+		util_mutex_destroy(&h->huge_shards[i].lock);
+	Free(h->huge_shards);
+error_huge_shards_new:
+	critnib_delete(h->zone_owners);
+error_zone_owners_new:
+	critnib_delete(h->run_deltas);
+error_run_deltas_new:
 	heap_arenas_fini(&h->arenas);
 error_arenas_malloc:
+	type_index_delete(heap->type_index);
+	heap->type_index = NULL;
+error_type_index_new:
 	alloc_class_collection_delete(h->alloc_classes);
 error_alloc_classes_new:
 	Free(h);
@@ -1597,6 +2409,9 @@ heap_cleanup(struct palloc_heap *heap)
 
 	alloc_class_collection_delete(rt->alloc_classes);
 
+	type_index_delete(heap->type_index);
+	heap->type_index = NULL;
+
 	os_tls_key_delete(rt->arenas.thread);
 	bucket_delete(rt->default_bucket);
 
@@ -1607,6 +2422,14 @@ heap_cleanup(struct palloc_heap *heap)
 	for (unsigned i = 0; i < rt->nlocks; ++i)
 		util_mutex_destroy(&rt->run_locks[i]);
 
+	heap_run_deltas_delete(rt->run_deltas);
+
+	for (unsigned i = 0; i < rt->nhuge_shards; ++i)
+		util_mutex_destroy(&rt->huge_shards[i].lock);
+	Free(rt->huge_shards);
+
+	critnib_delete(rt->zone_owners);
+
 	heap_arenas_fini(&rt->arenas);
 
 	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
@@ -1794,17 +2617,18 @@ out:
 }
 
 /*
- * heap_zone_foreach_object -- (internal) iterates through objects in a zone
+ * heap_zone_foreach_object -- (internal) iterates through objects in a zone,
+ *	in the chunks which start before the 'end' chunk
  */
 static int
 heap_zone_foreach_object(struct palloc_heap *heap, object_callback cb,
-	void *arg, struct memory_block *m)
+	void *arg, struct memory_block *m, uint32_t end)
 {
 	struct zone *zone = ZID_TO_ZONE(heap->layout, m->zone_id);
 	if (zone->header.magic == 0)
 		return 0;
 
-	for (; m->chunk_id < zone->header.size_idx; ) {
+	for (; m->chunk_id < zone->header.size_idx && m->chunk_id < end; ) {
 		struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
 		memblock_rebuild_state(heap, m);
 		m->size_idx = hdr->size_idx;
@@ -1827,13 +2651,159 @@ heap_foreach_object(struct palloc_heap *heap, object_callback cb, void *arg,
 	struct memory_block m)
 {
 	for (; m.zone_id < heap->rt->nzones; ++m.zone_id) {
-		if (heap_zone_foreach_object(heap, cb, arg, &m) != 0)
+		if (heap_zone_foreach_object(heap, cb, arg, &m,
+				MAX_CHUNK) != 0)
 			break;
 
 		m.chunk_id = 0;
 	}
 }
 
+/* number of chunks handed out at once to a thread of a parallel iteration */
+#define HEAP_FOREACH_SLICE_CHUNKS 1024
+#define HEAP_FOREACH_ZONE_SLICES\
+	((MAX_CHUNK + HEAP_FOREACH_SLICE_CHUNKS - 1) /\
+	HEAP_FOREACH_SLICE_CHUNKS)
+
+struct heap_foreach_parallel {
+	struct palloc_heap *heap;
+	object_callback cb;
+	void *arg;
+
+	unsigned nslices; /* total number of slices in all the zones */
+	unsigned next_slice; /* the slice to be handed out to a thread next */
+	int stop; /* set once the callback terminated the iteration */
+};
+
+/*
+ * heap_foreach_parallel_cb -- (internal) calls the user callback unless
+ *	another thread has already terminated the iteration
+ */
+static int
+heap_foreach_parallel_cb(const struct memory_block *m, void *arg)
+{
+	struct heap_foreach_parallel *p = arg;
+
+	int stop;
+	util_atomic_load_explicit32(&p->stop, &stop, memory_order_acquire);
+	if (stop)
+		return 1;
+
+	if (p->cb(m, p->arg) != 0) {
+		util_atomic_store_explicit32(&p->stop, 1, memory_order_release);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * heap_foreach_parallel_slice -- (internal) iterates through the objects
+ *	in the chunks which start within the given slice of a zone
+ */
+static int
+heap_foreach_parallel_slice(struct heap_foreach_parallel *p, unsigned slice)
+{
+	struct palloc_heap *heap = p->heap;
+
+	struct memory_block m = MEMORY_BLOCK_NONE;
+	m.zone_id = slice / HEAP_FOREACH_ZONE_SLICES;
+
+	struct zone *zone = ZID_TO_ZONE(heap->layout, m.zone_id);
+	uint32_t first = (slice % HEAP_FOREACH_ZONE_SLICES) *
+		HEAP_FOREACH_SLICE_CHUNKS;
+	if (zone->header.magic == 0 || first >= zone->header.size_idx)
+		return 0;
+
+	/* skip the chunks that start in the previous slices */
+	while (m.chunk_id < first)
+		m.chunk_id += heap_get_chunk_hdr(heap, &m)->size_idx;
+
+	return heap_zone_foreach_object(heap, heap_foreach_parallel_cb, p, &m,
+		first + HEAP_FOREACH_SLICE_CHUNKS);
+}
+
+/*
+ * heap_foreach_parallel_worker -- (internal) iterates through the objects
+ *	of the heap, taking one slice of a zone at a time until there are none
+ *	left
+ */
+static void *
+heap_foreach_parallel_worker(void *arg)
+{
+	struct heap_foreach_parallel *p = arg;
+
+	for (;;) {
+		unsigned slice = util_fetch_and_add32(&p->next_slice, 1);
+		if (slice >= p->nslices)
+			break;
+
+		if (heap_foreach_parallel_slice(p, slice) != 0)
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * heap_foreach_object_parallel -- iterates through objects in the heap using
+ *	up to nthreads threads, including the calling one, or as many threads
+ *	as there are online processors if nthreads is 0
+ *
+ * Each zone is divided into slices of HEAP_FOREACH_SLICE_CHUNKS chunks and
+ * the slices are handed out to the threads one by one, so the callback is
+ * called concurrently and in no particular order. Returns 1 if the iteration
+ * was terminated by the callback, 0 otherwise. If a thread cannot be created
+ * the slices are simply processed by the remaining ones.
+ */
+int
+heap_foreach_object_parallel(struct palloc_heap *heap, unsigned nthreads,
+	object_callback cb, void *arg)
+{
+	struct heap_foreach_parallel p;
+	p.heap = heap;
+	p.cb = cb;
+	p.arg = arg;
+	p.nslices = heap->rt->nzones * HEAP_FOREACH_ZONE_SLICES;
+	p.next_slice = 0;
+	p.stop = 0;
+
+	if (nthreads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = cpus < 1 ? 1 : (unsigned)cpus;
+	}
+
+	if (nthreads > p.nslices)
+		nthreads = p.nslices;
+
+	os_thread_t *threads = NULL;
+	unsigned nstarted = 0;
+	if (nthreads > 1) {
+		threads = Malloc(sizeof(*threads) * (nthreads - 1));
+		if (threads == NULL)
+			LOG(2, "!Malloc");
+	}
+
+	for (; threads != NULL && nstarted < nthreads - 1; ++nstarted) {
+		int ret = os_thread_create(&threads[nstarted], NULL,
+			heap_foreach_parallel_worker, &p);
+		if (ret != 0) {
+			errno = ret;
+			LOG(2, "!os_thread_create");
+			break;
+		}
+	}
+
+	heap_foreach_parallel_worker(&p);
+
+	for (unsigned i = 0; i < nstarted; ++i)
+		os_thread_join(&threads[i], NULL);
+
+	Free(threads);
+
+	return p.stop;
+}
+
 #if VG_MEMCHECK_ENABLED
 
 /*
@@ -56,6 +56,9 @@ heap_bucket_release(struct palloc_heap *heap, struct bucket *b);
 
 int heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block *m);
+int heap_get_huge_block(struct palloc_heap *heap, uint16_t arena_id,
+	struct memory_block *m);
+int heap_free_huge_block(struct palloc_heap *heap, struct memory_block *m);
 struct memory_block
 heap_coalesce_huge(struct palloc_heap *heap, struct bucket *b,
 	const struct memory_block *m);
@@ -71,12 +74,20 @@ heap_discard_run(struct palloc_heap *heap, struct memory_block *m);
 void
 heap_memblock_on_free(struct palloc_heap *heap, const struct memory_block *m);
 
+void heap_run_delta_reset(struct palloc_heap *heap,
+	const struct memory_block *m);
+int heap_run_delta_take(struct palloc_heap *heap,
+	const struct memory_block *m, uint32_t *freed_units,
+	uint32_t *max_freed);
+
 int
 heap_free_chunk_reuse(struct palloc_heap *heap,
 	struct bucket *bucket, struct memory_block *m);
 
 void heap_foreach_object(struct palloc_heap *heap, object_callback cb,
 	void *arg, struct memory_block start);
+int heap_foreach_object_parallel(struct palloc_heap *heap, unsigned nthreads,
+	object_callback cb, void *arg);
 
 struct alloc_class_collection *heap_alloc_classes(struct palloc_heap *heap);
 
@@ -104,6 +115,11 @@ int heap_set_arena_auto(struct palloc_heap *heap, unsigned arena_id,
 
 void heap_set_arena_thread(struct palloc_heap *heap, unsigned arena_id);
 
+void heap_get_arena_zones(struct palloc_heap *heap, unsigned arena_id,
+	unsigned *first, unsigned *count);
+int heap_set_arena_zones(struct palloc_heap *heap, unsigned arena_id,
+	unsigned first, unsigned count);
+
 void heap_vg_open(struct palloc_heap *heap, object_callback cb,
 		void *arg, int objects);
 
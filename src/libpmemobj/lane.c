@@ -218,6 +218,8 @@ lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout)
 		LOG_TYPE_REDO);
 	if (lane->external == NULL)
 		goto error_external_new;
+	operation_set_log_retention(lane->external,
+		&pop->lanes_desc.log_retention);
 
 	lane->undo = operation_new((struct ulog *)&layout->undo,
 		LANE_UNDO_SIZE,
@@ -225,6 +227,8 @@ lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout)
 		LOG_TYPE_UNDO);
 	if (lane->undo == NULL)
 		goto error_undo_new;
+	operation_set_log_retention(lane->undo,
+		&pop->lanes_desc.log_retention);
 
 	return 0;
 
@@ -264,6 +268,9 @@ lane_boot(PMEMobjpool *pop)
 
 	pop->lanes_desc.next_lane_idx = 0;
 
+	pop->lanes_desc.log_retention.size = 0;
+	pop->lanes_desc.log_retention.period = LANE_DEFAULT_LOG_RETAIN_PERIOD;
+
 	pop->lanes_desc.lane_locks =
 		Zalloc(sizeof(*pop->lanes_desc.lane_locks) * pop->nlanes);
 	if (pop->lanes_desc.lane_locks == NULL) {
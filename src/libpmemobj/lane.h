@@ -32,6 +32,12 @@ extern "C" {
 
 #define RLANE_DEFAULT 0
 
+/*
+ * Number of operations after which the log extensions which were not needed
+ * by any of them are freed, if the lanes are configured to keep them.
+ */
+#define LANE_DEFAULT_LOG_RETAIN_PERIOD 64
+
 #define LANE_TOTAL_SIZE 3072 /* 3 * 1024 (sum of 3 old lane sections) */
 /*
  * We have 3 kilobytes to distribute.
@@ -97,6 +103,9 @@ struct lane_descriptor {
 	unsigned next_lane_idx;
 	uint64_t *lane_locks;
 	struct lane *lane;
+
+	/* log extensions the lanes keep between operations */
+	struct ulog_retention log_retention;
 };
 
 typedef int (*section_layout_op)(PMEMobjpool *pop, void *data, unsigned length);
@@ -62,6 +62,12 @@ struct operation_context {
 	int ulog_auto_reserve; /* allow or do not to auto ulog reservation */
 	int ulog_any_user_buffer; /* set if any user buffer is added */
 
+	/* extensions to keep after finishing, NULL if none */
+	const struct ulog_retention *retention;
+	size_t ulog_retained; /* capacity of the extensions kept */
+	size_t ulog_retain_peak; /* capacity needed in the current period */
+	unsigned ulog_retain_nops; /* operations in the current period */
+
 	struct ulog_next next; /* vector of 'next' fields of persistent ulog */
 
 	enum operation_state state; /* operation sanity check */
@@ -182,6 +188,11 @@ operation_new(struct ulog *ulog, size_t ulog_base_nbytes,
 	ctx->type = type;
 	ctx->ulog_any_user_buffer = 0;
 
+	ctx->retention = NULL;
+	ctx->ulog_retained = 0;
+	ctx->ulog_retain_peak = 0;
+	ctx->ulog_retain_nops = 0;
+
 	ctx->ulog_curr_offset = 0;
 	ctx->ulog_curr_capacity = 0;
 	ctx->ulog_curr = NULL;
@@ -344,6 +355,38 @@ operation_merge_entry_add(struct operation_context *ctx,
 	}
 }
 
+/*
+ * operation_log_grow -- (internal) makes room for nbytes of new entries in
+ *	the volatile log
+ *
+ * Always make sure to have one extra spare cacheline so that the ulog log
+ * entry creation has enough room for zeroing.
+ */
+static int
+operation_log_grow(struct operation_context *ctx,
+	struct operation_log *oplog, size_t nbytes)
+{
+	if (oplog->offset + nbytes + CACHELINE_SIZE <= oplog->capacity)
+		return 0;
+
+	size_t ncapacity = ALIGN_UP(oplog->offset + nbytes + CACHELINE_SIZE,
+		(size_t)ULOG_BASE_SIZE);
+	struct ulog *ulog = Realloc(oplog->ulog, SIZEOF_ULOG(ncapacity));
+	if (ulog == NULL)
+		return -1;
+	oplog->capacity = ncapacity;
+	oplog->ulog = ulog;
+	oplog->ulog->capacity = oplog->capacity;
+
+	/*
+	 * Realloc invalidated the ulog entries that are inside of this
+	 * vector, need to clear it to avoid use after free.
+	 */
+	VECQ_CLEAR(&ctx->merge_entries);
+
+	return 0;
+}
+
 /*
  * operation_add_typed_value -- adds new entry to the current operation, if the
  *	same ptr address already exists and the operation type is set,
@@ -357,26 +400,9 @@ operation_add_typed_entry(struct operation_context *ctx,
 	struct operation_log *oplog = log_type == LOG_PERSISTENT ?
 		&ctx->pshadow_ops : &ctx->transient_ops;
 
-	/*
-	 * Always make sure to have one extra spare cacheline so that the
-	 * ulog log entry creation has enough room for zeroing.
-	 */
-	if (oplog->offset + CACHELINE_SIZE == oplog->capacity) {
-		size_t ncapacity = oplog->capacity + ULOG_BASE_SIZE;
-		struct ulog *ulog = Realloc(oplog->ulog,
-			SIZEOF_ULOG(ncapacity));
-		if (ulog == NULL)
-			return -1;
-		oplog->capacity += ULOG_BASE_SIZE;
-		oplog->ulog = ulog;
-		oplog->ulog->capacity = oplog->capacity;
-
-		/*
-		 * Realloc invalidated the ulog entries that are inside of this
-		 * vector, need to clear it to avoid use after free.
-		 */
-		VECQ_CLEAR(&ctx->merge_entries);
-	}
+	if (operation_log_grow(ctx, oplog,
+			sizeof(struct ulog_entry_val)) != 0)
+		return -1;
 
 	if (log_type == LOG_PERSISTENT &&
 		operation_try_merge_entry(ctx, ptr, value, type) != 0)
@@ -412,6 +438,69 @@ operation_add_entry(struct operation_context *ctx, void *ptr, uint64_t value,
 		from_pool ? LOG_PERSISTENT : LOG_TRANSIENT);
 }
 
+/*
+ * operation_add_redo_buffer -- (internal) adds a buffer operation to the
+ *	shadow of the persistent redo log
+ *
+ * The shadow is stored as-is in the persistent log and its extensions, so an
+ * entry cannot cross the end of any of them. Buffers have to be added before
+ * any values, the entries are then cacheline aligned and can be split exactly
+ * at the end of every log, just like in the undo log.
+ */
+static int
+operation_add_redo_buffer(struct operation_context *ctx,
+	void *dest, void *src, size_t size, ulog_operation_type type)
+{
+	struct operation_log *oplog = &ctx->pshadow_ops;
+	ASSERTeq(oplog->offset % CACHELINE_SIZE, 0);
+
+	size_t real_size = size + sizeof(struct ulog_entry_buf);
+
+	/* if there's no space left in the current log, move to the next one */
+	if (ctx->ulog_curr_capacity == 0) {
+		size_t needed = oplog->offset +
+			ALIGN_UP(real_size, CACHELINE_SIZE) + CACHELINE_SIZE;
+		if (operation_reserve(ctx, needed) != 0)
+			return -1;
+
+		ctx->ulog_curr = ctx->ulog_curr == NULL ? ctx->ulog :
+			ulog_next(ctx->ulog_curr, ctx->p_ops);
+		ASSERTne(ctx->ulog_curr, NULL);
+		ctx->ulog_curr_capacity = ctx->ulog_curr == ctx->ulog ?
+			ctx->ulog_base_nbytes - oplog->offset :
+			ctx->ulog_curr->capacity;
+	}
+
+	size_t curr_size = MIN(real_size, ctx->ulog_curr_capacity);
+	size_t data_size = curr_size - sizeof(struct ulog_entry_buf);
+	size_t entry_size = ALIGN_UP(curr_size, CACHELINE_SIZE);
+
+	if (operation_log_grow(ctx, oplog, entry_size) != 0)
+		return -1;
+
+	struct ulog_entry_buf *e = ulog_entry_buf_create(oplog->ulog,
+		oplog->offset, oplog->ulog->gen_num,
+		dest, src, data_size,
+		type, &ctx->s_ops);
+	ASSERT(entry_size == ulog_entry_size(&e->base));
+	ASSERT(entry_size <= ctx->ulog_curr_capacity);
+
+	ctx->total_logged += entry_size;
+	oplog->offset += entry_size;
+	ctx->ulog_curr_capacity -= entry_size;
+
+	/* clear the leftovers of a previous log, like value entries do */
+	struct ulog_entry_base *next_entry = (struct ulog_entry_base *)
+		(oplog->ulog->data + oplog->offset);
+	next_entry->offset = 0;
+
+	if (size == data_size)
+		return 0;
+
+	return operation_add_redo_buffer(ctx, (char *)dest + data_size,
+		(char *)src + data_size, size - data_size, type);
+}
+
 /*
  * operation_add_buffer -- adds a buffer operation to the log
  */
@@ -419,6 +508,9 @@ int
 operation_add_buffer(struct operation_context *ctx,
 	void *dest, void *src, size_t size, ulog_operation_type type)
 {
+	if (ctx->type == LOG_TYPE_REDO)
+		return operation_add_redo_buffer(ctx, dest, src, size, type);
+
 	size_t real_size = size + sizeof(struct ulog_entry_buf);
 
 	/* if there's no space left in the log, reserve some more */
@@ -610,6 +702,16 @@ operation_add_user_buffer(struct operation_context *ctx,
 	operation_set_any_user_buffer(ctx, 1);
 }
 
+/*
+ * operation_get_total_logged -- returns the number of bytes occupied by the
+ *	buffer entries of the current operation
+ */
+size_t
+operation_get_total_logged(struct operation_context *ctx)
+{
+	return ctx->total_logged;
+}
+
 /*
  * operation_set_auto_reserve -- set auto reserve value for context
  */
@@ -638,6 +740,50 @@ operation_get_any_user_buffer(struct operation_context *ctx)
 	return ctx->ulog_any_user_buffer;
 }
 
+/*
+ * operation_set_log_retention -- sets the policy of keeping the log
+ *	extensions between operations, the policy is read on every finish
+ */
+void
+operation_set_log_retention(struct operation_context *ctx,
+	const struct ulog_retention *retention)
+{
+	ctx->retention = retention;
+}
+
+/*
+ * operation_log_retained -- (internal) returns the capacity of the log
+ *	extensions to keep once the current operation is finished
+ *
+ * The kept capacity grows as soon as an operation needs more space than is
+ * already kept, but it shrinks only at the end of a period of operations,
+ * down to the most any of them needed. This way a workload that mixes small
+ * and large transactions does not allocate and free the logs over and over.
+ */
+static size_t
+operation_log_retained(struct operation_context *ctx)
+{
+	const struct ulog_retention *r = ctx->retention;
+	if (r == NULL || r->size == 0)
+		return 0;
+
+	size_t used = ctx->type == LOG_TYPE_UNDO ?
+		ctx->total_logged : ctx->pshadow_ops.offset;
+	size_t needed = used > ctx->ulog_base_nbytes ?
+		used - ctx->ulog_base_nbytes : 0;
+
+	ctx->ulog_retain_peak = MAX(ctx->ulog_retain_peak, needed);
+	ctx->ulog_retained = MAX(ctx->ulog_retained, needed);
+
+	if (++ctx->ulog_retain_nops >= r->period) {
+		ctx->ulog_retained = ctx->ulog_retain_peak;
+		ctx->ulog_retain_peak = 0;
+		ctx->ulog_retain_nops = 0;
+	}
+
+	return MIN(ctx->ulog_retained, r->size);
+}
+
 /*
  * operation_process_persistent_redo -- (internal) process using ulog
  */
@@ -651,8 +797,8 @@ operation_process_persistent_redo(struct operation_context *ctx)
 		ctx->ulog_capacity,
 		&ctx->next, ctx->p_ops);
 
-	ulog_process(ctx->pshadow_ops.ulog, OBJ_OFF_IS_VALID_FROM_CTX,
-		ctx->p_ops);
+	ulog_process_sized(ctx->pshadow_ops.ulog, ctx->pshadow_ops.offset,
+		OBJ_OFF_IS_VALID_FROM_CTX, ctx->p_ops);
 
 	ulog_clobber(ctx->ulog, &ctx->next, ctx->p_ops);
 }
@@ -799,6 +945,13 @@ operation_finish(struct operation_context *ctx, unsigned flags)
 {
 	ASSERTne(ctx->state, OPERATION_IDLE);
 
+	/*
+	 * Every operation counts toward the retention period, including the
+	 * ones that logged nothing, otherwise the kept capacity would never
+	 * shrink in a workload of mostly read-only transactions.
+	 */
+	size_t retained = operation_log_retained(ctx);
+
 	if (ctx->type == LOG_TYPE_UNDO && ctx->total_logged != 0)
 		ctx->state = OPERATION_CLEANUP;
 
@@ -810,16 +963,22 @@ operation_finish(struct operation_context *ctx, unsigned flags)
 	if (ctx->state != OPERATION_CLEANUP)
 		goto out;
 
+	/* logs with user buffers are always reverted to a single ulog */
+	if (flags & (ULOG_ANY_USER_BUFFER | ULOG_FREE_AFTER_FIRST))
+		retained = 0;
+
 	if (ctx->type == LOG_TYPE_UNDO) {
 		int ret = ulog_clobber_data(ctx->ulog,
 			ctx->total_logged, ctx->ulog_base_nbytes,
-			&ctx->next, ctx->ulog_free,
+			&ctx->next, retained, ctx->ulog_free,
 			operation_user_buffer_remove,
 			ctx->p_ops, flags);
 		if (ret == 0)
 			goto out;
 	} else if (ctx->type == LOG_TYPE_REDO) {
-		int ret = ulog_free_next(ctx->ulog, ctx->p_ops,
+		struct ulog *u = ulog_retain(ctx->ulog, retained,
+			ctx->p_ops);
+		int ret = ulog_free_next(u, ctx->p_ops,
 			ctx->ulog_free, operation_user_buffer_remove,
 			flags);
 		if (ret == 0)
@@ -70,6 +70,9 @@ void operation_set_auto_reserve(struct operation_context *ctx,
 void operation_set_any_user_buffer(struct operation_context *ctx,
 	int any_user_buffer);
 int operation_get_any_user_buffer(struct operation_context *ctx);
+void operation_set_log_retention(struct operation_context *ctx,
+	const struct ulog_retention *retention);
+size_t operation_get_total_logged(struct operation_context *ctx);
 int operation_user_buffer_range_cmp(const void *lhs, const void *rhs);
 
 int operation_reserve(struct operation_context *ctx, size_t new_capacity);
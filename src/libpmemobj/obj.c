@@ -27,6 +27,7 @@
 #include "sync.h"
 #include "tx.h"
 #include "sys_util.h"
+#include "checkpoint.h"
 
 /*
  * The variable from which the config is directly loaded. The string
@@ -163,6 +164,7 @@ obj_ctl_init_and_load(PMEMobjpool *pop)
 		tx_ctl_register(pop);
 		pmalloc_ctl_register(pop);
 		stats_ctl_register(pop);
+		dirtymap_ctl_register(pop);
 		debug_ctl_register(pop);
 	}
 
@@ -420,6 +422,10 @@ obj_norep_memcpy(void *ctx, void *dest, const void *src, size_t len,
 	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
 			flags);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_write(pop->stats, dest, len,
+			flags & PMEM_F_MEM_VALID_FLAGS);
+
 	return pop->memcpy_local(dest, src, len,
 					flags & PMEM_F_MEM_VALID_FLAGS);
 }
@@ -435,6 +441,10 @@ obj_norep_memmove(void *ctx, void *dest, const void *src, size_t len,
 	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
 			flags);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_write(pop->stats, dest, len,
+			flags & PMEM_F_MEM_VALID_FLAGS);
+
 	return pop->memmove_local(dest, src, len,
 					flags & PMEM_F_MEM_VALID_FLAGS);
 }
@@ -449,6 +459,10 @@ obj_norep_memset(void *ctx, void *dest, int c, size_t len, unsigned flags)
 	LOG(15, "pop %p dest %p c 0x%02x len %zu flags 0x%x", pop, dest, c, len,
 			flags);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_write(pop->stats, dest, len,
+			flags & PMEM_F_MEM_VALID_FLAGS);
+
 	return pop->memset_local(dest, c, len, flags & PMEM_F_MEM_VALID_FLAGS);
 }
 
@@ -461,6 +475,11 @@ obj_norep_persist(void *ctx, const void *addr, size_t len, unsigned flags)
 	PMEMobjpool *pop = ctx;
 	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
 
+	if (STATS_PERSIST_ENABLED(pop->stats)) {
+		stats_persist_flush(pop->stats, addr, len);
+		stats_persist_fence(pop->stats);
+	}
+
 	pop->persist_local(addr, len);
 
 	return 0;
@@ -475,6 +494,9 @@ obj_norep_flush(void *ctx, const void *addr, size_t len, unsigned flags)
 	PMEMobjpool *pop = ctx;
 	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_flush(pop->stats, addr, len);
+
 	pop->flush_local(addr, len);
 
 	return 0;
@@ -489,6 +511,9 @@ obj_norep_drain(void *ctx)
 	PMEMobjpool *pop = ctx;
 	LOG(15, "pop %p", pop);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_fence(pop->stats);
+
 	pop->drain_local();
 }
 
@@ -504,6 +529,11 @@ obj_handle_remote_persist_error(PMEMobjpool *pop)
 	LOG(1, "pop %p", pop);
 
 	ERR("error clean up...");
+
+	/* the replicas may differ, all the marked regions have to stay so */
+	dirtymap_delete(pop->dirtymap);
+	pop->dirtymap = NULL;
+
 	obj_pool_cleanup(pop);
 
 	FATAL("Fatal error of remote persist. Aborting...");
@@ -525,6 +555,12 @@ obj_rep_memcpy(void *ctx, void *dest, const void *src, size_t len,
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_write(pop->stats, dest, len, flags);
+
+	if (dirtymap_mark(pop->dirtymap, dest, len, lane))
+		obj_handle_remote_persist_error(pop);
+
 	void *ret = pop->memcpy_local(dest, src, len, flags);
 
 	PMEMobjpool *rep = pop->replica;
@@ -562,6 +598,12 @@ obj_rep_memmove(void *ctx, void *dest, const void *src, size_t len,
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_write(pop->stats, dest, len, flags);
+
+	if (dirtymap_mark(pop->dirtymap, dest, len, lane))
+		obj_handle_remote_persist_error(pop);
+
 	void *ret = pop->memmove_local(dest, src, len, flags);
 
 	PMEMobjpool *rep = pop->replica;
@@ -598,6 +640,12 @@ obj_rep_memset(void *ctx, void *dest, int c, size_t len, unsigned flags)
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_write(pop->stats, dest, len, flags);
+
+	if (dirtymap_mark(pop->dirtymap, dest, len, lane))
+		obj_handle_remote_persist_error(pop);
+
 	void *ret = pop->memset_local(dest, c, len, flags);
 
 	PMEMobjpool *rep = pop->replica;
@@ -633,6 +681,14 @@ obj_rep_persist(void *ctx, const void *addr, size_t len, unsigned flags)
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL);
 
+	if (STATS_PERSIST_ENABLED(pop->stats)) {
+		stats_persist_flush(pop->stats, addr, len);
+		stats_persist_fence(pop->stats);
+	}
+
+	if (dirtymap_mark(pop->dirtymap, addr, len, lane))
+		obj_handle_remote_persist_error(pop);
+
 	pop->persist_local(addr, len);
 
 	PMEMobjpool *rep = pop->replica;
@@ -667,6 +723,12 @@ obj_rep_flush(void *ctx, const void *addr, size_t len, unsigned flags)
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_flush(pop->stats, addr, len);
+
+	if (dirtymap_mark(pop->dirtymap, addr, len, lane))
+		obj_handle_remote_persist_error(pop);
+
 	pop->flush_local(addr, len);
 
 	PMEMobjpool *rep = pop->replica;
@@ -697,6 +759,9 @@ obj_rep_drain(void *ctx)
 	PMEMobjpool *pop = ctx;
 	LOG(15, "pop %p", pop);
 
+	if (STATS_PERSIST_ENABLED(pop->stats))
+		stats_persist_fence(pop->stats);
+
 	pop->drain_local();
 
 	PMEMobjpool *rep = pop->replica;
@@ -924,11 +989,23 @@ obj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
 		sizeof(pop->conversion_flags));
 
 	/*
-	 * It's safe to use PMEMOBJ_F_RELAXED flag because the reserved
-	 * area must be entirely zeroed.
+	 * The tracking of modified regions is disabled by default and there
+	 * are no stored allocation classes, so the dirty map is zeroed
+	 * together with the fields and the reserved area which follow it.
+	 * It's safe to use PMEMOBJ_F_RELAXED flag because all must be
+	 * entirely zeroed.
 	 */
-	pmemops_memset(p_ops, pop->pmem_reserved, 0,
-		sizeof(pop->pmem_reserved), PMEMOBJ_F_RELAXED);
+	COMPILE_ERROR_ON(offsetof(struct pmemobjpool, alloc_class_set_offset) !=
+		offsetof(struct pmemobjpool, dirtymap_persistent) +
+		sizeof(struct dirtymap_persistent));
+	COMPILE_ERROR_ON(offsetof(struct pmemobjpool, pmem_reserved) !=
+		offsetof(struct pmemobjpool, alloc_class_set_offset) +
+		sizeof(pop->alloc_class_set_offset));
+	pmemops_memset(p_ops, &pop->dirtymap_persistent, 0,
+		sizeof(pop->dirtymap_persistent) +
+		sizeof(pop->alloc_class_set_offset) +
+		sizeof(pop->pmem_reserved),
+		PMEMOBJ_F_RELAXED);
 
 	return 0;
 }
@@ -1094,6 +1171,15 @@ obj_replica_init(PMEMobjpool *rep, struct pool_set *set, unsigned repidx,
 {
 	struct pool_replica *repset = set->replica[repidx];
 
+	/* writes are not accounted until the statistics are created */
+	rep->stats = NULL;
+
+	/* nor tracked until the dirty map is created */
+	rep->dirtymap = NULL;
+
+	/* a pool opened in the copy-on-write mode is marked as such later */
+	rep->is_cow = 0;
+
 	if (repidx == 0) {
 		/* master replica */
 		rep->is_master_replica = 1;
@@ -1165,6 +1251,11 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 	LOG(3, "pop %p rdonly %d boot %d", pop, rdonly, boot);
 	struct pmem_ops *p_ops = &pop->p_ops;
 
+	/* must be created before anything is written to the pool */
+	pop->dirtymap = dirtymap_new(pop);
+	if (pop->dirtymap == NULL)
+		return -1;
+
 	/* run_id is made unique by incrementing the previous value */
 	pop->run_id += 2;
 	if (pop->run_id == 0)
@@ -1268,6 +1359,7 @@ err_boot:
 err_stat:
 	tx_params_delete(pop->tx_params);
 err_tx_params:
+	dirtymap_delete(pop->dirtymap);
 
 	return -1;
 }
@@ -1715,6 +1807,11 @@ obj_open_common(const char *path, const char *layout, unsigned flags, int boot)
 	 * environment variable whichever is lower.
 	 */
 	unsigned runtime_nlanes = obj_get_nlanes();
+
+	/* complete the checkpoint interrupted by a crash, if any */
+	if (boot && checkpoint_recover(path))
+		return NULL;
+
 	if (obj_pool_open(&set, path, flags, &runtime_nlanes))
 		return NULL;
 
@@ -1724,6 +1821,8 @@ obj_open_common(const char *path, const char *layout, unsigned flags, int boot)
 	if (obj_replicas_init(set))
 		goto replicas_init;
 
+	pop->is_cow = (flags & POOL_OPEN_COW) != 0;
+
 	for (unsigned r = 0; r < set->nreplicas; r++) {
 		struct pool_replica *repset = set->replica[r];
 		PMEMobjpool *rep = repset->part[0].addr;
@@ -1918,7 +2017,6 @@ obj_pool_cleanup(PMEMobjpool *pop)
 	ravl_delete(pop->ulog_user_buffers.map);
 	util_mutex_destroy(&pop->ulog_user_buffers.lock);
 
-	stats_delete(pop, pop->stats);
 	tx_params_delete(pop->tx_params);
 	ctl_delete(pop->ctl);
 
@@ -1927,6 +2025,10 @@ obj_pool_cleanup(PMEMobjpool *pop)
 	lane_section_cleanup(pop);
 	lane_cleanup(pop);
 
+	/* the heap and lanes may still write to the pool until cleaned up */
+	stats_delete(pop, pop->stats);
+	dirtymap_close(pop->dirtymap);
+
 	/* unmap all the replicas */
 	obj_replicas_cleanup(pop->set);
 	util_poolset_close(pop->set, DO_NOT_DELETE_PARTS);
@@ -1973,6 +2075,29 @@ pmemobj_close(PMEMobjpool *pop)
 	PMEMOBJ_API_END();
 }
 
+/*
+ * pmemobj_checkpoint -- write the modifications of a pool opened in
+ *	the copy-on-write mode back to the pool
+ */
+int
+pmemobj_checkpoint(PMEMobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+	PMEMOBJ_API_START();
+
+	int ret;
+	if (!pop->is_cow) {
+		ERR("the pool is not opened in the copy-on-write mode");
+		errno = EINVAL;
+		ret = -1;
+	} else {
+		ret = checkpoint_commit(pop->set);
+	}
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
 /*
  * pmemobj_checkU -- transactional memory pool consistency check
  */
@@ -2006,6 +2131,7 @@ pmemobj_checkU(const char *path, const char *layout)
 		obj_pool_cleanup(pop);
 	} else {
 		stats_delete(pop, pop->stats);
+		dirtymap_delete(pop->dirtymap);
 		tx_params_delete(pop->tx_params);
 		ctl_delete(pop->ctl);
 
@@ -2629,6 +2755,17 @@ pmemobj_alloc_usable_size(PMEMoid oid)
 	return (palloc_usable_size(&pop->heap, oid.off));
 }
 
+/*
+ * obj_flush_deferred -- (internal) returns 1 if flushing the range can be left
+ *	to the commit of the current transaction, see tx.flush.dedup
+ */
+static inline int
+obj_flush_deferred(PMEMobjpool *pop, const void *addr, size_t len)
+{
+	return unlikely(pop->tx_params->flush_dedup) &&
+		tx_flush_deferred(pop, addr, len);
+}
+
 /*
  * pmemobj_memcpy_persist -- pmemobj version of memcpy
  */
@@ -2639,7 +2776,9 @@ pmemobj_memcpy_persist(PMEMobjpool *pop, void *dest, const void *src,
 	LOG(15, "pop %p dest %p src %p len %zu", pop, dest, src, len);
 	PMEMOBJ_API_START();
 
-	void *ptr = pmemops_memcpy(&pop->p_ops, dest, src, len, 0);
+	unsigned flags = obj_flush_deferred(pop, dest, len) ?
+		PMEMOBJ_F_MEM_NOFLUSH : 0;
+	void *ptr = pmemops_memcpy(&pop->p_ops, dest, src, len, flags);
 
 	PMEMOBJ_API_END();
 	return ptr;
@@ -2654,7 +2793,9 @@ pmemobj_memset_persist(PMEMobjpool *pop, void *dest, int c, size_t len)
 	LOG(15, "pop %p dest %p c 0x%02x len %zu", pop, dest, c, len);
 	PMEMOBJ_API_START();
 
-	void *ptr = pmemops_memset(&pop->p_ops, dest, c, len, 0);
+	unsigned flags = obj_flush_deferred(pop, dest, len) ?
+		PMEMOBJ_F_MEM_NOFLUSH : 0;
+	void *ptr = pmemops_memset(&pop->p_ops, dest, c, len, flags);
 
 	PMEMOBJ_API_END();
 	return ptr;
@@ -2672,6 +2813,9 @@ pmemobj_memcpy(PMEMobjpool *pop, void *dest, const void *src, size_t len,
 
 	PMEMOBJ_API_START();
 
+	if (obj_flush_deferred(pop, dest, len))
+		flags = PMEMOBJ_F_MEM_NOFLUSH;
+
 	void *ptr = pmemops_memcpy(&pop->p_ops, dest, src, len, flags);
 
 	PMEMOBJ_API_END();
@@ -2690,6 +2834,9 @@ pmemobj_memmove(PMEMobjpool *pop, void *dest, const void *src, size_t len,
 
 	PMEMOBJ_API_START();
 
+	if (obj_flush_deferred(pop, dest, len))
+		flags = PMEMOBJ_F_MEM_NOFLUSH;
+
 	void *ptr = pmemops_memmove(&pop->p_ops, dest, src, len, flags);
 
 	PMEMOBJ_API_END();
@@ -2707,6 +2854,9 @@ pmemobj_memset(PMEMobjpool *pop, void *dest, int c, size_t len, unsigned flags)
 
 	PMEMOBJ_API_START();
 
+	if (obj_flush_deferred(pop, dest, len))
+		flags = PMEMOBJ_F_MEM_NOFLUSH;
+
 	void *ptr = pmemops_memset(&pop->p_ops, dest, c, len, flags);
 
 	PMEMOBJ_API_END();
@@ -2721,6 +2871,9 @@ pmemobj_persist(PMEMobjpool *pop, const void *addr, size_t len)
 {
 	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
 
+	if (obj_flush_deferred(pop, addr, len))
+		return;
+
 	pmemops_persist(&pop->p_ops, addr, len);
 }
 
@@ -2732,6 +2885,9 @@ pmemobj_flush(PMEMobjpool *pop, const void *addr, size_t len)
 {
 	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
 
+	if (obj_flush_deferred(pop, addr, len))
+		return;
+
 	pmemops_flush(&pop->p_ops, addr, len);
 }
 
@@ -2750,6 +2906,9 @@ pmemobj_xpersist(PMEMobjpool *pop, const void *addr, size_t len, unsigned flags)
 		return -1;
 	}
 
+	if (obj_flush_deferred(pop, addr, len))
+		return 0;
+
 	return pmemops_xpersist(&pop->p_ops, addr, len, flags);
 }
 
@@ -2768,6 +2927,9 @@ pmemobj_xflush(PMEMobjpool *pop, const void *addr, size_t len, unsigned flags)
 		return -1;
 	}
 
+	if (obj_flush_deferred(pop, addr, len))
+		return 0;
+
 	return pmemops_xflush(&pop->p_ops, addr, len, flags);
 }
 
@@ -2967,6 +3129,109 @@ pmemobj_next(PMEMoid oid)
 	return curr;
 }
 
+/*
+ * obj_next_type -- (internal) returns the first object of the specified type
+ *	that follows the given offset, or the first one in the pool if the
+ *	offset is 0
+ */
+static PMEMoid
+obj_next_type(PMEMobjpool *pop, uint64_t type_num, uint64_t off)
+{
+	PMEMoid ret = {pop->uuid_lo, off};
+	uint64_t next;
+
+	while (palloc_next_of_type(&pop->heap, type_num, ret.off,
+			&next) == 0) {
+		if (next == 0)
+			return OID_NULL;
+
+		ret.off = next;
+
+		if (!(palloc_flags(&pop->heap, next) &
+				OBJ_INTERNAL_OBJECT_MASK))
+			return ret;
+	}
+
+	/* the type index is disabled, go through all the objects */
+	ret = ret.off == 0 ? pmemobj_first(pop) : pmemobj_next(ret);
+	while (ret.off != 0 && palloc_extra(&pop->heap, ret.off) != type_num)
+		ret = pmemobj_next(ret);
+
+	return ret;
+}
+
+/*
+ * pmemobj_first_type -- returns the first object of the specified type
+ */
+PMEMoid
+pmemobj_first_type(PMEMobjpool *pop, uint64_t type_num)
+{
+	LOG(3, "pop %p type_num %" PRIu64, pop, type_num);
+
+	return obj_next_type(pop, type_num, 0);
+}
+
+/*
+ * pmemobj_next_type -- returns the next object of the same type
+ */
+PMEMoid
+pmemobj_next_type(PMEMoid oid)
+{
+	LOG(3, "oid.off 0x%016" PRIx64, oid.off);
+
+	if (oid.off == 0)
+		return OID_NULL;
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+
+	return obj_next_type(pop, palloc_extra(&pop->heap, oid.off), oid.off);
+}
+
+struct obj_foreach_arg {
+	PMEMobjpool *pop;
+	pmemobj_foreach_cb cb;
+	void *arg;
+};
+
+/*
+ * obj_foreach_parallel_cb -- (internal) skips the internal objects and
+ *	passes the remaining ones to the user callback
+ */
+static int
+obj_foreach_parallel_cb(uint64_t off, void *arg)
+{
+	struct obj_foreach_arg *a = arg;
+
+	if (palloc_flags(&a->pop->heap, off) & OBJ_INTERNAL_OBJECT_MASK)
+		return 0;
+
+	PMEMoid oid = {a->pop->uuid_lo, off};
+
+	return a->cb(oid, a->arg);
+}
+
+/*
+ * pmemobj_foreach_parallel -- calls the callback for every object in the
+ *	pool, with the heap split among up to nthreads threads
+ */
+int
+pmemobj_foreach_parallel(PMEMobjpool *pop, unsigned nthreads,
+	pmemobj_foreach_cb cb, void *arg)
+{
+	LOG(3, "pop %p nthreads %u cb %p arg %p", pop, nthreads, cb, arg);
+
+	PMEMOBJ_API_START();
+
+	struct obj_foreach_arg a = {pop, cb, arg};
+	int ret = palloc_foreach_parallel(&pop->heap, nthreads,
+		obj_foreach_parallel_cb, &a);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
 /*
  * pmemobj_reserve -- reserves a single object
  */
@@ -17,6 +17,7 @@
 #include "ctl.h"
 #include "sync.h"
 #include "stats.h"
+#include "dirtymap.h"
 #include "ctl_debug.h"
 #include "page_size.h"
 
@@ -72,6 +73,7 @@ static const features_t obj_format_feat_default = OBJ_FORMAT_FEAT_CHECK;
 	(OBJ_OFF_FROM_HEAP(pop, off) ||\
 	(OBJ_PTR_TO_OFF(pop, &(pop)->root_offset) == (off)) ||\
 	(OBJ_PTR_TO_OFF(pop, &(pop)->root_size) == (off)) ||\
+	(OBJ_PTR_TO_OFF(pop, &(pop)->alloc_class_set_offset) == (off)) ||\
 	(OBJ_OFF_FROM_LANES(pop, off)))
 
 #define OBJ_PTR_IS_VALID(pop, ptr)\
@@ -95,7 +97,7 @@ typedef uint64_t type_num_t;
 #define CONVERSION_FLAG_OLD_SET_CACHE ((1ULL) << 0)
 
 /* PMEM_OBJ_POOL_HEAD_SIZE Without the unused and unused2 arrays */
-#define PMEM_OBJ_POOL_HEAD_SIZE 2196
+#define PMEM_OBJ_POOL_HEAD_SIZE 2228
 #define PMEM_OBJ_POOL_UNUSED2_SIZE (PMEM_PAGESIZE \
 					- OBJ_DSC_P_UNUSED\
 					- PMEM_OBJ_POOL_HEAD_SIZE)
@@ -129,7 +131,13 @@ struct pmemobjpool {
 
 	struct stats_persistent stats_persistent;
 
-	char pmem_reserved[496]; /* must be zeroed */
+	/* regions modified since the replicas were last synced */
+	struct dirtymap_persistent dirtymap_persistent;
+
+	/* allocation classes recreated on each open, see pmalloc_boot */
+	uint64_t alloc_class_set_offset;
+
+	char pmem_reserved[32]; /* must be zeroed */
 
 	/* some run-time state, allocated out of memory pool... */
 	void *addr;		/* mapped region */
@@ -139,9 +147,11 @@ struct pmemobjpool {
 	struct lane_descriptor lanes_desc;
 	uint64_t uuid_lo;
 	int is_dev_dax;		/* true if mapped on device dax */
+	int is_cow;		/* true if mapped privately (copy on write) */
 
 	struct ctl *ctl;	/* top level node of the ctl tree structure */
 	struct stats *stats;
+	struct dirtymap *dirtymap;
 
 	struct pool_set *set;		/* pool set info */
 	struct pmemobjpool *replica;	/* next replica */
@@ -41,6 +41,7 @@
 #include "sys_util.h"
 #include "palloc.h"
 #include "ravl.h"
+#include "type_index.h"
 #include "vec.h"
 
 struct pobj_action_internal {
@@ -213,9 +214,18 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	*new_block = MEMORY_BLOCK_NONE;
 	new_block->size_idx = (uint32_t)size_idx;
 
-	struct bucket *b = heap_bucket_acquire(heap, c->id, arena_id);
-
-	err = heap_get_bestfit_block(heap, b, new_block);
+	/*
+	 * Huge blocks don't need the bucket to be held for the duration of
+	 * the reservation, and are likely to be found without ever locking
+	 * the default bucket.
+	 */
+	struct bucket *b = NULL;
+	if (c->id == DEFAULT_ALLOC_CLASS_ID) {
+		err = heap_get_huge_block(heap, arena_id, new_block);
+	} else {
+		b = heap_bucket_acquire(heap, c->id, arena_id);
+		err = heap_get_bestfit_block(heap, b, new_block);
+	}
 	if (err != 0)
 		goto out;
 
@@ -226,7 +236,7 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 		 * the memory block reservation has to be rolled back.
 		 */
 		if (new_block->type == MEMORY_BLOCK_HUGE) {
-			bucket_insert_block(b, new_block);
+			heap_free_huge_block(heap, new_block);
 		}
 		err = ECANCELED;
 		goto out;
@@ -238,14 +248,16 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	 * The memory block cannot be put back into the global state unless
 	 * there are no active reservations.
 	 */
-	if ((out->mresv = b->active_memory_block) != NULL)
+	out->mresv = b != NULL ? b->active_memory_block : NULL;
+	if (out->mresv != NULL)
 		util_fetch_and_add64(&out->mresv->nresv, 1);
 
 	out->lock = new_block->m_ops->get_lock(new_block);
 	out->new_state = MEMBLOCK_ALLOCATED;
 
 out:
-	heap_bucket_release(heap, b);
+	if (b != NULL)
+		heap_bucket_release(heap, b);
 
 	if (err == 0)
 		return 0;
@@ -288,10 +300,7 @@ palloc_restore_free_chunk_state(struct palloc_heap *heap,
 	struct memory_block *m)
 {
 	if (m->type == MEMORY_BLOCK_HUGE) {
-		struct bucket *b = heap_bucket_acquire(heap,
-			DEFAULT_ALLOC_CLASS_ID,
-			HEAP_ARENA_PER_THREAD);
-		if (heap_free_chunk_reuse(heap, b, m) != 0) {
+		if (heap_free_huge_block(heap, m) != 0) {
 			if (errno == EEXIST) {
 				FATAL(
 					"duplicate runtime chunk state, possible double free");
@@ -299,7 +308,6 @@ palloc_restore_free_chunk_state(struct palloc_heap *heap,
 				LOG(2, "unable to track runtime chunk state");
 			}
 		}
-		heap_bucket_release(heap, b);
 	}
 }
 
@@ -328,7 +336,7 @@ palloc_reservation_clear(struct palloc_heap *heap,
 	struct bucket *b = mresv->bucket;
 
 	if (!publish) {
-		util_mutex_lock(&b->lock);
+		stats_mutex_lock(heap->stats, STATS_LOCK_BUCKET, &b->lock);
 		struct memory_block *am = &b->active_memory_block->m;
 
 		/*
@@ -344,7 +352,7 @@ palloc_reservation_clear(struct palloc_heap *heap,
 			bucket_insert_block(b, &act->m);
 		}
 
-		util_mutex_unlock(&b->lock);
+		stats_mutex_unlock(heap->stats, STATS_LOCK_BUCKET, &b->lock);
 	}
 
 	if (util_fetch_and_sub64(&mresv->nresv, 1) == 1) {
@@ -395,6 +403,8 @@ palloc_heap_action_on_process(struct palloc_heap *heap,
 			STATS_INC(heap->stats, transient, heap_run_allocated,
 				act->m.m_ops->get_real_size(&act->m));
 		}
+		type_index_insert(heap->type_index,
+			act->m.m_ops->get_extra(&act->m), act->offset);
 	} else if (act->new_state == MEMBLOCK_FREE) {
 		if (On_memcheck) {
 			void *ptr = act->m.m_ops->get_user_data(&act->m);
@@ -423,6 +433,8 @@ palloc_heap_action_on_process(struct palloc_heap *heap,
 			STATS_SUB(heap->stats, transient, heap_run_allocated,
 				act->m.m_ops->get_real_size(&act->m));
 		}
+		type_index_remove(heap->type_index,
+			act->m.m_ops->get_extra(&act->m), act->offset);
 		heap_memblock_on_free(heap, &act->m);
 	}
 }
@@ -548,7 +560,8 @@ palloc_exec_actions(struct palloc_heap *heap,
 		 */
 		if (i == 0 || act->lock != actv[i - 1].lock) {
 			if (act->lock)
-				util_mutex_lock(act->lock);
+				stats_mutex_lock(heap->stats,
+					STATS_LOCK_RUN, act->lock);
 		}
 
 		/* translate action to some number of operation_entry'ies */
@@ -568,7 +581,8 @@ palloc_exec_actions(struct palloc_heap *heap,
 
 		if (i == actvcnt - 1 || act->lock != actv[i + 1].lock) {
 			if (act->lock)
-				util_mutex_unlock(act->lock);
+				stats_mutex_unlock(heap->stats,
+					STATS_LOCK_RUN, act->lock);
 		}
 	}
 
@@ -1236,6 +1250,53 @@ palloc_next(struct palloc_heap *heap, uint64_t off)
 	return HEAP_PTR_TO_OFF(heap, uptr);
 }
 
+/*
+ * palloc_next_of_type -- finds the next object of the given type relative
+ *	to 'off' (or the first one if 'off' is 0) using the type index
+ *
+ * Returns -1 if the type index is disabled.
+ */
+int
+palloc_next_of_type(struct palloc_heap *heap, uint64_t type_num,
+	uint64_t off, uint64_t *next)
+{
+	return type_index_next(heap->type_index, type_num, off, next);
+}
+
+struct palloc_foreach_arg {
+	struct palloc_heap *heap;
+	palloc_foreach_cb cb;
+	void *arg;
+};
+
+/*
+ * palloc_foreach_parallel_cb -- (internal) translates the memory block into
+ *	the offset of the object
+ */
+static int
+palloc_foreach_parallel_cb(const struct memory_block *m, void *arg)
+{
+	struct palloc_foreach_arg *a = arg;
+
+	void *uptr = m->m_ops->get_user_data(m);
+
+	return a->cb(HEAP_PTR_TO_OFF(a->heap, uptr), a->arg);
+}
+
+/*
+ * palloc_foreach_parallel -- calls the callback for every object in the heap,
+ *	concurrently from up to nthreads threads
+ */
+int
+palloc_foreach_parallel(struct palloc_heap *heap, unsigned nthreads,
+	palloc_foreach_cb cb, void *arg)
+{
+	struct palloc_foreach_arg a = {heap, cb, arg};
+
+	return heap_foreach_object_parallel(heap, nthreads,
+		palloc_foreach_parallel_cb, &a);
+}
+
 /*
  * palloc_boot -- initializes allocator section
  */
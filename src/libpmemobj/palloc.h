@@ -36,6 +36,8 @@ struct palloc_heap {
 	void *base;
 
 	int alloc_pattern;
+
+	struct type_index *type_index;
 };
 
 struct memory_block;
@@ -76,6 +78,15 @@ palloc_set_value(struct palloc_heap *heap, struct pobj_action *act,
 uint64_t palloc_first(struct palloc_heap *heap);
 uint64_t palloc_next(struct palloc_heap *heap, uint64_t off);
 
+int palloc_next_of_type(struct palloc_heap *heap, uint64_t type_num,
+	uint64_t off, uint64_t *next);
+
+/* palloc_foreach_parallel callback, terminates iteration if non-zero */
+typedef int (*palloc_foreach_cb)(uint64_t off, void *arg);
+
+int palloc_foreach_parallel(struct palloc_heap *heap, unsigned nthreads,
+	palloc_foreach_cb cb, void *arg);
+
 size_t palloc_usable_size(struct palloc_heap *heap, uint64_t off);
 uint64_t palloc_extra(struct palloc_heap *heap, uint64_t off);
 uint16_t palloc_flags(struct palloc_heap *heap, uint64_t off);
@@ -22,6 +22,7 @@
 #include "alloc_class.h"
 #include "set.h"
 #include "mmap.h"
+#include "type_index.h"
 
 enum pmalloc_operation_type {
 	OPERATION_INTERNAL, /* used only for single, one-off operations */
@@ -170,6 +171,173 @@ pfree(PMEMobjpool *pop, uint64_t *off)
 	pmalloc_operation_release(pop);
 }
 
+/*
+ * Allocation classes created from a proposal, stored in the pool so that they
+ * can be recreated each time the pool is opened.
+ */
+struct alloc_class_set {
+	uint64_t nclasses;
+	struct {
+		uint64_t unit_size;
+		uint64_t size_idx;
+	} classes[];
+};
+
+/*
+ * pmalloc_alloc_class_set_get -- (internal) returns the set of allocation
+ *	classes stored in the pool, if any
+ */
+static struct alloc_class_set *
+pmalloc_alloc_class_set_get(PMEMobjpool *pop)
+{
+	uint64_t off = pop->alloc_class_set_offset;
+	if (off == 0)
+		return NULL;
+
+	struct alloc_class_set *set = OBJ_OFF_TO_PTR(pop, off);
+	size_t usable_size = palloc_usable_size(&pop->heap, off);
+
+	if (usable_size < sizeof(*set) || set->nclasses >
+	    (usable_size - sizeof(*set)) / sizeof(set->classes[0])) {
+		LOG(2, "invalid set of allocation classes at 0x%" PRIx64, off);
+		return NULL;
+	}
+
+	return set;
+}
+
+/*
+ * pmalloc_alloc_class_create -- (internal) creates a new allocation class
+ *	with compact headers and its buckets
+ */
+static struct alloc_class *
+pmalloc_alloc_class_create(PMEMobjpool *pop, size_t unit_size,
+	uint32_t size_idx)
+{
+	struct alloc_class_collection *ac = heap_alloc_classes(&pop->heap);
+
+	struct alloc_class *c = alloc_class_new(-1, ac, CLASS_RUN,
+		HEADER_COMPACT, unit_size, 0, size_idx);
+	if (c == NULL)
+		return NULL;
+
+	if (heap_create_alloc_class_buckets(&pop->heap, c) != 0) {
+		alloc_class_delete(ac, c);
+		return NULL;
+	}
+
+	return c;
+}
+
+/*
+ * pmalloc_alloc_class_set_load -- (internal) creates the allocation classes
+ *	stored in the pool
+ *
+ * The classes only improve the fragmentation, so the ones that cannot be
+ * created are skipped and the allocations are served by the other classes.
+ */
+static void
+pmalloc_alloc_class_set_load(PMEMobjpool *pop)
+{
+	struct alloc_class_set *set = pmalloc_alloc_class_set_get(pop);
+	if (set == NULL)
+		return;
+
+	for (uint64_t i = 0; i < set->nclasses; ++i) {
+		uint64_t unit_size = set->classes[i].unit_size;
+		uint64_t size_idx = set->classes[i].size_idx;
+
+		if (unit_size == 0 || unit_size > PMEMOBJ_MAX_ALLOC_SIZE ||
+		    size_idx == 0 || size_idx > UINT16_MAX ||
+		    pmalloc_alloc_class_create(pop, unit_size,
+				(uint32_t)size_idx) == NULL) {
+			LOG(2, "cannot create stored allocation class, "
+				"unit size %" PRIu64, unit_size);
+		}
+	}
+
+	alloc_class_size_map_reset(heap_alloc_classes(&pop->heap));
+}
+
+/* arguments of pmalloc_alloc_class_set_constructor */
+struct alloc_class_set_args {
+	struct alloc_class_set *old;
+	const struct alloc_class_proposal *classes;
+	unsigned nclasses;
+};
+
+/*
+ * pmalloc_alloc_class_set_constructor -- (internal) fills a new set with the
+ *	classes of the old one followed by the new classes
+ */
+static int
+pmalloc_alloc_class_set_constructor(void *base, void *ptr,
+	size_t usable_size, void *arg)
+{
+	PMEMobjpool *pop = base;
+	struct alloc_class_set *set = ptr;
+	struct alloc_class_set_args *args = arg;
+
+	uint64_t n = 0;
+	if (args->old != NULL) {
+		for (; n < args->old->nclasses; ++n)
+			set->classes[n] = args->old->classes[n];
+	}
+
+	for (unsigned i = 0; i < args->nclasses; ++i, ++n) {
+		set->classes[n].unit_size = args->classes[i].unit_size;
+		set->classes[n].size_idx = args->classes[i].size_idx;
+	}
+
+	set->nclasses = n;
+
+	pmemops_persist(&pop->p_ops, set,
+		sizeof(*set) + n * sizeof(set->classes[0]));
+
+	return 0;
+}
+
+/*
+ * pmalloc_alloc_class_set_store -- (internal) atomically replaces the set of
+ *	allocation classes stored in the pool with one that also contains the
+ *	given classes
+ */
+static int
+pmalloc_alloc_class_set_store(PMEMobjpool *pop,
+	const struct alloc_class_proposal *classes, unsigned nclasses)
+{
+	struct alloc_class_set_args args;
+	args.old = pmalloc_alloc_class_set_get(pop);
+	args.classes = classes;
+	args.nclasses = nclasses;
+
+	uint64_t n = nclasses + (args.old ? args.old->nclasses : 0);
+	size_t size = sizeof(struct alloc_class_set) +
+		n * sizeof(args.old->classes[0]);
+
+	struct pobj_action actv[3];
+	size_t actvcnt = 0;
+
+	if (palloc_reserve(&pop->heap, size,
+			pmalloc_alloc_class_set_constructor, &args,
+			0, OBJ_INTERNAL_OBJECT_MASK, 0, 0,
+			&actv[actvcnt]) != 0)
+		return -1;
+
+	uint64_t off = actv[actvcnt++].heap.offset;
+	palloc_set_value(&pop->heap, &actv[actvcnt++],
+		&pop->alloc_class_set_offset, off);
+	if (pop->alloc_class_set_offset != 0)
+		palloc_defer_free(&pop->heap, pop->alloc_class_set_offset,
+			&actv[actvcnt++]);
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+	palloc_publish(&pop->heap, actv, actvcnt, ctx);
+	pmalloc_operation_release(pop);
+
+	return 0;
+}
+
 /*
  * pmalloc_boot -- global runtime init routine of allocator section
  */
@@ -189,10 +357,14 @@ pmalloc_boot(PMEMobjpool *pop)
 #endif
 
 	ret = palloc_buckets_init(&pop->heap);
-	if (ret)
+	if (ret) {
 		palloc_heap_cleanup(&pop->heap);
+		return ret;
+	}
 
-	return ret;
+	pmalloc_alloc_class_set_load(pop);
+
+	return 0;
 }
 
 /*
@@ -418,9 +590,121 @@ static const struct ctl_node CTL_NODE(new)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(histogram) -- returns whether the sizes of the default
+ *	allocations are recorded
+ */
+static int
+CTL_READ_HANDLER(histogram)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = alloc_class_histogram_is_enabled(
+		heap_alloc_classes(&pop->heap));
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(histogram) -- starts or stops recording the sizes of the
+ *	default allocations
+ */
+static int
+CTL_WRITE_HANDLER(histogram)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	return alloc_class_histogram_enable(heap_alloc_classes(&pop->heap),
+		arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(histogram) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_RUNNABLE_HANDLER(propose) -- proposes allocation classes for the
+ *	recorded allocation sizes and optionally creates them
+ */
+static int
+CTL_RUNNABLE_HANDLER(propose)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct pobj_alloc_class_proposal *p = arg;
+
+	if (source != CTL_QUERY_PROGRAMMATIC) {
+		ERR("proposal can only be obtained programmatically");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct alloc_class_collection *ac = heap_alloc_classes(&pop->heap);
+	struct alloc_class_proposal classes[POBJ_ALLOC_CLASS_PROPOSAL_MAX];
+	struct alloc_class_waste waste;
+
+	int nclasses = alloc_class_propose(ac, classes,
+		POBJ_ALLOC_CLASS_PROPOSAL_MAX, &waste);
+	if (nclasses < 0) {
+		ERR("!cannot propose allocation classes");
+		return -1;
+	}
+
+	p->nclasses = (unsigned)nclasses;
+	p->requested_bytes = waste.requested;
+	p->wasted_bytes = waste.wasted;
+	p->proposed_wasted_bytes = waste.proposed_wasted;
+
+	for (unsigned i = 0; i < p->nclasses; ++i) {
+		struct pobj_alloc_class_desc *d = &p->desc[i];
+		d->unit_size = classes[i].unit_size;
+		d->alignment = 0;
+		d->units_per_block = classes[i].nallocs;
+		d->header_type = POBJ_HEADER_COMPACT;
+		d->class_id = 0;
+	}
+
+	if (!p->apply || p->nclasses == 0)
+		return 0;
+
+	unsigned ncreated = 0;
+	for (; ncreated < p->nclasses; ++ncreated) {
+		struct alloc_class *c = pmalloc_alloc_class_create(pop,
+			classes[ncreated].unit_size,
+			classes[ncreated].size_idx);
+		if (c == NULL)
+			break;
+
+		p->desc[ncreated].class_id = c->id;
+	}
+
+	/* let the default allocations pick the new classes */
+	alloc_class_size_map_reset(ac);
+
+	if (ncreated != 0 &&
+	    pmalloc_alloc_class_set_store(pop, classes, ncreated) != 0) {
+		ERR("!cannot store the allocation classes");
+		return -1;
+	}
+
+	if (ncreated != p->nclasses) {
+		ERR("cannot create a proposed allocation class");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	return 0;
+}
+
 static const struct ctl_node CTL_NODE(alloc_class)[] = {
 	CTL_INDEXED(class_id),
 	CTL_INDEXED(new),
+	CTL_LEAF_RW(histogram),
+	CTL_LEAF_RUNNABLE(propose),
 
 	CTL_NODE_END
 };
@@ -749,9 +1033,79 @@ CTL_RUNNABLE_HANDLER(create)(void *ctx,
 	return 0;
 }
 
+/*
+ * CTL_READ_HANDLER(zones) -- reads the zones bound to the arena
+ */
+static int
+CTL_READ_HANDLER(zones)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct pobj_arena_zones *arg_out = arg;
+	unsigned arena_id;
+
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "arena_id"), 0);
+	arena_id = (unsigned)idx->value;
+
+	unsigned narenas = heap_get_narenas_total(&pop->heap);
+
+	if (arena_id < 1 || arena_id > narenas) {
+		LOG(1, "arena id outside of the allowed range: <1,%u>",
+			narenas);
+		errno = ERANGE;
+		return -1;
+	}
+
+	heap_get_arena_zones(&pop->heap, arena_id, &arg_out->first,
+		&arg_out->count);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(zones) -- binds the arena to a range of zones
+ */
+static int
+CTL_WRITE_HANDLER(zones)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct pobj_arena_zones *arg_in = arg;
+	unsigned arena_id;
+
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "arena_id"), 0);
+	arena_id = (unsigned)idx->value;
+
+	unsigned narenas = heap_get_narenas_total(&pop->heap);
+
+	if (arena_id < 1 || arena_id > narenas) {
+		LOG(1, "arena id outside of the allowed range: <1,%u>",
+			narenas);
+		errno = ERANGE;
+		return -1;
+	}
+
+	return heap_set_arena_zones(&pop->heap, arena_id, arg_in->first,
+		arg_in->count);
+}
+
+static const struct ctl_argument CTL_ARG(zones) = {
+	.dest_size = sizeof(struct pobj_arena_zones),
+	.parsers = {
+		CTL_ARG_PARSER_STRUCT(struct pobj_arena_zones,
+			first, ctl_arg_integer),
+		CTL_ARG_PARSER_STRUCT(struct pobj_arena_zones,
+			count, ctl_arg_integer),
+		CTL_ARG_PARSER_END
+	}
+};
+
 static const struct ctl_node CTL_NODE(arena_id)[] = {
 	CTL_LEAF_RO(size),
 	CTL_LEAF_RW(automatic),
+	CTL_LEAF_RW(zones),
 
 	CTL_NODE_END
 };
@@ -777,12 +1131,57 @@ static const struct ctl_node CTL_NODE(thread)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(enabled) -- returns whether the type index is in use
+ */
+static int
+CTL_READ_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = type_index_is_enabled(pop->heap.type_index);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled) -- builds the type index or drops it
+ */
+static int
+CTL_WRITE_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	if (!arg_in) {
+		type_index_disable(pop->heap.type_index);
+		return 0;
+	}
+
+	/* scan the heap with one thread per online processor */
+	return type_index_enable(pop->heap.type_index, &pop->heap, 0);
+}
+
+static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(type_index)[] = {
+	CTL_LEAF_RW(enabled),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(heap)[] = {
 	CTL_CHILD(alloc_class),
 	CTL_CHILD(arena),
 	CTL_CHILD(size),
 	CTL_CHILD(thread),
 	CTL_CHILD(narenas),
+	CTL_CHILD(type_index),
 
 	CTL_NODE_END
 };
@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2016-2019, Intel Corporation */
+/* Copyright 2016-2020, Intel Corporation */
 
 /*
  * recycler.c -- implementation of run recycler
@@ -52,12 +52,9 @@ struct recycler {
 	 * How many unaccounted units there *might* be inside of the memory
 	 * blocks stored in the recycler.
 	 * The value is not meant to be accurate, but rather a rough measure on
-	 * how often should the memory block scores be recalculated.
-	 *
-	 * Per-chunk unaccounted units are shared for all zones, which might
-	 * lead to some unnecessary recalculations.
+	 * how often should the memory block scores be recalculated. The exact
+	 * number of units freed in each of the runs is tracked by the heap.
 	 */
-	size_t unaccounted_units[MAX_CHUNK];
 	size_t unaccounted_total;
 	size_t nallocs;
 	size_t *peak_arenas;
@@ -86,7 +83,6 @@ recycler_new(struct palloc_heap *heap, size_t nallocs, size_t *peak_arenas)
 	r->nallocs = nallocs;
 	r->peak_arenas = peak_arenas;
 	r->unaccounted_total = 0;
-	memset(&r->unaccounted_units, 0, sizeof(r->unaccounted_units));
 
 	VEC_INIT(&r->recalc);
 
@@ -139,6 +135,9 @@ recycler_element_new(struct palloc_heap *heap, const struct memory_block *m)
 	};
 	m->m_ops->calc_free(m, &e.free_space, &e.max_free_block);
 
+	/* the scan accounts for all of the units freed so far */
+	heap_run_delta_reset(heap, m);
+
 	util_mutex_unlock(lock);
 
 	return e;
@@ -197,9 +196,39 @@ out:
 	return ret;
 }
 
+/*
+ * recycler_element_update -- (internal) updates the score of a run by the
+ *	units freed in it since the score was calculated
+ *
+ * The freed blocks might have been coalesced with the neighboring free space,
+ * so the resulting largest free block is only a lower bound. Returns -1 if
+ * the freed units are not tracked and the run has to be scanned again.
+ */
+static int
+recycler_element_update(struct recycler *r, const struct memory_block *m,
+	struct recycler_element *e)
+{
+	uint32_t freed_units;
+	uint32_t max_freed;
+	if (heap_run_delta_take(r->heap, m, &freed_units, &max_freed) != 0)
+		return -1;
+
+	e->free_space += freed_units;
+	if (e->free_space == r->nallocs)
+		e->max_free_block = e->free_space;
+	else if (max_freed > e->max_free_block)
+		e->max_free_block = max_freed;
+
+	return 0;
+}
+
 /*
  * recycler_recalc -- recalculates the scores of runs in the recycler to match
  *	the updated persistent state
+ *
+ * The scores are updated incrementally, with the units freed since they were
+ * calculated, unless the recalculation is forced, in which case all of the
+ * runs are scanned again for exact scores.
  */
 struct empty_runs
 recycler_recalc(struct recycler *r, int force)
@@ -238,17 +267,15 @@ recycler_recalc(struct recycler *r, int force)
 		struct recycler_element *ne = ravl_data(n);
 		next = *ne;
 
-		uint64_t chunk_units = r->unaccounted_units[ne->chunk_id];
-		if (!force && chunk_units == 0)
-			continue;
-
 		uint32_t existing_free_space = ne->free_space;
 
 		nm.chunk_id = ne->chunk_id;
 		nm.zone_id = ne->zone_id;
 		memblock_rebuild_state(r->heap, &nm);
 
-		struct recycler_element e = recycler_element_new(r->heap, &nm);
+		struct recycler_element e = *ne;
+		if (force || recycler_element_update(r, &nm, &e) != 0)
+			e = recycler_element_new(r->heap, &nm);
 
 		ASSERT(e.free_space >= existing_free_space);
 		uint64_t free_space_diff = e.free_space - existing_free_space;
@@ -257,14 +284,6 @@ recycler_recalc(struct recycler *r, int force)
 		if (free_space_diff == 0)
 			continue;
 
-		/*
-		 * Decrease the per chunk_id counter by the number of nallocs
-		 * found, increased by the blocks potentially freed in the
-		 * active memory block. Cap the sub value to prevent overflow.
-		 */
-		util_fetch_and_sub64(&r->unaccounted_units[nm.chunk_id],
-			MIN(chunk_units, free_space_diff + r->nallocs));
-
 		ravl_remove(r->runs, n);
 
 		if (e.free_space == r->nallocs) {
@@ -298,6 +317,4 @@ void
 recycler_inc_unaccounted(struct recycler *r, const struct memory_block *m)
 {
 	util_fetch_and_add64(&r->unaccounted_total, m->size_idx);
-	util_fetch_and_add64(&r->unaccounted_units[m->chunk_id],
-		m->size_idx);
 }
@@ -1,13 +1,76 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2017-2019, Intel Corporation */
+/* Copyright 2017-2020, Intel Corporation */
 
 /*
  * stats.c -- implementation of statistics
  */
 
 #include "obj.h"
+#include "os.h"
 #include "stats.h"
 
+/* how many locks held by a single thread are tracked for hold times */
+#define STATS_LOCKS_HELD_MAX 16
+
+/* how many slots are probed for a lock before it is left unaccounted */
+#define STATS_LOCK_PROBES 8
+
+/*
+ * Statistics of a single lock, slots are claimed by the first lock hashed to
+ * them and remain bound to it until the statistics are reset.
+ */
+struct stats_lock_instance {
+	uint64_t lock; /* address of the lock, 0 if the slot is unused */
+	uint64_t type;
+	struct pobj_lock_stats stats;
+};
+
+/*
+ * Locks currently held by the thread, along with the time at which they were
+ * acquired. An entry is valid only as long as the statistics it was recorded
+ * in have not been disabled or reset since, which is told by the epoch.
+ */
+struct stats_lock_held {
+	const void *lock;
+	const struct stats *s;
+	uint64_t epoch;
+	struct stats_lock_instance *inst; /* NULL if the lock is unaccounted */
+	uint64_t since;
+};
+
+static __thread struct stats_lock_held Locks_held[STATS_LOCKS_HELD_MAX];
+static __thread unsigned Nlocks_held;
+
+/* source of the epochs of lock statistics, unique across pools */
+static uint64_t Locks_epoch;
+
+/* how many cache lines flushed since the last fence a thread remembers */
+#define STATS_PERSIST_LINES 64
+
+/* default length above which libpmem uses non-temporal stores */
+#define STATS_MOVNT_THRESHOLD 256
+
+/*
+ * Flush and fence accounting state of a thread. Cache lines flushed since the
+ * last fence are remembered in a small direct-mapped table, a fence forgets
+ * all of them at once by starting a new epoch.
+ */
+struct stats_persist_thread {
+	struct pobj_persist_stats counters; /* all writes of the thread */
+
+	uint64_t epoch;
+	struct {
+		uintptr_t line;
+		uint64_t epoch;
+	} lines[STATS_PERSIST_LINES];
+
+	struct pobj_persist_stats tx_start; /* counters at the tx begin */
+	const struct stats *tx_stats; /* pool of the last finished tx */
+	struct pobj_persist_stats tx_last; /* writes of the last finished tx */
+};
+
+static __thread struct stats_persist_thread Persist_thread;
+
 STATS_CTL_HANDLER(persistent, curr_allocated, heap_curr_allocated);
 
 STATS_CTL_HANDLER(transient, run_allocated, heap_run_allocated);
@@ -96,8 +159,307 @@ static const struct ctl_argument CTL_ARG(enabled) = {
 	}
 };
 
+/*
+ * CTL_READ_HANDLER(enabled, locks) -- returns whether or not lock statistics
+ *	are enabled
+ */
+static int
+CTL_READ_HANDLER(enabled, locks)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = stats_locks_enabled(pop->stats);
+
+	return 0;
+}
+
+/*
+ * stats_locks_restart -- (internal) starts a new epoch of lock statistics,
+ *	locks acquired before are no longer accounted for hold time
+ */
+static void
+stats_locks_restart(struct stats *s)
+{
+	uint64_t epoch = util_fetch_and_add64(&Locks_epoch, 1) + 1;
+	util_atomic_store_explicit64(&s->locks_epoch, epoch,
+		memory_order_release);
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, locks) -- enables or disables lock statistics
+ */
+static int
+CTL_WRITE_HANDLER(enabled, locks)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	/*
+	 * Releases of the locks held while the statistics were disabled were
+	 * not seen, so their hold times cannot be trusted anymore.
+	 */
+	if (arg_in)
+		stats_locks_restart(pop->stats);
+
+	util_atomic_store_explicit32(&pop->stats->locks_enabled, arg_in,
+		memory_order_release);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(locks_enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_RUNNABLE_HANDLER(reset, locks) -- zeroes all lock statistics
+ */
+static int
+CTL_RUNNABLE_HANDLER(reset, locks)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct stats *s = pop->stats;
+
+	stats_locks_restart(s);
+
+	for (int i = 0; i < MAX_STATS_LOCK_SITE; ++i) {
+		struct pobj_lock_stats *ls = &s->locks[i];
+		uint64_t *f = (uint64_t *)ls;
+		for (size_t j = 0; j < sizeof(*ls) / sizeof(*f); ++j)
+			util_atomic_store_explicit64(&f[j], 0,
+				memory_order_relaxed);
+	}
+
+	for (int i = 0; i < POBJ_LOCK_STATS_MAX_LOCKS; ++i) {
+		struct stats_lock_instance *inst = &s->lock_instances[i];
+		uint64_t *f = (uint64_t *)inst;
+		for (size_t j = 0; j < sizeof(*inst) / sizeof(*f); ++j)
+			util_atomic_store_explicit64(&f[j], 0,
+				memory_order_relaxed);
+	}
+
+	return 0;
+}
+
+/*
+ * stats_locks_read -- (internal) reads the lock statistics of a lock site
+ */
+static int
+stats_locks_read(PMEMobjpool *pop, enum stats_lock_site site, void *arg)
+{
+	struct pobj_lock_stats *ls = &pop->stats->locks[site];
+	struct pobj_lock_stats *arg_out = arg;
+
+	uint64_t *src = (uint64_t *)ls;
+	uint64_t *dst = (uint64_t *)arg_out;
+	for (size_t i = 0; i < sizeof(*ls) / sizeof(*src); ++i)
+		util_atomic_load_explicit64(&src[i], &dst[i],
+			memory_order_relaxed);
+
+	return 0;
+}
+
+#define STATS_LOCKS_CTL_HANDLER(name, site)\
+static int CTL_READ_HANDLER(name, locks)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	return stats_locks_read(ctx, (site), arg);\
+}
+
+STATS_LOCKS_CTL_HANDLER(mutex, STATS_LOCK_MUTEX);
+STATS_LOCKS_CTL_HANDLER(rwlock, STATS_LOCK_RWLOCK);
+STATS_LOCKS_CTL_HANDLER(lwlock, STATS_LOCK_LWLOCK);
+STATS_LOCKS_CTL_HANDLER(bucket, STATS_LOCK_BUCKET);
+STATS_LOCKS_CTL_HANDLER(run, STATS_LOCK_RUN);
+
+/*
+ * CTL_READ_HANDLER(stats, lock) -- reads the statistics of a single lock
+ */
+static int
+CTL_READ_HANDLER(stats, lock)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "lock_id"), 0);
+
+	if (idx->value < 0 || idx->value >= POBJ_LOCK_STATS_MAX_LOCKS) {
+		ERR("lock id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	struct stats_lock_instance *inst =
+		&pop->stats->lock_instances[idx->value];
+	struct pobj_lock_instance_stats *arg_out = arg;
+
+	uint64_t lock;
+	uint64_t type;
+	util_atomic_load_explicit64(&inst->lock, &lock, memory_order_acquire);
+	util_atomic_load_explicit64(&inst->type, &type, memory_order_relaxed);
+	arg_out->lock = (const void *)(uintptr_t)lock;
+	arg_out->type = (enum pobj_lock_type)type;
+
+	uint64_t *src = (uint64_t *)&inst->stats;
+	uint64_t *dst = (uint64_t *)&arg_out->stats;
+	for (size_t i = 0; i < sizeof(inst->stats) / sizeof(*src); ++i)
+		util_atomic_load_explicit64(&src[i], &dst[i],
+			memory_order_relaxed);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(lock_id, locks)[] = {
+	CTL_LEAF_RO(stats, lock),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(lock, locks)[] = {
+	CTL_INDEXED(lock_id, locks),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(locks)[] = {
+	{CTL_STR(enabled), CTL_NODE_LEAF,
+		{CTL_READ_HANDLER(enabled, locks),
+		CTL_WRITE_HANDLER(enabled, locks), NULL},
+		&CTL_ARG(locks_enabled), NULL},
+	CTL_LEAF_RUNNABLE(reset, locks),
+	CTL_LEAF_RO(mutex, locks),
+	CTL_LEAF_RO(rwlock, locks),
+	CTL_LEAF_RO(lwlock, locks),
+	CTL_LEAF_RO(bucket, locks),
+	CTL_LEAF_RO(run, locks),
+	CTL_CHILD(lock, locks),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(enabled, persist) -- returns whether or not flush and
+ *	fence accounting is enabled
+ */
+static int
+CTL_READ_HANDLER(enabled, persist)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->stats->persist_enabled;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, persist) -- enables or disables flush and fence
+ *	accounting
+ */
+static int
+CTL_WRITE_HANDLER(enabled, persist)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	pop->stats->persist_enabled = arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(persist_enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_RUNNABLE_HANDLER(reset, persist) -- zeroes the flush and fence counters
+ *	of the pool
+ */
+static int
+CTL_RUNNABLE_HANDLER(reset, persist)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *f = (uint64_t *)pop->stats->persist;
+	for (size_t i = 0; i < sizeof(*pop->stats->persist) / sizeof(*f); ++i)
+		util_atomic_store_explicit64(&f[i], 0, memory_order_relaxed);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(total, persist) -- returns the flush and fence counters
+ *	of all writes to the pool
+ */
+static int
+CTL_READ_HANDLER(total, persist)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *src = (uint64_t *)pop->stats->persist;
+	uint64_t *dst = arg;
+	for (size_t i = 0; i < sizeof(*pop->stats->persist) / sizeof(*src);
+			++i)
+		util_atomic_load_explicit64(&src[i], &dst[i],
+			memory_order_relaxed);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(tx, persist) -- returns the flush and fence counters of the
+ *	last transaction in the pool finished by the calling thread
+ */
+static int
+CTL_READ_HANDLER(tx, persist)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct pobj_persist_stats *arg_out = arg;
+
+	if (Persist_thread.tx_stats == pop->stats)
+		*arg_out = Persist_thread.tx_last;
+	else
+		memset(arg_out, 0, sizeof(*arg_out));
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(persist)[] = {
+	{CTL_STR(enabled), CTL_NODE_LEAF,
+		{CTL_READ_HANDLER(enabled, persist),
+		CTL_WRITE_HANDLER(enabled, persist), NULL},
+		&CTL_ARG(persist_enabled), NULL},
+	CTL_LEAF_RUNNABLE(reset, persist),
+	CTL_LEAF_RO(total, persist),
+	CTL_LEAF_RO(tx, persist),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(stats)[] = {
 	CTL_CHILD(heap),
+	CTL_CHILD(locks),
+	CTL_CHILD(persist),
 	CTL_LEAF_RW(enabled),
 
 	CTL_NODE_END
@@ -122,8 +484,38 @@ stats_new(PMEMobjpool *pop)
 	if (s->transient == NULL)
 		goto error_transient_alloc;
 
+	s->locks_enabled = 0;
+	s->locks_epoch = 0;
+	s->locks = Zalloc(MAX_STATS_LOCK_SITE * sizeof(*s->locks));
+	if (s->locks == NULL)
+		goto error_locks_alloc;
+
+	s->lock_instances = Zalloc(POBJ_LOCK_STATS_MAX_LOCKS *
+		sizeof(*s->lock_instances));
+	if (s->lock_instances == NULL)
+		goto error_lock_instances_alloc;
+
+	s->persist_enabled = 0;
+	s->persist_is_pmem = pop->is_pmem;
+	s->persist_movnt_threshold = STATS_MOVNT_THRESHOLD;
+	char *ptr = os_getenv("PMEM_MOVNT_THRESHOLD");
+	if (ptr) {
+		long long val = atoll(ptr);
+		if (val >= 0)
+			s->persist_movnt_threshold = (size_t)val;
+	}
+	s->persist = Zalloc(sizeof(*s->persist));
+	if (s->persist == NULL)
+		goto error_persist_alloc;
+
 	return s;
 
+error_persist_alloc:
+	Free(s->lock_instances);
+error_lock_instances_alloc:
+	Free(s->locks);
+error_locks_alloc:
+	Free(s->transient);
 error_transient_alloc:
 	Free(s);
 	return NULL;
@@ -137,10 +529,312 @@ stats_delete(PMEMobjpool *pop, struct stats *s)
 {
 	pmemops_persist(&pop->p_ops, s->persistent,
 	sizeof(struct stats_persistent));
+	Free(s->persist);
+	Free(s->lock_instances);
+	Free(s->locks);
 	Free(s->transient);
 	Free(s);
 }
 
+/*
+ * stats_lock_time -- returns the current time in nanoseconds, as used by
+ *	lock statistics
+ */
+uint64_t
+stats_lock_time(void)
+{
+	struct timespec t;
+	os_clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/*
+ * stats_lock_max -- (internal) atomically raises *max to value
+ */
+static void
+stats_lock_max(uint64_t *max, uint64_t value)
+{
+	uint64_t cur;
+	util_atomic_load_explicit64(max, &cur, memory_order_relaxed);
+	while (value > cur && !util_bool_compare_and_swap64(max, cur, value))
+		util_atomic_load_explicit64(max, &cur, memory_order_relaxed);
+}
+
+/*
+ * stats_lock_instance -- (internal) returns the statistics slot of the lock,
+ *	claiming a free one if needed, or NULL if all the probed slots are taken
+ *	by other locks
+ */
+static struct stats_lock_instance *
+stats_lock_instance(struct stats *s, enum stats_lock_site site,
+	const void *lock)
+{
+	uint64_t addr = (uint64_t)(uintptr_t)lock;
+	/* Fibonacci hashing, the top bits are the best mixed */
+	uint64_t hash = addr * 0x9E3779B97F4A7C15ULL;
+
+	for (unsigned i = 0; i < STATS_LOCK_PROBES; ++i) {
+		size_t n = (size_t)((hash >> 32) + i) %
+			POBJ_LOCK_STATS_MAX_LOCKS;
+		struct stats_lock_instance *inst = &s->lock_instances[n];
+
+		uint64_t cur;
+		util_atomic_load_explicit64(&inst->lock, &cur,
+			memory_order_acquire);
+		if (cur == 0) {
+			if (util_bool_compare_and_swap64(&inst->lock, 0,
+					addr)) {
+				util_atomic_store_explicit64(&inst->type,
+					(uint64_t)site, memory_order_relaxed);
+				return inst;
+			}
+			util_atomic_load_explicit64(&inst->lock, &cur,
+				memory_order_acquire);
+		}
+
+		if (cur == addr)
+			return inst;
+	}
+
+	return NULL;
+}
+
+/*
+ * stats_lock_wait -- (internal) records a wait for a lock
+ */
+static void
+stats_lock_wait(struct pobj_lock_stats *ls, uint64_t wait)
+{
+	util_fetch_and_add64(&ls->contended, 1);
+	util_fetch_and_add64(&ls->wait_ns, wait);
+	stats_lock_max(&ls->max_wait_ns, wait);
+
+	unsigned bucket = wait == 0 ? 0 : util_mssb_index64(wait);
+	if (bucket >= POBJ_LOCK_STATS_HIST_SIZE)
+		bucket = POBJ_LOCK_STATS_HIST_SIZE - 1;
+	util_fetch_and_add64(&ls->wait_hist[bucket], 1);
+}
+
+/*
+ * stats_lock_hold -- (internal) records how long a lock was held
+ */
+static void
+stats_lock_hold(struct pobj_lock_stats *ls, uint64_t hold)
+{
+	util_fetch_and_add64(&ls->hold_ns, hold);
+	stats_lock_max(&ls->max_hold_ns, hold);
+}
+
+/*
+ * stats_lock_held_purge -- (internal) forgets the locks the thread acquired
+ *	in an earlier epoch of the statistics, their releases might have not
+ *	been seen
+ */
+static void
+stats_lock_held_purge(const struct stats *s, uint64_t epoch)
+{
+	for (unsigned i = Nlocks_held; i > 0; --i) {
+		struct stats_lock_held *h = &Locks_held[i - 1];
+		if (h->s == s && h->epoch != epoch)
+			*h = Locks_held[--Nlocks_held];
+	}
+}
+
+/*
+ * stats_lock_acquired -- records an acquisition of a lock, wait_start is
+ *	the time at which the thread started waiting for it, or 0 if the lock
+ *	was acquired right away
+ */
+void
+stats_lock_acquired(struct stats *s, enum stats_lock_site site,
+	const void *lock, uint64_t wait_start)
+{
+	struct pobj_lock_stats *ls = &s->locks[site];
+	struct stats_lock_instance *inst = stats_lock_instance(s, site, lock);
+	uint64_t now = stats_lock_time();
+
+	util_fetch_and_add64(&ls->acquired, 1);
+	if (inst)
+		util_fetch_and_add64(&inst->stats.acquired, 1);
+
+	if (wait_start != 0) {
+		uint64_t wait = now - wait_start;
+
+		stats_lock_wait(ls, wait);
+		if (inst)
+			stats_lock_wait(&inst->stats, wait);
+	}
+
+	uint64_t epoch;
+	util_atomic_load_explicit64(&s->locks_epoch, &epoch,
+		memory_order_acquire);
+
+	if (Nlocks_held == STATS_LOCKS_HELD_MAX)
+		stats_lock_held_purge(s, epoch);
+
+	/* locks beyond the tracking limit are not accounted for hold time */
+	if (Nlocks_held < STATS_LOCKS_HELD_MAX) {
+		struct stats_lock_held *h = &Locks_held[Nlocks_held++];
+		h->lock = lock;
+		h->s = s;
+		h->epoch = epoch;
+		h->inst = inst;
+		h->since = now;
+	}
+}
+
+/*
+ * stats_lock_released -- records the release of a lock
+ */
+void
+stats_lock_released(struct stats *s, enum stats_lock_site site,
+	const void *lock)
+{
+	uint64_t epoch;
+	util_atomic_load_explicit64(&s->locks_epoch, &epoch,
+		memory_order_acquire);
+
+	/* most recently acquired locks are usually released first */
+	for (unsigned i = Nlocks_held; i > 0; --i) {
+		struct stats_lock_held *h = &Locks_held[i - 1];
+		if (h->lock != lock || h->s != s)
+			continue;
+
+		if (h->epoch == epoch) {
+			uint64_t hold = stats_lock_time() - h->since;
+			stats_lock_hold(&s->locks[site], hold);
+			if (h->inst)
+				stats_lock_hold(&h->inst->stats, hold);
+		}
+
+		*h = Locks_held[--Nlocks_held];
+		return;
+	}
+}
+
+/*
+ * stats_persist_add -- (internal) adds value to a flush and fence counter of
+ *	the pool and of the calling thread
+ */
+#define stats_persist_add(s, name, value) do {\
+	Persist_thread.counters.name += (value);\
+	util_fetch_and_add64(&(s)->persist->name, (value));\
+} while (0)
+
+/*
+ * stats_persist_flush -- records a flush of the given range
+ */
+void
+stats_persist_flush(struct stats *s, const void *addr, size_t len)
+{
+	if (len == 0)
+		return;
+
+	struct stats_persist_thread *t = &Persist_thread;
+
+	uintptr_t first = (uintptr_t)addr & ~(CACHELINE_SIZE - 1);
+	uintptr_t last = ((uintptr_t)addr + len - 1) & ~(CACHELINE_SIZE - 1);
+	uint64_t nlines = (last - first) / CACHELINE_SIZE + 1;
+
+	/*
+	 * Lines of longer ranges would evict each other from the table anyway,
+	 * only the tail of the range is looked up.
+	 */
+	if (nlines > STATS_PERSIST_LINES)
+		first = last - (STATS_PERSIST_LINES - 1) * CACHELINE_SIZE;
+
+	uint64_t redundant = 0;
+	for (uintptr_t line = first; line <= last; line += CACHELINE_SIZE) {
+		unsigned slot = (unsigned)((line / CACHELINE_SIZE) %
+			STATS_PERSIST_LINES);
+		if (t->lines[slot].line == line &&
+				t->lines[slot].epoch == t->epoch) {
+			redundant++;
+		} else {
+			t->lines[slot].line = line;
+			t->lines[slot].epoch = t->epoch;
+		}
+	}
+
+	stats_persist_add(s, flushed_lines, nlines);
+	if (redundant != 0)
+		stats_persist_add(s, redundant_lines, redundant);
+}
+
+/*
+ * stats_persist_fence -- records a fence
+ */
+void
+stats_persist_fence(struct stats *s)
+{
+	Persist_thread.epoch++;
+
+	stats_persist_add(s, fences, 1);
+}
+
+/*
+ * stats_persist_write -- records a memcpy, memmove or memset of the given
+ *	range, following the choice of instructions made by libpmem
+ */
+void
+stats_persist_write(struct stats *s, const void *dest, size_t len,
+	unsigned flags)
+{
+	if (flags & PMEMOBJ_F_MEM_NOFLUSH) {
+		stats_persist_add(s, temporal_bytes, len);
+		return;
+	}
+
+	int nontemporal;
+	if (!s->persist_is_pmem)
+		nontemporal = 0;
+	else if (flags & (PMEMOBJ_F_MEM_NONTEMPORAL | PMEMOBJ_F_MEM_WC))
+		nontemporal = 1;
+	else if (flags & (PMEMOBJ_F_MEM_TEMPORAL | PMEMOBJ_F_MEM_WB))
+		nontemporal = 0;
+	else
+		nontemporal = len >= s->persist_movnt_threshold;
+
+	if (nontemporal) {
+		stats_persist_add(s, nontemporal_bytes, len);
+	} else {
+		stats_persist_add(s, temporal_bytes, len);
+		stats_persist_flush(s, dest, len);
+	}
+
+	if (!(flags & PMEMOBJ_F_MEM_NODRAIN))
+		stats_persist_fence(s);
+}
+
+/*
+ * stats_persist_tx_begin -- starts accounting writes of an outermost
+ *	transaction of the calling thread
+ */
+void
+stats_persist_tx_begin(struct stats *s)
+{
+	Persist_thread.tx_start = Persist_thread.counters;
+}
+
+/*
+ * stats_persist_tx_end -- finishes accounting writes of an outermost
+ *	transaction of the calling thread
+ */
+void
+stats_persist_tx_end(struct stats *s)
+{
+	struct stats_persist_thread *t = &Persist_thread;
+
+	uint64_t *start = (uint64_t *)&t->tx_start;
+	uint64_t *cur = (uint64_t *)&t->counters;
+	uint64_t *last = (uint64_t *)&t->tx_last;
+	for (size_t i = 0; i < sizeof(t->tx_last) / sizeof(*last); ++i)
+		last[i] = cur[i] - start[i];
+
+	t->tx_stats = s;
+}
+
 /*
  * stats_ctl_register -- registers ctl nodes for statistics
  */
@@ -10,6 +10,8 @@
 
 #include "ctl.h"
 #include "libpmemobj/ctl.h"
+#include "os_thread.h"
+#include "sys_util.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,10 +26,34 @@ struct stats_persistent {
 	uint64_t heap_curr_allocated;
 };
 
+/* groups of locks for which contention statistics are collected */
+enum stats_lock_site {
+	STATS_LOCK_MUTEX = POBJ_LOCK_TYPE_MUTEX,
+	STATS_LOCK_RWLOCK = POBJ_LOCK_TYPE_RWLOCK,
+	STATS_LOCK_LWLOCK = POBJ_LOCK_TYPE_LWLOCK,
+	STATS_LOCK_BUCKET = POBJ_LOCK_TYPE_BUCKET,
+	STATS_LOCK_RUN = POBJ_LOCK_TYPE_RUN,
+
+	MAX_STATS_LOCK_SITE
+};
+
+struct stats_lock_instance;
+
 struct stats {
 	enum pobj_stats_enabled enabled;
 	struct stats_transient *transient;
 	struct stats_persistent *persistent;
+
+	int locks_enabled;
+	uint64_t locks_epoch; /* changed every time the statistics restart */
+	struct pobj_lock_stats *locks; /* MAX_STATS_LOCK_SITE entries */
+	/* POBJ_LOCK_STATS_MAX_LOCKS entries, hashed by the lock address */
+	struct stats_lock_instance *lock_instances;
+
+	int persist_enabled;
+	int persist_is_pmem; /* false if the pool is flushed with msync */
+	size_t persist_movnt_threshold;
+	struct pobj_persist_stats *persist;
 };
 
 #define STATS_INC(stats, type, name, value) do {\
@@ -80,6 +106,78 @@ struct stats {
 		(value), memory_order_release);\
 } while (0)
 
+/*
+ * Lock statistics are disabled by default, in which case the only cost is
+ * this check.
+ */
+#define STATS_LOCKS_ENABLED(stats) unlikely(stats_locks_enabled(stats))
+
+/*
+ * stats_locks_enabled -- returns whether lock statistics are enabled
+ */
+static inline int
+stats_locks_enabled(struct stats *s)
+{
+	int enabled;
+	util_atomic_load_explicit32(&s->locks_enabled, &enabled,
+		memory_order_acquire);
+
+	return enabled;
+}
+
+uint64_t stats_lock_time(void);
+void stats_lock_acquired(struct stats *s, enum stats_lock_site site,
+	const void *lock, uint64_t wait_start);
+void stats_lock_released(struct stats *s, enum stats_lock_site site,
+	const void *lock);
+
+/*
+ * stats_mutex_lock -- util_mutex_lock variant that records lock statistics
+ */
+static inline void
+stats_mutex_lock(struct stats *s, enum stats_lock_site site, os_mutex_t *m)
+{
+	if (!STATS_LOCKS_ENABLED(s)) {
+		util_mutex_lock(m);
+		return;
+	}
+
+	uint64_t wait_start = 0;
+	if (os_mutex_trylock(m) != 0) {
+		wait_start = stats_lock_time();
+		util_mutex_lock(m);
+	}
+
+	stats_lock_acquired(s, site, m, wait_start);
+}
+
+/*
+ * stats_mutex_unlock -- util_mutex_unlock variant that records lock statistics
+ */
+static inline void
+stats_mutex_unlock(struct stats *s, enum stats_lock_site site, os_mutex_t *m)
+{
+	if (STATS_LOCKS_ENABLED(s))
+		stats_lock_released(s, site, m);
+
+	util_mutex_unlock(m);
+}
+
+/*
+ * Flush and fence accounting is disabled by default, in which case the only
+ * cost is this check. Statistics are created once the pool is booted, writes
+ * performed before that are never accounted.
+ */
+#define STATS_PERSIST_ENABLED(stats)\
+	unlikely((stats) != NULL && (stats)->persist_enabled)
+
+void stats_persist_flush(struct stats *s, const void *addr, size_t len);
+void stats_persist_fence(struct stats *s);
+void stats_persist_write(struct stats *s, const void *dest, size_t len,
+	unsigned flags);
+void stats_persist_tx_begin(struct stats *s);
+void stats_persist_tx_end(struct stats *s);
+
 #define STATS_CTL_LEAF(type, name)\
 {CTL_STR(name), CTL_NODE_LEAF,\
 {CTL_READ_HANDLER(type##_##name), NULL, NULL},\
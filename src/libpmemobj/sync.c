@@ -67,6 +67,20 @@ _get_value(uint64_t pop_runid, volatile uint64_t *runid, void *value, void *arg,
 	return initializer;
 }
 
+/*
+ * lock_stats_acquired -- (internal) records the acquisition of a lock if the
+ *	locking function (with result ret) succeeded, passes ret through
+ */
+static inline int
+lock_stats_acquired(PMEMobjpool *pop, enum stats_lock_site site,
+	const void *lock, int ret, uint64_t wait_start)
+{
+	if (ret == 0)
+		stats_lock_acquired(pop->stats, site, lock, wait_start);
+
+	return ret;
+}
+
 /*
  * get_mutex -- (internal) atomically initialize, record and return a mutex
  */
@@ -205,7 +219,17 @@ pmemobj_mutex_lock(PMEMobjpool *pop, PMEMmutex *mutexp)
 
 	ASSERTeq((uintptr_t)mutex % util_alignof(os_mutex_t), 0);
 
-	return os_mutex_lock(mutex);
+	if (!STATS_LOCKS_ENABLED(pop->stats))
+		return os_mutex_lock(mutex);
+
+	int ret = os_mutex_trylock(mutex);
+	if (ret != EBUSY)
+		return lock_stats_acquired(pop, STATS_LOCK_MUTEX, mutexp,
+			ret, 0);
+
+	uint64_t wait_start = stats_lock_time();
+	return lock_stats_acquired(pop, STATS_LOCK_MUTEX, mutexp,
+		os_mutex_lock(mutex), wait_start);
 }
 
 /*
@@ -262,7 +286,17 @@ pmemobj_mutex_timedlock(PMEMobjpool *pop, PMEMmutex *__restrict mutexp,
 
 	ASSERTeq((uintptr_t)mutex % util_alignof(os_mutex_t), 0);
 
-	return os_mutex_timedlock(mutex, abs_timeout);
+	if (!STATS_LOCKS_ENABLED(pop->stats))
+		return os_mutex_timedlock(mutex, abs_timeout);
+
+	int ret = os_mutex_trylock(mutex);
+	if (ret != EBUSY)
+		return lock_stats_acquired(pop, STATS_LOCK_MUTEX, mutexp,
+			ret, 0);
+
+	uint64_t wait_start = stats_lock_time();
+	return lock_stats_acquired(pop, STATS_LOCK_MUTEX, mutexp,
+		os_mutex_timedlock(mutex, abs_timeout), wait_start);
 }
 
 /*
@@ -285,7 +319,11 @@ pmemobj_mutex_trylock(PMEMobjpool *pop, PMEMmutex *mutexp)
 
 	ASSERTeq((uintptr_t)mutex % util_alignof(os_mutex_t), 0);
 
-	return os_mutex_trylock(mutex);
+	int ret = os_mutex_trylock(mutex);
+	if (STATS_LOCKS_ENABLED(pop->stats))
+		lock_stats_acquired(pop, STATS_LOCK_MUTEX, mutexp, ret, 0);
+
+	return ret;
 }
 
 /*
@@ -306,6 +344,9 @@ pmemobj_mutex_unlock(PMEMobjpool *pop, PMEMmutex *mutexp)
 
 	ASSERTeq((uintptr_t)mutex % util_alignof(os_mutex_t), 0);
 
+	if (STATS_LOCKS_ENABLED(pop->stats))
+		stats_lock_released(pop->stats, STATS_LOCK_MUTEX, mutexp);
+
 	return os_mutex_unlock(mutex);
 }
 
@@ -347,7 +388,17 @@ pmemobj_rwlock_rdlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
-	return os_rwlock_rdlock(rwlock);
+	if (!STATS_LOCKS_ENABLED(pop->stats))
+		return os_rwlock_rdlock(rwlock);
+
+	int ret = os_rwlock_tryrdlock(rwlock);
+	if (ret != EBUSY)
+		return lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp,
+			ret, 0);
+
+	uint64_t wait_start = stats_lock_time();
+	return lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp,
+		os_rwlock_rdlock(rwlock), wait_start);
 }
 
 /*
@@ -370,7 +421,17 @@ pmemobj_rwlock_wrlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
-	return os_rwlock_wrlock(rwlock);
+	if (!STATS_LOCKS_ENABLED(pop->stats))
+		return os_rwlock_wrlock(rwlock);
+
+	int ret = os_rwlock_trywrlock(rwlock);
+	if (ret != EBUSY)
+		return lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp,
+			ret, 0);
+
+	uint64_t wait_start = stats_lock_time();
+	return lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp,
+		os_rwlock_wrlock(rwlock), wait_start);
 }
 
 /*
@@ -395,7 +456,17 @@ pmemobj_rwlock_timedrdlock(PMEMobjpool *pop, PMEMrwlock *__restrict rwlockp,
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
-	return os_rwlock_timedrdlock(rwlock, abs_timeout);
+	if (!STATS_LOCKS_ENABLED(pop->stats))
+		return os_rwlock_timedrdlock(rwlock, abs_timeout);
+
+	int ret = os_rwlock_tryrdlock(rwlock);
+	if (ret != EBUSY)
+		return lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp,
+			ret, 0);
+
+	uint64_t wait_start = stats_lock_time();
+	return lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp,
+		os_rwlock_timedrdlock(rwlock, abs_timeout), wait_start);
 }
 
 /*
@@ -420,7 +491,17 @@ pmemobj_rwlock_timedwrlock(PMEMobjpool *pop, PMEMrwlock *__restrict rwlockp,
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
-	return os_rwlock_timedwrlock(rwlock, abs_timeout);
+	if (!STATS_LOCKS_ENABLED(pop->stats))
+		return os_rwlock_timedwrlock(rwlock, abs_timeout);
+
+	int ret = os_rwlock_trywrlock(rwlock);
+	if (ret != EBUSY)
+		return lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp,
+			ret, 0);
+
+	uint64_t wait_start = stats_lock_time();
+	return lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp,
+		os_rwlock_timedwrlock(rwlock, abs_timeout), wait_start);
 }
 
 /*
@@ -443,7 +524,11 @@ pmemobj_rwlock_tryrdlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
-	return os_rwlock_tryrdlock(rwlock);
+	int ret = os_rwlock_tryrdlock(rwlock);
+	if (STATS_LOCKS_ENABLED(pop->stats))
+		lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp, ret, 0);
+
+	return ret;
 }
 
 /*
@@ -466,7 +551,11 @@ pmemobj_rwlock_trywrlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
-	return os_rwlock_trywrlock(rwlock);
+	int ret = os_rwlock_trywrlock(rwlock);
+	if (STATS_LOCKS_ENABLED(pop->stats))
+		lock_stats_acquired(pop, STATS_LOCK_RWLOCK, rwlockp, ret, 0);
+
+	return ret;
 }
 
 /*
@@ -487,6 +576,9 @@ pmemobj_rwlock_unlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 
 	ASSERTeq((uintptr_t)rwlock % util_alignof(os_rwlock_t), 0);
 
+	if (STATS_LOCKS_ENABLED(pop->stats))
+		stats_lock_released(pop->stats, STATS_LOCK_RWLOCK, rwlockp);
+
 	return os_rwlock_unlock(rwlock);
 }
 
@@ -581,7 +673,14 @@ pmemobj_cond_timedwait(PMEMobjpool *pop, PMEMcond *__restrict condp,
 	ASSERTeq((uintptr_t)mutex % util_alignof(os_mutex_t), 0);
 	ASSERTeq((uintptr_t)cond % util_alignof(os_cond_t), 0);
 
-	return os_cond_timedwait(cond, mutex, abs_timeout);
+	if (!STATS_LOCKS_ENABLED(pop->stats))
+		return os_cond_timedwait(cond, mutex, abs_timeout);
+
+	/* the mutex is not held while waiting for the condition */
+	stats_lock_released(pop->stats, STATS_LOCK_MUTEX, mutexp);
+
+	return lock_stats_acquired(pop, STATS_LOCK_MUTEX, mutexp,
+		os_cond_timedwait(cond, mutex, abs_timeout), 0);
 }
 
 /*
@@ -609,7 +708,459 @@ pmemobj_cond_wait(PMEMobjpool *pop, PMEMcond *condp,
 	ASSERTeq((uintptr_t)mutex % util_alignof(os_mutex_t), 0);
 	ASSERTeq((uintptr_t)cond % util_alignof(os_cond_t), 0);
 
-	return os_cond_wait(cond, mutex);
+	if (!STATS_LOCKS_ENABLED(pop->stats))
+		return os_cond_wait(cond, mutex);
+
+	/* the mutex is not held while waiting for the condition */
+	stats_lock_released(pop->stats, STATS_LOCK_MUTEX, mutexp);
+
+	return lock_stats_acquired(pop, STATS_LOCK_MUTEX, mutexp,
+		os_cond_wait(cond, mutex), 0);
+}
+
+/*
+ * Lightweight locks
+ *
+ * A lightweight lock is a single 32-bit futex word, tagged with the generation
+ * of the pool run it was last used in.  A lock with a generation other than
+ * the current one is unlocked, so a lock left locked by a previous run (or a
+ * crash) does not need to be reinitialized.
+ *
+ * The state of a lock consists of the number of readers and two flags.
+ * The mutex only ever uses the writer flag.
+ */
+#define LWLOCK_WRITER (1U << 31)
+#define LWLOCK_WAITERS (1U << 30)	/* there might be sleeping threads */
+#define LWLOCK_READERS (LWLOCK_WAITERS - 1)
+#define LWLOCK_READER 1U
+
+/*
+ * Bounds of adaptive spinning.  Threads spin before going to sleep, for
+ * at most twice the number of spins recently needed to get hold of a lock.
+ */
+#define LWLOCK_SPIN_MIN 10
+#define LWLOCK_SPIN_MAX 1000
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define lwlock_cpu_relax() _mm_pause()
+#elif defined(__aarch64__)
+#define lwlock_cpu_relax() __asm__ volatile("yield" ::: "memory")
+#else
+#define lwlock_cpu_relax() do {} while (0)
+#endif
+
+/*
+ * moving average of the number of spins it took to acquire a busy lock,
+ * shared by all lightweight locks in the process
+ */
+static unsigned Lwlock_spins = LWLOCK_SPIN_MIN;
+
+/*
+ * lwlock_gen -- (internal) returns the lock generation of the current run
+ */
+static inline uint32_t
+lwlock_gen(PMEMobjpool *pop)
+{
+	/* run_id is always even */
+	return (uint32_t)(pop->run_id >> 1);
+}
+
+/*
+ * lwlock_load -- (internal) atomically read a lightweight lock
+ */
+static inline PMEMlwlock_internal
+lwlock_load(PMEMlwlock_internal *lwp)
+{
+	PMEMlwlock_internal cur;
+	util_atomic_load_explicit64(&lwp->raw, &cur.raw, memory_order_acquire);
+
+	return cur;
+}
+
+/*
+ * lwlock_state -- (internal) returns the state of a lightweight lock in the
+ *	current run
+ */
+static inline uint32_t
+lwlock_state(PMEMlwlock_internal cur, uint32_t gen)
+{
+	return cur.lw.gen == gen ? cur.lw.state : 0;
+}
+
+/*
+ * lwlock_cas -- (internal) atomically replace the lock word with the given
+ *	state of the current run
+ */
+static inline int
+lwlock_cas(PMEMlwlock_internal *lwp, PMEMlwlock_internal cur,
+	uint32_t gen, uint32_t state)
+{
+	PMEMlwlock_internal next;
+	next.lw.state = state;
+	next.lw.gen = gen;
+
+	return util_bool_compare_and_swap64(&lwp->raw, cur.raw, next.raw);
+}
+
+/*
+ * lwlock_spin_limit -- (internal) returns the number of spins to do before
+ *	going to sleep
+ */
+static inline unsigned
+lwlock_spin_limit(void)
+{
+	unsigned spins;
+	util_atomic_load_explicit32(&Lwlock_spins, &spins,
+		memory_order_relaxed);
+
+	return MIN(LWLOCK_SPIN_MAX, 2 * spins + LWLOCK_SPIN_MIN);
+}
+
+/*
+ * lwlock_spin_update -- (internal) update the spin estimate with the number
+ *	of spins done by the last contended acquisition
+ */
+static inline void
+lwlock_spin_update(unsigned spins)
+{
+	unsigned cur;
+	util_atomic_load_explicit32(&Lwlock_spins, &cur, memory_order_relaxed);
+	int next = (int)cur + ((int)spins - (int)cur) / 8;
+	util_atomic_store_explicit32(&Lwlock_spins, (unsigned)next,
+		memory_order_relaxed);
+}
+
+/*
+ * lwlock_acquire -- (internal) acquire a lightweight lock
+ *
+ * The lock is available when none of the busy bits are set in its state, it is
+ * then acquired by adding add to the state.  Otherwise the thread spins for a
+ * while and then goes to sleep until the lock is released.
+ */
+static int
+lwlock_acquire(PMEMobjpool *pop, PMEMlwlock_internal *lwp, uint32_t busy,
+	uint32_t add, int trylock, const struct timespec *abstime)
+{
+	VALGRIND_REMOVE_PMEM_MAPPING(lwp, sizeof(*lwp));
+
+	uint32_t gen = lwlock_gen(pop);
+	unsigned limit = trylock ? 0 : lwlock_spin_limit();
+	unsigned spins = 0;
+	uint64_t wait_start = 0;
+	int stats = STATS_LOCKS_ENABLED(pop->stats) != 0;
+
+	/*
+	 * Once a thread has slept, it cannot tell whether it was the only
+	 * waiter, so it has to leave the waiters flag set when taking the lock.
+	 */
+	uint32_t waiters = 0;
+
+	for (;;) {
+		PMEMlwlock_internal cur = lwlock_load(lwp);
+		uint32_t state = lwlock_state(cur, gen);
+
+		if ((state & busy) == 0) {
+			if (add == LWLOCK_READER &&
+			    (state & LWLOCK_READERS) == LWLOCK_READERS)
+				return EAGAIN;
+
+			if (lwlock_cas(lwp, cur, gen, (state + add) | waiters))
+				break;
+
+			continue;
+		}
+
+		if (trylock)
+			return EBUSY;
+
+		if (stats && wait_start == 0)
+			wait_start = stats_lock_time();
+
+		/* there is no point in spinning if others are already asleep */
+		if (spins < limit && (state & LWLOCK_WAITERS) == 0) {
+			spins++;
+			lwlock_cpu_relax();
+			continue;
+		}
+
+		if ((state & LWLOCK_WAITERS) == 0) {
+			if (!lwlock_cas(lwp, cur, gen, state | LWLOCK_WAITERS))
+				continue;
+			state |= LWLOCK_WAITERS;
+		}
+
+		waiters = LWLOCK_WAITERS;
+		int ret = os_futex_wait(&lwp->lw.state, state, abstime);
+		if (ret != 0) {
+			/*
+			 * The wake-up meant for this thread might have been
+			 * consumed by it, pass it on to the next waiter.
+			 */
+			os_futex_wake(&lwp->lw.state, 0);
+			return ret;
+		}
+	}
+
+	if (spins != 0)
+		lwlock_spin_update(spins);
+
+	if (stats)
+		stats_lock_acquired(pop->stats, STATS_LOCK_LWLOCK, lwp,
+			wait_start);
+
+	VALGRIND_ANNOTATE_HAPPENS_AFTER(lwp);
+
+	return 0;
+}
+
+/*
+ * lwlock_release -- (internal) release a lightweight lock held either
+ *	by a writer or by a reader
+ */
+static int
+lwlock_release(PMEMobjpool *pop, PMEMlwlock_internal *lwp, int wake_all)
+{
+	VALGRIND_REMOVE_PMEM_MAPPING(lwp, sizeof(*lwp));
+
+	uint32_t gen = lwlock_gen(pop);
+	PMEMlwlock_internal cur;
+	uint32_t state;
+	uint32_t next;
+
+	if (STATS_LOCKS_ENABLED(pop->stats))
+		stats_lock_released(pop->stats, STATS_LOCK_LWLOCK, lwp);
+
+	VALGRIND_ANNOTATE_HAPPENS_BEFORE(lwp);
+
+	do {
+		cur = lwlock_load(lwp);
+		state = lwlock_state(cur, gen);
+
+		if (state & LWLOCK_WRITER) {
+			next = 0;
+		} else if (state & LWLOCK_READERS) {
+			next = state - LWLOCK_READER;
+			/* the last reader wakes up the waiters */
+			if ((next & LWLOCK_READERS) == 0)
+				next = 0;
+		} else {
+			return EPERM;
+		}
+	} while (!lwlock_cas(lwp, cur, gen, next));
+
+	if ((state & LWLOCK_WAITERS) && next == 0)
+		os_futex_wake(&lwp->lw.state, wake_all);
+
+	return 0;
+}
+
+/*
+ * lwlock_zero -- (internal) zero-initialize a lightweight lock
+ */
+static void
+lwlock_zero(PMEMobjpool *pop, PMEMlwlock_internal *lwp)
+{
+	COMPILE_ERROR_ON(sizeof(PMEMlwmutex) != sizeof(PMEMlwlock_internal));
+	COMPILE_ERROR_ON(sizeof(PMEMlwrwlock) != sizeof(PMEMlwlock_internal));
+
+	ASSERTeq((uintptr_t)lwp % util_alignof(uint64_t), 0);
+
+	lwp->raw = 0;
+	pmemops_persist(&pop->p_ops, &lwp->raw, sizeof(lwp->raw));
+}
+
+/*
+ * pmemobj_lwmutex_zero -- zero-initialize a pmem resident lightweight mutex
+ *
+ * This function is not MT safe.
+ */
+void
+pmemobj_lwmutex_zero(PMEMobjpool *pop, PMEMlwmutex *mutexp)
+{
+	LOG(3, "pop %p mutex %p", pop, mutexp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
+
+	lwlock_zero(pop, (PMEMlwlock_internal *)mutexp);
+}
+
+/*
+ * pmemobj_lwmutex_lock -- lock a pmem resident lightweight mutex
+ */
+int
+pmemobj_lwmutex_lock(PMEMobjpool *pop, PMEMlwmutex *mutexp)
+{
+	LOG(3, "pop %p mutex %p", pop, mutexp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)mutexp,
+		LWLOCK_WRITER, LWLOCK_WRITER, 0, NULL);
+}
+
+/*
+ * pmemobj_lwmutex_timedlock -- lock a pmem resident lightweight mutex
+ */
+int
+pmemobj_lwmutex_timedlock(PMEMobjpool *pop, PMEMlwmutex *__restrict mutexp,
+		const struct timespec *__restrict abs_timeout)
+{
+	LOG(3, "pop %p mutex %p", pop, mutexp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)mutexp,
+		LWLOCK_WRITER, LWLOCK_WRITER, 0, abs_timeout);
+}
+
+/*
+ * pmemobj_lwmutex_trylock -- trylock a pmem resident lightweight mutex
+ */
+int
+pmemobj_lwmutex_trylock(PMEMobjpool *pop, PMEMlwmutex *mutexp)
+{
+	LOG(3, "pop %p mutex %p", pop, mutexp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)mutexp,
+		LWLOCK_WRITER, LWLOCK_WRITER, 1, NULL);
+}
+
+/*
+ * pmemobj_lwmutex_unlock -- unlock a pmem resident lightweight mutex
+ */
+int
+pmemobj_lwmutex_unlock(PMEMobjpool *pop, PMEMlwmutex *mutexp)
+{
+	LOG(3, "pop %p mutex %p", pop, mutexp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(mutexp));
+
+	/* only one waiter can take the mutex, no need to wake up the others */
+	return lwlock_release(pop, (PMEMlwlock_internal *)mutexp, 0);
+}
+
+/*
+ * pmemobj_lwrwlock_zero -- zero-initialize a pmem resident lightweight rwlock
+ *
+ * This function is not MT safe.
+ */
+void
+pmemobj_lwrwlock_zero(PMEMobjpool *pop, PMEMlwrwlock *rwlockp)
+{
+	LOG(3, "pop %p rwlock %p", pop, rwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(rwlockp));
+
+	lwlock_zero(pop, (PMEMlwlock_internal *)rwlockp);
+}
+
+/*
+ * pmemobj_lwrwlock_rdlock -- rdlock a pmem resident lightweight rwlock
+ */
+int
+pmemobj_lwrwlock_rdlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp)
+{
+	LOG(3, "pop %p rwlock %p", pop, rwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(rwlockp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)rwlockp,
+		LWLOCK_WRITER, LWLOCK_READER, 0, NULL);
+}
+
+/*
+ * pmemobj_lwrwlock_wrlock -- wrlock a pmem resident lightweight rwlock
+ */
+int
+pmemobj_lwrwlock_wrlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp)
+{
+	LOG(3, "pop %p rwlock %p", pop, rwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(rwlockp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)rwlockp,
+		LWLOCK_WRITER | LWLOCK_READERS, LWLOCK_WRITER, 0, NULL);
+}
+
+/*
+ * pmemobj_lwrwlock_timedrdlock -- timedrdlock a pmem resident lightweight
+ *	rwlock
+ */
+int
+pmemobj_lwrwlock_timedrdlock(PMEMobjpool *pop,
+			PMEMlwrwlock *__restrict rwlockp,
+			const struct timespec *__restrict abs_timeout)
+{
+	LOG(3, "pop %p rwlock %p timeout sec %ld nsec %ld", pop, rwlockp,
+		abs_timeout->tv_sec, abs_timeout->tv_nsec);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(rwlockp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)rwlockp,
+		LWLOCK_WRITER, LWLOCK_READER, 0, abs_timeout);
+}
+
+/*
+ * pmemobj_lwrwlock_timedwrlock -- timedwrlock a pmem resident lightweight
+ *	rwlock
+ */
+int
+pmemobj_lwrwlock_timedwrlock(PMEMobjpool *pop,
+			PMEMlwrwlock *__restrict rwlockp,
+			const struct timespec *__restrict abs_timeout)
+{
+	LOG(3, "pop %p rwlock %p timeout sec %ld nsec %ld", pop, rwlockp,
+		abs_timeout->tv_sec, abs_timeout->tv_nsec);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(rwlockp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)rwlockp,
+		LWLOCK_WRITER | LWLOCK_READERS, LWLOCK_WRITER, 0, abs_timeout);
+}
+
+/*
+ * pmemobj_lwrwlock_tryrdlock -- tryrdlock a pmem resident lightweight rwlock
+ */
+int
+pmemobj_lwrwlock_tryrdlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp)
+{
+	LOG(3, "pop %p rwlock %p", pop, rwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(rwlockp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)rwlockp,
+		LWLOCK_WRITER, LWLOCK_READER, 1, NULL);
+}
+
+/*
+ * pmemobj_lwrwlock_trywrlock -- trywrlock a pmem resident lightweight rwlock
+ */
+int
+pmemobj_lwrwlock_trywrlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp)
+{
+	LOG(3, "pop %p rwlock %p", pop, rwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(rwlockp));
+
+	return lwlock_acquire(pop, (PMEMlwlock_internal *)rwlockp,
+		LWLOCK_WRITER | LWLOCK_READERS, LWLOCK_WRITER, 1, NULL);
+}
+
+/*
+ * pmemobj_lwrwlock_unlock -- unlock a pmem resident lightweight rwlock
+ */
+int
+pmemobj_lwrwlock_unlock(PMEMobjpool *pop, PMEMlwrwlock *rwlockp)
+{
+	LOG(3, "pop %p rwlock %p", pop, rwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(rwlockp));
+
+	/* both readers and writers might be waiting */
+	return lwlock_release(pop, (PMEMlwlock_internal *)rwlockp, 1);
 }
 
 /*
@@ -73,6 +73,21 @@ typedef union padded_pmemcond {
 #define PMEMcond_bsd_cond_p pmemcond.cond_u.bsd_u.bsd_cond_p
 #define PMEMcond_next pmemcond.cond_u.bsd_u.next
 
+/*
+ * internal definition of the lightweight PMEM-locks
+ *
+ * The state is only meaningful if gen matches the generation of the current
+ * pool run, otherwise the lock is considered unlocked.  This way the lock
+ * never needs to be reinitialized after the pool is reopened.
+ */
+typedef union pmemlwlock {
+	uint64_t raw;
+	struct {
+		uint32_t state;	/* futex word */
+		uint32_t gen;	/* pool run the state belongs to */
+	} lw;
+} PMEMlwlock_internal;
+
 /*
  * pmemobj_mutex_lock_nofail -- pmemobj_mutex_lock variant that never
  * fails from caller perspective. If pmemobj_mutex_lock failed, this function
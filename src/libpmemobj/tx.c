@@ -33,6 +33,9 @@ struct tx {
 
 	struct ravl *ranges;
 
+	struct ravl *redo_writes; /* writes buffered until commit */
+	size_t redo_writes_size; /* redo log space needed to apply them */
+
 	VEC(, struct pobj_action) actions;
 	VEC(, struct user_buffer_def) redo_userbufs;
 	size_t redo_userbufs_capacity;
@@ -42,6 +45,11 @@ struct tx {
 
 	int first_snapshot;
 
+	/* statistics of the pool, if its persistent writes are accounted */
+	struct stats *persist_stats;
+
+	int flush_dedup; /* tx.flush.dedup at the time the tx began */
+
 	void *user_data;
 };
 
@@ -84,6 +92,16 @@ struct tx_range_def {
 	uint64_t flags;
 };
 
+/*
+ * Write buffered by pmemobj_tx_write, applied through the redo log on commit.
+ * The buffered writes never overlap nor are adjacent to each other.
+ */
+struct tx_redo_write {
+	uint64_t offset;
+	uint64_t size;
+	char *data;
+};
+
 /*
  * tx_range_def_cmp -- compares two snapshot ranges
  */
@@ -113,6 +131,7 @@ tx_params_new(void)
 		return NULL;
 
 	tx_params->cache_size = TX_DEFAULT_RANGE_CACHE_SIZE;
+	tx_params->flush_dedup = 0;
 
 	return tx_params;
 }
@@ -174,7 +193,7 @@ static int
 tx_action_reserve(struct tx *tx, size_t n)
 {
 	size_t entries_size = (VEC_SIZE(&tx->actions) + n) *
-		sizeof(struct ulog_entry_val);
+		sizeof(struct ulog_entry_val) + tx->redo_writes_size;
 
 	/* take the provided user buffers into account when reserving */
 	entries_size -= MIN(tx->redo_userbufs_capacity, entries_size);
@@ -408,6 +427,58 @@ tx_flush_range(void *data, void *ctx)
 		range->size);
 }
 
+/*
+ * Cache lines of the committed ranges which are yet to be flushed. Ranges are
+ * visited in the order of their offsets, so lines shared by neighbouring
+ * ranges are merged into a single flush.
+ */
+struct tx_flush_lines {
+	PMEMobjpool *pop;
+	uint64_t start; /* offset of the first pending line */
+	uint64_t end; /* offset past the last pending line, 0 if none */
+};
+
+/*
+ * tx_flush_lines_pending -- (internal) flush the pending lines
+ */
+static void
+tx_flush_lines_pending(struct tx_flush_lines *lines)
+{
+	if (lines->end == 0)
+		return;
+
+	PMEMobjpool *pop = lines->pop;
+	pmemops_xflush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, lines->start),
+		lines->end - lines->start, PMEMOBJ_F_RELAXED);
+	lines->end = 0;
+}
+
+/*
+ * tx_flush_range_lines -- (internal) flush the lines of one range which were
+ *	not flushed already as part of the previous range
+ */
+static void
+tx_flush_range_lines(void *data, void *ctx)
+{
+	struct tx_flush_lines *lines = ctx;
+	PMEMobjpool *pop = lines->pop;
+	struct tx_range_def *range = data;
+	if (!(range->flags & POBJ_FLAG_NO_FLUSH)) {
+		uint64_t start = ALIGN_DOWN(range->offset, CACHELINE_SIZE);
+		uint64_t end = ALIGN_UP(range->offset + range->size,
+			CACHELINE_SIZE);
+		if (lines->end != 0 && start <= lines->end) {
+			lines->end = MAX(lines->end, end);
+		} else {
+			tx_flush_lines_pending(lines);
+			lines->start = start;
+			lines->end = end;
+		}
+	}
+	VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, range->offset),
+		range->size);
+}
+
 /*
  * tx_clean_range -- (internal) clean one range
  */
@@ -430,10 +501,98 @@ tx_pre_commit(struct tx *tx)
 	LOG(5, NULL);
 
 	/* Flush all regions and destroy the whole tree. */
-	ravl_delete_cb(tx->ranges, tx_flush_range, tx->pop);
+	if (tx->flush_dedup) {
+		struct tx_flush_lines lines = {tx->pop, 0, 0};
+		ravl_delete_cb(tx->ranges, tx_flush_range_lines, &lines);
+		tx_flush_lines_pending(&lines);
+	} else {
+		ravl_delete_cb(tx->ranges, tx_flush_range, tx->pop);
+	}
 	tx->ranges = NULL;
 }
 
+/*
+ * tx_redo_write_log_size -- (internal) returns the redo log space taken by
+ *	a buffered write of the given size
+ */
+static size_t
+tx_redo_write_log_size(size_t size)
+{
+	return ALIGN_UP(sizeof(struct ulog_entry_buf) + size, CACHELINE_SIZE);
+}
+
+/*
+ * tx_redo_write_free -- (internal) frees the data of a single buffered write
+ */
+static void
+tx_redo_write_free(void *data, void *arg)
+{
+	struct tx_redo_write *w = data;
+	Free(w->data);
+}
+
+/*
+ * tx_redo_writes_delete -- (internal) discards all the buffered writes
+ */
+static void
+tx_redo_writes_delete(struct tx *tx)
+{
+	if (tx->redo_writes == NULL)
+		return;
+
+	ravl_delete_cb(tx->redo_writes, tx_redo_write_free, NULL);
+	tx->redo_writes = NULL;
+	tx->redo_writes_size = 0;
+}
+
+struct tx_redo_writes_log {
+	PMEMobjpool *pop;
+	struct operation_context *ctx;
+	int ret;
+};
+
+/*
+ * tx_redo_write_log -- (internal) adds a single buffered write to the redo log
+ */
+static void
+tx_redo_write_log(void *data, void *arg)
+{
+	struct tx_redo_write *w = data;
+	struct tx_redo_writes_log *log = arg;
+
+	if (log->ret != 0)
+		return;
+
+	log->ret = operation_add_buffer(log->ctx,
+		OBJ_OFF_TO_PTR(log->pop, w->offset), w->data, w->size,
+		ULOG_OPERATION_BUF_CPY);
+}
+
+/*
+ * tx_redo_writes_log -- (internal) adds all the buffered writes to the redo
+ *	log of the transaction, must be done before any other redo log entries
+ *	are created
+ */
+static int
+tx_redo_writes_log(struct tx *tx)
+{
+	if (tx->redo_writes == NULL)
+		return 0;
+
+	struct tx_redo_writes_log log = {tx->pop, tx->lane->external, 0};
+	ravl_foreach(tx->redo_writes, tx_redo_write_log, &log);
+	if (log.ret != 0)
+		return -1;
+
+	/*
+	 * The writes might have been split between the logs, make sure there's
+	 * still enough space for the remaining entries.
+	 */
+	tx->redo_writes_size = operation_get_total_logged(tx->lane->external);
+
+	return tx_action_reserve(tx, 0);
+}
+
 /*
  * tx_abort -- (internal) abort all allocated objects
  */
@@ -450,6 +609,8 @@ tx_abort(PMEMobjpool *pop, struct lane *lane)
 	palloc_cancel(&pop->heap,
 		VEC_ARR(&tx->actions), VEC_SIZE(&tx->actions));
 	tx->ranges = NULL;
+
+	tx_redo_writes_delete(tx);
 }
 
 /*
@@ -462,6 +623,37 @@ tx_get_pop(void)
 	return get_tx()->pop;
 }
 
+/*
+ * tx_flush_deferred -- returns 1 if the range is going to be flushed by the
+ * commit of the current transaction and flushing it earlier is unnecessary.
+ *
+ * That's the case for ranges which are entirely covered by a snapshot: should
+ * the transaction not commit, their previous contents are restored anyway.
+ */
+int
+tx_flush_deferred(PMEMobjpool *pop, const void *addr, size_t len)
+{
+	struct tx *tx = get_tx();
+
+	if (tx->stage != TX_STAGE_WORK || tx->pop != pop || !tx->flush_dedup)
+		return 0;
+
+	if (!OBJ_PTR_FROM_POOL(pop, addr))
+		return 0;
+
+	struct tx_range_def search = {OBJ_PTR_TO_OFF(pop, addr), 0, 0};
+	struct ravl_node *n = ravl_find(tx->ranges, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	if (n == NULL)
+		return 0;
+
+	struct tx_range_def *r = ravl_data(n);
+	if (r->flags & (POBJ_FLAG_NO_FLUSH | POBJ_FLAG_NO_SNAPSHOT))
+		return 0;
+
+	return r->offset + r->size >= search.offset + len;
+}
+
 /*
  * add_to_tx_and_lock -- (internal) add lock to the transaction and acquire it
  */
@@ -738,6 +930,12 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 	} else if (tx->stage == TX_STAGE_NONE) {
 		VALGRIND_START_TX;
 
+		tx->persist_stats = NULL;
+		if (STATS_PERSIST_ENABLED(pop->stats)) {
+			tx->persist_stats = pop->stats;
+			stats_persist_tx_begin(tx->persist_stats);
+		}
+
 		lane_hold(pop, &tx->lane);
 		operation_start(tx->lane->undo);
 
@@ -750,10 +948,15 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 		tx->ranges = ravl_new_sized(tx_range_def_cmp,
 			sizeof(struct tx_range_def));
 
+		tx->redo_writes = NULL;
+		tx->redo_writes_size = 0;
+
 		tx->pop = pop;
 
 		tx->first_snapshot = 1;
 
+		tx->flush_dedup = pop->tx_params->flush_dedup;
+
 		tx->user_data = NULL;
 	} else {
 		FATAL("Invalid stage %d to begin new transaction", tx->stage);
@@ -996,13 +1199,21 @@ pmemobj_tx_commit(void)
 
 		PMEMobjpool *pop = tx->pop;
 
+		operation_start(tx->lane->external);
+
+		if (tx_redo_writes_log(tx) != 0) {
+			operation_cancel(tx->lane->external);
+			ERR("out of memory");
+			obj_tx_abort(ENOMEM, 0);
+			PMEMOBJ_API_END();
+			return;
+		}
+
 		/* pre-commit phase */
 		tx_pre_commit(tx);
 
 		pmemops_drain(&pop->p_ops);
 
-		operation_start(tx->lane->external);
-
 		struct user_buffer_def *userbuf;
 		VEC_FOREACH_BY_PTR(userbuf, &tx->redo_userbufs)
 			operation_add_user_buffer(tx->lane->external, userbuf);
@@ -1010,6 +1221,8 @@ pmemobj_tx_commit(void)
 		palloc_publish(&pop->heap, VEC_ARR(&tx->actions),
 			VEC_SIZE(&tx->actions), tx->lane->external);
 
+		tx_redo_writes_delete(tx);
+
 		tx_post_commit(tx);
 
 		lane_release(pop);
@@ -1063,6 +1276,11 @@ pmemobj_tx_end(void)
 		VEC_DELETE(&tx->actions);
 		VEC_DELETE(&tx->redo_userbufs);
 
+		if (tx->persist_stats) {
+			stats_persist_tx_end(tx->persist_stats);
+			tx->persist_stats = NULL;
+		}
+
 		if (tx->stage_callback) {
 			pmemobj_tx_callback cb = tx->stage_callback;
 			void *arg = tx->stage_callback_arg;
@@ -1538,6 +1756,250 @@ pmemobj_tx_xadd_range(PMEMoid oid, uint64_t hoff, size_t size, uint64_t flags)
 	return ret;
 }
 
+/*
+ * tx_redo_write_cmp -- (internal) compares two buffered writes
+ */
+static int
+tx_redo_write_cmp(const void *lhs, const void *rhs)
+{
+	const struct tx_redo_write *l = lhs;
+	const struct tx_redo_write *r = rhs;
+
+	if (l->offset > r->offset)
+		return 1;
+	else if (l->offset < r->offset)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * tx_redo_write_first -- (internal) returns the first buffered write that
+ *	overlaps with, or is adjacent to, the given range
+ */
+static struct ravl_node *
+tx_redo_write_first(struct tx *tx, uint64_t offset, uint64_t end)
+{
+	struct tx_redo_write search = {offset, 0, NULL};
+	struct ravl_node *n = ravl_find(tx->redo_writes, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	if (n != NULL) {
+		struct tx_redo_write *w = ravl_data(n);
+		if (w->offset + w->size >= offset)
+			return n;
+	}
+
+	n = ravl_find(tx->redo_writes, &search, RAVL_PREDICATE_GREATER);
+	if (n != NULL && ((struct tx_redo_write *)ravl_data(n))->offset > end)
+		return NULL;
+
+	return n;
+}
+
+/*
+ * tx_redo_write_add -- (internal) buffers a write, merging it with all the
+ *	buffered writes it overlaps with or is adjacent to
+ */
+static int
+tx_redo_write_add(struct tx *tx, uint64_t offset, const void *src,
+	size_t size)
+{
+	if (tx->redo_writes == NULL) {
+		tx->redo_writes = ravl_new_sized(tx_redo_write_cmp,
+			sizeof(struct tx_redo_write));
+		if (tx->redo_writes == NULL)
+			return -1;
+	}
+
+	uint64_t end = offset + size;
+	struct ravl_node *first = tx_redo_write_first(tx, offset, end);
+	struct tx_redo_write *w = first ? ravl_data(first) : NULL;
+
+	/* the most common case, the same range written again */
+	if (w != NULL && w->offset <= offset && w->offset + w->size >= end) {
+		memcpy(w->data + (offset - w->offset), src, size);
+		return 0;
+	}
+
+	struct tx_redo_write merged = {MIN(offset, w ? w->offset : offset),
+		0, NULL};
+	uint64_t merged_end = end;
+	size_t log_size = tx->redo_writes_size;
+
+	struct ravl_node *n = first;
+	while (n != NULL) {
+		struct tx_redo_write *m = ravl_data(n);
+		if (m->offset > end)
+			break;
+
+		merged_end = MAX(merged_end, m->offset + m->size);
+		log_size -= tx_redo_write_log_size(m->size);
+		n = ravl_find(tx->redo_writes, m, RAVL_PREDICATE_GREATER);
+	}
+	merged.size = merged_end - merged.offset;
+	log_size += tx_redo_write_log_size(merged.size);
+
+	size_t old_log_size = tx->redo_writes_size;
+	tx->redo_writes_size = log_size;
+	if (tx_action_reserve(tx, 0) != 0) {
+		tx->redo_writes_size = old_log_size;
+		return -1;
+	}
+
+	merged.data = Malloc(merged.size);
+	if (merged.data == NULL) {
+		tx->redo_writes_size = old_log_size;
+		return -1;
+	}
+
+	if (first == NULL) {
+		memcpy(merged.data, src, size);
+		if (ravl_emplace_copy(tx->redo_writes, &merged) != 0) {
+			Free(merged.data);
+			tx->redo_writes_size = old_log_size;
+			return -1;
+		}
+		return 0;
+	}
+
+	/* the first merged write takes over the others, the order is kept */
+	n = ravl_find(tx->redo_writes, w, RAVL_PREDICATE_GREATER);
+	while (n != NULL) {
+		struct tx_redo_write *m = ravl_data(n);
+		if (m->offset > end)
+			break;
+
+		memcpy(merged.data + (m->offset - merged.offset), m->data,
+			m->size);
+		Free(m->data);
+		ravl_remove(tx->redo_writes, n);
+		n = ravl_find(tx->redo_writes, w, RAVL_PREDICATE_GREATER);
+	}
+
+	memcpy(merged.data + (w->offset - merged.offset), w->data, w->size);
+	memcpy(merged.data + (offset - merged.offset), src, size);
+	Free(w->data);
+	*w = merged;
+
+	return 0;
+}
+
+/*
+ * tx_redo_write_check -- (internal) verifies that the range can be buffered
+ */
+static int
+tx_redo_write_check(struct tx *tx, const void *ptr, size_t size)
+{
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("write size too large");
+		return -1;
+	}
+
+	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
+		ERR("object outside of pool");
+		return -1;
+	}
+
+	uint64_t offset = (uint64_t)((char *)ptr - (char *)tx->pop);
+	if (offset < tx->pop->heap_offset || offset + size >
+			tx->pop->heap_offset + tx->pop->heap_size) {
+		ERR("object outside of heap");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_write -- buffers a write to persistent memory until the commit
+ *	of the transaction
+ */
+int
+pmemobj_tx_write(void *dest, const void *src, size_t size)
+{
+	LOG(3, "dest %p src %p size %zu", dest, src, size);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret = 0;
+
+	uint64_t flags = tx_abort_on_failure_flag(tx);
+
+	if (tx_redo_write_check(tx, dest, size) != 0) {
+		ret = obj_tx_fail_err(EINVAL, flags);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	if (size != 0 && tx_redo_write_add(tx,
+			(uint64_t)((char *)dest - (char *)tx->pop),
+			src, size) != 0) {
+		ERR("out of memory");
+		ret = obj_tx_fail_err(ENOMEM, flags);
+	}
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_read -- reads persistent memory, including the writes buffered
+ *	by the transaction
+ */
+int
+pmemobj_tx_read(void *dest, const void *src, size_t size)
+{
+	LOG(3, "dest %p src %p size %zu", dest, src, size);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret = 0;
+
+	uint64_t flags = tx_abort_on_failure_flag(tx);
+
+	if (tx_redo_write_check(tx, src, size) != 0) {
+		ret = obj_tx_fail_err(EINVAL, flags);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	memcpy(dest, src, size);
+
+	if (tx->redo_writes == NULL || size == 0) {
+		PMEMOBJ_API_END();
+		return 0;
+	}
+
+	uint64_t offset = (uint64_t)((char *)src - (char *)tx->pop);
+	uint64_t end = offset + size;
+
+	struct ravl_node *n = tx_redo_write_first(tx, offset, end);
+	while (n != NULL) {
+		struct tx_redo_write *w = ravl_data(n);
+		if (w->offset >= end)
+			break;
+
+		uint64_t start = MAX(w->offset, offset);
+		uint64_t stop = MIN(w->offset + w->size, end);
+		if (start < stop)
+			memcpy((char *)dest + (start - offset),
+				w->data + (start - w->offset), stop - start);
+
+		n = ravl_find(tx->redo_writes, w, RAVL_PREDICATE_GREATER);
+	}
+
+	PMEMOBJ_API_END();
+	return 0;
+}
+
 /*
  * pmemobj_tx_alloc -- allocates a new object
  */
@@ -2357,10 +2819,145 @@ static const struct ctl_node CTL_NODE(post_commit)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(dedup) -- returns whether dirty cache lines are flushed
+ *	once, at commit
+ */
+static int
+CTL_READ_HANDLER(dedup)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->tx_params->flush_dedup;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(dedup) -- enables or disables flushing dirty cache lines
+ *	once, at commit
+ */
+static int
+CTL_WRITE_HANDLER(dedup)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	pop->tx_params->flush_dedup = arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(dedup) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(flush)[] = {
+	CTL_LEAF_RW(dedup),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(retain_size) -- returns the capacity of the log
+ *	extensions each lane may keep between transactions
+ */
+static int
+CTL_READ_HANDLER(retain_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->lanes_desc.log_retention.size;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(retain_size) -- sets the capacity of the log
+ *	extensions each lane may keep between transactions
+ */
+static int
+CTL_WRITE_HANDLER(retain_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(ssize_t *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		ERR("invalid log retain size, must not be negative");
+		return -1;
+	}
+
+	pop->lanes_desc.log_retention.size = (size_t)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(retain_size) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(retain_period) -- returns the number of transactions
+ *	after which the log extensions which were not needed are freed
+ */
+static int
+CTL_READ_HANDLER(retain_period)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = (int)pop->lanes_desc.log_retention.period;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(retain_period) -- sets the number of transactions
+ *	after which the log extensions which were not needed are freed
+ */
+static int
+CTL_WRITE_HANDLER(retain_period)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	if (arg_in <= 0) {
+		errno = EINVAL;
+		ERR("invalid log retain period, must be positive");
+		return -1;
+	}
+
+	pop->lanes_desc.log_retention.period = (unsigned)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(retain_period) = CTL_ARG_INT;
+
+static const struct ctl_node CTL_NODE(log)[] = {
+	CTL_LEAF_RW(retain_size),
+	CTL_LEAF_RW(retain_period),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(tx)[] = {
 	CTL_CHILD(debug),
 	CTL_CHILD(cache),
 	CTL_CHILD(post_commit),
+	CTL_CHILD(flush),
+	CTL_CHILD(log),
 
 	CTL_NODE_END
 };
@@ -34,6 +34,7 @@ extern "C" {
 
 struct tx_parameters {
 	size_t cache_size;
+	int flush_dedup; /* flush every dirty cache line once, at commit */
 };
 
 /*
@@ -42,6 +43,8 @@ struct tx_parameters {
  */
 PMEMobjpool *tx_get_pop(void);
 
+int tx_flush_deferred(PMEMobjpool *pop, const void *addr, size_t len);
+
 void tx_ctl_register(PMEMobjpool *pop);
 
 struct tx_parameters *tx_params_new(void);
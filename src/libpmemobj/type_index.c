@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * type_index.c -- volatile index of the allocated objects by type number
+ *
+ * The index is an ordered set of (type number, offset) pairs, so all the
+ * objects of a given type are adjacent and sorted by their offsets. This
+ * lets pmemobj_first_type and pmemobj_next_type visit only the objects of
+ * the requested type, instead of walking the entire heap and reading the
+ * header of every allocated object.
+ *
+ * The index is disabled by default. Once enabled, it is built by scanning
+ * the heap with multiple threads and then it is kept up to date by the
+ * allocator, which inserts and removes entries after the persistent state
+ * of an object has changed. Internal objects are indexed as well, it is up
+ * to the caller to skip them.
+ */
+
+#include <errno.h>
+
+#include "heap.h"
+#include "memblock.h"
+#include "out.h"
+#include "palloc.h"
+#include "ravl.h"
+#include "sys_util.h"
+#include "type_index.h"
+
+struct type_index_entry {
+	uint64_t type_num;
+	uint64_t off;
+};
+
+struct type_index {
+	os_rwlock_t lock;
+	struct ravl *objects; /* entries sorted by type number and offset */
+
+	/*
+	 * Nonzero if the index is in use. It is read without the lock by the
+	 * allocator to skip the updates when the index is disabled.
+	 */
+	int enabled;
+};
+
+/*
+ * type_index_entry_compare -- (internal) orders the entries by the type
+ *	number first and the offset second
+ */
+static int
+type_index_entry_compare(const void *lhs, const void *rhs)
+{
+	const struct type_index_entry *l = lhs;
+	const struct type_index_entry *r = rhs;
+
+	if (l->type_num != r->type_num)
+		return l->type_num > r->type_num ? 1 : -1;
+
+	if (l->off != r->off)
+		return l->off > r->off ? 1 : -1;
+
+	return 0;
+}
+
+/*
+ * type_index_new -- allocates a new, disabled, type index
+ */
+struct type_index *
+type_index_new(void)
+{
+	struct type_index *idx = Malloc(sizeof(*idx));
+	if (idx == NULL)
+		return NULL;
+
+	idx->objects = ravl_new_sized(type_index_entry_compare,
+		sizeof(struct type_index_entry));
+	if (idx->objects == NULL) {
+		Free(idx);
+		return NULL;
+	}
+
+	util_rwlock_init(&idx->lock);
+	idx->enabled = 0;
+
+	return idx;
+}
+
+/*
+ * type_index_delete -- deletes the type index
+ */
+void
+type_index_delete(struct type_index *idx)
+{
+	ravl_delete(idx->objects);
+	util_rwlock_destroy(&idx->lock);
+	Free(idx);
+}
+
+struct type_index_build {
+	struct palloc_heap *heap;
+	struct ravl *objects;
+	os_mutex_t lock; /* serializes the insertions of the scanning threads */
+	int error;
+};
+
+/*
+ * type_index_build_cb -- (internal) adds a single object to the index
+ *	being built, called concurrently by the threads scanning the heap
+ */
+static int
+type_index_build_cb(const struct memory_block *m, void *arg)
+{
+	struct type_index_build *b = arg;
+
+	struct type_index_entry e;
+	e.type_num = m->m_ops->get_extra(m);
+	e.off = HEAP_PTR_TO_OFF(b->heap, m->m_ops->get_user_data(m));
+
+	util_mutex_lock(&b->lock);
+	int ret = ravl_emplace_copy(b->objects, &e);
+	if (ret != 0)
+		b->error = errno;
+	util_mutex_unlock(&b->lock);
+
+	return ret;
+}
+
+/*
+ * type_index_enable -- builds the index, using up to nthreads threads to
+ *	scan the heap (one per online processor if 0), and keeps it up to
+ *	date from now on
+ *
+ * The index must not be enabled while other threads allocate or free
+ * objects in the same heap.
+ */
+int
+type_index_enable(struct type_index *idx, struct palloc_heap *heap,
+	unsigned nthreads)
+{
+	util_rwlock_wrlock(&idx->lock);
+
+	if (idx->enabled) {
+		util_rwlock_unlock(&idx->lock);
+		return 0;
+	}
+
+	struct type_index_build b;
+	b.heap = heap;
+	b.objects = idx->objects;
+	b.error = 0;
+	util_mutex_init(&b.lock);
+
+	heap_foreach_object_parallel(heap, nthreads, type_index_build_cb, &b);
+
+	util_mutex_destroy(&b.lock);
+
+	if (b.error != 0) {
+		ravl_clear(idx->objects);
+		util_rwlock_unlock(&idx->lock);
+		errno = b.error;
+		ERR("!cannot build the type index");
+		return -1;
+	}
+
+	idx->enabled = 1;
+
+	util_rwlock_unlock(&idx->lock);
+
+	return 0;
+}
+
+/*
+ * type_index_disable -- stops maintaining the index and frees its entries
+ */
+void
+type_index_disable(struct type_index *idx)
+{
+	util_rwlock_wrlock(&idx->lock);
+	idx->enabled = 0;
+	ravl_clear(idx->objects);
+	util_rwlock_unlock(&idx->lock);
+}
+
+/*
+ * type_index_is_enabled -- returns whether the index is in use
+ */
+int
+type_index_is_enabled(struct type_index *idx)
+{
+	util_rwlock_rdlock(&idx->lock);
+	int enabled = idx->enabled;
+	util_rwlock_unlock(&idx->lock);
+
+	return enabled;
+}
+
+/*
+ * type_index_insert -- adds a newly allocated object to the index
+ *
+ * There's no way to report an error to the caller, so if the entry cannot
+ * be allocated the index is dropped and the lookups fall back to walking
+ * the heap.
+ */
+void
+type_index_insert(struct type_index *idx, uint64_t type_num, uint64_t off)
+{
+	if (likely(!idx->enabled))
+		return;
+
+	struct type_index_entry e = {type_num, off};
+
+	util_rwlock_wrlock(&idx->lock);
+	if (idx->enabled && ravl_emplace_copy(idx->objects, &e) != 0 &&
+			errno != EEXIST) {
+		LOG(2, "!type index disabled, cannot insert an entry");
+		idx->enabled = 0;
+		ravl_clear(idx->objects);
+	}
+	util_rwlock_unlock(&idx->lock);
+}
+
+/*
+ * type_index_remove -- removes a freed object from the index
+ */
+void
+type_index_remove(struct type_index *idx, uint64_t type_num, uint64_t off)
+{
+	if (likely(!idx->enabled))
+		return;
+
+	struct type_index_entry e = {type_num, off};
+
+	util_rwlock_wrlock(&idx->lock);
+	struct ravl_node *n = ravl_find(idx->objects, &e,
+		RAVL_PREDICATE_EQUAL);
+	if (n != NULL)
+		ravl_remove(idx->objects, n);
+	util_rwlock_unlock(&idx->lock);
+}
+
+/*
+ * type_index_next -- finds the object of the given type with the lowest
+ *	offset greater than off, the offset is 0 if there's no such object
+ *
+ * Returns -1 if the index is disabled.
+ */
+int
+type_index_next(struct type_index *idx, uint64_t type_num, uint64_t off,
+	uint64_t *next)
+{
+	struct type_index_entry e = {type_num, off};
+
+	util_rwlock_rdlock(&idx->lock);
+	if (!idx->enabled) {
+		util_rwlock_unlock(&idx->lock);
+		return -1;
+	}
+
+	struct ravl_node *n = ravl_find(idx->objects, &e,
+		RAVL_PREDICATE_GREATER);
+	struct type_index_entry *found = n ? ravl_data(n) : NULL;
+
+	*next = found != NULL && found->type_num == type_num ? found->off : 0;
+
+	util_rwlock_unlock(&idx->lock);
+
+	return 0;
+}
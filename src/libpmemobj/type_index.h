@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * type_index.h -- volatile index of the allocated objects by type number
+ */
+
+#ifndef LIBPMEMOBJ_TYPE_INDEX_H
+#define LIBPMEMOBJ_TYPE_INDEX_H 1
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct palloc_heap;
+struct type_index;
+
+struct type_index *type_index_new(void);
+void type_index_delete(struct type_index *idx);
+
+int type_index_enable(struct type_index *idx, struct palloc_heap *heap,
+	unsigned nthreads);
+void type_index_disable(struct type_index *idx);
+int type_index_is_enabled(struct type_index *idx);
+
+void type_index_insert(struct type_index *idx, uint64_t type_num,
+	uint64_t off);
+void type_index_remove(struct type_index *idx, uint64_t type_num,
+	uint64_t off);
+
+int type_index_next(struct type_index *idx, uint64_t type_num, uint64_t off,
+	uint64_t *next);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,13 +5,17 @@
  * ulog.c -- unified log implementation
  */
 
+#include <errno.h>
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "libpmemobj.h"
 #include "pmemops.h"
 #include "ulog.h"
 #include "obj.h"
+#include "os_thread.h"
 #include "out.h"
 #include "util.h"
 #include "valgrind_internal.h"
@@ -29,6 +33,32 @@
 #define IS_CACHELINE_ALIGNED(ptr)\
 	(((uintptr_t)(ptr) & (CACHELINE_SIZE - 1)) == 0)
 
+/* number of cache lines modified by value entries flushed at once */
+#define ULOG_FLUSH_BATCH_LINES 64
+
+/*
+ * Logs with at least ULOG_PROCESS_PARALLEL_MIN bytes of entries are applied
+ * by one thread per ULOG_PROCESS_THREAD_NBYTES bytes, but no more than
+ * ULOG_PROCESS_MAX_THREADS. The modified memory is divided into stripes of
+ * ULOG_PROCESS_STRIPE bytes and each thread applies only the parts of the
+ * entries that fall into its own stripes, in the order of the log.
+ */
+#define ULOG_PROCESS_PARALLEL_MIN (1 << 22) /* 4 megabytes */
+#define ULOG_PROCESS_THREAD_NBYTES (1 << 21) /* 2 megabytes */
+#define ULOG_PROCESS_MAX_THREADS 8
+#define ULOG_PROCESS_STRIPE (1 << 12)
+
+/*
+ * The cache lines modified by value entries are collected and flushed in
+ * batches, so that a line is flushed once even if many entries modify it,
+ * which is common for the bitmaps and headers of the heap.
+ */
+struct ulog_flush_batch {
+	const struct pmem_ops *p_ops;
+	unsigned nlines;
+	uintptr_t lines[ULOG_FLUSH_BATCH_LINES];
+};
+
 /*
  * ulog_by_offset -- calculates the ulog pointer
  */
@@ -465,7 +495,7 @@ ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
 
 	if (rcopy != 0) {
 		void *dest = e->data + ncopy;
-		ASSERT(IS_CACHELINE_ALIGNED(dest));
+		ASSERT(IS_CACHELINE_ALIGNED((char *)dest - (char *)e));
 
 		VALGRIND_ADD_TO_TX(dest, rcopy);
 		pmemops_memcpy(p_ops, dest, srcof, rcopy,
@@ -475,7 +505,7 @@ ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
 
 	if (lcopy != 0) {
 		void *dest = e->data + ncopy + rcopy;
-		ASSERT(IS_CACHELINE_ALIGNED(dest));
+		ASSERT(IS_CACHELINE_ALIGNED((char *)dest - (char *)e));
 
 		VALGRIND_ADD_TO_TX(dest, CACHELINE_SIZE);
 		pmemops_memcpy(p_ops, dest, last_cacheline, CACHELINE_SIZE,
@@ -493,7 +523,11 @@ ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
 	b->checksum = util_checksum_seq(&gen_num, sizeof(gen_num),
 			b->checksum);
 
-	ASSERT(IS_CACHELINE_ALIGNED(e));
+	/*
+	 * The entries of the volatile shadow of a redo log are aligned only
+	 * relative to the beginning of its data.
+	 */
+	ASSERT(IS_CACHELINE_ALIGNED(offset));
 
 	VALGRIND_ADD_TO_TX(e, CACHELINE_SIZE);
 	pmemops_memcpy(p_ops, e, b, CACHELINE_SIZE,
@@ -584,6 +618,127 @@ ulog_entry_apply(const struct ulog_entry_base *e, int persist,
 	VALGRIND_REMOVE_FROM_TX(dst, dst_size);
 }
 
+/*
+ * ulog_line_compare -- (internal) orders the cache lines by their addresses
+ */
+static int
+ulog_line_compare(const void *lhs, const void *rhs)
+{
+	uintptr_t l = *(const uintptr_t *)lhs;
+	uintptr_t r = *(const uintptr_t *)rhs;
+
+	if (l == r)
+		return 0;
+
+	return l > r ? 1 : -1;
+}
+
+/*
+ * ulog_flush_batch_flush -- (internal) flushes every distinct cache line of
+ *	the batch once
+ */
+static void
+ulog_flush_batch_flush(struct ulog_flush_batch *b)
+{
+	qsort(b->lines, b->nlines, sizeof(b->lines[0]), ulog_line_compare);
+
+	for (unsigned i = 0; i < b->nlines; ++i) {
+		if (i != 0 && b->lines[i] == b->lines[i - 1])
+			continue;
+
+		pmemops_xflush(b->p_ops, (void *)b->lines[i], CACHELINE_SIZE,
+			PMEMOBJ_F_RELAXED);
+	}
+
+	b->nlines = 0;
+}
+
+/*
+ * ulog_flush_batch_add -- (internal) adds the cache line of the modified
+ *	value to the batch
+ */
+static void
+ulog_flush_batch_add(struct ulog_flush_batch *b, const void *addr)
+{
+	uintptr_t line = ALIGN_DOWN((uintptr_t)addr, CACHELINE_SIZE);
+
+	if (b->nlines != 0 && b->lines[b->nlines - 1] == line)
+		return;
+
+	if (b->nlines == ULOG_FLUSH_BATCH_LINES)
+		ulog_flush_batch_flush(b);
+
+	b->lines[b->nlines++] = line;
+}
+
+/*
+ * ulog_entry_apply_part -- (internal) applies 'len' bytes of the ulog entry,
+ *	starting 'off' bytes into its destination
+ *
+ * Values are applied as a whole, their cache lines are added to the flush
+ * batch instead of being flushed right away.
+ */
+static void
+ulog_entry_apply_part(const struct ulog_entry_base *e, size_t off,
+	size_t len, struct ulog_flush_batch *b)
+{
+	const struct pmem_ops *p_ops = b->p_ops;
+	ulog_operation_type t = ulog_entry_type(e);
+	uint64_t *dst = (uint64_t *)((uintptr_t)p_ops->base +
+		ulog_entry_offset(e));
+
+	const struct ulog_entry_val *ev = (const struct ulog_entry_val *)e;
+	const struct ulog_entry_buf *eb = (const struct ulog_entry_buf *)e;
+
+	switch (t) {
+		case ULOG_OPERATION_AND:
+		case ULOG_OPERATION_OR:
+		case ULOG_OPERATION_SET:
+			VALGRIND_ADD_TO_TX(dst, sizeof(*dst));
+			if (t == ULOG_OPERATION_AND)
+				*dst &= ev->value;
+			else if (t == ULOG_OPERATION_OR)
+				*dst |= ev->value;
+			else
+				*dst = ev->value;
+			VALGRIND_REMOVE_FROM_TX(dst, sizeof(*dst));
+
+			ulog_flush_batch_add(b, dst);
+		break;
+		case ULOG_OPERATION_BUF_SET:
+			VALGRIND_ADD_TO_TX((char *)dst + off, len);
+			pmemops_memset(p_ops, (char *)dst + off, *eb->data,
+				len, PMEMOBJ_F_RELAXED | PMEMOBJ_F_MEM_NODRAIN);
+			VALGRIND_REMOVE_FROM_TX((char *)dst + off, len);
+		break;
+		case ULOG_OPERATION_BUF_CPY:
+			VALGRIND_ADD_TO_TX((char *)dst + off, len);
+			pmemops_memcpy(p_ops, (char *)dst + off,
+				eb->data + off, len,
+				PMEMOBJ_F_RELAXED | PMEMOBJ_F_MEM_NODRAIN);
+			VALGRIND_REMOVE_FROM_TX((char *)dst + off, len);
+		break;
+		default:
+			ASSERT(0);
+	}
+}
+
+/*
+ * ulog_entry_dest_size -- (internal) returns the number of bytes modified
+ *	by the ulog entry
+ */
+static size_t
+ulog_entry_dest_size(const struct ulog_entry_base *e)
+{
+	switch (ulog_entry_type(e)) {
+		case ULOG_OPERATION_BUF_SET:
+		case ULOG_OPERATION_BUF_CPY:
+			return ((const struct ulog_entry_buf *)e)->size;
+		default:
+			return sizeof(uint64_t);
+	}
+}
+
 /*
  * ulog_process_entry -- (internal) processes a single ulog entry
  */
@@ -591,7 +746,7 @@ static int
 ulog_process_entry(struct ulog_entry_base *e, void *arg,
 	const struct pmem_ops *p_ops)
 {
-	ulog_entry_apply(e, 0, p_ops);
+	ulog_entry_apply_part(e, 0, ulog_entry_dest_size(e), arg);
 
 	return 0;
 }
@@ -684,6 +839,26 @@ out:
 	return ret;
 }
 
+/*
+ * ulog_retain -- returns the last of the ulogs following 'u' that are kept
+ *	for the next operations, 'u' itself if none are
+ *
+ * The ulogs are kept until their total capacity reaches 'nbytes'.
+ */
+struct ulog *
+ulog_retain(struct ulog *u, size_t nbytes, const struct pmem_ops *p_ops)
+{
+	size_t retained = 0;
+	struct ulog *next;
+
+	while (retained < nbytes && (next = ulog_next(u, p_ops)) != NULL) {
+		u = next;
+		retained += u->capacity;
+	}
+
+	return u;
+}
+
 /*
  * ulog_clobber -- zeroes the metadata of the ulog
  */
@@ -709,7 +884,7 @@ ulog_clobber(struct ulog *dest, struct ulog_next *next,
 int
 ulog_clobber_data(struct ulog *ulog_first,
 	size_t nbytes, size_t ulog_base_nbytes,
-	struct ulog_next *next, ulog_free_fn ulog_free,
+	struct ulog_next *next, size_t retain_nbytes, ulog_free_fn ulog_free,
 	ulog_rm_user_buffer_fn user_buff_remove,
 	const struct pmem_ops *p_ops, unsigned flags)
 {
@@ -765,10 +940,33 @@ ulog_clobber_data(struct ulog *ulog_first,
 		 * each transaction is an acceptable overhead for the average
 		 * case.
 		 */
-		if (flags & ULOG_FREE_AFTER_FIRST)
+		if (flags & ULOG_FREE_AFTER_FIRST) {
 			u = ulog_first;
-		else
-			u = ulog_second;
+		} else {
+			/*
+			 * The logs following the second one can be kept as
+			 * well, if asked to. Just like the second ulog, they
+			 * are never read after an ungraceful shutdown.
+			 */
+			u = ulog_retain(ulog_first, retain_nbytes, p_ops);
+			if (u == ulog_first)
+				u = ulog_second;
+
+			/*
+			 * Every kept ulog has to have its generation number
+			 * bumped together with the second one, which is
+			 * already done above. So walk the kept ulogs that
+			 * follow the second one, up to and including 'u'.
+			 * 'u' is NULL only if there is no second ulog, and
+			 * otherwise it is the second ulog or one of its
+			 * successors, so the walk always ends at 'u'.
+			 */
+			for (struct ulog *r = ulog_second; r != u; ) {
+				r = ulog_next(r, p_ops);
+				ASSERTne(r, NULL);
+				ulog_inc_gen_num(r, NULL);
+			}
+		}
 	}
 
 	if (u == NULL)
@@ -791,10 +989,149 @@ ulog_process(struct ulog *ulog, ulog_check_offset_fn check,
 		ulog_check(ulog, check, p_ops);
 #endif
 
-	ulog_foreach_entry(ulog, ulog_process_entry, NULL, p_ops);
+	struct ulog_flush_batch b;
+	b.p_ops = p_ops;
+	b.nlines = 0;
+
+	ulog_foreach_entry(ulog, ulog_process_entry, &b, p_ops);
+	ulog_flush_batch_flush(&b);
+
 	pmemops_drain(p_ops);
 }
 
+struct ulog_process_parallel {
+	const struct pmem_ops *p_ops;
+	VEC(, const struct ulog_entry_base *) entries;
+	unsigned nthreads;
+	unsigned next_thread; /* index of the next thread to start applying */
+};
+
+/*
+ * ulog_process_collect -- (internal) adds a ulog entry to the ones applied
+ *	in parallel
+ */
+static int
+ulog_process_collect(struct ulog_entry_base *e, void *arg,
+	const struct pmem_ops *p_ops)
+{
+	struct ulog_process_parallel *p = arg;
+
+	return VEC_PUSH_BACK(&p->entries, e);
+}
+
+/*
+ * ulog_process_worker -- (internal) applies the parts of all the entries
+ *	that fall into the stripes owned by the thread
+ *
+ * Each thread flushes what it has modified and waits for the flushes to
+ * complete, a fence on a different thread would not order them.
+ */
+static void *
+ulog_process_worker(void *arg)
+{
+	struct ulog_process_parallel *p = arg;
+	unsigned t = util_fetch_and_add32(&p->next_thread, 1);
+
+	struct ulog_flush_batch b;
+	b.p_ops = p->p_ops;
+	b.nlines = 0;
+
+	const struct ulog_entry_base *e;
+	VEC_FOREACH(e, &p->entries) {
+		size_t off = ulog_entry_offset(e);
+		size_t end = off + ulog_entry_dest_size(e);
+
+		for (size_t s = off; s < end; ) {
+			size_t stripe = s / ULOG_PROCESS_STRIPE;
+			size_t next = MIN((stripe + 1) * ULOG_PROCESS_STRIPE,
+				end);
+
+			if (stripe % p->nthreads == t)
+				ulog_entry_apply_part(e, s - off, next - s,
+					&b);
+
+			s = next;
+		}
+	}
+
+	ulog_flush_batch_flush(&b);
+	pmemops_drain(p->p_ops);
+
+	return NULL;
+}
+
+/*
+ * ulog_process_sized -- process ulog entries which occupy 'nbytes' in
+ *	total, large logs are applied by multiple threads
+ *
+ * The result is the same as the one of ulog_process, since every byte is
+ * modified by a single thread, in the order of the log.
+ */
+void
+ulog_process_sized(struct ulog *ulog, size_t nbytes,
+	ulog_check_offset_fn check, const struct pmem_ops *p_ops)
+{
+	unsigned nthreads = (unsigned)MIN(nbytes / ULOG_PROCESS_THREAD_NBYTES,
+		ULOG_PROCESS_MAX_THREADS);
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 0 && (unsigned long)cpus < nthreads)
+		nthreads = (unsigned)cpus;
+
+	if (nbytes < ULOG_PROCESS_PARALLEL_MIN || nthreads < 2 ||
+			On_valgrind) {
+		ulog_process(ulog, check, p_ops);
+		return;
+	}
+
+	LOG(15, "ulog %p nbytes %zu nthreads %u", ulog, nbytes, nthreads);
+
+#ifdef DEBUG
+	if (check)
+		ulog_check(ulog, check, p_ops);
+#endif
+
+	struct ulog_process_parallel p;
+	p.p_ops = p_ops;
+	p.nthreads = nthreads;
+	p.next_thread = 0;
+	VEC_INIT(&p.entries);
+
+	if (ulog_foreach_entry(ulog, ulog_process_collect, &p, p_ops) != 0) {
+		LOG(2, "!cannot apply the log in parallel");
+		VEC_DELETE(&p.entries);
+		ulog_process(ulog, NULL, p_ops);
+		return;
+	}
+
+	os_thread_t threads[ULOG_PROCESS_MAX_THREADS];
+	unsigned nstarted = 0;
+
+	/*
+	 * The stripes are assigned to the threads up front, so all of them
+	 * have to run. If a thread cannot be created, its stripes are applied
+	 * by the calling one.
+	 */
+	for (unsigned i = 0; i < nthreads - 1; ++i) {
+		int ret = os_thread_create(&threads[nstarted], NULL,
+			ulog_process_worker, &p);
+		if (ret != 0) {
+			errno = ret;
+			LOG(2, "!os_thread_create");
+			ulog_process_worker(&p);
+		} else {
+			nstarted++;
+		}
+	}
+
+	ulog_process_worker(&p);
+
+	for (unsigned i = 0; i < nstarted; ++i)
+		os_thread_join(&threads[i], NULL);
+
+	VEC_DELETE(&p.entries);
+}
+
 /*
  * ulog_base_nbytes -- (internal) counts the actual of number of bytes
  *	occupied by the ulog
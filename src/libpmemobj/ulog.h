@@ -88,6 +88,16 @@ typedef uint64_t ulog_operation_type;
 /* informs if there was any buffer allocated by user in the tx  */
 #define ULOG_ANY_USER_BUFFER (1U << 2)
 
+/*
+ * Policy of keeping the extensions attached to a log once an operation is
+ * finished, so that the next operations can reuse them instead of allocating
+ * new ones.
+ */
+struct ulog_retention {
+	size_t size; /* capacity of the extensions that may be kept */
+	unsigned period; /* operations after which unneeded ones are freed */
+};
+
 typedef int (*ulog_check_offset_fn)(void *ctx, uint64_t offset);
 typedef int (*ulog_extend_fn)(void *, uint64_t *, uint64_t);
 typedef int (*ulog_entry_cb)(struct ulog_entry_base *e, void *arg,
@@ -124,9 +134,11 @@ int ulog_free_next(struct ulog *u, const struct pmem_ops *p_ops,
 		uint64_t flags);
 void ulog_clobber(struct ulog *dest, struct ulog_next *next,
 	const struct pmem_ops *p_ops);
+struct ulog *ulog_retain(struct ulog *u, size_t nbytes,
+	const struct pmem_ops *p_ops);
 int ulog_clobber_data(struct ulog *dest,
 	size_t nbytes, size_t ulog_base_nbytes,
-	struct ulog_next *next, ulog_free_fn ulog_free,
+	struct ulog_next *next, size_t retain_nbytes, ulog_free_fn ulog_free,
 	ulog_rm_user_buffer_fn user_buff_remove,
 	const struct pmem_ops *p_ops, unsigned flags);
 void ulog_clobber_entry(const struct ulog_entry_base *e,
@@ -134,6 +146,8 @@ void ulog_clobber_entry(const struct ulog_entry_base *e,
 
 void ulog_process(struct ulog *ulog, ulog_check_offset_fn check,
 	const struct pmem_ops *p_ops);
+void ulog_process_sized(struct ulog *ulog, size_t nbytes,
+	ulog_check_offset_fn check, const struct pmem_ops *p_ops);
 
 size_t ulog_base_nbytes(struct ulog *ulog);
 int ulog_recovery_needed(struct ulog *ulog, int verify_checksum);
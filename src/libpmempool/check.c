@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2016-2018, Intel Corporation */
+/* Copyright 2016-2020, Intel Corporation */
 
 /*
  * check.c -- functions performing checks in proper order
@@ -67,6 +67,11 @@ static const struct step steps[] = {
 		.func		= check_blk,
 		.part		= false,
 	},
+	{
+		.type		= POOL_TYPE_OBJ,
+		.func		= check_obj,
+		.part		= false,
+	},
 	{
 		.type		= POOL_TYPE_BLK | POOL_TYPE_BTT,
 		.func		= check_btt_info,
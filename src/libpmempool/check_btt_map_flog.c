@@ -1,8 +1,13 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2016-2019, Intel Corporation */
+/* Copyright 2016-2020, Intel Corporation */
 
 /*
  * check_btt_map_flog.c -- check BTT Map and Flog
+ *
+ * The Map and Flog of all the arenas are read and analyzed up front, one
+ * arena per worker thread. The results are kept in bitmaps, which are then
+ * reported and used for repairs arena by arena, in the same order as if the
+ * arenas were analyzed one after another.
  */
 
 #include <stdint.h>
@@ -10,6 +15,8 @@
 #include <endian.h>
 
 #include "out.h"
+#include "os_thread.h"
+#include "sys_util.h"
 #include "btt.h"
 #include "libpmempool.h"
 #include "pmempool.h"
@@ -21,6 +28,54 @@ enum questions {
 	Q_REPAIR_FLOG,
 };
 
+/* reasons why an arena could not be analyzed */
+enum arena_error {
+	ARENA_OK,
+	ARENA_ERR_FLOG_READ,
+	ARENA_ERR_MAP_READ,
+	ARENA_ERR_NOMEM,
+};
+
+/* states of flog entries */
+enum flog_state {
+	FLOG_VALID,
+	FLOG_INVALID,
+	FLOG_DUP_FREE,		/* holds the same free block as another entry */
+	FLOG_DUP_MAPPED,	/* both old_map and new_map are used in map */
+};
+
+/*
+ * arena_map_flog -- results of the BTT Map and Flog analysis of an arena
+ */
+struct arena_map_flog {
+	struct arena *arenap;
+	enum arena_error error;
+
+	uint8_t *bitmap;	/* postmap LBAs in use */
+	uint8_t *dup_bitmap;	/* postmap LBAs used more than once */
+	uint8_t *fbitmap;	/* postmap LBAs held by the flog */
+	uint8_t *inval;		/* invalid and duplicated map entries */
+	uint8_t *flog_state;	/* enum flog_state of every flog entry */
+
+	uint32_t ninval;	/* number of invalid map entries */
+	uint32_t nflog_inval;	/* number of invalid flog entries */
+	uint32_t nunmap;	/* number of unmapped blocks */
+
+	/* the entries are repaired from the last one */
+	uint32_t inval_next;
+	uint32_t flog_next;
+	uint32_t unmap_next;
+};
+
+/*
+ * map_flog_ctx -- shared state of the workers analyzing the arenas
+ */
+struct map_flog_ctx {
+	PMEMpoolcheck *ppc;
+	struct arena_map_flog *amf;
+	os_mutex_t read_lock;	/* serializes reads of a BTT device */
+};
+
 /*
  * flog_read -- (internal) read and convert flog from file
  */
@@ -93,335 +148,376 @@ error_malloc:
 }
 
 /*
- * list_item -- item for simple list
+ * map_get_postmap_lba -- extract postmap LBA from map entry
  */
-struct list_item {
-	PMDK_LIST_ENTRY(list_item) next;
-	uint32_t val;
-};
+static inline uint32_t
+map_get_postmap_lba(struct arena *arenap, uint32_t i)
+{
+	uint32_t entry = arenap->map[i];
+
+	/* if map record is in initial state (flags == 0b00) */
+	if (map_entry_is_initial(entry))
+		return i;
+
+	/* read postmap LBA otherwise */
+	return entry & BTT_MAP_ENTRY_LBA_MASK;
+}
 
 /*
- * list -- simple list for storing numbers
+ * arena_map_flog_free -- (internal) free the results of the analysis
+ * of a single arena
  */
-struct list {
-	PMDK_LIST_HEAD(listhead, list_item) head;
-	uint32_t count;
-};
+static void
+arena_map_flog_free(struct arena_map_flog *amf)
+{
+	free(amf->bitmap);
+	free(amf->dup_bitmap);
+	free(amf->fbitmap);
+	free(amf->inval);
+	free(amf->flog_state);
+
+	amf->bitmap = NULL;
+	amf->dup_bitmap = NULL;
+	amf->fbitmap = NULL;
+	amf->inval = NULL;
+	amf->flog_state = NULL;
+}
 
 /*
- * list_alloc -- (internal) allocate an empty list
+ * map_flog_free -- (internal) free the results of the analysis of all arenas
  */
-static struct list *
-list_alloc(void)
+static void
+map_flog_free(PMEMpoolcheck *ppc, location *loc)
 {
-	struct list *list = malloc(sizeof(struct list));
-	if (!list) {
-		ERR("!malloc");
-		return NULL;
-	}
-	PMDK_LIST_INIT(&list->head);
-	list->count = 0;
-	return list;
+	if (!loc->amf)
+		return;
+
+	for (uint32_t i = 0; i < ppc->pool->narenas; i++)
+		arena_map_flog_free(&loc->amf[i]);
+
+	free(loc->amf);
+	loc->amf = NULL;
 }
 
 /*
- * list_push -- (internal) insert new element to the list
+ * map_entry_analyze -- (internal) analyze single map entry
  */
-static struct list_item *
-list_push(struct list *list, uint32_t val)
+static void
+map_entry_analyze(struct arena_map_flog *amf, uint32_t i)
 {
-	struct list_item *item = malloc(sizeof(*item));
-	if (!item) {
-		ERR("!malloc");
-		return NULL;
+	struct arena *arenap = amf->arenap;
+	uint32_t lba = map_get_postmap_lba(arenap, i);
+
+	/* mark duplicated and invalid entries */
+	if (lba < arenap->btt_info.internal_nlba) {
+		if (util_isset(amf->bitmap, lba)) {
+			util_setbit(amf->dup_bitmap, lba);
+			util_setbit(amf->inval, i);
+			amf->ninval++;
+		} else
+			util_setbit(amf->bitmap, lba);
+	} else {
+		util_setbit(amf->inval, i);
+		amf->ninval++;
 	}
-	item->val = val;
-	list->count++;
-	PMDK_LIST_INSERT_HEAD(&list->head, item, next);
-	return item;
 }
 
 /*
- * list_pop -- (internal) pop element from list head
+ * flog_entry_analyze -- (internal) analyze single flog entry
  */
-static int
-list_pop(struct list *list, uint32_t *valp)
+static enum flog_state
+flog_entry_analyze(struct arena_map_flog *amf, uint32_t i)
 {
-	if (!PMDK_LIST_EMPTY(&list->head)) {
-		struct list_item *i = PMDK_LIST_FIRST(&list->head);
-		PMDK_LIST_REMOVE(i, next);
-		if (valp)
-			*valp = i->val;
-		free(i);
+	struct arena *arenap = amf->arenap;
 
-		list->count--;
+	/* flog entry consists of two btt_flog structures */
+	struct btt_flog *flog = (struct btt_flog *)
+		(arenap->flog + i * BTT_FLOG_PAIR_ALIGN);
 
-		return 1;
+	int next;
+	struct btt_flog *flog_cur = btt_flog_get_valid(flog, &next);
+	if (!flog_cur)
+		return FLOG_INVALID;
+
+	uint32_t entry = flog_cur->old_map & BTT_MAP_ENTRY_LBA_MASK;
+	uint32_t new_entry = flog_cur->new_map & BTT_MAP_ENTRY_LBA_MASK;
+
+	/*
+	 * Check if lba is in extranal_nlba range, and check if both old_map and
+	 * new_map are in internal_nlba range.
+	 */
+	if (flog_cur->lba >= arenap->btt_info.external_nlba ||
+			entry >= arenap->btt_info.internal_nlba ||
+			new_entry >= arenap->btt_info.internal_nlba)
+		return FLOG_INVALID;
+
+	if (util_isset(amf->fbitmap, entry)) {
+		/*
+		 * here we have two flog entries which holds the same free block
+		 */
+		return FLOG_DUP_FREE;
+	} else if (util_isset(amf->bitmap, entry)) {
+		/* here we have probably an unfinished write */
+		if (util_isset(amf->bitmap, new_entry)) {
+			/* Both old_map and new_map are already used in map. */
+			util_setbit(amf->dup_bitmap, new_entry);
+			return FLOG_DUP_MAPPED;
+		}
+
+		/*
+		 * Unfinished write. Next time pool is opened, the map
+		 * will be updated to new_map.
+		 */
+		util_setbit(amf->bitmap, new_entry);
+		util_setbit(amf->fbitmap, entry);
+	} else {
+		int flog_valid = 1;
+		/*
+		 * Either flog entry is in its initial state:
+		 * - current_btt_flog entry is first one in pair and
+		 * - current_btt_flog.old_map == current_btt_flog.new_map and
+		 * - current_btt_flog.seq == 0b01 and
+		 * - second flog entry in pair is zeroed
+		 * or
+		 * current_btt_flog.old_map != current_btt_flog.new_map
+		 */
+		if (entry == new_entry)
+			flog_valid = (next == 1) && (flog_cur->seq == 1) &&
+				util_is_zeroed((const void *)&flog[1],
+				sizeof(flog[1]));
+
+		if (!flog_valid)
+			return FLOG_INVALID;
+
+		/* totally fine case */
+		util_setbit(amf->bitmap, entry);
+		util_setbit(amf->fbitmap, entry);
 	}
-	return 0;
+
+	return FLOG_VALID;
 }
 
 /*
- * list_free -- (internal) free the list
+ * arena_analyze -- (internal) read and analyze map and flog of an arena
+ *
+ * Called from the worker threads, so instead of creating check statuses
+ * the problems are only recorded to be reported later.
  */
 static void
-list_free(struct list *list)
+arena_analyze(struct map_flog_ctx *ctx, struct arena_map_flog *amf)
 {
-	while (list_pop(list, NULL))
-		;
-	free(list);
+	PMEMpoolcheck *ppc = ctx->ppc;
+	struct arena *arenap = amf->arenap;
+	struct btt_info *infop = &arenap->btt_info;
+
+	/* a BTT device is read through a single file offset */
+	int lock = ppc->pool->params.type == POOL_TYPE_BTT;
+	if (lock)
+		util_mutex_lock(&ctx->read_lock);
+
+	/* read flog and map entries */
+	if (flog_read(ppc, arenap))
+		amf->error = ARENA_ERR_FLOG_READ;
+	else if (map_read(ppc, arenap))
+		amf->error = ARENA_ERR_MAP_READ;
+
+	if (lock)
+		util_mutex_unlock(&ctx->read_lock);
+
+	if (amf->error)
+		return;
+
+	/* create bitmaps for checking duplicated and unmapped blocks */
+	uint32_t bitmapsize = howmany(infop->internal_nlba, 8);
+	amf->bitmap = calloc(bitmapsize, 1);
+	amf->dup_bitmap = calloc(bitmapsize, 1);
+	amf->fbitmap = calloc(bitmapsize, 1);
+	amf->inval = calloc(howmany(infop->external_nlba, 8), 1);
+	amf->flog_state = calloc(infop->nfree, 1);
+	if (!amf->bitmap || !amf->dup_bitmap || !amf->fbitmap ||
+			!amf->inval || (!amf->flog_state && infop->nfree)) {
+		ERR("!calloc");
+		amf->error = ARENA_ERR_NOMEM;
+		arena_map_flog_free(amf);
+		return;
+	}
+
+	/* check map entries */
+	uint32_t i;
+	for (i = 0; i < infop->external_nlba; i++)
+		map_entry_analyze(amf, i);
+
+	/* check flog entries */
+	for (i = 0; i < infop->nfree; i++) {
+		enum flog_state state = flog_entry_analyze(amf, i);
+		amf->flog_state[i] = (uint8_t)state;
+		if (state != FLOG_VALID)
+			amf->nflog_inval++;
+	}
+
+	/* count unmapped blocks */
+	for (i = 0; i < infop->internal_nlba; i++) {
+		if (!util_isset(amf->bitmap, i))
+			amf->nunmap++;
+	}
+
+	amf->inval_next = infop->external_nlba;
+	amf->flog_next = infop->nfree;
+	amf->unmap_next = infop->internal_nlba;
 }
 
 /*
- * cleanup -- (internal) prepare resources for map and flog check
+ * map_flog_analyze_unit -- (internal) analyze a single arena
  */
 static int
-cleanup(PMEMpoolcheck *ppc, location *loc)
+map_flog_analyze_unit(void *arg, uint64_t unit)
 {
-	LOG(3, NULL);
+	struct map_flog_ctx *ctx = arg;
 
-	if (loc->list_unmap)
-		list_free(loc->list_unmap);
-	if (loc->list_flog_inval)
-		list_free(loc->list_flog_inval);
-	if (loc->list_inval)
-		list_free(loc->list_inval);
-	if (loc->fbitmap)
-		free(loc->fbitmap);
-	if (loc->bitmap)
-		free(loc->bitmap);
-	if (loc->dup_bitmap)
-		free(loc->dup_bitmap);
+	arena_analyze(ctx, &ctx->amf[unit]);
 
 	return 0;
 }
 
 /*
- * init -- (internal) initialize map and flog check
+ * map_flog_analyze -- (internal) analyze map and flog of all arenas
  */
 static int
-init(PMEMpoolcheck *ppc, location *loc)
+map_flog_analyze(PMEMpoolcheck *ppc, location *loc)
 {
 	LOG(3, NULL);
 
-	struct arena *arenap = loc->arenap;
+	uint32_t narenas = ppc->pool->narenas;
+	if (narenas == 0)
+		return 0;
 
-	/* read flog and map entries */
-	if (flog_read(ppc, arenap)) {
-		CHECK_ERR(ppc, "arena %u: cannot read BTT Flog", arenap->id);
-		goto error;
+	loc->amf = calloc(narenas, sizeof(*loc->amf));
+	if (!loc->amf) {
+		ERR("!calloc");
+		return -1;
 	}
 
-	if (map_read(ppc, arenap)) {
-		CHECK_ERR(ppc, "arena %u: cannot read BTT Map", arenap->id);
-		goto error;
+	uint32_t i = 0;
+	struct arena *arenap;
+	PMDK_TAILQ_FOREACH(arenap, &ppc->pool->arenas, next) {
+		ASSERT(i < narenas);
+		loc->amf[i++].arenap = arenap;
 	}
 
-	/* create bitmaps for checking duplicated blocks */
-	uint32_t bitmapsize = howmany(arenap->btt_info.internal_nlba, 8);
-	loc->bitmap = calloc(bitmapsize, 1);
-	if (!loc->bitmap) {
-		ERR("!calloc");
-		CHECK_ERR(ppc, "arena %u: cannot allocate memory for blocks "
-			"bitmap", arenap->id);
-		goto error;
-	}
+	struct map_flog_ctx ctx;
+	ctx.ppc = ppc;
+	ctx.amf = loc->amf;
+	util_mutex_init(&ctx.read_lock);
 
-	loc->dup_bitmap = calloc(bitmapsize, 1);
-	if (!loc->dup_bitmap) {
-		ERR("!calloc");
-		CHECK_ERR(ppc, "arena %u: cannot allocate memory for "
-			"duplicated blocks bitmap", arenap->id);
-		goto error;
-	}
+	int ret = check_parallel(narenas, map_flog_analyze_unit, &ctx);
 
-	loc->fbitmap = calloc(bitmapsize, 1);
-	if (!loc->fbitmap) {
-		ERR("!calloc");
-		CHECK_ERR(ppc, "arena %u: cannot allocate memory for BTT Flog "
-			"bitmap", arenap->id);
-		goto error;
-	}
+	util_mutex_destroy(&ctx.read_lock);
 
-	/* list of invalid map entries */
-	loc->list_inval = list_alloc();
-	if (!loc->list_inval) {
-		CHECK_ERR(ppc,
-			"arena %u: cannot allocate memory for invalid BTT map "
-			"entries list", arenap->id);
-		goto error;
-	}
+	if (ret)
+		map_flog_free(ppc, loc);
 
-	/* list of invalid flog entries */
-	loc->list_flog_inval = list_alloc();
-	if (!loc->list_flog_inval) {
-		CHECK_ERR(ppc,
-			"arena %u: cannot allocate memory for invalid BTT Flog "
-			"entries list", arenap->id);
-		goto error;
-	}
+	return ret;
+}
 
-	/* list of unmapped blocks */
-	loc->list_unmap = list_alloc();
-	if (!loc->list_unmap) {
-		CHECK_ERR(ppc,
-			"arena %u: cannot allocate memory for unmaped blocks "
-			"list", arenap->id);
-		goto error;
+/*
+ * inval_pop -- (internal) take the last invalid map entry
+ */
+static int
+inval_pop(struct arena_map_flog *amf, uint32_t *valp)
+{
+	while (amf->inval_next > 0) {
+		uint32_t i = --amf->inval_next;
+		if (util_isset(amf->inval, i)) {
+			util_clrbit(amf->inval, i);
+			*valp = i;
+			return 1;
+		}
 	}
 
 	return 0;
-
-error:
-	ppc->result = CHECK_RESULT_ERROR;
-	cleanup(ppc, loc);
-	return -1;
 }
 
 /*
- * map_get_postmap_lba -- extract postmap LBA from map entry
+ * flog_inval_pop -- (internal) take the last invalid flog entry
  */
-static inline uint32_t
-map_get_postmap_lba(struct arena *arenap, uint32_t i)
+static int
+flog_inval_pop(struct arena_map_flog *amf, uint32_t *valp)
 {
-	uint32_t entry = arenap->map[i];
-
-	/* if map record is in initial state (flags == 0b00) */
-	if (map_entry_is_initial(entry))
-		return i;
+	while (amf->flog_next > 0) {
+		uint32_t i = --amf->flog_next;
+		if (amf->flog_state[i] != FLOG_VALID) {
+			amf->flog_state[i] = FLOG_VALID;
+			*valp = i;
+			return 1;
+		}
+	}
 
-	/* read postmap LBA otherwise */
-	return entry & BTT_MAP_ENTRY_LBA_MASK;
+	return 0;
 }
 
 /*
- * map_entry_check -- (internal) check single map entry
+ * unmap_pop -- (internal) take the last unmapped block
  */
 static int
-map_entry_check(PMEMpoolcheck *ppc, location *loc, uint32_t i)
+unmap_pop(struct arena_map_flog *amf, uint32_t *valp)
 {
-	struct arena *arenap = loc->arenap;
-	uint32_t lba = map_get_postmap_lba(arenap, i);
-
-	/* add duplicated and invalid entries to list */
-	if (lba < arenap->btt_info.internal_nlba) {
-		if (util_isset(loc->bitmap, lba)) {
-			CHECK_INFO(ppc, "arena %u: BTT Map entry %u duplicated "
-				"at %u", arenap->id, lba, i);
-			util_setbit(loc->dup_bitmap, lba);
-			if (!list_push(loc->list_inval, i))
-				return -1;
-		} else
-			util_setbit(loc->bitmap, lba);
-	} else {
-		CHECK_INFO(ppc, "arena %u: invalid BTT Map entry at %u",
-			arenap->id, i);
-		if (!list_push(loc->list_inval, i))
-			return -1;
+	while (amf->unmap_next > 0) {
+		uint32_t i = --amf->unmap_next;
+		if (!util_isset(amf->bitmap, i)) {
+			util_setbit(amf->bitmap, i);
+			*valp = i;
+			return 1;
+		}
 	}
 
 	return 0;
 }
 
 /*
- * flog_entry_check -- (internal) check single flog entry
+ * cleanup -- (internal) free resources of map and flog check of an arena
  */
 static int
-flog_entry_check(PMEMpoolcheck *ppc, location *loc, uint32_t i,
-	uint8_t **ptr)
+cleanup(PMEMpoolcheck *ppc, location *loc)
 {
-	struct arena *arenap = loc->arenap;
-
-	/* flog entry consists of two btt_flog structures */
-	struct btt_flog *flog = (struct btt_flog *)*ptr;
-
-	int next;
-	struct btt_flog *flog_cur = btt_flog_get_valid(flog, &next);
-
-	/* insert invalid and duplicated indexes to list */
-	if (!flog_cur) {
-		CHECK_INFO(ppc, "arena %u: invalid BTT Flog entry at %u",
-			arenap->id, i);
-		if (!list_push(loc->list_flog_inval, i))
-			return -1;
+	LOG(3, NULL);
 
-		goto next;
-	}
+	arena_map_flog_free(&loc->amf[loc->narena]);
 
-	uint32_t entry = flog_cur->old_map & BTT_MAP_ENTRY_LBA_MASK;
-	uint32_t new_entry = flog_cur->new_map & BTT_MAP_ENTRY_LBA_MASK;
-
-	/*
-	 * Check if lba is in extranal_nlba range, and check if both old_map and
-	 * new_map are in internal_nlba range.
-	 */
-	if (flog_cur->lba >= arenap->btt_info.external_nlba ||
-			entry >= arenap->btt_info.internal_nlba ||
-			new_entry >= arenap->btt_info.internal_nlba) {
-		CHECK_INFO(ppc, "arena %u: invalid BTT Flog entry at %u",
-			arenap->id, i);
-		if (!list_push(loc->list_flog_inval, i))
-			return -1;
+	return 0;
+}
 
-		goto next;
-	}
+/*
+ * init -- (internal) initialize map and flog check of an arena
+ */
+static int
+init(PMEMpoolcheck *ppc, location *loc)
+{
+	LOG(3, NULL);
 
-	if (util_isset(loc->fbitmap, entry)) {
-		/*
-		 * here we have two flog entries which holds the same free block
-		 */
-		CHECK_INFO(ppc, "arena %u: duplicated BTT Flog entry at %u\n",
-			arenap->id, i);
-		if (!list_push(loc->list_flog_inval, i))
-			return -1;
-	} else if (util_isset(loc->bitmap, entry)) {
-		/* here we have probably an unfinished write */
-		if (util_isset(loc->bitmap, new_entry)) {
-			/* Both old_map and new_map are already used in map. */
-			CHECK_INFO(ppc, "arena %u: duplicated BTT Flog entry "
-				"at %u", arenap->id, i);
-			util_setbit(loc->dup_bitmap, new_entry);
-			if (!list_push(loc->list_flog_inval, i))
-				return -1;
-		} else {
-			/*
-			 * Unfinished write. Next time pool is opened, the map
-			 * will be updated to new_map.
-			 */
-			util_setbit(loc->bitmap, new_entry);
-			util_setbit(loc->fbitmap, entry);
-		}
-	} else {
-		int flog_valid = 1;
-		/*
-		 * Either flog entry is in its initial state:
-		 * - current_btt_flog entry is first one in pair and
-		 * - current_btt_flog.old_map == current_btt_flog.new_map and
-		 * - current_btt_flog.seq == 0b01 and
-		 * - second flog entry in pair is zeroed
-		 * or
-		 * current_btt_flog.old_map != current_btt_flog.new_map
-		 */
-		if (entry == new_entry)
-			flog_valid = (next == 1) && (flog_cur->seq == 1) &&
-				util_is_zeroed((const void *)&flog[1],
-				sizeof(flog[1]));
+	struct arena_map_flog *amf = &loc->amf[loc->narena];
+	ASSERTeq(amf->arenap, loc->arenap);
 
-		if (flog_valid) {
-			/* totally fine case */
-			util_setbit(loc->bitmap, entry);
-			util_setbit(loc->fbitmap, entry);
-		} else {
-			CHECK_INFO(ppc, "arena %u: invalid BTT Flog entry at "
-				"%u", arenap->id, i);
-			if (!list_push(loc->list_flog_inval, i))
-				return -1;
-		}
+	switch (amf->error) {
+	case ARENA_OK:
+		return 0;
+	case ARENA_ERR_FLOG_READ:
+		CHECK_ERR(ppc, "arena %u: cannot read BTT Flog",
+			amf->arenap->id);
+		break;
+	case ARENA_ERR_MAP_READ:
+		CHECK_ERR(ppc, "arena %u: cannot read BTT Map",
+			amf->arenap->id);
+		break;
+	case ARENA_ERR_NOMEM:
+	default:
+		CHECK_ERR(ppc, "arena %u: cannot allocate memory for BTT "
+			"Map and Flog check", amf->arenap->id);
+		break;
 	}
 
-next:
-	*ptr += BTT_FLOG_PAIR_ALIGN;
-	return 0;
+	ppc->result = CHECK_RESULT_ERROR;
+	map_flog_free(ppc, loc);
+	return -1;
 }
 
 /*
@@ -432,43 +528,62 @@ arena_map_flog_check(PMEMpoolcheck *ppc, location *loc)
 {
 	LOG(3, NULL);
 
-	struct arena *arenap = loc->arenap;
+	struct arena_map_flog *amf = &loc->amf[loc->narena];
+	struct arena *arenap = amf->arenap;
 
-	/* check map entries */
+	/* report invalid and duplicated map entries */
 	uint32_t i;
 	for (i = 0; i < arenap->btt_info.external_nlba; i++) {
-		if (map_entry_check(ppc, loc, i))
-			goto error_push;
+		if (!util_isset(amf->inval, i))
+			continue;
+
+		uint32_t lba = map_get_postmap_lba(arenap, i);
+		if (lba < arenap->btt_info.internal_nlba)
+			CHECK_INFO(ppc, "arena %u: BTT Map entry %u duplicated "
+				"at %u", arenap->id, lba, i);
+		else
+			CHECK_INFO(ppc, "arena %u: invalid BTT Map entry at %u",
+				arenap->id, i);
 	}
 
-	/* check flog entries */
-	uint8_t *ptr = arenap->flog;
+	/* report invalid and duplicated flog entries */
 	for (i = 0; i < arenap->btt_info.nfree; i++) {
-		if (flog_entry_check(ppc, loc, i, &ptr))
-			goto error_push;
+		switch (amf->flog_state[i]) {
+		case FLOG_INVALID:
+			CHECK_INFO(ppc, "arena %u: invalid BTT Flog entry at "
+				"%u", arenap->id, i);
+			break;
+		case FLOG_DUP_FREE:
+			CHECK_INFO(ppc, "arena %u: duplicated BTT Flog entry "
+				"at %u\n", arenap->id, i);
+			break;
+		case FLOG_DUP_MAPPED:
+			CHECK_INFO(ppc, "arena %u: duplicated BTT Flog entry "
+				"at %u", arenap->id, i);
+			break;
+		default:
+			break;
+		}
 	}
 
-	/* check unmapped blocks and insert to list */
+	/* report unmapped blocks */
 	for (i = 0; i < arenap->btt_info.internal_nlba; i++) {
-		if (!util_isset(loc->bitmap, i)) {
+		if (!util_isset(amf->bitmap, i))
 			CHECK_INFO(ppc, "arena %u: unmapped block %u",
 				arenap->id, i);
-			if (!list_push(loc->list_unmap, i))
-				goto error_push;
-		}
 	}
 
-	if (loc->list_unmap->count)
+	if (amf->nunmap)
 		CHECK_INFO(ppc, "arena %u: number of unmapped blocks: %u",
-			arenap->id, loc->list_unmap->count);
-	if (loc->list_inval->count)
+			arenap->id, amf->nunmap);
+	if (amf->ninval)
 		CHECK_INFO(ppc, "arena %u: number of invalid BTT Map entries: "
-			"%u", arenap->id, loc->list_inval->count);
-	if (loc->list_flog_inval->count)
+			"%u", arenap->id, amf->ninval);
+	if (amf->nflog_inval)
 		CHECK_INFO(ppc, "arena %u: number of invalid BTT Flog entries: "
-			"%u", arenap->id, loc->list_flog_inval->count);
+			"%u", arenap->id, amf->nflog_inval);
 
-	if (CHECK_IS_NOT(ppc, REPAIR) && loc->list_unmap->count > 0) {
+	if (CHECK_IS_NOT(ppc, REPAIR) && amf->nunmap > 0) {
 		ppc->result = CHECK_RESULT_NOT_CONSISTENT;
 		check_end(ppc->data);
 		goto cleanup;
@@ -478,16 +593,15 @@ arena_map_flog_check(PMEMpoolcheck *ppc, location *loc)
 	 * We are able to repair if and only if number of unmapped blocks is
 	 * equal to sum of invalid map and flog entries.
 	 */
-	if (loc->list_unmap->count != (loc->list_inval->count +
-			loc->list_flog_inval->count)) {
+	if (amf->nunmap != amf->ninval + amf->nflog_inval) {
 		ppc->result = CHECK_RESULT_CANNOT_REPAIR;
 		CHECK_ERR(ppc, "arena %u: cannot repair BTT Map and Flog",
 			arenap->id);
 		goto cleanup;
 	}
 
-	if (CHECK_IS_NOT(ppc, ADVANCED) && loc->list_inval->count +
-			loc->list_flog_inval->count > 0) {
+	if (CHECK_IS_NOT(ppc, ADVANCED) && amf->ninval +
+			amf->nflog_inval > 0) {
 		ppc->result = CHECK_RESULT_CANNOT_REPAIR;
 		CHECK_INFO(ppc, REQUIRE_ADVANCED);
 		CHECK_ERR(ppc, "BTT Map and / or BTT Flog contain invalid "
@@ -496,24 +610,20 @@ arena_map_flog_check(PMEMpoolcheck *ppc, location *loc)
 		goto cleanup;
 	}
 
-	if (loc->list_inval->count > 0) {
+	if (amf->ninval > 0) {
 		CHECK_ASK(ppc, Q_REPAIR_MAP, "Do you want to repair invalid "
 			"BTT Map entries?");
 	}
 
-	if (loc->list_flog_inval->count > 0) {
+	if (amf->nflog_inval > 0) {
 		CHECK_ASK(ppc, Q_REPAIR_FLOG, "Do you want to repair invalid "
 			"BTT Flog entries?");
 	}
 
 	return check_questions_sequence_validate(ppc);
 
-error_push:
-	CHECK_ERR(ppc, "arena %u: cannot allocate momory for list item",
-			arenap->id);
-	ppc->result = CHECK_RESULT_ERROR;
 cleanup:
-	cleanup(ppc, loc);
+	map_flog_free(ppc, loc);
 	return -1;
 }
 
@@ -529,7 +639,8 @@ arena_map_flog_fix(PMEMpoolcheck *ppc, location *loc, uint32_t question,
 	ASSERTeq(ctx, NULL);
 	ASSERTne(loc, NULL);
 
-	struct arena *arenap = loc->arenap;
+	struct arena_map_flog *amf = &loc->amf[loc->narena];
+	struct arena *arenap = amf->arenap;
 	uint32_t inval;
 	uint32_t unmap;
 	switch (question) {
@@ -545,11 +656,11 @@ arena_map_flog_fix(PMEMpoolcheck *ppc, location *loc, uint32_t question,
 			if (lba >= arenap->btt_info.internal_nlba)
 				continue;
 
-			if (!util_isset(loc->dup_bitmap, lba))
+			if (!util_isset(amf->dup_bitmap, lba))
 				continue;
 
 			arenap->map[i] = BTT_MAP_ENTRY_ERROR | lba;
-			util_clrbit(loc->dup_bitmap, lba);
+			util_clrbit(amf->dup_bitmap, lba);
 			CHECK_INFO(ppc,
 				"arena %u: storing 0x%x at %u BTT Map entry",
 				arenap->id, arenap->map[i], i);
@@ -559,8 +670,8 @@ arena_map_flog_fix(PMEMpoolcheck *ppc, location *loc, uint32_t question,
 		 * repair invalid or duplicated map entries by using unmapped
 		 * blocks
 		 */
-		while (list_pop(loc->list_inval, &inval)) {
-			if (!list_pop(loc->list_unmap, &unmap)) {
+		while (inval_pop(amf, &inval)) {
+			if (!unmap_pop(amf, &unmap)) {
 				ppc->result = CHECK_RESULT_ERROR;
 				return -1;
 			}
@@ -571,8 +682,8 @@ arena_map_flog_fix(PMEMpoolcheck *ppc, location *loc, uint32_t question,
 		break;
 	case Q_REPAIR_FLOG:
 		/* repair invalid flog entries using unmapped blocks */
-		while (list_pop(loc->list_flog_inval, &inval)) {
-			if (!list_pop(loc->list_unmap, &unmap)) {
+		while (flog_inval_pop(amf, &inval)) {
+			if (!unmap_pop(amf, &unmap)) {
 				ppc->result = CHECK_RESULT_ERROR;
 				return -1;
 			}
@@ -587,7 +698,7 @@ arena_map_flog_fix(PMEMpoolcheck *ppc, location *loc, uint32_t question,
 			flog[0].seq = 1;
 
 			CHECK_INFO(ppc, "arena %u: repairing BTT Flog at %u "
-				"with free block entry 0x%x", loc->arenap->id,
+				"with free block entry 0x%x", arenap->id,
 				inval, entry);
 		}
 		break;
@@ -638,7 +749,7 @@ step_exe(PMEMpoolcheck *ppc, location *loc)
 	if (!check_answer_loop(ppc, loc, NULL, 1, step->fix))
 		return 0;
 
-	cleanup(ppc, loc);
+	map_flog_free(ppc, loc);
 	return -1;
 }
 
@@ -661,6 +772,13 @@ check_btt_map_flog(PMEMpoolcheck *ppc)
 		CHECK_INFO(ppc, "checking BTT Map and Flog");
 		loc->arenap = PMDK_TAILQ_FIRST(&ppc->pool->arenas);
 		loc->narena = 0;
+
+		if (map_flog_analyze(ppc, loc)) {
+			CHECK_ERR(ppc, "cannot check BTT Map and Flog");
+			ppc->result = CHECK_RESULT_ERROR;
+			loc->arenap = NULL;
+			return;
+		}
 	}
 
 	while (loc->arenap != NULL) {
@@ -682,4 +800,6 @@ check_btt_map_flog(PMEMpoolcheck *ppc)
 		loc->narena++;
 		loc->step = 0;
 	}
+
+	map_flog_free(ppc, loc);
 }
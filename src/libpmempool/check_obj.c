@@ -0,0 +1,703 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * check_obj.c -- check pmemobj descriptor, lanes and heap
+ *
+ * The ulogs of the lanes and the chunk headers and run bitmaps of the heap
+ * zones are validated by a number of worker threads, a group of lanes or
+ * a zone at a time. The problems found are reported afterwards, in order.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "out.h"
+#include "libpmempool.h"
+#include "pmempool.h"
+#include "pool.h"
+#include "check_util.h"
+#include "heap_layout.h"
+#include "lane.h"
+#include "obj.h"
+#include "ulog.h"
+
+/* number of lanes validated by a single worker at a time */
+#define LANES_PER_UNIT 64
+
+#define ULOG_OP_MASK ((uint64_t)(0b111ULL << 61ULL))
+#define ULOG_ALIGN(size) ALIGN_UP(size, CACHELINE_SIZE)
+
+/* ulogs of a lane */
+enum lane_log {
+	LANE_LOG_INTERNAL,
+	LANE_LOG_EXTERNAL,
+	LANE_LOG_UNDO,
+
+	MAX_LANE_LOG
+};
+
+static const char *lane_log_str[MAX_LANE_LOG] = {
+	[LANE_LOG_INTERNAL] = "internal redo log",
+	[LANE_LOG_EXTERNAL] = "external redo log",
+	[LANE_LOG_UNDO] = "undo log",
+};
+
+enum ulog_error {
+	ULOG_OK,
+	ULOG_ERR_CAPACITY,
+	ULOG_ERR_NEXT,
+	ULOG_ERR_ENTRY,
+
+	MAX_ULOG_ERR
+};
+
+static const char *ulog_error_str[MAX_ULOG_ERR] = {
+	[ULOG_ERR_CAPACITY] = "invalid capacity",
+	[ULOG_ERR_NEXT] = "invalid extension",
+	[ULOG_ERR_ENTRY] = "invalid entry",
+};
+
+enum zone_error {
+	ZONE_OK,
+	ZONE_ERR_MAGIC,
+	ZONE_ERR_SIZE,
+	ZONE_ERR_CHUNK_TYPE,
+	ZONE_ERR_CHUNK_FLAGS,
+	ZONE_ERR_CHUNK_SIZE,
+	ZONE_ERR_RUN_DATA,
+	ZONE_ERR_RUN_BLOCK_SIZE,
+	ZONE_ERR_RUN_BITMAP,
+
+	MAX_ZONE_ERR
+};
+
+static const char *zone_error_str[MAX_ZONE_ERR] = {
+	[ZONE_ERR_MAGIC] = "invalid zone magic",
+	[ZONE_ERR_SIZE] = "invalid zone size",
+	[ZONE_ERR_CHUNK_TYPE] = "invalid chunk type",
+	[ZONE_ERR_CHUNK_FLAGS] = "invalid chunk flags",
+	[ZONE_ERR_CHUNK_SIZE] = "invalid chunk size",
+	[ZONE_ERR_RUN_DATA] = "invalid run data chunk header",
+	[ZONE_ERR_RUN_BLOCK_SIZE] = "invalid run block size",
+	[ZONE_ERR_RUN_BITMAP] = "invalid run bitmap",
+};
+
+/*
+ * zone_result -- the first problem found in a zone
+ */
+struct zone_result {
+	enum zone_error error;
+	uint32_t chunk_id;
+};
+
+/*
+ * obj_ctx -- shared state of the workers validating the pool
+ */
+struct obj_ctx {
+	char *base;		/* beginning of the pool */
+	uint64_t poolsize;
+	uint64_t heap_offset;
+	uint64_t heap_size;
+	uint64_t nlanes;
+
+	uint8_t (*lanes)[MAX_LANE_LOG];	/* enum ulog_error of every ulog */
+	struct zone_result *zones;
+};
+
+/*
+ * obj_not_consistent -- (internal) report a part of the pool as incorrect
+ */
+static int
+obj_not_consistent(PMEMpoolcheck *ppc, const char *what)
+{
+	if (CHECK_IS_NOT(ppc, REPAIR)) {
+		ppc->result = CHECK_RESULT_NOT_CONSISTENT;
+		check_end(ppc->data);
+		return CHECK_ERR(ppc, "incorrect %s", what);
+	}
+
+	CHECK_INFO(ppc, "incorrect %s", what);
+	ppc->result = CHECK_RESULT_CANNOT_REPAIR;
+	return CHECK_ERR(ppc, "the repair of pmemobj pools is not supported");
+}
+
+/*
+ * obj_ctx_init -- (internal) initialize the context from the descriptor
+ */
+static struct obj_ctx *
+obj_ctx_init(PMEMpoolcheck *ppc, struct obj_ctx *ctx)
+{
+	PMEMobjpool *pop = pool_set_file_map(ppc->pool->set_file, 0);
+	if (pop == NULL)
+		return NULL;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->base = (char *)pop;
+	ctx->poolsize = ppc->pool->set_file->size;
+	ctx->heap_offset = pop->heap_offset;
+	ctx->heap_size = ctx->poolsize - pop->heap_offset;
+	ctx->nlanes = pop->nlanes;
+
+	return ctx;
+}
+
+/*
+ * obj_hdr_check -- (internal) check pmemobj descriptor
+ */
+static int
+obj_hdr_check(PMEMpoolcheck *ppc, location *loc)
+{
+	LOG(3, NULL);
+
+	CHECK_INFO(ppc, "checking pmemobj header");
+
+	PMEMobjpool *pop = pool_set_file_map(ppc->pool->set_file, 0);
+	uint64_t poolsize = ppc->pool->set_file->size;
+	if (pop == NULL || poolsize < sizeof(*pop)) {
+		ppc->result = CHECK_RESULT_ERROR;
+		return CHECK_ERR(ppc, "cannot read pmemobj header");
+	}
+
+	int valid = 1;
+
+	void *dscp = (void *)((uintptr_t)pop + sizeof(struct pool_hdr));
+	if (!util_checksum(dscp, OBJ_DSC_P_SIZE, &pop->checksum, 0, 0)) {
+		CHECK_INFO(ppc, "invalid pmemobj.checksum");
+		valid = 0;
+	}
+
+	if (pop->heap_offset % Pagesize ||
+			pop->heap_offset > poolsize ||
+			poolsize - pop->heap_offset < HEAP_MIN_SIZE) {
+		CHECK_INFO(ppc, "invalid pmemobj.heap_offset: 0x%jx",
+			pop->heap_offset);
+		valid = 0;
+	}
+
+	if (pop->lanes_offset < OBJ_LANES_OFFSET ||
+			pop->lanes_offset > pop->heap_offset) {
+		CHECK_INFO(ppc, "invalid pmemobj.lanes_offset: 0x%jx",
+			pop->lanes_offset);
+		valid = 0;
+	} else if (pop->nlanes == 0 || pop->nlanes >
+			(pop->heap_offset - pop->lanes_offset) /
+			sizeof(struct lane_layout)) {
+		CHECK_INFO(ppc, "invalid pmemobj.nlanes: %ju", pop->nlanes);
+		valid = 0;
+	}
+
+	if (!valid)
+		return obj_not_consistent(ppc, "pmemobj header");
+
+	CHECK_INFO(ppc, "pmemobj header correct");
+
+	return 0;
+}
+
+/*
+ * obj_ulog_entry_valid -- (internal) check whether the entry of a ulog has
+ * been written completely
+ */
+static int
+obj_ulog_entry_valid(struct ulog *ulog, struct ulog_entry_base *e,
+	size_t size)
+{
+	uint64_t op = e->offset & ULOG_OP_MASK;
+	if (op != ULOG_OPERATION_BUF_SET && op != ULOG_OPERATION_BUF_CPY)
+		return 1;
+
+	struct ulog_entry_buf *b = (struct ulog_entry_buf *)e;
+	uint64_t csum = util_checksum_compute(b, size, &b->checksum, 0);
+	csum = util_checksum_seq(&ulog->gen_num, sizeof(ulog->gen_num), csum);
+
+	return b->checksum == csum;
+}
+
+/*
+ * obj_ulog_walk -- (internal) validate the entries of a ulog
+ *
+ * If nbytesp is not NULL, only the first ulog is walked, a malformed entry
+ * is treated as the end of the log and the number of bytes taken by the
+ * entries before it is returned through nbytesp.
+ */
+static enum ulog_error
+obj_ulog_walk(struct obj_ctx *ctx, struct ulog *ulog, size_t *nbytesp)
+{
+	for (struct ulog *r = ulog; r != NULL; ) {
+		size_t off = 0;
+		int end = 0;
+		while (off < r->capacity) {
+			struct ulog_entry_base *e = (struct ulog_entry_base *)
+				(r->data + off);
+			size_t left = r->capacity - off;
+			if (left < sizeof(struct ulog_entry_val) ||
+					e->offset == 0) {
+				end = 1;
+				break;
+			}
+
+			uint64_t op = e->offset & ULOG_OP_MASK;
+			uint64_t target = e->offset & ~ULOG_OP_MASK;
+			size_t size = sizeof(struct ulog_entry_val);
+			size_t len = sizeof(uint64_t);
+			int malformed = 0;
+
+			if (op == ULOG_OPERATION_BUF_SET ||
+					op == ULOG_OPERATION_BUF_CPY) {
+				struct ulog_entry_buf *b =
+					(struct ulog_entry_buf *)e;
+				if (left < sizeof(*b) ||
+						b->size > left - sizeof(*b)) {
+					malformed = 1;
+				} else {
+					size = ULOG_ALIGN(sizeof(*b) +
+						b->size);
+					len = b->size;
+					malformed = size > left;
+				}
+			} else if (op != ULOG_OPERATION_SET &&
+					op != ULOG_OPERATION_AND &&
+					op != ULOG_OPERATION_OR) {
+				malformed = 1;
+			}
+
+			if (!malformed &&
+					!obj_ulog_entry_valid(ulog, e, size)) {
+				end = 1;
+				break;
+			}
+
+			if (!malformed && (target > ctx->poolsize ||
+					len > ctx->poolsize - target))
+				malformed = 1;
+
+			if (malformed) {
+				if (nbytesp == NULL)
+					return ULOG_ERR_ENTRY;
+				end = 1;
+				break;
+			}
+
+			off += size;
+		}
+
+		if (nbytesp) {
+			*nbytesp = off;
+			return ULOG_OK;
+		}
+
+		if (end)
+			break;
+
+		r = r->next ? (struct ulog *)
+			(ctx->base + ULOG_ALIGN(r->next)) : NULL;
+	}
+
+	return ULOG_OK;
+}
+
+/*
+ * obj_ulog_check -- (internal) check a single ulog of a lane
+ */
+static enum ulog_error
+obj_ulog_check(struct obj_ctx *ctx, struct ulog *ulog, size_t capacity,
+	int redo)
+{
+	/* a redo log stores the capacity it actually uses */
+	if (ulog->capacity > capacity)
+		return ULOG_ERR_CAPACITY;
+
+	/*
+	 * The extensions are allocated from the heap. The sum of their
+	 * capacities cannot exceed the heap size, which also detects loops.
+	 */
+	uint64_t total = 0;
+	for (struct ulog *r = ulog; r->next != 0; ) {
+		uint64_t off = ULOG_ALIGN(r->next);
+		if (off < ctx->heap_offset || off >= ctx->poolsize ||
+				ctx->poolsize - off < sizeof(struct ulog))
+			return ULOG_ERR_NEXT;
+
+		r = (struct ulog *)(ctx->base + off);
+		if (r->capacity == 0 || r->capacity >
+				ctx->poolsize - off - sizeof(struct ulog))
+			return ULOG_ERR_NEXT;
+
+		total += r->capacity;
+		if (total > ctx->heap_size)
+			return ULOG_ERR_NEXT;
+	}
+
+	if (!redo)
+		return ULOG_OK;
+
+	/* the entries of a redo log matter only if it is to be processed */
+	size_t nbytes = 0;
+	enum ulog_error ret = obj_ulog_walk(ctx, ulog, &nbytes);
+	if (ret != ULOG_OK || nbytes == 0)
+		return ret;
+
+	if (!util_checksum(ulog, SIZEOF_ULOG(nbytes), &ulog->checksum, 0, 0))
+		return ULOG_OK;
+
+	return obj_ulog_walk(ctx, ulog, NULL);
+}
+
+/*
+ * lanes_check_unit -- (internal) check a group of lanes
+ */
+static int
+lanes_check_unit(void *arg, uint64_t unit)
+{
+	struct obj_ctx *ctx = arg;
+	PMEMobjpool *pop = (PMEMobjpool *)ctx->base;
+
+	uint64_t first = unit * LANES_PER_UNIT;
+	uint64_t last = first + LANES_PER_UNIT;
+	if (last > ctx->nlanes)
+		last = ctx->nlanes;
+
+	for (uint64_t i = first; i < last; i++) {
+		struct lane_layout *layout = (struct lane_layout *)
+			(ctx->base + pop->lanes_offset) + i;
+		uint8_t *res = ctx->lanes[i];
+
+		res[LANE_LOG_INTERNAL] = (uint8_t)obj_ulog_check(ctx,
+			(struct ulog *)&layout->internal,
+			LANE_REDO_INTERNAL_SIZE, 1);
+		res[LANE_LOG_EXTERNAL] = (uint8_t)obj_ulog_check(ctx,
+			(struct ulog *)&layout->external,
+			LANE_REDO_EXTERNAL_SIZE, 1);
+		res[LANE_LOG_UNDO] = (uint8_t)obj_ulog_check(ctx,
+			(struct ulog *)&layout->undo,
+			LANE_UNDO_SIZE, 0);
+	}
+
+	return 0;
+}
+
+/*
+ * obj_lanes_check -- (internal) check ulogs of all lanes
+ */
+static int
+obj_lanes_check(PMEMpoolcheck *ppc, location *loc)
+{
+	LOG(3, NULL);
+
+	CHECK_INFO(ppc, "checking pmemobj lanes");
+
+	struct obj_ctx ctx;
+	if (obj_ctx_init(ppc, &ctx) == NULL) {
+		ppc->result = CHECK_RESULT_ERROR;
+		return CHECK_ERR(ppc, "cannot read pmemobj lanes");
+	}
+
+	ctx.lanes = calloc(ctx.nlanes, sizeof(*ctx.lanes));
+	if (!ctx.lanes) {
+		ERR("!calloc");
+		ppc->result = CHECK_RESULT_ERROR;
+		return CHECK_ERR(ppc, "cannot allocate memory for lanes check");
+	}
+
+	uint64_t nunits = (ctx.nlanes + LANES_PER_UNIT - 1) / LANES_PER_UNIT;
+	if (check_parallel(nunits, lanes_check_unit, &ctx)) {
+		free(ctx.lanes);
+		ppc->result = CHECK_RESULT_ERROR;
+		return CHECK_ERR(ppc, "cannot check pmemobj lanes");
+	}
+
+	int valid = 1;
+	for (uint64_t i = 0; i < ctx.nlanes; i++) {
+		for (unsigned l = 0; l < MAX_LANE_LOG; l++) {
+			uint8_t err = ctx.lanes[i][l];
+			if (err == ULOG_OK)
+				continue;
+
+			CHECK_INFO(ppc, "lane %ju: %s: %s", i,
+				lane_log_str[l], ulog_error_str[err]);
+			valid = 0;
+		}
+	}
+
+	free(ctx.lanes);
+
+	if (!valid)
+		return obj_not_consistent(ppc, "pmemobj lanes");
+
+	CHECK_INFO(ppc, "pmemobj lanes correct");
+
+	return 0;
+}
+
+/*
+ * zone_nchunks -- (internal) return the max number of chunks of a zone
+ */
+static uint32_t
+zone_nchunks(uint64_t heap_size, uint64_t zone_id)
+{
+	uint64_t size = heap_size - sizeof(struct heap_header) -
+		zone_id * ZONE_MAX_SIZE;
+	if (size > ZONE_MAX_SIZE)
+		size = ZONE_MAX_SIZE;
+
+	return (uint32_t)((size - sizeof(struct zone)) / CHUNKSIZE);
+}
+
+/*
+ * run_check -- (internal) check the header and bitmap of a run
+ */
+static enum zone_error
+run_check(struct chunk_header *hdr, struct chunk_run *run)
+{
+	uint64_t unit_size = run->hdr.block_size;
+	if (unit_size == 0 || unit_size > RUN_CONTENT_SIZE_BYTES(hdr->size_idx))
+		return ZONE_ERR_RUN_BLOCK_SIZE;
+
+	/* calculate the bitmap parameters the same way as the allocator */
+	unsigned nbits;
+	unsigned nvalues;
+	if (hdr->flags & CHUNK_FLAG_FLEX_BITMAP) {
+		size_t content_size = RUN_CONTENT_SIZE_BYTES(hdr->size_idx);
+		nbits = (unsigned)(content_size / unit_size);
+		nvalues = util_div_ceil(nbits, RUN_BITS_PER_VALUE);
+		nvalues = ALIGN_UP(nvalues + RUN_BASE_METADATA_VALUES,
+			(unsigned)(CACHELINE_SIZE / sizeof(uint64_t)))
+			- RUN_BASE_METADATA_VALUES;
+
+		size_t bitmap_size = nvalues * sizeof(uint64_t);
+		if (bitmap_size + unit_size > content_size)
+			return ZONE_ERR_RUN_BLOCK_SIZE;
+
+		nbits = (unsigned)((content_size - bitmap_size) / unit_size)
+			- (run->hdr.alignment ? 1U : 0U);
+		nvalues -= ((nvalues * RUN_BITS_PER_VALUE) - nbits) /
+			RUN_BITS_PER_VALUE;
+	} else {
+		uint64_t nallocs = RUN_DEFAULT_SIZE_BYTES(hdr->size_idx) /
+			unit_size;
+		if (nallocs > RUN_DEFAULT_BITMAP_NBITS) {
+			/* the allocator would have used a smaller run */
+			if (hdr->size_idx > 1)
+				return ZONE_ERR_RUN_BLOCK_SIZE;
+			nallocs = RUN_DEFAULT_BITMAP_NBITS;
+		}
+
+		nbits = (unsigned)nallocs - (run->hdr.alignment ? 1U : 0U);
+		nvalues = RUN_DEFAULT_BITMAP_VALUES -
+			(RUN_DEFAULT_BITMAP_NBITS - nbits) / RUN_BITS_PER_VALUE;
+	}
+
+	if (nbits == 0 || nvalues == 0)
+		return ZONE_ERR_RUN_BLOCK_SIZE;
+
+	/* the bits past the last unit are always set */
+	uint64_t *values = (uint64_t *)run->content;
+	uint64_t trailing = UINT64_MAX << (nbits % RUN_BITS_PER_VALUE);
+	if ((values[nvalues - 1] & trailing) != trailing)
+		return ZONE_ERR_RUN_BITMAP;
+
+	return ZONE_OK;
+}
+
+/*
+ * zone_check -- (internal) check the chunk headers and runs of a zone
+ */
+static enum zone_error
+zone_check(struct obj_ctx *ctx, uint64_t zone_id, uint32_t *chunk_idp)
+{
+	struct heap_layout *layout = (struct heap_layout *)
+		(ctx->base + ctx->heap_offset);
+	struct zone *z = ZID_TO_ZONE(layout, zone_id);
+
+	*chunk_idp = 0;
+
+	if (z->header.magic == 0)
+		return ZONE_OK; /* not initialized, and that is OK */
+
+	if (z->header.magic != ZONE_HEADER_MAGIC)
+		return ZONE_ERR_MAGIC;
+
+	uint32_t size_idx = z->header.size_idx;
+	if (size_idx == 0 || size_idx > zone_nchunks(ctx->heap_size, zone_id))
+		return ZONE_ERR_SIZE;
+
+	for (uint32_t c = 0; c < size_idx; ) {
+		struct chunk_header *hdr = &z->chunk_headers[c];
+		*chunk_idp = c;
+
+		if (hdr->type != CHUNK_TYPE_FREE &&
+				hdr->type != CHUNK_TYPE_USED &&
+				hdr->type != CHUNK_TYPE_RUN)
+			return ZONE_ERR_CHUNK_TYPE;
+
+		if (hdr->flags & ~CHUNK_FLAGS_ALL_VALID)
+			return ZONE_ERR_CHUNK_FLAGS;
+
+		if (hdr->size_idx == 0 || hdr->size_idx > size_idx - c)
+			return ZONE_ERR_CHUNK_SIZE;
+
+		if (hdr->type == CHUNK_TYPE_RUN) {
+			for (uint32_t i = 1; i < hdr->size_idx; i++) {
+				struct chunk_header *data = hdr + i;
+				if (data->type != CHUNK_TYPE_RUN_DATA ||
+						data->size_idx != i)
+					return ZONE_ERR_RUN_DATA;
+			}
+
+			enum zone_error err = run_check(hdr,
+				(struct chunk_run *)&z->chunks[c]);
+			if (err != ZONE_OK)
+				return err;
+		}
+
+		c += hdr->size_idx;
+	}
+
+	return ZONE_OK;
+}
+
+/*
+ * zones_check_unit -- (internal) check a single zone
+ */
+static int
+zones_check_unit(void *arg, uint64_t unit)
+{
+	struct obj_ctx *ctx = arg;
+	struct zone_result *res = &ctx->zones[unit];
+
+	res->error = zone_check(ctx, unit, &res->chunk_id);
+
+	return 0;
+}
+
+/*
+ * obj_heap_check -- (internal) check heap header and all zones
+ */
+static int
+obj_heap_check(PMEMpoolcheck *ppc, location *loc)
+{
+	LOG(3, NULL);
+
+	CHECK_INFO(ppc, "checking pmemobj heap");
+
+	struct obj_ctx ctx;
+	if (obj_ctx_init(ppc, &ctx) == NULL) {
+		ppc->result = CHECK_RESULT_ERROR;
+		return CHECK_ERR(ppc, "cannot read pmemobj heap");
+	}
+
+	struct heap_layout *layout = (struct heap_layout *)
+		(ctx.base + ctx.heap_offset);
+	struct heap_header *hdr = &layout->header;
+
+	if (memcmp(hdr->signature, HEAP_SIGNATURE, HEAP_SIGNATURE_LEN) != 0) {
+		CHECK_INFO(ppc, "invalid heap signature");
+		return obj_not_consistent(ppc, "pmemobj heap");
+	}
+
+	if (!util_checksum(hdr, sizeof(*hdr), &hdr->checksum, 0, 0)) {
+		CHECK_INFO(ppc, "invalid heap checksum");
+		return obj_not_consistent(ppc, "pmemobj heap");
+	}
+
+	uint64_t nzones = 0;
+	uint64_t size = ctx.heap_size - sizeof(struct heap_header);
+	while (size >= ZONE_MIN_SIZE) {
+		nzones++;
+		size -= size <= ZONE_MAX_SIZE ? size : ZONE_MAX_SIZE;
+	}
+
+	ctx.zones = calloc(nzones, sizeof(*ctx.zones));
+	if (!ctx.zones) {
+		ERR("!calloc");
+		ppc->result = CHECK_RESULT_ERROR;
+		return CHECK_ERR(ppc, "cannot allocate memory for heap check");
+	}
+
+	if (check_parallel(nzones, zones_check_unit, &ctx)) {
+		free(ctx.zones);
+		ppc->result = CHECK_RESULT_ERROR;
+		return CHECK_ERR(ppc, "cannot check pmemobj heap");
+	}
+
+	int valid = 1;
+	for (uint64_t z = 0; z < nzones; z++) {
+		struct zone_result *res = &ctx.zones[z];
+		switch (res->error) {
+		case ZONE_OK:
+			continue;
+		case ZONE_ERR_MAGIC:
+		case ZONE_ERR_SIZE:
+			CHECK_INFO(ppc, "zone %ju: %s", z,
+				zone_error_str[res->error]);
+			break;
+		default:
+			CHECK_INFO(ppc, "zone %ju: chunk %u: %s", z,
+				res->chunk_id, zone_error_str[res->error]);
+			break;
+		}
+		valid = 0;
+	}
+
+	free(ctx.zones);
+
+	if (!valid)
+		return obj_not_consistent(ppc, "pmemobj heap");
+
+	CHECK_INFO(ppc, "pmemobj heap correct");
+
+	return 0;
+}
+
+struct step {
+	int (*check)(PMEMpoolcheck *, location *);
+	int (*fix)(PMEMpoolcheck *, location *, uint32_t, void *);
+};
+
+static const struct step steps[] = {
+	{
+		.check	= obj_hdr_check,
+	},
+	{
+		.check	= obj_lanes_check,
+	},
+	{
+		.check	= obj_heap_check,
+	},
+	{
+		.check	= NULL,
+		.fix	= NULL,
+	},
+};
+
+/*
+ * step_exe -- (internal) perform single step according to its parameters
+ */
+static inline int
+step_exe(PMEMpoolcheck *ppc, location *loc)
+{
+	ASSERT(loc->step < ARRAY_SIZE(steps));
+	ASSERTeq(ppc->pool->params.type, POOL_TYPE_OBJ);
+
+	const struct step *step = &steps[loc->step++];
+
+	return step->check(ppc, loc);
+}
+
+/*
+ * check_obj -- entry point for pmemobj checks
+ */
+void
+check_obj(PMEMpoolcheck *ppc)
+{
+	LOG(3, NULL);
+
+	location *loc = check_get_step_data(ppc->data);
+
+	/* do all checks */
+	while (CHECK_NOT_COMPLETE(loc, steps)) {
+		if (step_exe(ppc, loc))
+			break;
+	}
+}
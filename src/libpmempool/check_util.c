@@ -5,10 +5,16 @@
  * check_util.c -- check utility functions
  */
 
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "out.h"
+#include "os.h"
+#include "os_thread.h"
 #include "libpmempool.h"
 #include "pmempool.h"
 #include "pool.h"
@@ -31,6 +37,8 @@
 
 #define UUID_STR_MAX 37
 
+#define CHECK_MAX_THREADS 16U /* default limit of threads of parallel checks */
+
 enum check_answer {
 	PMEMPOOL_CHECK_ANSWER_EMPTY,
 	PMEMPOOL_CHECK_ANSWER_YES,
@@ -667,3 +675,142 @@ check_insert_arena(PMEMpoolcheck *ppc, struct arena *arenap)
 	PMDK_TAILQ_INSERT_TAIL(&ppc->pool->arenas, arenap, next);
 	ppc->pool->narenas++;
 }
+
+/*
+ * Shared state of the workers of a parallel check.
+ */
+struct check_parallel_task {
+	int (*func)(void *arg, uint64_t unit);
+	void *arg;
+
+	uint64_t nunits;
+	uint64_t next;		/* next unit to be picked up by a worker */
+
+	int failed;		/* set by the first unit that fails */
+	int error;		/* errno of the failed unit */
+};
+
+/*
+ * check_parallel_nthreads -- (internal) return the max number of threads
+ * of a parallel check
+ *
+ * It is equal to the number of online processors, up to CHECK_MAX_THREADS,
+ * unless set explicitly with the CHECK_THREADS_VAR environment variable.
+ */
+static unsigned
+check_parallel_nthreads(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus < 1)
+		ncpus = 1;
+
+	unsigned nthreads = (unsigned)ncpus < CHECK_MAX_THREADS ?
+		(unsigned)ncpus : CHECK_MAX_THREADS;
+
+	char *env = os_getenv(CHECK_THREADS_VAR);
+	if (env != NULL) {
+		char *end;
+		errno = 0;
+		unsigned long n = strtoul(env, &end, 10);
+		if (errno || *end != '\0' || n == 0 || n > UINT_MAX)
+			LOG(2, "invalid %s value -- '%s'",
+				CHECK_THREADS_VAR, env);
+		else
+			nthreads = (unsigned)n;
+	}
+
+	return nthreads;
+}
+
+/*
+ * check_parallel_worker -- (internal) process units until there are none left
+ */
+static void *
+check_parallel_worker(void *arg)
+{
+	struct check_parallel_task *task = arg;
+
+	while (1) {
+		uint64_t unit = util_fetch_and_add64(&task->next, 1);
+		if (unit >= task->nunits)
+			break;
+
+		int failed;
+		util_atomic_load_explicit32(&task->failed, &failed,
+				memory_order_relaxed);
+		if (failed)
+			break;
+
+		if (task->func(task->arg, unit)) {
+			if (util_bool_compare_and_swap32(&task->failed, 0, 1))
+				task->error = errno;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * check_parallel -- call func for every unit from 0 to nunits - 1
+ *
+ * The units are picked up one by one by a number of worker threads, including
+ * the calling one, so func must not create any check statuses. The order in
+ * which the units are processed is unspecified.
+ *
+ * Returns 0 on success, otherwise -1/errno of the first unit that failed.
+ */
+int
+check_parallel(uint64_t nunits, int (*func)(void *arg, uint64_t unit),
+	void *arg)
+{
+	LOG(3, "nunits %" PRIu64, nunits);
+
+	struct check_parallel_task task;
+	memset(&task, 0, sizeof(task));
+	task.func = func;
+	task.arg = arg;
+	task.nunits = nunits;
+
+	uint64_t nworkers = check_parallel_nthreads();
+	if (nworkers > nunits)
+		nworkers = nunits;
+
+	os_thread_t *threads = NULL;
+	unsigned nthreads = 0;
+	if (nworkers > 1) {
+		threads = Malloc((nworkers - 1) * sizeof(*threads));
+		if (threads == NULL)
+			LOG(2, "!Malloc for %" PRIu64 " threads",
+				nworkers - 1);
+	}
+
+	if (threads != NULL) {
+		for (; nthreads < nworkers - 1; nthreads++) {
+			if (os_thread_create(&threads[nthreads], NULL,
+					check_parallel_worker, &task) != 0) {
+				/* not fatal, the other workers will cope */
+				LOG(2, "cannot create checking thread");
+				break;
+			}
+		}
+	}
+
+	LOG(4, "checking %" PRIu64 " units using %u threads",
+		nunits, nthreads + 1);
+
+	check_parallel_worker(&task);
+
+	for (unsigned i = 0; i < nthreads; i++)
+		os_thread_join(&threads[i], NULL);
+
+	if (threads)
+		Free(threads);
+
+	if (task.failed) {
+		errno = task.error;
+		return -1;
+	}
+
+	return 0;
+}
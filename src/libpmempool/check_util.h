@@ -18,6 +18,11 @@ extern "C" {
 #define CHECK_STEP_COMPLETE	UINT_MAX
 #define CHECK_INVALID_QUESTION	UINT_MAX
 
+/*
+ * Environment variable which limits the number of threads of parallel checks
+ */
+#define CHECK_THREADS_VAR	"PMEMPOOL_CHECK_THREADS"
+
 #define REQUIRE_ADVANCED	"the following error can be fixed using " \
 				"PMEMPOOL_CHECK_ADVANCED flag"
 
@@ -28,6 +33,7 @@ extern "C" {
 /* check control context */
 struct check_data;
 struct arena;
+struct arena_map_flog;
 
 /* queue of check statuses */
 struct check_status;
@@ -85,13 +91,8 @@ typedef struct {
 	uint64_t offset;
 	uint32_t narena;
 
-	uint8_t *bitmap;
-	uint8_t *dup_bitmap;
-	uint8_t *fbitmap;
-
-	struct list *list_inval;
-	struct list *list_flog_inval;
-	struct list *list_unmap;
+	/* results of the BTT Map and Flog analysis of all the arenas */
+	struct arena_map_flog *amf;
 
 	struct {
 		int btti_header;
@@ -114,6 +115,7 @@ void check_log(PMEMpoolcheck *ppc);
 void check_blk(PMEMpoolcheck *ppc);
 void check_btt_info(PMEMpoolcheck *ppc);
 void check_btt_map_flog(PMEMpoolcheck *ppc);
+void check_obj(PMEMpoolcheck *ppc);
 void check_write(PMEMpoolcheck *ppc);
 
 struct check_data *check_data_alloc(void);
@@ -176,6 +178,9 @@ const char *check_get_pool_type_str(enum pool_type type);
 
 void check_insert_arena(PMEMpoolcheck *ppc, struct arena *arenap);
 
+int check_parallel(uint64_t nunits, int (*func)(void *arg, uint64_t unit),
+	void *arg);
+
 #ifdef _WIN32
 void cache_to_utf8(struct check_data *data, char *buf, size_t size);
 #endif
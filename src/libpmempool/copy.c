@@ -0,0 +1,496 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * copy.c -- a module for copying data between replicas
+ *
+ * The data is split into units of COPY_UNIT_SIZE bytes, which are picked up
+ * one by one by a number of worker threads (including the calling one).
+ * If the destination is known to be zeroed, units which contain only zeroes
+ * or lie entirely in a free part of the heap of the source obj pool are not
+ * copied at all.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libpmem.h"
+#include "libpmempool.h"
+#include "copy.h"
+#include "heap_layout.h"
+#include "obj.h"
+#include "os.h"
+#include "os_thread.h"
+#include "out.h"
+#include "util.h"
+#include "vec.h"
+
+#define COPY_UNIT_SIZE		((size_t)1 << 20)
+#define COPY_MAX_THREADS	16U	/* default limit of copying threads */
+#define COPY_PROGRESS_INTERVAL	1000000000ULL	/* 1 s, in nanoseconds */
+
+/*
+ * A range of the pool (in bytes, from its beginning) which does not hold
+ * any data.
+ */
+struct copy_range {
+	size_t off;
+	size_t len;
+};
+
+struct copy_ctx {
+	unsigned nthreads;	/* max number of threads, with the caller */
+	int progress;		/* report progress of copying */
+
+	/* unused ranges of the heap, sorted by offset */
+	VEC(copy_range_vec, struct copy_range) unused;
+
+	uint64_t start;		/* when the current operation started */
+	uint64_t last_report;	/* when the progress was reported last time */
+};
+
+/* function reporting progress, set by pmempool_set_progress_func() */
+static pmempool_progress_func *Progress_func;
+static void *Progress_arg;
+
+/*
+ * Shared state of the workers copying a single range.
+ */
+struct copy_task {
+	struct copy_ctx *ctx;
+	const char *desc;
+	char *dst;
+	const char *src;
+	size_t off;
+	size_t len;
+	unsigned flags;
+
+	uint64_t nunits;
+	uint64_t next;		/* next unit to be picked up by a worker */
+	uint64_t copied;	/* bytes copied so far */
+	uint64_t skipped;	/* bytes skipped so far */
+
+	int failed;		/* set by the first unit that fails */
+	int error;		/* errno of the failed unit */
+};
+
+/*
+ * copy_now -- (internal) return monotonic time in nanoseconds
+ */
+static uint64_t
+copy_now(void)
+{
+	struct timespec ts;
+	os_clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * copy_new -- allocate a copy context
+ *
+ * The number of copying threads is equal to the number of online processors,
+ * up to COPY_MAX_THREADS, unless set explicitly with the COPY_THREADS_VAR
+ * environment variable.
+ */
+struct copy_ctx *
+copy_new(int progress)
+{
+	LOG(3, "progress %d", progress);
+
+	struct copy_ctx *ctx = Zalloc(sizeof(*ctx));
+	if (ctx == NULL) {
+		ERR("!Zalloc");
+		return NULL;
+	}
+
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus < 1)
+		ncpus = 1;
+
+	ctx->nthreads = (unsigned)ncpus < COPY_MAX_THREADS ?
+		(unsigned)ncpus : COPY_MAX_THREADS;
+
+	char *env = os_getenv(COPY_THREADS_VAR);
+	if (env != NULL) {
+		char *end;
+		errno = 0;
+		unsigned long n = strtoul(env, &end, 10);
+		if (errno || *end != '\0' || n == 0 || n > UINT_MAX)
+			LOG(2, "invalid %s value -- '%s'",
+				COPY_THREADS_VAR, env);
+		else
+			ctx->nthreads = (unsigned)n;
+	}
+
+	ctx->progress = progress;
+	VEC_INIT(&ctx->unused);
+
+	LOG(4, "copying with up to %u threads", ctx->nthreads);
+
+	return ctx;
+}
+
+/*
+ * copy_delete -- free a copy context
+ */
+void
+copy_delete(struct copy_ctx *ctx)
+{
+	VEC_DELETE(&ctx->unused);
+	Free(ctx);
+}
+
+/*
+ * copy_add_unused -- (internal) record a range of the pool with no data
+ */
+static int
+copy_add_unused(struct copy_ctx *ctx, size_t off, size_t len)
+{
+	if (VEC_SIZE(&ctx->unused) != 0) {
+		struct copy_range *last = &VEC_BACK(&ctx->unused);
+		if (last->off + last->len == off) {
+			last->len += len;
+			return 0;
+		}
+	}
+
+	struct copy_range range = {off, len};
+	if (VEC_PUSH_BACK(&ctx->unused, range)) {
+		ERR("!Realloc");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * copy_skip_unused_heap -- find the free ranges of the heap of an obj pool
+ *
+ * The ranges are found based on the zone and chunk headers of the pool
+ * mapped at the given address. The chunks which are not in use and the
+ * zones which have not been initialized yet do not hold any data, so they
+ * are not copied to zeroed destinations.
+ * Pools of other types and pools with malformed heap metadata are ignored.
+ */
+int
+copy_skip_unused_heap(struct copy_ctx *ctx, const void *pool, size_t poolsize)
+{
+	LOG(3, "ctx %p pool %p poolsize %zu", ctx, pool, poolsize);
+
+	const PMEMobjpool *pop = pool;
+
+	if (poolsize < sizeof(*pop) ||
+	    memcmp(pop->hdr.signature, OBJ_HDR_SIG, POOL_HDR_SIG_LEN) != 0)
+		return 0;
+
+	if (pop->heap_offset > poolsize ||
+	    pop->heap_size > poolsize - pop->heap_offset ||
+	    pop->heap_size < HEAP_MIN_SIZE) {
+		LOG(2, "invalid heap offset or size, heap not analyzed");
+		return 0;
+	}
+
+	struct heap_layout *layout = (struct heap_layout *)
+		((uintptr_t)pool + pop->heap_offset);
+
+	if (memcmp(layout->header.signature, HEAP_SIGNATURE,
+			HEAP_SIGNATURE_LEN) != 0 ||
+	    layout->header.chunksize != CHUNKSIZE) {
+		LOG(2, "invalid heap header, heap not analyzed");
+		return 0;
+	}
+
+	size_t size = pop->heap_size - sizeof(struct heap_header);
+	for (size_t zid = 0; size >= ZONE_MIN_SIZE; ++zid) {
+		size_t zone_size = size < ZONE_MAX_SIZE ? size : ZONE_MAX_SIZE;
+		size -= zone_size;
+
+		struct zone *z = ZID_TO_ZONE(layout, zid);
+		size_t chunks_off = (uintptr_t)&z->chunks[0] - (uintptr_t)pool;
+		uint32_t nchunks = (uint32_t)
+			((zone_size - sizeof(struct zone)) / CHUNKSIZE);
+
+		if (z->header.magic != ZONE_HEADER_MAGIC) {
+			/* the zone has never been used */
+			if (copy_add_unused(ctx, chunks_off,
+					nchunks * CHUNKSIZE))
+				return -1;
+			continue;
+		}
+
+		if (z->header.size_idx < nchunks)
+			nchunks = z->header.size_idx;
+
+		for (uint32_t c = 0; c < nchunks; ) {
+			struct chunk_header *hdr = &z->chunk_headers[c];
+			if (hdr->size_idx == 0 || hdr->size_idx > nchunks - c) {
+				LOG(2, "invalid chunk header, zone %zu "
+					"chunk %u", zid, c);
+				break;
+			}
+
+			if (hdr->type == CHUNK_TYPE_FREE &&
+			    copy_add_unused(ctx, chunks_off + c * CHUNKSIZE,
+					hdr->size_idx * CHUNKSIZE))
+				return -1;
+
+			c += hdr->size_idx;
+		}
+	}
+
+	LOG(4, "%zu unused ranges of the heap found",
+		VEC_SIZE(&ctx->unused));
+
+	return 0;
+}
+
+/*
+ * copy_is_unused -- (internal) check whether the range of the pool lies
+ * entirely in one of the unused ranges
+ */
+static int
+copy_is_unused(struct copy_ctx *ctx, size_t off, size_t len)
+{
+	size_t lo = 0;
+	size_t hi = VEC_SIZE(&ctx->unused);
+
+	/* find the last range which starts at or before off */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (VEC_ARR(&ctx->unused)[mid].off <= off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0)
+		return 0;
+
+	struct copy_range *r = &VEC_ARR(&ctx->unused)[lo - 1];
+
+	return off + len <= r->off + r->len;
+}
+
+/*
+ * pmempool_set_progress_func -- set the function reporting progress of
+ * copying the data
+ */
+void
+pmempool_set_progress_func(pmempool_progress_func *func, void *arg)
+{
+	LOG(3, "arg %p", arg);
+
+	Progress_func = func;
+	Progress_arg = arg;
+}
+
+/*
+ * copy_progress_begin -- start measuring time of an operation
+ */
+void
+copy_progress_begin(struct copy_ctx *ctx)
+{
+	ctx->start = copy_now();
+	ctx->last_report = ctx->start;
+}
+
+/*
+ * copy_progress -- report progress and throughput of an operation
+ *
+ * Progress is logged and passed to the function set by the application.
+ * Unless it is the final report of the operation, at most one report per
+ * COPY_PROGRESS_INTERVAL is made, so this can be called often and from
+ * many threads at once.
+ */
+void
+copy_progress(struct copy_ctx *ctx, const char *desc, size_t done,
+		size_t skipped, size_t total, int final)
+{
+	if (!ctx->progress || desc == NULL)
+		return;
+
+	uint64_t now = copy_now();
+
+	if (!final) {
+		uint64_t last;
+		util_atomic_load_explicit64(&ctx->last_report, &last,
+				memory_order_acquire);
+		if (now - last < COPY_PROGRESS_INTERVAL ||
+		    !util_bool_compare_and_swap64(&ctx->last_report,
+				last, now))
+			return;
+	}
+
+	struct pmempool_progress p;
+	p.desc = desc;
+	p.done = done;
+	p.skipped = skipped;
+	p.total = total;
+	p.elapsed_ns = now - ctx->start;
+	p.final = final;
+
+	LOG(final ? 2 : 3, "%s: %zu of %zu bytes done, %zu skipped, "
+		"%" PRIu64 " ns", desc, done, total, skipped, p.elapsed_ns);
+
+	pmempool_progress_func *func = Progress_func;
+	if (func != NULL)
+		func(&p, Progress_arg);
+}
+
+/*
+ * copy_unit -- (internal) copy a single unit of the task
+ */
+static int
+copy_unit(struct copy_task *task, uint64_t unit)
+{
+	size_t uoff = (size_t)unit * COPY_UNIT_SIZE;
+	size_t ulen = task->len - uoff;
+	if (ulen > COPY_UNIT_SIZE)
+		ulen = COPY_UNIT_SIZE;
+
+	void *dst = task->dst + uoff;
+	const void *src = task->src + uoff;
+
+	if ((task->flags & COPY_DST_ZEROED) &&
+	    (copy_is_unused(task->ctx, task->off + uoff, ulen) ||
+	    util_is_zeroed(src, ulen))) {
+		util_fetch_and_add64(&task->skipped, ulen);
+		return 0;
+	}
+
+	if (task->flags & COPY_DST_PMEM) {
+		pmem_memcpy(dst, src, ulen,
+			PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
+	} else {
+		memcpy(dst, src, ulen);
+		if (pmem_msync(dst, ulen))
+			return -1;
+	}
+
+	util_fetch_and_add64(&task->copied, ulen);
+
+	return 0;
+}
+
+/*
+ * copy_worker -- (internal) copy units of the task until none is left
+ */
+static void *
+copy_worker(void *arg)
+{
+	struct copy_task *task = arg;
+
+	uint64_t unit;
+	while ((unit = util_fetch_and_add64(&task->next, 1)) <
+			task->nunits) {
+		int failed;
+		util_atomic_load_explicit32(&task->failed, &failed,
+				memory_order_acquire);
+		if (failed)
+			break;
+
+		if (copy_unit(task, unit)) {
+			if (util_bool_compare_and_swap32(&task->failed, 0, 1))
+				task->error = errno;
+			break;
+		}
+
+		uint64_t copied;
+		uint64_t skipped;
+		util_atomic_load_explicit64(&task->copied, &copied,
+				memory_order_relaxed);
+		util_atomic_load_explicit64(&task->skipped, &skipped,
+				memory_order_relaxed);
+		copy_progress(task->ctx, task->desc, copied + skipped,
+				skipped, task->len, 0);
+	}
+
+	/* non-temporal stores of this thread have to be fenced */
+	if (task->flags & COPY_DST_PMEM)
+		pmem_drain();
+
+	return NULL;
+}
+
+/*
+ * copy_data -- copy len bytes of the pool, starting at the offset off,
+ * from src to dst
+ *
+ * If desc is not NULL, it describes the copied range in progress reports.
+ * Otherwise the range is a piece of a larger operation and the caller is
+ * responsible for measuring and reporting it.
+ * The data is persistent when the function returns.
+ *
+ * Returns 0 on success, otherwise -1/errno.
+ */
+int
+copy_data(struct copy_ctx *ctx, const char *desc, void *dst,
+		const void *src, size_t off, size_t len, unsigned flags)
+{
+	LOG(3, "ctx %p desc %s dst %p src %p off %zu len %zu flags %u",
+		ctx, desc ? desc : "", dst, src, off, len, flags);
+
+	struct copy_task task;
+	memset(&task, 0, sizeof(task));
+	task.ctx = ctx;
+	task.desc = desc;
+	task.dst = dst;
+	task.src = src;
+	task.off = off;
+	task.len = len;
+	task.flags = flags;
+	task.nunits = (len + COPY_UNIT_SIZE - 1) / COPY_UNIT_SIZE;
+
+	if (desc != NULL)
+		copy_progress_begin(ctx);
+
+	uint64_t nworkers = ctx->nthreads;
+	if (nworkers > task.nunits)
+		nworkers = task.nunits;
+
+	os_thread_t *threads = NULL;
+	unsigned nthreads = 0;
+	if (nworkers > 1) {
+		threads = Malloc((nworkers - 1) * sizeof(*threads));
+		if (threads == NULL)
+			LOG(2, "!Malloc for %" PRIu64 " threads",
+				nworkers - 1);
+	}
+
+	if (threads != NULL) {
+		for (; nthreads < nworkers - 1; nthreads++) {
+			if (os_thread_create(&threads[nthreads], NULL,
+					copy_worker, &task) != 0) {
+				/* not fatal, the other workers will cope */
+				LOG(2, "cannot create copying thread");
+				break;
+			}
+		}
+	}
+
+	LOG(4, "copying %" PRIu64 " units using %u threads",
+		task.nunits, nthreads + 1);
+
+	copy_worker(&task);
+
+	for (unsigned i = 0; i < nthreads; i++)
+		os_thread_join(&threads[i], NULL);
+
+	if (threads)
+		Free(threads);
+
+	if (task.failed) {
+		errno = task.error;
+		ERR("!copying data failed");
+		return -1;
+	}
+
+	copy_progress(ctx, desc, len, task.skipped, len, 1);
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * copy.h -- internal definitions for copying data between replicas
+ */
+#ifndef COPY_H
+#define COPY_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Flags which modify how copy_data() writes the data
+ */
+/* the destination is known to be zeroed, zeroed data can be skipped */
+#define COPY_DST_ZEROED		(1U << 0)
+/* the destination is persistent memory, no msync is required */
+#define COPY_DST_PMEM		(1U << 1)
+
+/*
+ * Environment variable which limits the number of copying threads
+ */
+#define COPY_THREADS_VAR	"PMEMPOOL_COPY_THREADS"
+
+struct copy_ctx;
+
+struct copy_ctx *copy_new(int progress);
+void copy_delete(struct copy_ctx *ctx);
+int copy_skip_unused_heap(struct copy_ctx *ctx, const void *pool,
+		size_t poolsize);
+int copy_data(struct copy_ctx *ctx, const char *desc, void *dst,
+		const void *src, size_t off, size_t len, unsigned flags);
+void copy_progress_begin(struct copy_ctx *ctx);
+void copy_progress(struct copy_ctx *ctx, const char *desc, size_t done,
+		size_t skipped, size_t total, int final);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -36,7 +36,8 @@
 static int
 check_flags_sync(unsigned flags)
 {
-	flags &= ~(PMEMPOOL_SYNC_DRY_RUN | PMEMPOOL_SYNC_FIX_BAD_BLOCKS);
+	flags &= ~(PMEMPOOL_SYNC_DRY_RUN | PMEMPOOL_SYNC_FIX_BAD_BLOCKS |
+			PMEMPOOL_SYNC_PROGRESS);
 	return flags > 0;
 }
 
@@ -47,7 +48,7 @@ check_flags_sync(unsigned flags)
 static int
 check_flags_transform(unsigned flags)
 {
-	flags &= ~PMEMPOOL_TRANSFORM_DRY_RUN;
+	flags &= ~(PMEMPOOL_TRANSFORM_DRY_RUN | PMEMPOOL_TRANSFORM_PROGRESS);
 	return flags > 0;
 }
 
@@ -406,6 +407,21 @@ replica_is_poolset_healthy(struct poolset_health_status *set_hs)
 	return 1;
 }
 
+/*
+ * replica_is_poolset_dirty -- check if any of the replicas has regions which
+ *                             were modified since the last sync
+ */
+int
+replica_is_poolset_dirty(struct poolset_health_status *set_hs)
+{
+	LOG(3, "set_hs %p", set_hs);
+	for (unsigned r = 0; r < set_hs->nreplicas; ++r) {
+		if (REP_HEALTH(set_hs, r)->flags & HAS_DIRTY_REGIONS)
+			return 1;
+	}
+	return 0;
+}
+
 /*
  * replica_is_poolset_transformed -- check if the flag indicating a call from
  *                                   pmempool_transform is on
@@ -512,6 +528,10 @@ replica_check_store_size(struct pool_set *set,
 
 	set_hs->replica[repn]->pool_size = pop.heap_offset + pop.heap_size;
 
+	set_hs->replica[repn]->dirtymap = pop.dirtymap_persistent;
+	if (dirtymap_persistent_is_dirty(&pop.dirtymap_persistent))
+		set_hs->replica[repn]->flags |= HAS_DIRTY_REGIONS;
+
 	return 0;
 }
 
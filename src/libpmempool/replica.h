@@ -10,6 +10,7 @@
 #include "libpmempool.h"
 #include "pool.h"
 #include "badblocks.h"
+#include "dirtymap.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,6 +41,12 @@ extern "C" {
  */
 #define HAS_CORRUPTED_HEADER	(1U << 3)
 
+/*
+ * A replica marked in this way has regions which were modified since the last
+ * sync and may differ from the other replicas.
+ */
+#define HAS_DIRTY_REGIONS	(1U << 4)
+
 /*
  * A flag which can be passed to sync_replica() to indicate that the function is
  * called by pmempool_transform
@@ -71,6 +78,8 @@ struct replica_health_status {
 	unsigned flags;
 	/* effective size of a pool, valid only for healthy replica */
 	size_t pool_size;
+	/* modified regions, valid only for replica with healthy header */
+	struct dirtymap_persistent dirtymap;
 	/* flags for each part */
 	struct part_health_status part[];
 };
@@ -159,6 +168,23 @@ fix_bad_blocks(unsigned flags)
 	return flags & PMEMPOOL_SYNC_FIX_BAD_BLOCKS;
 }
 
+/*
+ * report_progress -- (internal) check whether progress of copying the data
+ *                    should be reported
+ */
+static inline bool
+report_progress(unsigned flags)
+{
+	/*
+	 * PMEMPOOL_SYNC_PROGRESS and PMEMPOOL_TRANSFORM_PROGRESS
+	 * have to have the same value in order to use this common function.
+	 */
+	ASSERT_COMPILE_ERROR_ON(PMEMPOOL_SYNC_PROGRESS !=
+				PMEMPOOL_TRANSFORM_PROGRESS);
+
+	return flags & PMEMPOOL_SYNC_PROGRESS;
+}
+
 int replica_remove_all_recovery_files(struct poolset_health_status *set_hs);
 int replica_remove_part(struct pool_set *set, unsigned repn, unsigned partn,
 		int fix_bad_blocks);
@@ -189,6 +215,7 @@ unsigned replica_find_replica_healthy_header(
 		struct poolset_health_status *set_hs);
 
 int replica_is_poolset_healthy(struct poolset_health_status *set_hs);
+int replica_is_poolset_dirty(struct poolset_health_status *set_hs);
 int replica_is_poolset_transformed(unsigned flags);
 ssize_t replica_get_pool_size(struct pool_set *set, unsigned repn);
 int replica_check_part_sizes(struct pool_set *set, size_t min_size);
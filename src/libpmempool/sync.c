@@ -6,7 +6,9 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -14,6 +16,8 @@
 #include <limits.h>
 
 #include "libpmem.h"
+#include "copy.h"
+#include "obj.h"
 #include "replica.h"
 #include "out.h"
 #include "os.h"
@@ -71,13 +75,14 @@ err:
  *                   to the broken one
  */
 static int
-sync_copy_data(void *src_addr, void *dst_addr, size_t off, size_t len,
+sync_copy_data(struct copy_ctx *ctx, const char *desc,
+		void *src_addr, void *dst_addr, size_t off, size_t len,
 		struct pool_replica *rep_h,
 		struct pool_replica *rep, const struct pool_set_part *part)
 {
-	LOG(3, "src_addr %p dst_addr %p off %zu len %zu "
+	LOG(3, "ctx %p src_addr %p dst_addr %p off %zu len %zu "
 		"rep_h %p rep %p part %p",
-		src_addr, dst_addr, off, len, rep_h, rep, part);
+		ctx, src_addr, dst_addr, off, len, rep_h, rep, part);
 
 	int ret;
 
@@ -116,9 +121,18 @@ sync_copy_data(void *src_addr, void *dst_addr, size_t off, size_t len,
 			"copying data (offset 0x%zx length 0x%zx) from local replica -- '%s'",
 			off, len, rep_h->part[0].path);
 
+		unsigned flags = 0;
+		if (part->created)
+			flags |= COPY_DST_ZEROED;
+		if (part->is_dev_dax || part->map_sync)
+			flags |= COPY_DST_PMEM;
+
 		/* copy all data */
-		memcpy(dst_addr, src_addr, len);
-		util_persist(part->is_dev_dax, dst_addr, len);
+		if (copy_data(ctx, desc, dst_addr, src_addr, off, len,
+				flags)) {
+			LOG(1, "copying data from local replica failed");
+			return -1;
+		}
 	}
 
 	return 0;
@@ -805,6 +819,10 @@ sync_badblocks_data(struct pool_set *set, struct poolset_health_status *set_hs)
 
 	struct pool_replica *rep_h;
 
+	struct copy_ctx *ctx = copy_new(0 /* no progress */);
+	if (ctx == NULL)
+		return -1;
+
 	for (unsigned r = 0; r < set->nreplicas; ++r) {
 		struct pool_replica *rep = REP(set, r);
 		struct replica_health_status *rep_hs = set_hs->replica[r];
@@ -837,10 +855,12 @@ sync_badblocks_data(struct pool_set *set, struct poolset_health_status *set_hs)
 								part_off + off);
 				void *dst_addr = ADDR_SUM(part->addr, off);
 
-				if (sync_copy_data(src_addr, dst_addr,
-							part_off + off, len,
-							rep_h, rep, part))
+				if (sync_copy_data(ctx, NULL, src_addr,
+						dst_addr, part_off + off, len,
+						rep_h, rep, part)) {
+					copy_delete(ctx);
 					return -1;
+				}
 			}
 
 			/* free array of bad blocks */
@@ -855,6 +875,8 @@ sync_badblocks_data(struct pool_set *set, struct poolset_health_status *set_hs)
 		sync_mark_replica_no_badblocks(r, set_hs);
 	}
 
+	copy_delete(ctx);
+
 	LOG(1, "all bad blocks have been fixed");
 
 	if (replica_remove_all_recovery_files(set_hs)) {
@@ -1091,14 +1113,27 @@ copy_data_to_broken_parts(struct pool_set *set, unsigned healthy_replica,
 
 	/* get pool size from healthy replica */
 	size_t poolsize = set->poolsize;
+	struct pool_replica *rep_h = REP(set, healthy_replica);
 
+	struct copy_ctx *ctx = copy_new(report_progress(flags));
+	if (ctx == NULL)
+		return -1;
+
+	/* unused parts of the heap do not have to be copied to new parts */
+	if (!rep_h->remote &&
+			copy_skip_unused_heap(ctx, rep_h->part[0].addr,
+				poolsize)) {
+		copy_delete(ctx);
+		return -1;
+	}
+
+	int ret = 0;
 	for (unsigned r = 0; r < set_hs->nreplicas; ++r) {
 		/* skip unbroken and consistent replicas */
 		if (replica_is_replica_healthy(r, set_hs))
 			continue;
 
 		struct pool_replica *rep = REP(set, r);
-		struct pool_replica *rep_h = REP(set, healthy_replica);
 
 		for (unsigned p = 0; p < rep->nparts; ++p) {
 			/* skip unbroken parts from consistent replicas */
@@ -1126,14 +1161,216 @@ copy_data_to_broken_parts(struct pool_set *set, unsigned healthy_replica,
 			void *src_addr = ADDR_SUM(rep_h->part[0].addr, off);
 			void *dst_addr = ADDR_SUM(part->addr, fpoff);
 
-			if (sync_copy_data(src_addr, dst_addr, off, len,
-						rep_h, rep, part))
-				return -1;
+			char desc[64];
+			util_snprintf(desc, sizeof(desc),
+				"replica %u part %u", r, p);
+
+			if (sync_copy_data(ctx, desc, src_addr, dst_addr,
+						off, len, rep_h, rep, part)) {
+				ret = -1;
+				goto out;
+			}
 		}
 	}
+
+out:
+	copy_delete(ctx);
+	return ret;
+}
+
+/*
+ * copy_dirty_region -- (internal) copy a region modified since the last sync
+ *                      to all the parts of a replica which were not
+ *                      recreated
+ */
+static int
+copy_dirty_region(struct copy_ctx *ctx, struct pool_set *set,
+		unsigned healthy_replica, unsigned repn, size_t off, size_t len,
+		struct poolset_health_status *set_hs)
+{
+	LOG(3, "ctx %p, set %p, healthy_replica %u, repn %u, off %zu, len %zu, "
+		"set_hs %p", ctx, set, healthy_replica, repn, off, len,
+		set_hs);
+
+	struct pool_replica *rep_h = REP(set, healthy_replica);
+	struct pool_replica *rep = REP(set, repn);
+
+	/* the pool header is not a part of the replicated data */
+	if (off < POOL_HDR_SIZE) {
+		if (off + len <= POOL_HDR_SIZE)
+			return 0;
+		len -= POOL_HDR_SIZE - off;
+		off = POOL_HDR_SIZE;
+	}
+
+	/* recreated replicas already contain all the data */
+	if (rep->remote) {
+		if (!replica_is_replica_healthy(repn, set_hs))
+			return 0;
+
+		return sync_copy_data(ctx, NULL,
+				ADDR_SUM(rep_h->part[0].addr, off), NULL,
+				off, len, rep_h, rep, PART(rep, 0));
+	}
+
+	for (unsigned p = 0; p < rep->nparts; ++p) {
+		/* recreated parts already contain all the data */
+		if (replica_is_part_broken(repn, p, set_hs) ||
+		    !replica_is_replica_consistent(repn, set_hs))
+			continue;
+
+		const struct pool_set_part *part = &rep->part[p];
+
+		size_t poff = replica_get_part_data_offset(set, repn, p);
+		size_t plen = replica_get_part_data_len(set, repn, p);
+
+		size_t begin = off > poff ? off : poff;
+		size_t end = off + len < poff + plen ? off + len : poff + plen;
+		if (begin >= end)
+			continue;
+
+		/* first part of replica is mapped with header */
+		size_t fpoff = (p == 0) ? POOL_HDR_SIZE : 0;
+		void *src_addr = ADDR_SUM(rep_h->part[0].addr, begin);
+		void *dst_addr = ADDR_SUM(part->addr, fpoff + begin - poff);
+
+		if (sync_copy_data(ctx, NULL, src_addr, dst_addr,
+				begin, end - begin, rep_h, rep, part))
+			return -1;
+	}
+
 	return 0;
 }
 
+/*
+ * clear_dirty_maps -- (internal) unmark all the regions in all the replicas
+ */
+static int
+clear_dirty_maps(struct pool_set *set)
+{
+	LOG(3, "set %p", set);
+
+	size_t off = offsetof(struct pmemobjpool, dirtymap_persistent.bits);
+	size_t len = sizeof(((struct pmemobjpool *)NULL)->
+			dirtymap_persistent.bits);
+
+	/* remote replicas are updated from the first, always local, replica */
+	for (unsigned r = 0; r < set->nreplicas; ++r) {
+		struct pool_replica *rep = REP(set, r);
+		if (rep->remote)
+			continue;
+
+		void *bits = ADDR_SUM(rep->part[0].addr, off);
+		memset(bits, 0, len);
+		util_persist(PART(rep, 0)->is_dev_dax, bits, len);
+	}
+
+	for (unsigned r = 0; r < set->nreplicas; ++r) {
+		struct pool_replica *rep = REP(set, r);
+		if (!rep->remote)
+			continue;
+
+		if (Rpmem_persist(rep->remote->rpp, off, len, 0, 0)) {
+			LOG(1, "clearing dirty map failed -- '%s' on '%s'",
+				rep->remote->pool_desc,
+				rep->remote->node_addr);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * copy_dirty_regions -- (internal) copy the regions modified since the last
+ *                       sync from the healthy replica to all the other
+ *                       replicas and clear their dirty maps
+ *
+ * Regions which were modified while the replicas were not being synced
+ * (e.g. the application crashed) are marked in the pool descriptors,
+ * so only these regions have to be copied to bring the replicas back in sync.
+ */
+static int
+copy_dirty_regions(struct pool_set *set, unsigned healthy_replica,
+		unsigned flags, struct poolset_health_status *set_hs)
+{
+	LOG(3, "set %p, healthy_replica %u, flags %u, set_hs %p", set,
+			healthy_replica, flags, set_hs);
+
+	if (!replica_is_poolset_dirty(set_hs))
+		return 0;
+
+	const struct dirtymap_persistent *dmap =
+		&REP_HEALTH(set_hs, healthy_replica)->dirtymap;
+
+	size_t poolsize = set->poolsize;
+	size_t region = dmap->shift ? (size_t)1 << dmap->shift : 0;
+
+	/* sum up the size of the marked regions */
+	size_t total = 0;
+	for (size_t n = 0; region && n < DIRTYMAP_NBITS; ++n) {
+		size_t off = n * region;
+		if (off >= poolsize)
+			break;
+		if (!dirtymap_persistent_test(dmap, n))
+			continue;
+		total += off + region > poolsize ?
+			poolsize - off : region;
+	}
+
+	struct copy_ctx *ctx = copy_new(report_progress(flags));
+	if (ctx == NULL)
+		return -1;
+
+	int ret = 0;
+	for (unsigned r = 0; total && r < set_hs->nreplicas; ++r) {
+		if (r == healthy_replica)
+			continue;
+
+		char desc[64];
+		util_snprintf(desc, sizeof(desc),
+			"replica %u dirty regions", r);
+
+		copy_progress_begin(ctx);
+
+		size_t done = 0;
+		for (size_t n = 0; n < DIRTYMAP_NBITS; ++n) {
+			size_t off = n * region;
+			if (off >= poolsize)
+				break;
+			if (!dirtymap_persistent_test(dmap, n))
+				continue;
+
+			/* adjacent regions are copied at once */
+			size_t len = region;
+			while (n + 1 < DIRTYMAP_NBITS && off + len < poolsize &&
+			    dirtymap_persistent_test(dmap, n + 1)) {
+				len += region;
+				n++;
+			}
+			if (off + len > poolsize)
+				len = poolsize - off;
+
+			if (copy_dirty_region(ctx, set, healthy_replica, r,
+					off, len, set_hs)) {
+				ret = -1;
+				goto out;
+			}
+
+			done += len;
+			copy_progress(ctx, desc, done, 0, total, 0);
+		}
+
+		copy_progress(ctx, desc, done, 0, total, 1);
+	}
+
+	ret = clear_dirty_maps(set);
+
+out:
+	copy_delete(ctx);
+	return ret;
+}
+
 /*
  * grant_created_parts_perm -- (internal) set RW permission rights to all
  *                            the parts created in place of the broken ones
@@ -1492,8 +1729,12 @@ replica_sync(struct pool_set *set, struct poolset_health_status *s_hs,
 			return -1;
 		}
 
-		/* check if poolset is broken; if not, nothing to do */
-		if (replica_is_poolset_healthy(set_hs)) {
+		/*
+		 * check if poolset is broken or was modified without being
+		 * synced; if not, nothing to do
+		 */
+		if (replica_is_poolset_healthy(set_hs) &&
+		    !replica_is_poolset_dirty(set_hs)) {
 			LOG(1, "poolset is healthy");
 			goto out;
 		}
@@ -1626,6 +1867,13 @@ replica_sync(struct pool_set *set, struct poolset_health_status *s_hs,
 		goto out;
 	}
 
+	/* copy data modified since the last sync to all the other replicas */
+	if (copy_dirty_regions(set, healthy_replica, flags, set_hs)) {
+		ERR("copying dirty regions failed");
+		ret = -1;
+		goto out;
+	}
+
 	/* update uuids of replicas and parts */
 	if (update_uuids(set, set_hs)) {
 		ERR("updating uuids failed");
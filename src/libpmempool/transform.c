@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2016-2019, Intel Corporation */
+/* Copyright 2016-2020, Intel Corporation */
 
 /*
  * transform.c -- a module for poolset transforming
@@ -15,6 +15,7 @@
 #include <dirent.h>
 #include <assert.h>
 
+#include "copy.h"
 #include "replica.h"
 #include "out.h"
 #include "file.h"
@@ -22,6 +23,9 @@
 #include "libpmem.h"
 #include "util_pmem.h"
 
+/* number of blocks copied between progress reports */
+#define PROGRESS_BLOCKS 256
+
 /*
  * poolset_compare_status - a helping structure for gathering corresponding
  *                          replica numbers when comparing poolsets
@@ -549,9 +553,10 @@ delete_replicas(struct pool_set *set, struct poolset_compare_status *set_s)
  */
 static void
 copy_replica_data_fw(struct pool_set *set_dst, struct pool_set *set_src,
-		unsigned repn)
+		unsigned repn, struct copy_ctx *ctx)
 {
-	LOG(3, "set_in %p, set_out %p, repn %u", set_src, set_dst, repn);
+	LOG(3, "set_in %p, set_out %p, repn %u, ctx %p", set_src, set_dst,
+			repn, ctx);
 	ssize_t pool_size = replica_get_pool_size(set_src, repn);
 	if (pool_size < 0) {
 		LOG(1, "getting pool size from replica %u failed", repn);
@@ -563,11 +568,26 @@ copy_replica_data_fw(struct pool_set *set_dst, struct pool_set *set_src,
 	void *src = PART(REP(set_src, repn), 1)->addr;
 	void *dst = PART(REP(set_dst, repn), 1)->addr;
 	size_t count = len / POOL_HDR_SIZE;
-	while (count-- > 0) {
+
+	char desc[64];
+	util_snprintf(desc, sizeof(desc), "replica %u", repn);
+	copy_progress_begin(ctx);
+
+	/*
+	 * Both mappings share the part files, so the data has to be moved
+	 * one header-sized block at a time, in order.
+	 */
+	for (size_t i = 0; i < count; ++i) {
 		pmem_memcpy_persist(dst, src, POOL_HDR_SIZE);
 		src = ADDR_SUM(src, POOL_HDR_SIZE);
 		dst = ADDR_SUM(dst, POOL_HDR_SIZE);
+
+		if (i % PROGRESS_BLOCKS == PROGRESS_BLOCKS - 1)
+			copy_progress(ctx, desc, (i + 1) * POOL_HDR_SIZE, 0,
+					len, 0);
 	}
+
+	copy_progress(ctx, desc, count * POOL_HDR_SIZE, 0, len, 1);
 }
 
 /*
@@ -576,9 +596,10 @@ copy_replica_data_fw(struct pool_set *set_dst, struct pool_set *set_src,
  */
 static void
 copy_replica_data_bw(struct pool_set *set_dst, struct pool_set *set_src,
-		unsigned repn)
+		unsigned repn, struct copy_ctx *ctx)
 {
-	LOG(3, "set_in %p, set_out %p, repn %u", set_src, set_dst, repn);
+	LOG(3, "set_in %p, set_out %p, repn %u, ctx %p", set_src, set_dst,
+			repn, ctx);
 	ssize_t pool_size = replica_get_pool_size(set_src, repn);
 	if (pool_size < 0) {
 		LOG(1, "getting pool size from replica %u failed", repn);
@@ -590,11 +611,23 @@ copy_replica_data_bw(struct pool_set *set_dst, struct pool_set *set_src,
 	size_t count = len / POOL_HDR_SIZE;
 	void *src = ADDR_SUM(PART(REP(set_src, repn), 1)->addr, len);
 	void *dst = ADDR_SUM(PART(REP(set_dst, repn), 1)->addr, len);
-	while (count-- > 0) {
+
+	char desc[64];
+	util_snprintf(desc, sizeof(desc), "replica %u", repn);
+	copy_progress_begin(ctx);
+
+	/* see copy_replica_data_fw() */
+	for (size_t i = 0; i < count; ++i) {
 		src = ADDR_SUM(src, -(ssize_t)POOL_HDR_SIZE);
 		dst = ADDR_SUM(dst, -(ssize_t)POOL_HDR_SIZE);
 		pmem_memcpy_persist(dst, src, POOL_HDR_SIZE);
+
+		if (i % PROGRESS_BLOCKS == PROGRESS_BLOCKS - 1)
+			copy_progress(ctx, desc, (i + 1) * POOL_HDR_SIZE, 0,
+					len, 0);
 	}
+
+	copy_progress(ctx, desc, count * POOL_HDR_SIZE, 0, len, 1);
 }
 
 /*
@@ -719,9 +752,9 @@ copy_part_fds(struct pool_set *set_dst, struct pool_set *set_src)
  */
 static int
 remove_hdrs_replica(struct pool_set *set_in, struct pool_set *set_out,
-		unsigned repn)
+		unsigned repn, struct copy_ctx *ctx)
 {
-	LOG(3, "set %p, repn %u", set_in, repn);
+	LOG(3, "set %p, repn %u, ctx %p", set_in, repn, ctx);
 	int ret = 0;
 
 	/* open all part files of the input replica */
@@ -750,7 +783,7 @@ remove_hdrs_replica(struct pool_set *set_in, struct pool_set *set_out,
 
 	/* move data between the two mappings of the replica */
 	if (REP(set_in, repn)->nparts > 1)
-		copy_replica_data_fw(set_out, set_in, repn);
+		copy_replica_data_fw(set_out, set_in, repn, ctx);
 
 	/* make changes to the first part's header */
 	update_replica_header(set_out, repn);
@@ -771,9 +804,9 @@ out:
  */
 static int
 add_hdrs_replica(struct pool_set *set_in, struct pool_set *set_out,
-		unsigned repn)
+		unsigned repn, struct copy_ctx *ctx)
 {
-	LOG(3, "set %p, repn %u", set_in, repn);
+	LOG(3, "set %p, repn %u, ctx %p", set_in, repn, ctx);
 	int ret = 0;
 
 	/* open all part files of the input replica */
@@ -810,7 +843,7 @@ add_hdrs_replica(struct pool_set *set_in, struct pool_set *set_out,
 
 	/* copy data between the two mappings of the replica */
 	if (REP(set_in, repn)->nparts > 1)
-		copy_replica_data_bw(set_out, set_in, repn);
+		copy_replica_data_bw(set_out, set_in, repn, ctx);
 
 	/* create the missing headers */
 	if (create_missing_headers(set_out, repn)) {
@@ -820,7 +853,7 @@ add_hdrs_replica(struct pool_set *set_in, struct pool_set *set_out,
 		 * state
 		 */
 		if (REP(set_in, repn)->nparts > 1)
-			copy_replica_data_fw(set_in, set_out, repn);
+			copy_replica_data_fw(set_in, set_out, repn, ctx);
 		ret = -1;
 		goto out_unmap_out;
 	}
@@ -852,15 +885,22 @@ remove_hdrs(struct pool_set *set_in, struct pool_set *set_out,
 {
 	LOG(3, "set_in %p, set_out %p, set_in_hs %p, flags %u",
 			set_in, set_out, set_in_hs, flags);
+	struct copy_ctx *ctx = copy_new(report_progress(flags));
+	if (ctx == NULL)
+		return -1;
+
 	for (unsigned r = 0; r < set_in->nreplicas; ++r) {
-		if (remove_hdrs_replica(set_in, set_out, r)) {
+		if (remove_hdrs_replica(set_in, set_out, r, ctx)) {
 			LOG(1, "removing headers from replica %u failed", r);
 			/* mark all previous replicas as damaged */
 			while (--r < set_in->nreplicas)
 				REP_HEALTH(set_in_hs, r)->flags |= IS_BROKEN;
+			copy_delete(ctx);
 			return -1;
 		}
 	}
+
+	copy_delete(ctx);
 	return 0;
 }
 
@@ -876,15 +916,22 @@ add_hdrs(struct pool_set *set_in, struct pool_set *set_out,
 {
 	LOG(3, "set_in %p, set_out %p, set_in_hs %p, flags %u",
 			set_in, set_out, set_in_hs, flags);
+	struct copy_ctx *ctx = copy_new(report_progress(flags));
+	if (ctx == NULL)
+		return -1;
+
 	for (unsigned r = 0; r < set_in->nreplicas; ++r) {
-		if (add_hdrs_replica(set_in, set_out, r)) {
+		if (add_hdrs_replica(set_in, set_out, r, ctx)) {
 			LOG(1, "adding headers to replica %u failed", r);
 			/* mark all previous replicas as damaged */
 			while (--r < set_in->nreplicas)
 				REP_HEALTH(set_in_hs, r)->flags |= IS_BROKEN;
+			copy_delete(ctx);
 			return -1;
 		}
 	}
+
+	copy_delete(ctx);
 	return 0;
 }
 
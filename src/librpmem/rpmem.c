@@ -52,6 +52,7 @@ struct rpmem_pool {
 	os_thread_t monitor;
 	int closing;
 	int no_headers;
+	unsigned caps;			/* negotiated protocol capabilities */
 	/*
 	 * Last error code, need to be volatile because it can
 	 * be accessed by multiple threads.
@@ -251,6 +252,36 @@ rpmem_common_fini(RPMEMpool *rpp, int join)
 	free(rpp);
 }
 
+/*
+ * rpmem_retry_without_caps -- prepare for retrying the request without
+ * the capabilities
+ *
+ * Target nodes which do not know the capabilities refuse the requests
+ * containing them and close the connection, so the request has to be sent
+ * again over a new connection.
+ */
+static int
+rpmem_retry_without_caps(RPMEMpool *rpp, struct rpmem_req_attr *req)
+{
+	LOG(3, "rpp %p, req %p", rpp, req);
+
+	if (!req->caps || errno != ECONNRESET)
+		return -1;
+
+	RPMEM_LOG(NOTICE, "retrying request without capabilities");
+
+	(void) rpmem_obc_disconnect(rpp->obc);
+
+	if (rpmem_obc_connect(rpp->obc, rpp->info)) {
+		ERR("!out-of-band connection failed");
+		return -1;
+	}
+
+	req->caps = 0;
+
+	return 0;
+}
+
 /*
  * rpmem_common_fip_init -- common routine for initializing fabric provider
  */
@@ -449,10 +480,13 @@ rpmem_create(const char *target, const char *pool_set_name,
 		.provider	= rpp->provider,
 		.pool_desc	= pool_set_name,
 		.buff_size	= buff_size,
+		.caps		= RPMEM_CAPS_SUPPORTED,
 	};
 
 	struct rpmem_resp_attr resp;
 	int ret = rpmem_obc_create(rpp->obc, &req, &resp, create_attr);
+	if (ret && rpmem_retry_without_caps(rpp, &req) == 0)
+		ret = rpmem_obc_create(rpp->obc, &req, &resp, create_attr);
 	if (ret) {
 		RPMEM_LOG(ERR, "!create request failed");
 		goto err_obc_create;
@@ -462,6 +496,8 @@ rpmem_create(const char *target, const char *pool_set_name,
 			util_is_zeroed(create_attr, sizeof(*create_attr)))
 		rpp->no_headers = 1;
 
+	rpp->caps = resp.caps;
+
 	rpmem_log_resp("create", &resp);
 
 	ret = rpmem_common_fip_init(rpp, &req, &resp,
@@ -526,11 +562,14 @@ rpmem_open(const char *target, const char *pool_set_name,
 		.provider	= rpp->provider,
 		.pool_desc	= pool_set_name,
 		.buff_size	= buff_size,
+		.caps		= RPMEM_CAPS_SUPPORTED,
 	};
 
 	struct rpmem_resp_attr resp;
 
 	int ret = rpmem_obc_open(rpp->obc, &req, &resp, open_attr);
+	if (ret && rpmem_retry_without_caps(rpp, &req) == 0)
+		ret = rpmem_obc_open(rpp->obc, &req, &resp, open_attr);
 	if (ret) {
 		RPMEM_LOG(ERR, "!open request failed");
 		goto err_obc_create;
@@ -539,6 +578,8 @@ rpmem_open(const char *target, const char *pool_set_name,
 	if (open_attr == NULL || util_is_zeroed(open_attr, sizeof(*open_attr)))
 		rpp->no_headers = 1;
 
+	rpp->caps = resp.caps;
+
 	rpmem_log_resp("open", &resp);
 
 	ret = rpmem_common_fip_init(rpp, &req, &resp,
@@ -730,6 +771,78 @@ rpmem_persist(RPMEMpool *rpp, size_t offset, size_t length,
 	return 0;
 }
 
+/*
+ * rpmem_persist_v -- persist operation of multiple ranges on target node
+ *
+ * rpp           -- remote pool handle
+ * ranges        -- ranges to persist
+ * nranges       -- number of ranges
+ * lane          -- lane number
+ * flags         -- additional flags
+ */
+int
+rpmem_persist_v(RPMEMpool *rpp, const struct rpmem_range *ranges,
+	unsigned nranges, unsigned lane, unsigned flags)
+{
+	LOG(3, "rpp %p, ranges %p, nranges %u, lane %d, flags 0x%x",
+			rpp, ranges, nranges, lane, flags);
+
+	if (unlikely(rpp->error)) {
+		errno = rpp->error;
+		return -1;
+	}
+
+	if (flags & RPMEM_PERSIST_FLAGS_MASK) {
+		ERR("invalid flags (0x%x)", flags);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ranges == NULL || nranges == 0) {
+		ERR("invalid ranges (%p, %u)", ranges, nranges);
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (unsigned i = 0; i < nranges; ++i) {
+		if (rpp->no_headers == 0 &&
+				ranges[i].offset < RPMEM_HDR_SIZE) {
+			ERR("offset (%zu) in pool is less than %d bytes",
+					ranges[i].offset, RPMEM_HDR_SIZE);
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	/*
+	 * By default use RDMA SEND persist mode which has atomicity
+	 * guarantees. For relaxed persist use RDMA WRITE.
+	 */
+	unsigned mode = RPMEM_PERSIST_SEND;
+	if (flags & RPMEM_PERSIST_RELAXED)
+		mode = RPMEM_FLUSH_WRITE;
+
+	int ret = 0;
+	if (rpp->caps & RPMEM_CAP_PERSIST_VECTOR) {
+		ret = rpmem_fip_persist_v(rpp->fip, ranges, nranges, lane,
+				mode);
+	} else {
+		/* the target node does not support vectored persist */
+		for (unsigned i = 0; i < nranges && ret == 0; ++i)
+			ret = rpmem_fip_persist(rpp->fip, ranges[i].offset,
+					ranges[i].length, lane, mode);
+	}
+
+	if (unlikely(ret)) {
+		LOG(2, "persist operation failed");
+		rpp->error = ret;
+		errno = rpp->error;
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * rpmem_deep_persist -- deep flush operation on target node
  *
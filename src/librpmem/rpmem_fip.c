@@ -60,6 +60,10 @@ typedef int (*rpmem_fip_drain_fn)(struct rpmem_fip *fip, unsigned lane);
 typedef ssize_t (*rpmem_fip_persist_fn)(struct rpmem_fip *fip, size_t offset,
 		size_t len, unsigned lane, unsigned flags);
 
+typedef int (*rpmem_fip_persist_v_fn)(struct rpmem_fip *fip,
+		const struct rpmem_range *ranges, unsigned nranges,
+		unsigned lane, unsigned flags);
+
 typedef int (*rpmem_fip_init_fn)(struct rpmem_fip *fip);
 typedef void (*rpmem_fip_fini_fn)(struct rpmem_fip *fip);
 
@@ -78,6 +82,7 @@ struct rpmem_fip_ops {
 	rpmem_fip_flush_fn flush;
 	rpmem_fip_drain_fn drain;
 	rpmem_fip_persist_fn persist;
+	rpmem_fip_persist_v_fn persist_v;
 	rpmem_fip_init_fn lanes_init;
 	rpmem_fip_init_fn lanes_init_mem;
 	rpmem_fip_fini_fn lanes_fini;
@@ -791,7 +796,8 @@ rpmem_fip_init_mem_lanes_gpspm(struct rpmem_fip *fip)
 	 * If the completion is required the FI_COMPLETION flag and
 	 * appropriate context should be used.
 	 *
-	 * In GPSPM only the RECV and SEND completions are required.
+	 * In GPSPM only the RECV and SEND completions are required,
+	 * except for the WRITE which has to flush the full WQ.
 	 *
 	 * For RECV the context is RECV operation structure used for
 	 * fi_recvmsg(3) function call.
@@ -811,6 +817,13 @@ rpmem_fip_init_mem_lanes_gpspm(struct rpmem_fip *fip)
 				&fip->lanes[i],
 				0);
 
+		/* WRITE + FI_COMPLETION */
+		rpmem_fip_rma_init(&fip->lanes[i].write_cq,
+				fip->mr_desc, 0,
+				fip->rkey,
+				&fip->lanes[i],
+				FI_COMPLETION);
+
 		/* SEND */
 		rpmem_fip_msg_init(&fip->lanes[i].send,
 				fip->pmsg_mr_desc, 0,
@@ -1485,6 +1498,260 @@ rpmem_fip_persist_apm(struct rpmem_fip *fip, size_t offset,
 	return (ssize_t)len;
 }
 
+/*
+ * rpmem_fip_write_v -- (internal) post WRITEs of all ranges without waiting
+ * for their completions
+ */
+static int
+rpmem_fip_write_v(struct rpmem_fip *fip, const struct rpmem_range *ranges,
+	unsigned nranges, unsigned lane)
+{
+	struct rpmem_fip_plane *lanep = &fip->lanes[lane];
+	int ret;
+
+	for (unsigned i = 0; i < nranges; i++) {
+		size_t offset = ranges[i].offset;
+		size_t len = ranges[i].length;
+
+		while (len > 0) {
+			size_t tmplen = min(len,
+					fip->fi->ep_attr->max_msg_size);
+			unsigned flags = RPMEM_FLUSH_WRITE;
+
+			ret = rpmem_fip_wq_flush_check(fip, lanep, &flags);
+			if (unlikely(ret))
+				return ret;
+
+			ret = rpmem_fip_flush_raw(fip, offset, tmplen, lane,
+					flags);
+			if (unlikely(ret))
+				return ret;
+
+			rpmem_fip_wq_inc(lanep);
+
+			offset += tmplen;
+			len -= tmplen;
+		}
+	}
+
+	/* the last WRITE may leave the WQ full */
+	if (rpmem_fip_wq_is_flushing(lanep))
+		return rpmem_fip_wq_flush_wait(fip, lanep);
+
+	return 0;
+}
+
+/*
+ * rpmem_fip_persist_vec_send -- (internal) perform persist operation of
+ * multiple ranges using as few SEND messages as possible
+ *
+ * In the RPMEM_PERSIST_SEND mode the data is inlined in the messages,
+ * otherwise the ranges have to be already written using RMA WRITE.
+ *
+ * The lane has a single SEND and RECV buffer, so every message has to wait
+ * for the response to the previous one. The ranges which do not fit in one
+ * message cost one round-trip per message.
+ */
+static int
+rpmem_fip_persist_vec_send(struct rpmem_fip *fip,
+	const struct rpmem_range *ranges, unsigned nranges,
+	unsigned lane, unsigned mode)
+{
+	struct rpmem_fip_plane *lanep = &fip->lanes[lane];
+	struct rpmem_msg_persist *msg;
+	unsigned i = 0;
+	size_t done = 0; /* part of the current range already sent */
+	int ret;
+
+	while (i < nranges) {
+		ret = rpmem_fip_lane_wait(fip, &lanep->base, FI_SEND);
+		if (unlikely(ret)) {
+			ERR("waiting for SEND completion failed");
+			return ret;
+		}
+
+		msg = rpmem_fip_msg_get_pmsg(&lanep->send);
+		msg->flags = mode | RPMEM_PERSIST_VECTOR;
+		msg->lane = lane;
+		msg->addr = 0;
+		msg->size = 0;
+
+		/* pack as many ranges as fit in the message buffer */
+		size_t used = 0;
+		while (i < nranges) {
+			struct rpmem_msg_persist_range *range =
+				(void *)((uintptr_t)msg->data + used);
+
+			size_t len = ranges[i].length - done;
+			if (len == 0) {
+				i++;
+				done = 0;
+				continue;
+			}
+
+			size_t room = fip->buff_size - used;
+			if (room < rpmem_msg_persist_range_size(mode, 1))
+				break;
+
+			if (mode == RPMEM_PERSIST_SEND) {
+				size_t max = room - sizeof(*range);
+				max &= ~((size_t)RPMEM_PERSIST_RANGE_ALIGN - 1);
+				len = min(len, max);
+			}
+
+			size_t offset = ranges[i].offset + done;
+			range->addr = fip->raddr + offset;
+			range->size = len;
+
+			if (mode == RPMEM_PERSIST_SEND) {
+				void *laddr = (void *)((uintptr_t)fip->laddr +
+						offset);
+				memcpy(range->data, laddr, len);
+			}
+
+			used += rpmem_msg_persist_range_size(mode, len);
+			msg->size++;
+
+			done += len;
+			if (done == ranges[i].length) {
+				i++;
+				done = 0;
+			}
+		}
+
+		/* only empty ranges were left */
+		if (msg->size == 0)
+			break;
+
+		rpmem_fip_lane_begin(&lanep->base, FI_RECV | FI_SEND);
+
+		ret = rpmem_fip_sendmsg(lanep->base.ep, &lanep->send,
+				sizeof(*msg) + used);
+		if (unlikely(ret)) {
+			RPMEM_FI_ERR(ret, "MSG send");
+			return ret;
+		}
+
+		/* wait for persist operation completion */
+		ret = rpmem_fip_lane_wait(fip, &lanep->base, FI_RECV);
+		if (unlikely(ret)) {
+			ERR("waiting for RECV completion failed");
+			return ret;
+		}
+
+		ret = rpmem_fip_post_resp(fip, lanep);
+		if (unlikely(ret)) {
+			ERR("posting RECV buffer failed");
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * rpmem_fip_persist_v_gpspm -- (internal) perform persist operation of
+ * multiple ranges for GPSPM
+ *
+ * All ranges are written first and then persisted by a single persist
+ * message, unless they do not fit in it.
+ */
+static int
+rpmem_fip_persist_v_gpspm(struct rpmem_fip *fip,
+	const struct rpmem_range *ranges, unsigned nranges,
+	unsigned lane, unsigned flags)
+{
+	unsigned mode = flags & RPMEM_FLUSH_PERSIST_MASK;
+	int ret;
+
+	if (mode != RPMEM_PERSIST_SEND) {
+		ret = rpmem_fip_write_v(fip, ranges, nranges, lane);
+		if (unlikely(ret))
+			return ret;
+	}
+
+	ret = rpmem_fip_persist_vec_send(fip, ranges, nranges, lane, mode);
+	if (unlikely(ret))
+		return ret;
+
+	rpmem_fip_wq_set_empty(&fip->lanes[lane]);
+
+	return 0;
+}
+
+/*
+ * rpmem_fip_persist_v_gpspm_sockets -- (internal) perform persist operation
+ * of multiple ranges for GPSPM - sockets provider implementation which
+ * doesn't use the inline persist operation
+ */
+static int
+rpmem_fip_persist_v_gpspm_sockets(struct rpmem_fip *fip,
+	const struct rpmem_range *ranges, unsigned nranges,
+	unsigned lane, unsigned flags)
+{
+	flags = (flags & ~RPMEM_FLUSH_PERSIST_MASK) | RPMEM_FLUSH_WRITE;
+
+	return rpmem_fip_persist_v_gpspm(fip, ranges, nranges, lane, flags);
+}
+
+/*
+ * rpmem_fip_persist_v_raw -- (internal) perform persist operation of
+ * multiple ranges using READ after WRITE mechanism
+ *
+ * All ranges are written first and then a single READ makes sure all of
+ * them reached the remote node.
+ */
+static int
+rpmem_fip_persist_v_raw(struct rpmem_fip *fip,
+	const struct rpmem_range *ranges, unsigned nranges, unsigned lane)
+{
+	int ret = rpmem_fip_write_v(fip, ranges, nranges, lane);
+	if (unlikely(ret))
+		return ret;
+
+	return rpmem_fip_drain_apm(fip, lane);
+}
+
+/*
+ * rpmem_fip_persist_v_apm -- (internal) perform persist operation of
+ * multiple ranges for APM
+ */
+static int
+rpmem_fip_persist_v_apm(struct rpmem_fip *fip,
+	const struct rpmem_range *ranges, unsigned nranges,
+	unsigned lane, unsigned flags)
+{
+	unsigned mode = flags & RPMEM_FLUSH_PERSIST_MASK;
+
+	if (mode == RPMEM_PERSIST_SEND) {
+		int ret = rpmem_fip_persist_vec_send(fip, ranges, nranges,
+				lane, mode);
+		if (unlikely(ret))
+			return ret;
+
+		rpmem_fip_wq_set_empty(&fip->lanes[lane]);
+
+		return 0;
+	}
+
+	return rpmem_fip_persist_v_raw(fip, ranges, nranges, lane);
+}
+
+/*
+ * rpmem_fip_persist_v_apm_sockets -- (internal) perform persist operation
+ * of multiple ranges for APM - sockets provider implementation which
+ * doesn't use the inline persist operation
+ */
+static int
+rpmem_fip_persist_v_apm_sockets(struct rpmem_fip *fip,
+	const struct rpmem_range *ranges, unsigned nranges,
+	unsigned lane, unsigned flags)
+{
+	(void) flags;
+
+	return rpmem_fip_persist_v_raw(fip, ranges, nranges, lane);
+}
+
 /*
  * rpmem_fip_post_lanes_common -- (internal) post all persist response message
  * buffers
@@ -1517,6 +1784,7 @@ rpmem_fip_ops[MAX_RPMEM_PROV][MAX_RPMEM_PM] = {
 			.flush = rpmem_fip_persist_gpspm,
 			.drain = rpmem_fip_drain_nop,
 			.persist = rpmem_fip_persist_gpspm,
+			.persist_v = rpmem_fip_persist_v_gpspm,
 			.lanes_init = rpmem_fip_init_lanes_common,
 			.lanes_init_mem = rpmem_fip_init_mem_lanes_gpspm,
 			.lanes_fini = rpmem_fip_fini_lanes_common,
@@ -1526,6 +1794,7 @@ rpmem_fip_ops[MAX_RPMEM_PROV][MAX_RPMEM_PM] = {
 			.flush = rpmem_fip_flush_apm,
 			.drain = rpmem_fip_drain_apm,
 			.persist = rpmem_fip_persist_apm,
+			.persist_v = rpmem_fip_persist_v_apm,
 			.lanes_init = rpmem_fip_init_lanes_apm,
 			.lanes_init_mem = rpmem_fip_init_mem_lanes_apm,
 			.lanes_fini = rpmem_fip_fini_lanes_apm,
@@ -1537,6 +1806,7 @@ rpmem_fip_ops[MAX_RPMEM_PROV][MAX_RPMEM_PM] = {
 			.flush = rpmem_fip_persist_gpspm_sockets,
 			.drain = rpmem_fip_drain_nop,
 			.persist = rpmem_fip_persist_gpspm_sockets,
+			.persist_v = rpmem_fip_persist_v_gpspm_sockets,
 			.lanes_init = rpmem_fip_init_lanes_common,
 			.lanes_init_mem = rpmem_fip_init_mem_lanes_gpspm,
 			.lanes_fini = rpmem_fip_fini_lanes_common,
@@ -1546,6 +1816,7 @@ rpmem_fip_ops[MAX_RPMEM_PROV][MAX_RPMEM_PM] = {
 			.flush = rpmem_fip_flush_apm,
 			.drain = rpmem_fip_drain_apm,
 			.persist = rpmem_fip_persist_apm_sockets,
+			.persist_v = rpmem_fip_persist_v_apm_sockets,
 			.lanes_init = rpmem_fip_init_lanes_apm,
 			.lanes_init_mem = rpmem_fip_init_mem_lanes_apm,
 			.lanes_fini = rpmem_fip_fini_lanes_apm,
@@ -1812,6 +2083,66 @@ err:
 	return ret;
 }
 
+/*
+ * rpmem_fip_persist_v -- perform remote persist operation of multiple ranges
+ *
+ * The WRITEs of all ranges are chained and followed by a single persist
+ * request (SEND or READ after WRITE), so the whole vector costs one round-trip
+ * instead of one per range.
+ */
+int
+rpmem_fip_persist_v(struct rpmem_fip *fip, const struct rpmem_range *ranges,
+	unsigned nranges, unsigned lane, unsigned flags)
+{
+	RPMEM_ASSERT((flags & RPMEM_FLUSH_PERSIST_MASK) <= RPMEM_PERSIST_MAX);
+	RPMEM_ASSERT(flags != RPMEM_DEEP_PERSIST);
+
+	if (unlikely(rpmem_fip_is_closing(fip)))
+		return ECONNRESET; /* it will be passed to errno */
+
+	RPMEM_ASSERT(lane < fip->nlanes);
+	if (unlikely(lane >= fip->nlanes))
+		return EINVAL; /* it will be passed to errno */
+
+	int empty = 1;
+	for (unsigned i = 0; i < nranges; i++) {
+		size_t offset = ranges[i].offset;
+		size_t len = ranges[i].length;
+
+		if (unlikely(offset >= fip->size || len > fip->size - offset))
+			return EINVAL; /* it will be passed to errno */
+
+		if (len != 0)
+			empty = 0;
+	}
+
+	if (unlikely(empty))
+		return 0;
+
+	/*
+	 * If the persist message cannot carry even a single range entry,
+	 * persist the ranges one by one.
+	 */
+	unsigned mode = flags & RPMEM_FLUSH_PERSIST_MASK;
+	int ret = 0;
+	if (unlikely(fip->buff_size < rpmem_msg_persist_range_size(mode,
+			RPMEM_PERSIST_RANGE_ALIGN))) {
+		for (unsigned i = 0; i < nranges && ret == 0; i++)
+			ret = rpmem_fip_persist(fip, ranges[i].offset,
+					ranges[i].length, lane, flags);
+		return ret;
+	}
+
+	ret = fip->ops->persist_v(fip, ranges, nranges, lane, flags);
+	if (ret)
+		RPMEM_LOG(ERR, "persist operation failed");
+
+	if (unlikely(rpmem_fip_is_closing(fip)))
+		return ECONNRESET; /* it will be passed to errno */
+
+	return ret;
+}
+
 /*
  * rpmem_fip_read -- perform read operation
  */
@@ -18,6 +18,7 @@ extern "C" {
 #endif
 
 struct rpmem_fip;
+struct rpmem_range;
 
 struct rpmem_fip_attr {
 	enum rpmem_provider provider;
@@ -48,6 +49,10 @@ int rpmem_fip_drain(struct rpmem_fip *fip, unsigned lane);
 int rpmem_fip_persist(struct rpmem_fip *fip, size_t offset, size_t len,
 		unsigned lane, unsigned flags);
 
+int rpmem_fip_persist_v(struct rpmem_fip *fip,
+		const struct rpmem_range *ranges, unsigned nranges,
+		unsigned lane, unsigned flags);
+
 int rpmem_fip_read(struct rpmem_fip *fip, void *buff,
 		size_t len, size_t off, unsigned lane);
 void rpmem_fip_probe_fork_safety(void);
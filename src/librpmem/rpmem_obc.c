@@ -140,6 +140,51 @@ rpmem_obc_set_pool_desc(struct rpmem_msg_pool_desc *pool_desc,
 	pool_desc->desc[size - 1] = '\0';
 }
 
+/*
+ * rpmem_obc_msg_caps -- (internal) return the capabilities which follow
+ * the pool descriptor of the request
+ */
+static struct rpmem_msg_caps *
+rpmem_obc_msg_caps(struct rpmem_msg_pool_desc *pool_desc)
+{
+	return (struct rpmem_msg_caps *)&pool_desc->desc[pool_desc->size];
+}
+
+/*
+ * rpmem_obc_caps_size -- (internal) size of the capabilities attached to
+ * the request and its response
+ */
+static inline size_t
+rpmem_obc_caps_size(const struct rpmem_req_attr *req)
+{
+	return req->caps ? sizeof(struct rpmem_msg_caps) : 0;
+}
+
+/*
+ * rpmem_obc_recv_caps -- (internal) receive the capabilities following
+ * the response, if they were requested
+ */
+static int
+rpmem_obc_recv_caps(struct rpmem_obc *rpc, const struct rpmem_req_attr *req,
+	unsigned *caps)
+{
+	*caps = 0;
+
+	if (!req->caps)
+		return 0;
+
+	struct rpmem_msg_caps msg_caps;
+	if (rpmem_ssh_recv(rpc->ssh, &msg_caps, sizeof(msg_caps)))
+		return -1;
+
+	rpmem_ntoh_msg_caps(&msg_caps);
+
+	/* the target node cannot enable what was not requested */
+	*caps = msg_caps.caps & req->caps;
+
+	return 0;
+}
+
 /*
  * rpmem_obc_alloc_create_msg -- (internal) allocate and fill create request
  * message
@@ -149,7 +194,8 @@ rpmem_obc_alloc_create_msg(const struct rpmem_req_attr *req,
 	const struct rpmem_pool_attr *pool_attr, size_t *msg_sizep)
 {
 	size_t pool_desc_size = strlen(req->pool_desc) + 1;
-	size_t msg_size = sizeof(struct rpmem_msg_create) + pool_desc_size;
+	size_t msg_size = sizeof(struct rpmem_msg_create) + pool_desc_size +
+		rpmem_obc_caps_size(req);
 	struct rpmem_msg_create *msg = malloc(msg_size);
 	if (!msg) {
 		ERR("!cannot allocate create request message");
@@ -168,6 +214,9 @@ rpmem_obc_alloc_create_msg(const struct rpmem_req_attr *req,
 	rpmem_obc_set_pool_desc(&msg->pool_desc,
 			req->pool_desc, pool_desc_size);
 
+	if (req->caps)
+		rpmem_obc_msg_caps(&msg->pool_desc)->caps = req->caps;
+
 	if (pool_attr) {
 		pack_rpmem_pool_attr(pool_attr, &msg->pool_attr);
 	} else {
@@ -233,10 +282,11 @@ rpmem_obc_check_hdr_resp(struct rpmem_msg_hdr_resp *resp,
  * rpmem_obc_check_create_resp -- (internal) check create response message
  */
 static int
-rpmem_obc_check_create_resp(struct rpmem_msg_create_resp *resp)
+rpmem_obc_check_create_resp(struct rpmem_msg_create_resp *resp,
+	size_t caps_size)
 {
 	if (rpmem_obc_check_hdr_resp(&resp->hdr, RPMEM_MSG_TYPE_CREATE_RESP,
-			sizeof(struct rpmem_msg_create_resp)))
+			sizeof(struct rpmem_msg_create_resp) + caps_size))
 		return -1;
 
 	if (rpmem_obc_check_ibc_attr(&resp->ibc))
@@ -268,7 +318,8 @@ rpmem_obc_alloc_open_msg(const struct rpmem_req_attr *req,
 	const struct rpmem_pool_attr *pool_attr, size_t *msg_sizep)
 {
 	size_t pool_desc_size = strlen(req->pool_desc) + 1;
-	size_t msg_size = sizeof(struct rpmem_msg_open) + pool_desc_size;
+	size_t msg_size = sizeof(struct rpmem_msg_open) + pool_desc_size +
+		rpmem_obc_caps_size(req);
 	struct rpmem_msg_open *msg = malloc(msg_size);
 	if (!msg) {
 		ERR("!cannot allocate open request message");
@@ -287,6 +338,9 @@ rpmem_obc_alloc_open_msg(const struct rpmem_req_attr *req,
 	rpmem_obc_set_pool_desc(&msg->pool_desc,
 			req->pool_desc, pool_desc_size);
 
+	if (req->caps)
+		rpmem_obc_msg_caps(&msg->pool_desc)->caps = req->caps;
+
 	*msg_sizep = msg_size;
 	return msg;
 }
@@ -295,10 +349,11 @@ rpmem_obc_alloc_open_msg(const struct rpmem_req_attr *req,
  * rpmem_obc_check_open_resp -- (internal) check open response message
  */
 static int
-rpmem_obc_check_open_resp(struct rpmem_msg_open_resp *resp)
+rpmem_obc_check_open_resp(struct rpmem_msg_open_resp *resp,
+	size_t caps_size)
 {
 	if (rpmem_obc_check_hdr_resp(&resp->hdr, RPMEM_MSG_TYPE_OPEN_RESP,
-			sizeof(struct rpmem_msg_open_resp)))
+			sizeof(struct rpmem_msg_open_resp) + caps_size))
 		return -1;
 
 	if (rpmem_obc_check_ibc_attr(&resp->ibc))
@@ -467,6 +522,8 @@ rpmem_obc_create(struct rpmem_obc *rpc,
 
 	RPMEM_LOG(INFO, "sending create request message");
 
+	if (req->caps)
+		rpmem_hton_msg_caps(rpmem_obc_msg_caps(&msg->pool_desc));
 	rpmem_hton_msg_create(msg);
 	if (rpmem_ssh_send(rpc->ssh, msg, msg_size)) {
 		ERR("!sending create request message failed");
@@ -483,14 +540,21 @@ rpmem_obc_create(struct rpmem_obc *rpc,
 		goto err_msg_recv;
 	}
 
+	unsigned caps;
+	if (rpmem_obc_recv_caps(rpc, req, &caps)) {
+		ERR("!receiving capabilities failed");
+		goto err_msg_recv;
+	}
+
 	RPMEM_LOG(NOTICE, "create request response received");
 
 	rpmem_ntoh_msg_create_resp(&resp);
 
-	if (rpmem_obc_check_create_resp(&resp))
+	if (rpmem_obc_check_create_resp(&resp, rpmem_obc_caps_size(req)))
 		goto err_msg_resp;
 
 	rpmem_obc_get_res(res, &resp.ibc);
+	res->caps = caps;
 
 	free(msg);
 	return 0;
@@ -532,6 +596,8 @@ rpmem_obc_open(struct rpmem_obc *rpc,
 
 	RPMEM_LOG(INFO, "sending open request message");
 
+	if (req->caps)
+		rpmem_hton_msg_caps(rpmem_obc_msg_caps(&msg->pool_desc));
 	rpmem_hton_msg_open(msg);
 	if (rpmem_ssh_send(rpc->ssh, msg, msg_size)) {
 		ERR("!sending open request message failed");
@@ -547,14 +613,21 @@ rpmem_obc_open(struct rpmem_obc *rpc,
 		goto err_msg_recv;
 	}
 
+	unsigned caps;
+	if (rpmem_obc_recv_caps(rpc, req, &caps)) {
+		ERR("!receiving capabilities failed");
+		goto err_msg_recv;
+	}
+
 	RPMEM_LOG(NOTICE, "open request response received");
 
 	rpmem_ntoh_msg_open_resp(&resp);
 
-	if (rpmem_obc_check_open_resp(&resp))
+	if (rpmem_obc_check_open_resp(&resp, rpmem_obc_caps_size(req)))
 		goto err_msg_resp;
 
 	rpmem_obc_get_res(res, &resp.ibc);
+	res->caps = caps;
 	if (pool_attr)
 		unpack_rpmem_pool_attr(&resp.pool_attr, pool_attr);
 
@@ -89,6 +89,7 @@ struct rpmem_req_attr {
 	size_t buff_size;
 	enum rpmem_provider provider;
 	const char *pool_desc;
+	unsigned caps; /* capabilities to negotiate, 0 to skip negotiation */
 };
 
 /*
@@ -100,6 +101,7 @@ struct rpmem_resp_attr {
 	uint64_t raddr;
 	unsigned nlanes;
 	enum rpmem_persist_method persist_method;
+	unsigned caps; /* negotiated capabilities */
 };
 
 #define RPMEM_HAS_USER		0x1
@@ -82,6 +82,20 @@ struct rpmem_msg_pool_desc {
 	uint8_t desc[0];	/* pool descriptor, null-terminated string */
 } PACKED;
 
+/*
+ * rpmem_msg_caps -- protocol capabilities
+ *
+ * May follow the pool descriptor of the create and open requests. Daemons
+ * which do not know it refuse such requests, otherwise the response is
+ * followed by the capabilities supported by both sides.
+ */
+struct rpmem_msg_caps {
+	uint32_t caps;			/* mask of RPMEM_CAP_* flags */
+} PACKED;
+
+#define RPMEM_CAP_PERSIST_VECTOR (1U << 0) /* vectored persist messages */
+#define RPMEM_CAPS_SUPPORTED (RPMEM_CAP_PERSIST_VECTOR)
+
 /*
  * rpmem_msg_hdr -- message header which consists of type and size of message
  *
@@ -123,6 +137,8 @@ struct rpmem_msg_common {
  * The type of message must be set to RPMEM_MSG_TYPE_CREATE.
  * The size of message must be set to
  *     sizeof(struct rpmem_msg_create) + pool_desc_size
+ * increased by sizeof(struct rpmem_msg_caps) if the capabilities follow
+ * the pool descriptor.
  */
 struct rpmem_msg_create {
 	struct rpmem_msg_hdr hdr;	/* message header */
@@ -135,7 +151,9 @@ struct rpmem_msg_create {
  * rpmem_msg_create_resp -- create request response message
  *
  * The type of message must be set to RPMEM_MSG_TYPE_CREATE_RESP.
- * The size of message must be set to sizeof(struct rpmem_msg_create_resp).
+ * The size of message must be set to sizeof(struct rpmem_msg_create_resp)
+ * increased by sizeof(struct rpmem_msg_caps) if the request contained the
+ * capabilities.
  */
 struct rpmem_msg_create_resp {
 	struct rpmem_msg_hdr_resp hdr;	/* message header */
@@ -148,6 +166,8 @@ struct rpmem_msg_create_resp {
  * The type of message must be set to RPMEM_MSG_TYPE_OPEN.
  * The size of message must be set to
  *     sizeof(struct rpmem_msg_open) + pool_desc_size
+ * increased by sizeof(struct rpmem_msg_caps) if the capabilities follow
+ * the pool descriptor.
  */
 struct rpmem_msg_open {
 	struct rpmem_msg_hdr hdr;	/* message header */
@@ -160,6 +180,8 @@ struct rpmem_msg_open {
  *
  * The type of message must be set to RPMEM_MSG_TYPE_OPEN_RESP.
  * The size of message must be set to sizeof(struct rpmem_msg_open_resp)
+ * increased by sizeof(struct rpmem_msg_caps) if the request contained the
+ * capabilities.
  */
 struct rpmem_msg_open_resp {
 	struct rpmem_msg_hdr_resp hdr;	/* message header */
@@ -193,6 +215,7 @@ struct rpmem_msg_close_resp {
 #define RPMEM_DEEP_PERSIST	1U	/* deep persist operation */
 #define RPMEM_PERSIST_SEND	2U	/* persist using RDMA SEND */
 #define RPMEM_COMPLETION	4U	/* schedule command with a completion */
+#define RPMEM_PERSIST_VECTOR	8U	/* persist a vector of ranges */
 
 /* the two least significant bits are reserved for mode of persist */
 #define RPMEM_FLUSH_PERSIST_MASK	0x3U
@@ -201,6 +224,11 @@ struct rpmem_msg_close_resp {
 
 /*
  * rpmem_msg_persist -- remote persist message
+ *
+ * If the RPMEM_PERSIST_VECTOR flag is set the size is the number of
+ * rpmem_msg_persist_range entries stored in the data and the address is
+ * not used. The flag may be used only if the RPMEM_CAP_PERSIST_VECTOR
+ * capability was negotiated.
  */
 struct rpmem_msg_persist {
 	uint32_t flags; /* lane flags */
@@ -210,6 +238,35 @@ struct rpmem_msg_persist {
 	uint8_t data[];
 };
 
+/*
+ * rpmem_msg_persist_range -- single range of the vectored persist message
+ *
+ * In the RPMEM_PERSIST_SEND mode the range is followed by its data, padded
+ * to the multiple of RPMEM_PERSIST_RANGE_ALIGN bytes.
+ */
+struct rpmem_msg_persist_range {
+	uint64_t addr;	/* remote memory address */
+	uint64_t size;	/* remote memory size */
+	uint8_t data[];
+};
+
+#define RPMEM_PERSIST_RANGE_ALIGN	8
+
+/*
+ * rpmem_msg_persist_range_size -- size of the range entry of the vectored
+ * persist message
+ */
+static inline size_t
+rpmem_msg_persist_range_size(unsigned mode, uint64_t size)
+{
+	size_t entry = sizeof(struct rpmem_msg_persist_range);
+	if (mode == RPMEM_PERSIST_SEND)
+		entry += (size + RPMEM_PERSIST_RANGE_ALIGN - 1) &
+			~((uint64_t)RPMEM_PERSIST_RANGE_ALIGN - 1);
+
+	return entry;
+}
+
 /*
  * rpmem_msg_persist_resp -- remote persist response message
  */
@@ -277,6 +334,24 @@ rpmem_ntoh_pool_attr(struct rpmem_pool_attr_packed *attr)
 	attr->compat_features = be32toh(attr->compat_features);
 }
 
+/*
+ * rpmem_ntoh_msg_caps -- convert rpmem_msg_caps to host byte order
+ */
+static inline void
+rpmem_ntoh_msg_caps(struct rpmem_msg_caps *caps)
+{
+	caps->caps = be32toh(caps->caps);
+}
+
+/*
+ * rpmem_hton_msg_caps -- convert rpmem_msg_caps to network byte order
+ */
+static inline void
+rpmem_hton_msg_caps(struct rpmem_msg_caps *caps)
+{
+	rpmem_ntoh_msg_caps(caps);
+}
+
 /*
  * rpmem_ntoh_msg_hdr -- convert rpmem_msg_hdr to host byte order
  */
@@ -3,11 +3,14 @@
 
 /*
  * blk_rw.c -- unit test for pmemblk_read/write/set_zero/set_error
+ *	and pmemblk_readv/writev
  *
  * usage: blk_rw bsize file func operation:lba...
  *
  * func is 'c' or 'o' (create or open)
  * operations are 'r' or 'w' or 'z' or 'e'
+ * batched operations are 'R' or 'W' followed by a comma-separated
+ * list of lbas, e.g. W:5,3,4
  *
  */
 
@@ -51,6 +54,62 @@ ident(unsigned char *buf)
 	return descr;
 }
 
+#define MAX_BATCH 16
+
+/*
+ * parse_batch -- parse a comma-separated list of lbas
+ */
+static size_t
+parse_batch(const char *arg, long long *lbas)
+{
+	size_t n = 0;
+	char *end;
+
+	do {
+		if (n == MAX_BATCH)
+			UT_FATAL("too many lbas in a batch");
+		lbas[n++] = strtoll(arg, &end, 0);
+		arg = end + 1;
+	} while (*end == ',');
+
+	return n;
+}
+
+/*
+ * do_batch -- perform a batched read or write
+ */
+static void
+do_batch(PMEMblkpool *handle, char op, const char *arg)
+{
+	long long lbas[MAX_BATCH];
+	size_t n = parse_batch(arg, lbas);
+
+	unsigned char *bufs = MALLOC(n * Bsize);
+
+	if (op == 'R') {
+		if (pmemblk_readv(handle, bufs, lbas, n) < 0) {
+			UT_OUT("!readv     %s", arg);
+		} else {
+			for (size_t i = 0; i < n; i++)
+				UT_OUT("readv     lba %lld: %s", lbas[i],
+						ident(bufs + i * Bsize));
+		}
+	} else {
+		for (size_t i = 0; i < n; i++)
+			construct(bufs + i * Bsize);
+
+		if (pmemblk_writev(handle, bufs, lbas, n) < 0) {
+			UT_OUT("!writev    %s", arg);
+		} else {
+			for (size_t i = 0; i < n; i++)
+				UT_OUT("writev    lba %lld: %s", lbas[i],
+						ident(bufs + i * Bsize));
+		}
+	}
+
+	FREE(bufs);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -87,8 +146,15 @@ main(int argc, char *argv[])
 
 	/* map each file argument with the given map type */
 	for (int arg = 4; arg < argc; arg++) {
-		if (strchr("rwze", argv[arg][0]) == NULL || argv[arg][1] != ':')
-			UT_FATAL("op must be r: or w: or z: or e:");
+		if (strchr("rwzeRW", argv[arg][0]) == NULL ||
+				argv[arg][1] != ':')
+			UT_FATAL("op must be r: or w: or z: or e: or R: or W:");
+
+		if (argv[arg][0] == 'R' || argv[arg][0] == 'W') {
+			do_batch(handle, argv[arg][0], &argv[arg][2]);
+			continue;
+		}
+
 		os_off_t lba = strtol(&argv[arg][2], NULL, 0);
 
 		switch (argv[arg][0]) {
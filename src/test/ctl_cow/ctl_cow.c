@@ -1,13 +1,15 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2019, Intel Corporation */
+/* Copyright 2019-2020, Intel Corporation */
 
 /*
  * ctl_cow.c -- unit tests for copy on write feature which check
  * if changes are reverted after pool close when copy_on_write.at_open = 1
+ * and if pmemobj_checkpoint writes them back to the pool
  */
 
 #include <stddef.h>
 #include "unittest.h"
+#include "obj.h"
 #include <string.h>
 
 struct test_st {
@@ -64,6 +66,71 @@ test_obj(const char *path)
 	pmemobj_close(pop);
 }
 
+/*
+ * test_checkpoint -- modifies the pool opened in the copy-on-write mode,
+ *	commits the modifications and modifies the pool again
+ */
+static void
+test_checkpoint(const char *path, int fail)
+{
+	PMEMobjpool *pop = pmemobj_open(path, NULL);
+	if (pop == NULL)
+		UT_FATAL("!%s: pmemobj_open", path);
+
+	TOID(struct my_root) root = POBJ_ROOT(pop, struct my_root);
+
+	TX_BEGIN(pop) {
+		TX_ADD(root);
+		TOID(struct test_st) x = TX_NEW(struct test_st);
+		TOID(struct test_st) y = TX_NEW(struct test_st);
+		D_RW(x)->x = 5;
+		D_RW(y)->x = 10;
+		D_RW(root)->x = x;
+		D_RW(root)->y = y;
+	} TX_ONABORT {
+		abort();
+	} TX_END
+
+	if (fail && pmemobj_fault_injection_enabled()) {
+		/* fail after the journal is written, just like a crash would */
+		pmemobj_inject_fault_at(PMEM_MALLOC, 1, "checkpoint_commit");
+		UT_ASSERTeq(pmemobj_checkpoint(pop), -1);
+		UT_ASSERTeq(errno, ENOMEM);
+	} else {
+		UT_ASSERTeq(pmemobj_checkpoint(pop), 0);
+		/* nothing has changed since the last checkpoint */
+		UT_ASSERTeq(pmemobj_checkpoint(pop), 0);
+	}
+
+	/* this modification is never committed */
+	TOID(struct test_st) x = D_RO(root)->x;
+	D_RW(x)->x = 50;
+	pmemobj_persist(pop, &D_RW(x)->x, sizeof(D_RW(x)->x));
+
+	pmemobj_close(pop);
+}
+
+/*
+ * test_verify -- checks the state of the pool after the checkpoint
+ */
+static void
+test_verify(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_open(path, NULL);
+	if (pop == NULL)
+		UT_FATAL("!%s: pmemobj_open", path);
+
+	TOID(struct my_root) root = POBJ_ROOT(pop, struct my_root);
+	UT_ASSERTeq(D_RO(D_RO(root)->x)->x, 5);
+	UT_ASSERTeq(D_RO(D_RO(root)->y)->x, 10);
+
+	/* the pool is not opened in the copy-on-write mode */
+	UT_ASSERTeq(pmemobj_checkpoint(pop), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	pmemobj_close(pop);
+}
+
 static void
 test_blk(const char *path)
 {
@@ -124,7 +191,9 @@ main(int argc, char *argv[])
 	START(argc, argv, "ctl_cow");
 
 	if (argc < 3)
-		UT_FATAL("usage: %s filename obj|log|blk|dax", argv[0]);
+		UT_FATAL("usage: %s filename "
+			"obj|log|blk|dax|checkpoint|checkpoint_fail|verify",
+			argv[0]);
 
 	const char *path = argv[1];
 	const char *action = argv[2];
@@ -132,6 +201,15 @@ main(int argc, char *argv[])
 	if (strcmp(action, "obj") == 0) {
 		test_obj(path);
 
+	} else if (strcmp(action, "checkpoint") == 0) {
+		test_checkpoint(path, 0);
+
+	} else if (strcmp(action, "checkpoint_fail") == 0) {
+		test_checkpoint(path, 1);
+
+	} else if (strcmp(action, "verify") == 0) {
+		test_verify(path);
+
 	} else if (strcmp(action, "blk") == 0) {
 		test_blk(path);
 
@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2017-2018, Intel Corporation */
+/* Copyright 2017-2020, Intel Corporation */
 
 /*
  * obj_ctl_alloc_class.c -- tests for the ctl entry points: heap.alloc_class
@@ -263,19 +263,117 @@ many(const char *path)
 	pmemobj_close(pop);
 }
 
+#define PROPOSAL_NALLOCS 1000
+#define PROPOSAL_SIZE 200
+
+static void
+proposal(const char *path)
+{
+	PMEMobjpool *pop;
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 20,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "heap.alloc_class.histogram",
+		&enabled);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid oid;
+	for (int i = 0; i < PROPOSAL_NALLOCS; ++i) {
+		ret = pmemobj_alloc(pop, &oid, PROPOSAL_SIZE, 0, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	/* the default class has 256 bytes units */
+	UT_ASSERTeq(pmemobj_alloc_usable_size(oid), 240);
+
+	struct pobj_alloc_class_proposal p;
+	p.apply = 0;
+	ret = pmemobj_ctl_exec(pop, "heap.alloc_class.propose", &p);
+	UT_ASSERTeq(ret, 0);
+
+	/* the size is rounded up to 208 bytes, 224 with the header */
+	UT_ASSERTeq(p.nclasses, 1);
+	UT_ASSERTeq(p.desc[0].unit_size, 224);
+	UT_ASSERTeq(p.desc[0].header_type, POBJ_HEADER_COMPACT);
+	UT_ASSERT(p.desc[0].units_per_block >= 200);
+	UT_ASSERTeq(p.requested_bytes, PROPOSAL_NALLOCS * 208);
+	UT_ASSERTeq(p.wasted_bytes, PROPOSAL_NALLOCS * (256 - 224));
+	UT_ASSERTeq(p.proposed_wasted_bytes, 0);
+
+	/* nothing changes until the proposal is applied */
+	ret = pmemobj_alloc(pop, &oid, PROPOSAL_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemobj_alloc_usable_size(oid), 240);
+
+	/* the recorded sizes are kept after the histogram is disabled */
+	enabled = 0;
+	ret = pmemobj_ctl_set(pop, "heap.alloc_class.histogram", &enabled);
+	UT_ASSERTeq(ret, 0);
+	ret = pmemobj_ctl_get(pop, "heap.alloc_class.histogram", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	p.apply = 1;
+	ret = pmemobj_ctl_exec(pop, "heap.alloc_class.propose", &p);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(p.nclasses, 1);
+	UT_ASSERTne(p.desc[0].class_id, 0);
+
+	ret = pmemobj_alloc(pop, &oid, PROPOSAL_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemobj_alloc_usable_size(oid), 208);
+
+	/* the applied classes make the same proposal pointless */
+	struct pobj_alloc_class_proposal p2;
+	p2.apply = 0;
+	ret = pmemobj_ctl_exec(pop, "heap.alloc_class.propose", &p2);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(p2.nclasses, 0);
+
+	pmemobj_close(pop);
+
+	/* the applied classes are created again when the pool is opened */
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	ret = pmemobj_alloc(pop, &oid, PROPOSAL_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemobj_alloc_usable_size(oid), 208);
+
+	struct pobj_alloc_class_desc desc;
+	char query[1024];
+	SNPRINTF(query, 1024, "heap.alloc_class.%u.desc", p.desc[0].class_id);
+	ret = pmemobj_ctl_get(pop, query, &desc);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(desc.unit_size, 224);
+
+	/* the stored classes are not visible when iterating over objects */
+	int nobjs = 0;
+	POBJ_FOREACH(pop, oid)
+		nobjs++;
+	UT_ASSERTeq(nobjs, PROPOSAL_NALLOCS + 3);
+
+	pmemobj_close(pop);
+}
+
 int
 main(int argc, char *argv[])
 {
 	START(argc, argv, "obj_ctl_alloc_class");
 
 	if (argc != 3)
-		UT_FATAL("usage: %s file-name b|m", argv[0]);
+		UT_FATAL("usage: %s file-name b|m|p", argv[0]);
 
 	const char *path = argv[1];
 	if (argv[2][0] == 'b')
 		basic(path);
 	else if (argv[2][0] == 'm')
 		many(path);
+	else if (argv[2][0] == 'p')
+		proposal(path);
 
 	DONE(NULL);
 }
@@ -116,6 +116,149 @@ main(int argc, char *argv[])
 	UT_ASSERTeq(ret, 0);
 	UT_ASSERTeq(tmp, run_allocated + oid_size);
 
+	/* lock statistics */
+	struct pobj_lock_stats lstats;
+	ret = pmemobj_ctl_get(pop, "stats.locks.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	PMEMoid lock_oid;
+	ret = pmemobj_zalloc(pop, &lock_oid, sizeof(PMEMmutex), 0);
+	UT_ASSERTeq(ret, 0);
+	PMEMmutex *mtx = pmemobj_direct(lock_oid);
+
+	pmemobj_mutex_lock(pop, mtx);
+	pmemobj_mutex_unlock(pop, mtx);
+
+	ret = pmemobj_ctl_get(pop, "stats.locks.mutex", &lstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(lstats.acquired, 0);
+
+	enabled = 1;
+	ret = pmemobj_ctl_set(pop, "stats.locks.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	pmemobj_mutex_lock(pop, mtx);
+	UT_ASSERTeq(pmemobj_mutex_trylock(pop, mtx), EBUSY);
+	pmemobj_mutex_unlock(pop, mtx);
+	UT_ASSERTeq(pmemobj_mutex_trylock(pop, mtx), 0);
+	pmemobj_mutex_unlock(pop, mtx);
+
+	ret = pmemobj_ctl_get(pop, "stats.locks.mutex", &lstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(lstats.acquired, 2);
+	UT_ASSERTeq(lstats.contended, 0);
+	UT_ASSERTeq(lstats.wait_ns, 0);
+	UT_ASSERT(lstats.hold_ns >= lstats.max_hold_ns);
+
+	struct pobj_lock_instance_stats istats;
+	char query[64];
+	int found = 0;
+	for (int i = 0; i < POBJ_LOCK_STATS_MAX_LOCKS; ++i) {
+		SNPRINTF(query, sizeof(query), "stats.locks.lock.%d.stats", i);
+		ret = pmemobj_ctl_get(pop, query, &istats);
+		UT_ASSERTeq(ret, 0);
+		if (istats.lock != mtx)
+			continue;
+
+		UT_ASSERTeq(istats.type, POBJ_LOCK_TYPE_MUTEX);
+		UT_ASSERTeq(istats.stats.acquired, 2);
+		UT_ASSERTeq(istats.stats.contended, 0);
+		found++;
+	}
+	UT_ASSERTeq(found, 1);
+
+	ret = pmemobj_ctl_get(pop, "stats.locks.lock.128.stats", &istats);
+	UT_ASSERTne(ret, 0);
+
+	/* a lock held across disabling is not accounted for hold time */
+	ret = pmemobj_ctl_exec(pop, "stats.locks.reset", NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_mutex_lock(pop, mtx);
+	enabled = 0;
+	ret = pmemobj_ctl_set(pop, "stats.locks.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	enabled = 1;
+	ret = pmemobj_ctl_set(pop, "stats.locks.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_mutex_unlock(pop, mtx);
+
+	ret = pmemobj_ctl_get(pop, "stats.locks.mutex", &lstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(lstats.acquired, 1);
+	UT_ASSERTeq(lstats.hold_ns, 0);
+
+	ret = pmemobj_alloc(pop, NULL, 1, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.locks.bucket", &lstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTne(lstats.acquired, 0);
+
+	ret = pmemobj_ctl_exec(pop, "stats.locks.reset", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.locks.mutex", &lstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(lstats.acquired, 0);
+	UT_ASSERTeq(lstats.hold_ns, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.locks.lock.0.stats", &istats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(istats.lock, NULL);
+
+	/* flush and fence accounting */
+	struct pobj_persist_stats pstats;
+	ret = pmemobj_ctl_get(pop, "stats.persist.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	pmemobj_persist(pop, mtx, sizeof(*mtx));
+
+	ret = pmemobj_ctl_get(pop, "stats.persist.total", &pstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pstats.flushed_lines, 0);
+	UT_ASSERTeq(pstats.fences, 0);
+
+	enabled = 1;
+	ret = pmemobj_ctl_set(pop, "stats.persist.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	pmemobj_flush(pop, mtx, 1);
+	pmemobj_flush(pop, mtx, 1);
+	pmemobj_drain(pop);
+	pmemobj_flush(pop, mtx, 1);
+	pmemobj_memset(pop, mtx, 0, 16, PMEMOBJ_F_MEM_NOFLUSH);
+
+	ret = pmemobj_ctl_get(pop, "stats.persist.total", &pstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pstats.flushed_lines, 3);
+	UT_ASSERTeq(pstats.redundant_lines, 1);
+	UT_ASSERTeq(pstats.fences, 1);
+	UT_ASSERTeq(pstats.temporal_bytes, 16);
+	UT_ASSERTeq(pstats.nontemporal_bytes, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.persist.tx", &pstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pstats.fences, 0);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(lock_oid, 0, sizeof(PMEMmutex));
+	} TX_END
+
+	ret = pmemobj_ctl_get(pop, "stats.persist.tx", &pstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTne(pstats.flushed_lines, 0);
+	UT_ASSERTne(pstats.fences, 0);
+
+	ret = pmemobj_ctl_exec(pop, "stats.persist.reset", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.persist.total", &pstats);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pstats.flushed_lines, 0);
+	UT_ASSERTeq(pstats.fences, 0);
+
 	pmemobj_close(pop);
 
 	DONE(NULL);
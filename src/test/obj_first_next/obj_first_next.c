@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2015-2018, Intel Corporation */
+/* Copyright 2015-2020, Intel Corporation */
 
 /*
  * obj_first_next.c -- unit tests for POBJ_FIRST macro
@@ -231,6 +231,63 @@ do_next_type_sec(int n)
 
 static fn_op do_next[] = {do_next_type, do_next_type_sec};
 
+/*
+ * do_type_index -- enables or disables the type index
+ */
+static void
+do_type_index(int enabled)
+{
+	int ret = pmemobj_ctl_set(pop, "heap.type_index.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	int arg_out = -1;
+	ret = pmemobj_ctl_get(pop, "heap.type_index.enabled", &arg_out);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(arg_out, enabled);
+}
+
+/*
+ * count_cb -- counts the objects visited by pmemobj_foreach_parallel
+ */
+static int
+count_cb(PMEMoid oid, void *arg)
+{
+	unsigned *count = arg;
+
+	uint64_t type_num = pmemobj_type_num(oid);
+	UT_ASSERT(type_num == 0 || type_num == 1);
+
+	util_fetch_and_add32(count, 1);
+
+	return 0;
+}
+
+/*
+ * stop_cb -- terminates pmemobj_foreach_parallel at the first object
+ */
+static int
+stop_cb(PMEMoid oid, void *arg)
+{
+	return 1;
+}
+
+/*
+ * do_count -- prints the number of objects, counted by the given number
+ * of threads
+ */
+static void
+do_count(int nthreads)
+{
+	unsigned count = 0;
+	int ret = pmemobj_foreach_parallel(pop, (unsigned)nthreads,
+		count_cb, &count);
+	UT_ASSERTeq(ret, 0);
+	UT_OUT("count = %u", count);
+
+	ret = pmemobj_foreach_parallel(pop, (unsigned)nthreads, stop_cb, NULL);
+	UT_ASSERTeq(ret, count != 0);
+}
+
 /*
  * do_cleanup -- de-initialization function
  */
@@ -262,6 +319,17 @@ test_internal_object_mask(PMEMobjpool *pop)
 		iter = pmemobj_next(iter)) {
 		UT_ASSERT(OID_EQUALS(iter, oid));
 	}
+
+	/* the same for the iteration by type, with and without the index */
+	for (int enabled = 0; enabled <= 1; ++enabled) {
+		int ret = pmemobj_ctl_set(pop, "heap.type_index.enabled",
+			&enabled);
+		UT_ASSERTeq(ret, 0);
+
+		PMEMoid iter = pmemobj_first_type(pop, 0);
+		UT_ASSERT(OID_EQUALS(iter, oid));
+		UT_ASSERT(OID_IS_NULL(pmemobj_next_type(iter)));
+	}
 }
 
 int
@@ -298,6 +366,12 @@ main(int argc, char *argv[])
 		case 'n':
 			do_next[list_num](id);
 			break;
+		case 'i':
+			do_type_index(list_num);
+			break;
+		case 'c':
+			do_count(list_num);
+			break;
 		default:
 			FATAL_USAGE();
 		}
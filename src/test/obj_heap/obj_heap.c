@@ -5,7 +5,7 @@
  * obj_heap.c -- unit test for heap
  *
  * operations are: 't', 'b', 'r', 'c', 'h', 'a', 'n', 's'
- * t: do test_heap, test_recycler
+ * t: do test_heap, test_run_refill, test_recycler
  * b: do fault_injection in function container_new_ravl
  * r: do fault_injection in function recycler_new
  * c: do fault_injection in function container_new_seglists
@@ -32,6 +32,9 @@
 
 #define MAX_BLOCKS 3
 
+/* must match the limit of the run deltas in heap.c */
+#define RUN_DELTA_MAX_BLOCKS 32
+
 struct mock_pop {
 	PMEMobjpool p;
 	void *heap;
@@ -407,6 +410,9 @@ test_heap_with_size()
 	pop->set->options = 0;
 	pop->set->directory_based = 0;
 
+	struct stats *stats = stats_new(pop);
+	UT_ASSERTne(stats, NULL);
+
 	void *heap_start = (char *)pop + pop->heap_offset;
 	uint64_t heap_size = size - sizeof(PMEMobjpool);
 	struct palloc_heap *heap = &pop->heap;
@@ -417,7 +423,7 @@ test_heap_with_size()
 		&pop->heap_size, p_ops) == 0);
 	UT_ASSERT(heap_boot(heap, heap_start, heap_size,
 		&pop->heap_size,
-		pop, p_ops, NULL, pop->set) == 0);
+		pop, p_ops, stats, pop->set) == 0);
 	UT_ASSERT(heap_buckets_init(heap) == 0);
 	UT_ASSERT(pop->heap.rt != NULL);
 
@@ -445,10 +451,181 @@ test_heap_with_size()
 	heap_cleanup(heap);
 	UT_ASSERT(heap->rt == NULL);
 
+	stats_delete(pop, stats);
 	FREE(pop->set);
 	MUNMAP_ANON_ALIGNED(mpop, size);
 }
 
+/*
+ * run_mark_block -- sets the state of a single unit block in the run bitmap
+ */
+static void
+run_mark_block(const struct memory_block *m, int allocated)
+{
+	struct run_bitmap b;
+	m->m_ops->get_bitmap(m, &b);
+
+	uint64_t bit = 1ULL << (m->block_off % RUN_BITS_PER_VALUE);
+	uint64_t *value = &b.values[m->block_off / RUN_BITS_PER_VALUE];
+
+	if (allocated)
+		*value |= bit;
+	else
+		*value &= ~bit;
+}
+
+/*
+ * run_alloc_block -- allocates a single unit block from the bucket
+ */
+static struct memory_block
+run_alloc_block(struct palloc_heap *heap, struct bucket *b)
+{
+	struct memory_block m = MEMORY_BLOCK_NONE;
+	m.size_idx = 1;
+
+	UT_ASSERTeq(heap_get_bestfit_block(heap, b, &m), 0);
+	UT_ASSERTeq(m.size_idx, 1);
+	run_mark_block(&m, 1);
+
+	return m;
+}
+
+/*
+ * run_free_block -- frees a block the same way palloc does
+ */
+static void
+run_free_block(struct palloc_heap *heap, const struct memory_block *m)
+{
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+
+	util_mutex_lock(lock);
+	run_mark_block(m, 0);
+	heap_memblock_on_free(heap, m);
+	util_mutex_unlock(lock);
+}
+
+/*
+ * test_run_refill -- tests the refill of a bucket with the blocks freed in its
+ *	active run, with and without a scan of the run
+ */
+static void
+test_run_refill(void)
+{
+	struct mock_pop *mpop = MMAP_ANON_ALIGNED(MOCK_POOL_SIZE,
+		Ut_mmap_align);
+	PMEMobjpool *pop = &mpop->p;
+	memset(pop, 0, MOCK_POOL_SIZE);
+	pop->heap_offset = (uint64_t)((uint64_t)&mpop->heap - (uint64_t)mpop);
+	pop->p_ops.persist = obj_heap_persist;
+	pop->p_ops.flush = obj_heap_flush;
+	pop->p_ops.drain = obj_heap_drain;
+	pop->p_ops.memset = obj_heap_memset;
+	pop->p_ops.base = pop;
+	pop->set = MALLOC(sizeof(*(pop->set)));
+	pop->set->options = 0;
+	pop->set->directory_based = 0;
+
+	struct stats *s = stats_new(pop);
+	UT_ASSERTne(s, NULL);
+
+	void *heap_start = (char *)pop + pop->heap_offset;
+	uint64_t heap_size = MOCK_POOL_SIZE - sizeof(PMEMobjpool);
+	struct palloc_heap *heap = &pop->heap;
+	struct pmem_ops *p_ops = &pop->p_ops;
+
+	UT_ASSERT(heap_init(heap_start, heap_size,
+		&pop->heap_size, p_ops) == 0);
+	UT_ASSERT(heap_boot(heap, heap_start, heap_size,
+		&pop->heap_size,
+		pop, p_ops, s, pop->set) == 0);
+	UT_ASSERT(heap_buckets_init(heap) == 0);
+
+	struct alloc_class *c = heap_get_best_class(heap, 128);
+	UT_ASSERTeq(c->type, CLASS_RUN);
+
+	uint32_t nallocs = c->rdsc.nallocs;
+	UT_ASSERT(nallocs > 2 * RUN_DELTA_MAX_BLOCKS + 2);
+
+	struct bucket *b = heap_bucket_acquire(heap, c->id,
+		HEAP_ARENA_PER_THREAD);
+
+	/* use up the whole active run, the blocks are indexed by offset */
+	struct memory_block *blocks = MALLOC(sizeof(*blocks) * nallocs);
+	uint32_t chunk_id = 0;
+	for (uint32_t i = 0; i < nallocs; ++i) {
+		struct memory_block m = run_alloc_block(heap, b);
+		if (i == 0)
+			chunk_id = m.chunk_id;
+
+		UT_ASSERTeq(m.chunk_id, chunk_id);
+		UT_ASSERT(m.block_off < nallocs);
+		blocks[m.block_off] = m;
+	}
+
+	/*
+	 * A block freed behind the back of the heap can only be found by a
+	 * scan of the run bitmap.
+	 */
+	uint32_t hidden = nallocs - 1;
+	run_mark_block(&blocks[hidden], 0);
+
+	/*
+	 * Fewer blocks than the run delta can hold are given out again
+	 * without a scan, which would have left the hidden block in the
+	 * bucket...
+	 */
+	for (uint32_t i = 0; i < RUN_DELTA_MAX_BLOCKS / 2; ++i)
+		run_free_block(heap, &blocks[2 * i]);
+
+	for (uint32_t i = 0; i < RUN_DELTA_MAX_BLOCKS / 2; ++i) {
+		struct memory_block m = run_alloc_block(heap, b);
+		UT_ASSERTeq(m.chunk_id, chunk_id);
+		UT_ASSERTeq(m.block_off % 2, 0);
+		UT_ASSERT(m.block_off < RUN_DELTA_MAX_BLOCKS);
+	}
+	UT_ASSERT(b->c_ops->is_empty(b->container));
+
+	/* ...and only once they are used up the run is scanned again */
+	struct memory_block m = run_alloc_block(heap, b);
+	UT_ASSERTeq(m.chunk_id, chunk_id);
+	UT_ASSERTeq(m.block_off, hidden);
+
+	/*
+	 * After more blocks than the run delta can hold are freed, the run
+	 * is scanned again right away, so the hidden block is given out
+	 * along with the freed ones.
+	 */
+	hidden = nallocs - 2;
+	run_mark_block(&blocks[hidden], 0);
+
+	for (uint32_t i = 0; i <= RUN_DELTA_MAX_BLOCKS; ++i)
+		run_free_block(heap, &blocks[2 * i]);
+
+	int found = 0;
+	for (uint32_t i = 0; i <= RUN_DELTA_MAX_BLOCKS + 1; ++i) {
+		m = run_alloc_block(heap, b);
+		UT_ASSERTeq(m.chunk_id, chunk_id);
+		if (m.block_off == hidden) {
+			found = 1;
+		} else {
+			UT_ASSERTeq(m.block_off % 2, 0);
+			UT_ASSERT(m.block_off <= 2 * RUN_DELTA_MAX_BLOCKS);
+		}
+	}
+	UT_ASSERT(found);
+	UT_ASSERT(b->c_ops->is_empty(b->container));
+
+	heap_bucket_release(heap, b);
+	FREE(blocks);
+
+	stats_delete(pop, s);
+	heap_cleanup(heap);
+	UT_ASSERT(heap->rt == NULL);
+
+	FREE(pop->set);
+	MUNMAP_ANON_ALIGNED(mpop, MOCK_POOL_SIZE);
+}
+
 static void
 test_recycler(void)
 {
@@ -615,6 +792,7 @@ main(int argc, char *argv[])
 	case 't':
 		test_heap();
 		test_heap_with_size();
+		test_run_refill();
 		test_recycler();
 		break;
 	case 'b':
@@ -138,6 +138,9 @@ FUNC_MOCK_RUN_DEFAULT
 	Pop->rwlock_head = NULL;
 	Pop->cond_head = NULL;
 
+	Pop->stats = stats_new(Pop);
+	UT_ASSERTne(Pop->stats, NULL);
+
 	if (Pop->is_pmem) {
 		Pop->persist_local = pmem_persist;
 		Pop->flush_local = pmem_flush;
@@ -219,6 +222,7 @@ FUNC_MOCK_END
 FUNC_MOCK(pmemobj_close, void, PMEMobjpool *pop)
 	FUNC_MOCK_RUN_DEFAULT {
 		operation_delete(Lane.external);
+		stats_delete(Pop, Pop->stats);
 		UT_ASSERTeq(pmem_unmap(Pop,
 			Pop->heap_size + Pop->heap_offset), 0);
 		Pop = NULL;
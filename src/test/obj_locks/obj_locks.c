@@ -2,7 +2,8 @@
 /* Copyright 2016-2020, Intel Corporation */
 
 /*
- * obj_locks.c -- unit test for PMEMmutex, PMEMrwlock and PMEMcond
+ * obj_locks.c -- unit test for PMEMmutex, PMEMrwlock, PMEMcond, PMEMlwmutex
+ * and PMEMlwrwlock
  */
 #include <sys/param.h>
 #include <string.h>
@@ -12,7 +13,7 @@
 
 #define LAYOUT_NAME "obj_locks"
 #define NUM_THREADS 16
-#define MAX_FUNC 5
+#define MAX_FUNC 8
 
 TOID_DECLARE(struct locks, 0);
 
@@ -21,6 +22,8 @@ struct locks {
 	PMEMmutex mtx;
 	PMEMrwlock rwlk;
 	PMEMcond cond;
+	PMEMlwmutex lwmtx;
+	PMEMlwrwlock lwrwlk;
 	int data;
 };
 
@@ -132,9 +135,53 @@ do_cond_broadcast(void *arg)
 	return NULL;
 }
 
+/*
+ * do_lwmutex_lock -- lock and unlock the lightweight mutex
+ */
+static void *
+do_lwmutex_lock(void *arg)
+{
+	struct thread_args *t = (struct thread_args *)arg;
+	struct locks *lock = D_RW(t->lock);
+	UT_ASSERTeq(pmemobj_lwmutex_lock(lock->pop, &lock->lwmtx), 0);
+	lock->data++;
+	pmemobj_persist(lock->pop, &lock->data, sizeof(lock->data));
+	UT_ASSERTeq(pmemobj_lwmutex_unlock(lock->pop, &lock->lwmtx), 0);
+	return NULL;
+}
+
+/*
+ * do_lwrwlock_wrlock -- lock and unlock the lightweight write rwlock
+ */
+static void *
+do_lwrwlock_wrlock(void *arg)
+{
+	struct thread_args *t = (struct thread_args *)arg;
+	struct locks *lock = D_RW(t->lock);
+	UT_ASSERTeq(pmemobj_lwrwlock_wrlock(lock->pop, &lock->lwrwlk), 0);
+	lock->data++;
+	pmemobj_persist(lock->pop, &lock->data, sizeof(lock->data));
+	UT_ASSERTeq(pmemobj_lwrwlock_unlock(lock->pop, &lock->lwrwlk), 0);
+	return NULL;
+}
+
+/*
+ * do_lwrwlock_rdlock -- lock and unlock the lightweight read rwlock
+ */
+static void *
+do_lwrwlock_rdlock(void *arg)
+{
+	struct thread_args *t = (struct thread_args *)arg;
+	struct locks *lock = D_RW(t->lock);
+	UT_ASSERTeq(pmemobj_lwrwlock_rdlock(lock->pop, &lock->lwrwlk), 0);
+	UT_ASSERTeq(pmemobj_lwrwlock_unlock(lock->pop, &lock->lwrwlk), 0);
+	return NULL;
+}
+
 static fn_lock do_lock[MAX_FUNC] = {do_mutex_lock, do_rwlock_wrlock,
 				do_rwlock_rdlock, do_cond_signal,
-				do_cond_broadcast};
+				do_cond_broadcast, do_lwmutex_lock,
+				do_lwrwlock_wrlock, do_lwrwlock_rdlock};
 
 /*
  * do_lock_init -- initialize all types of locks
@@ -145,6 +192,8 @@ do_lock_init(struct locks *lock)
 	pmemobj_mutex_zero(lock->pop, &lock->mtx);
 	pmemobj_rwlock_zero(lock->pop, &lock->rwlk);
 	pmemobj_cond_zero(lock->pop, &lock->cond);
+	pmemobj_lwmutex_zero(lock->pop, &lock->lwmtx);
+	pmemobj_lwrwlock_zero(lock->pop, &lock->lwrwlk);
 }
 
 /*
@@ -172,6 +221,59 @@ do_lock_mt(TOID(struct locks) lock, unsigned f_num)
 					(D_RO(lock)->data == 0));
 }
 
+/*
+ * do_lw_states -- check the single-threaded semantics of the lightweight
+ * locks and that they are unlocked after the pool is reopened
+ */
+static PMEMobjpool *
+do_lw_states(PMEMobjpool *pop, const char *path, TOID(struct locks) lock)
+{
+	struct timespec t;
+	os_clock_gettime(CLOCK_REALTIME, &t);
+
+	PMEMlwmutex *mtx = &D_RW(lock)->lwmtx;
+	PMEMlwrwlock *rwlk = &D_RW(lock)->lwrwlk;
+
+	UT_ASSERTeq(pmemobj_lwmutex_unlock(pop, mtx), EPERM);
+	UT_ASSERTeq(pmemobj_lwrwlock_unlock(pop, rwlk), EPERM);
+
+	UT_ASSERTeq(pmemobj_lwmutex_trylock(pop, mtx), 0);
+	UT_ASSERTeq(pmemobj_lwmutex_trylock(pop, mtx), EBUSY);
+	UT_ASSERTeq(pmemobj_lwmutex_timedlock(pop, mtx, &t), ETIMEDOUT);
+	UT_ASSERTeq(pmemobj_lwmutex_unlock(pop, mtx), 0);
+	UT_ASSERTeq(pmemobj_lwmutex_timedlock(pop, mtx, &t), 0);
+
+	UT_ASSERTeq(pmemobj_lwrwlock_rdlock(pop, rwlk), 0);
+	UT_ASSERTeq(pmemobj_lwrwlock_tryrdlock(pop, rwlk), 0);
+	UT_ASSERTeq(pmemobj_lwrwlock_trywrlock(pop, rwlk), EBUSY);
+	UT_ASSERTeq(pmemobj_lwrwlock_timedwrlock(pop, rwlk, &t), ETIMEDOUT);
+	UT_ASSERTeq(pmemobj_lwrwlock_unlock(pop, rwlk), 0);
+	UT_ASSERTeq(pmemobj_lwrwlock_unlock(pop, rwlk), 0);
+	UT_ASSERTeq(pmemobj_lwrwlock_unlock(pop, rwlk), EPERM);
+
+	UT_ASSERTeq(pmemobj_lwrwlock_timedwrlock(pop, rwlk, &t), 0);
+	UT_ASSERTeq(pmemobj_lwrwlock_tryrdlock(pop, rwlk), EBUSY);
+	UT_ASSERTeq(pmemobj_lwrwlock_timedrdlock(pop, rwlk, &t), ETIMEDOUT);
+
+	/* both locks are left locked */
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open");
+
+	D_RW(lock)->pop = pop;
+	mtx = &D_RW(lock)->lwmtx;
+	rwlk = &D_RW(lock)->lwrwlk;
+
+	UT_ASSERTeq(pmemobj_lwmutex_trylock(pop, mtx), 0);
+	UT_ASSERTeq(pmemobj_lwmutex_unlock(pop, mtx), 0);
+	UT_ASSERTeq(pmemobj_lwrwlock_trywrlock(pop, rwlk), 0);
+	UT_ASSERTeq(pmemobj_lwrwlock_unlock(pop, rwlk), 0);
+
+	return pop;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -190,6 +292,10 @@ main(int argc, char *argv[])
 
 	do_lock_init(D_RW(lock));
 
+	for (unsigned i = 0; i < MAX_FUNC; i++)
+		do_lock_mt(lock, i);
+
+	pop = do_lw_states(pop, argv[1], lock);
 	for (unsigned i = 0; i < MAX_FUNC; i++)
 		do_lock_mt(lock, i);
 
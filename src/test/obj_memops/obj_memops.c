@@ -533,6 +533,88 @@ test_undo_log_reuse()
 #undef ULOG_SIZE
 }
 
+/*
+ * test_redo_process_large -- test for applying a log large enough to be
+ *	processed by multiple threads
+ */
+static void
+test_redo_process_large()
+{
+#define DEST_SIZE (1 << 23)
+#define ULOG_SIZE (DEST_SIZE + (1 << 14))
+	struct pmem_ops ops = {
+		.persist = persist_empty,
+		.flush = flush_empty,
+		.drain = drain_empty,
+		.memcpy = memcpy_libc,
+		.memmove = NULL,
+		.memset = memset_libc,
+		.base = NULL,
+	};
+	struct ulog *ulog = util_aligned_malloc(CACHELINE_SIZE,
+		SIZEOF_ULOG(ULOG_SIZE));
+	UT_ASSERTne(ulog, NULL);
+	memset(ulog, 0, SIZEOF_ULOG(ULOG_SIZE));
+	ulog_construct((uint64_t)ulog, ULOG_SIZE, 0, 0, 0, &ops);
+
+	char *dest = MALLOC(DEST_SIZE);
+	memset(dest, 0, DEST_SIZE);
+
+	char *data = MALLOC(DEST_SIZE);
+	for (size_t i = 0; i < DEST_SIZE; ++i)
+		data[i] = (char)(i % 251);
+
+	/* a single copy spanning all the stripes... */
+	size_t offset = 0;
+	ulog_entry_buf_create(ulog, offset, ulog->gen_num, (uint64_t *)dest,
+		data, DEST_SIZE, ULOG_OPERATION_BUF_CPY, &ops);
+	offset += ulog_entry_size((struct ulog_entry_base *)
+		(ulog->data + offset));
+
+	/* ...partially overwritten across a stripe boundary... */
+	size_t set_off = (1 << 20) - 100;
+	size_t set_size = 200;
+	memset(data, 0xab, set_size);
+	ulog_entry_buf_create(ulog, offset, ulog->gen_num,
+		(uint64_t *)(dest + set_off), data, set_size,
+		ULOG_OPERATION_BUF_SET, &ops);
+	offset += ulog_entry_size((struct ulog_entry_base *)
+		(ulog->data + offset));
+
+	/* ...and by values, which must be applied in the order of the log */
+	uint64_t *vals = (uint64_t *)(dest + (1 << 21));
+	for (size_t i = 0; i < TEST_VALUES; ++i) {
+		ulog_entry_val_create(ulog, offset, &vals[i % 8], i,
+			ULOG_OPERATION_SET, &ops);
+		offset += sizeof(struct ulog_entry_val);
+	}
+	ulog_entry_val_create(ulog, offset, &vals[0], 1ULL << 63,
+		ULOG_OPERATION_OR, &ops);
+	offset += sizeof(struct ulog_entry_val);
+
+	ulog_process_sized(ulog, offset, NULL, &ops);
+
+	for (size_t i = 0; i < DEST_SIZE; ++i) {
+		if (i >= set_off && i < set_off + set_size)
+			UT_ASSERTeq((unsigned char)dest[i], 0xab);
+		else if ((char *)&dest[i] >= (char *)vals &&
+			(char *)&dest[i] < (char *)&vals[8])
+			continue;
+		else
+			UT_ASSERTeq(dest[i], (char)(i % 251));
+	}
+
+	UT_ASSERTeq(vals[0], (TEST_VALUES - 8) | (1ULL << 63));
+	for (size_t i = 1; i < 8; ++i)
+		UT_ASSERTeq(vals[i], TEST_VALUES - 8 + i);
+
+	FREE(data);
+	FREE(dest);
+	util_aligned_free(ulog);
+#undef ULOG_SIZE
+#undef DEST_SIZE
+}
+
 /*
  * test_undo_log_reuse -- test for correct reuse of log space
  */
@@ -638,6 +720,7 @@ main(int argc, char *argv[])
 	test_undo(pop, object);
 	test_redo_cleanup_same_size(pop, object);
 	test_undo_log_reuse();
+	test_redo_process_large();
 
 	pmemobj_close(pop);
 
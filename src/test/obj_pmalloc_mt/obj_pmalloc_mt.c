@@ -20,6 +20,7 @@
 
 #define CHUNKSIZE (1 << 18)
 #define CHUNKS_PER_THREAD 3
+#define HUGE_ALLOC_SIZE CHUNKSIZE /* two chunks with the header */
 
 static unsigned Threads;
 static unsigned Ops_per_thread;
@@ -165,6 +166,22 @@ alloc_free_worker(void *arg)
 	return NULL;
 }
 
+static void *
+huge_alloc_free_worker(void *arg)
+{
+	struct worker_args *a = arg;
+
+	PMEMoid oid;
+	for (unsigned i = 0; i < Ops_per_thread; ++i) {
+		int err = pmemobj_alloc(a->pop, &oid, HUGE_ALLOC_SIZE,
+				0, NULL, NULL);
+		UT_ASSERTeq(err, 0);
+		pmemobj_free(&oid);
+	}
+
+	return NULL;
+}
+
 #define OPS_PER_TX 10
 #define STEP 8
 #define TEST_LANES 4
@@ -372,6 +389,7 @@ main(int argc, char *argv[])
 	run_worker(free_worker, args);
 	run_worker(mix_worker, args);
 	run_worker(alloc_free_worker, args);
+	run_worker(huge_alloc_free_worker, args);
 	run_worker(action_cancel_worker, args);
 	actions_clear(pop, r);
 	run_worker(action_publish_worker, args);
@@ -29,6 +29,29 @@ typedef void *(*worker)(void *);
 /* the mock pmemobj pool */
 static PMEMobjpool Mock_pop;
 
+/* lock statistics are never enabled in the mock pool */
+static struct stats Mock_stats;
+
+uint64_t
+stats_lock_time(void)
+{
+	return 0;
+}
+
+void
+stats_lock_acquired(struct stats *s, enum stats_lock_site site,
+	const void *lock, uint64_t wait_start)
+{
+	UT_ASSERT(0);
+}
+
+void
+stats_lock_released(struct stats *s, enum stats_lock_site site,
+	const void *lock)
+{
+	UT_ASSERT(0);
+}
+
 /* the tested object containing persistent synchronization primitives */
 static struct mock_obj {
 	PMEMmutex mutex;
@@ -337,6 +360,7 @@ main(int argc, char *argv[])
 
 	/* first pool open */
 	mock_open_pool(&Mock_pop);
+	Mock_pop.stats = &Mock_stats;
 	Mock_pop.p_ops.persist = obj_sync_persist;
 	Mock_pop.p_ops.base = &Mock_pop;
 	Test_obj = (struct mock_obj *)MALLOC(sizeof(struct mock_obj));
@@ -967,6 +967,262 @@ do_tx_add_range_flag_merge_middle(PMEMobjpool *pop)
 	} TX_END
 }
 
+#define DEDUP_FIELDS	8
+#define DEDUP_STRIDE	16
+
+/*
+ * do_tx_add_range_flush_dedup_tx -- (internal) snapshot, modify and persist
+ * a few fields sharing cache lines, returns the flush and fence counters of
+ * the transaction
+ */
+static struct pobj_persist_stats
+do_tx_add_range_flush_dedup_tx(PMEMobjpool *pop, TOID(struct object) obj,
+	int dedup)
+{
+	int ret = pmemobj_ctl_set(pop, "tx.flush.dedup", &dedup);
+	UT_ASSERTeq(ret, 0);
+
+	TX_BEGIN(pop) {
+		for (int i = 0; i < DEDUP_FIELDS; ++i) {
+			size_t off = DATA_OFF + (size_t)i * DEDUP_STRIDE;
+			ret = pmemobj_tx_add_range(obj.oid, off, sizeof(int));
+			UT_ASSERTeq(ret, 0);
+
+			int *field = (int *)((char *)D_RW(obj) + off);
+			*field = i + dedup;
+			pmemobj_persist(pop, field, sizeof(*field));
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (int i = 0; i < DEDUP_FIELDS; ++i) {
+		size_t off = DATA_OFF + (size_t)i * DEDUP_STRIDE;
+		UT_ASSERTeq(*(int *)((char *)D_RO(obj) + off), i + dedup);
+	}
+
+	struct pobj_persist_stats stats;
+	ret = pmemobj_ctl_get(pop, "stats.persist.tx", &stats);
+	UT_ASSERTeq(ret, 0);
+
+	return stats;
+}
+
+/*
+ * do_tx_add_range_flush_dedup -- check that with tx.flush.dedup enabled the
+ * persists of snapshotted ranges are collapsed into the commit and lines
+ * shared by several ranges are flushed once
+ */
+static void
+do_tx_add_range_flush_dedup(PMEMobjpool *pop)
+{
+	TOID(struct object) obj;
+	TOID_ASSIGN(obj, do_tx_zalloc(pop, TYPE_OBJ));
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "stats.persist.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	struct pobj_persist_stats plain =
+		do_tx_add_range_flush_dedup_tx(pop, obj, 0);
+	struct pobj_persist_stats dedup =
+		do_tx_add_range_flush_dedup_tx(pop, obj, 1);
+
+	UT_ASSERT(plain.fences >= dedup.fences + DEDUP_FIELDS);
+	UT_ASSERT(plain.flushed_lines >= dedup.flushed_lines + DEDUP_FIELDS);
+	UT_ASSERT(plain.redundant_lines > dedup.redundant_lines);
+
+	enabled = 0;
+	ret = pmemobj_ctl_set(pop, "tx.flush.dedup", &enabled);
+	UT_ASSERTeq(ret, 0);
+	ret = pmemobj_ctl_set(pop, "stats.persist.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * do_tx_write -- check that the writes buffered with pmemobj_tx_write are
+ * visible through pmemobj_tx_read, merged with each other, applied on commit
+ * and discarded on abort
+ */
+static void
+do_tx_write(PMEMobjpool *pop)
+{
+	TOID(struct object) obj;
+	TOID_ASSIGN(obj, do_tx_zalloc(pop, TYPE_OBJ));
+
+	char buf[DATA_SIZE];
+	char data[DATA_SIZE];
+	memset(data, TEST_VALUE_1, DATA_SIZE);
+
+	TX_BEGIN(pop) {
+		size_t value = TEST_VALUE_1;
+		int ret = pmemobj_tx_write(&D_RW(obj)->value, &value,
+			VALUE_SIZE);
+		UT_ASSERTeq(ret, 0);
+
+		/* the destination is untouched until commit */
+		UT_ASSERTeq(D_RO(obj)->value, 0);
+
+		value = 0;
+		ret = pmemobj_tx_read(&value, &D_RO(obj)->value, VALUE_SIZE);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(value, TEST_VALUE_1);
+
+		/* two disjoint writes, then one which covers both */
+		ret = pmemobj_tx_write(D_RW(obj)->data + 10, data, 10);
+		UT_ASSERTeq(ret, 0);
+		ret = pmemobj_tx_write(D_RW(obj)->data + 100, data, 10);
+		UT_ASSERTeq(ret, 0);
+		ret = pmemobj_tx_write(D_RW(obj)->data + 15, data, 90);
+		UT_ASSERTeq(ret, 0);
+
+		ret = pmemobj_tx_read(buf, D_RO(obj)->data, DATA_SIZE);
+		UT_ASSERTeq(ret, 0);
+		for (size_t i = 0; i < DATA_SIZE; ++i)
+			UT_ASSERTeq(buf[i], i >= 10 && i < 110 ?
+				TEST_VALUE_1 : 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(D_RO(obj)->value, TEST_VALUE_1);
+	for (size_t i = 0; i < DATA_SIZE; ++i)
+		UT_ASSERTeq(D_RO(obj)->data[i], i >= 10 && i < 110 ?
+			TEST_VALUE_1 : 0);
+
+	TX_BEGIN(pop) {
+		size_t value = TEST_VALUE_2;
+		int ret = pmemobj_tx_write(&D_RW(obj)->value, &value,
+			VALUE_SIZE);
+		UT_ASSERTeq(ret, 0);
+
+		pmemobj_tx_abort(EINVAL);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(D_RO(obj)->value, TEST_VALUE_1);
+
+	/* the whole object does not fit in the default redo log */
+	memset(data, TEST_VALUE_2, DATA_SIZE);
+	TX_BEGIN(pop) {
+		int ret = pmemobj_tx_write(D_RW(obj)->data, data, DATA_SIZE);
+		UT_ASSERTeq(ret, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (size_t i = 0; i < DATA_SIZE; ++i)
+		UT_ASSERTeq(D_RO(obj)->data[i], TEST_VALUE_2);
+
+	/* the destination has to be within the heap */
+	TX_BEGIN(pop) {
+		pmemobj_tx_set_failure_behavior(POBJ_TX_FAILURE_RETURN);
+		int ret = pmemobj_tx_write(buf, data, 1);
+		UT_ASSERTeq(ret, EINVAL);
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+#define RETAIN_SNAPSHOT_SIZE (8 * TX_DEFAULT_RANGE_CACHE_SIZE)
+
+/*
+ * do_tx_add_range_retained -- (internal) snapshots 'size' bytes of the object
+ *	and returns the change of the heap usage after the commit
+ */
+static ssize_t
+do_tx_add_range_retained(PMEMobjpool *pop, PMEMoid obj, size_t size)
+{
+	size_t before;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.curr_allocated", &before);
+	UT_ASSERTeq(ret, 0);
+
+	TX_BEGIN(pop) {
+		ret = pmemobj_tx_add_range(obj, 0, size);
+		UT_ASSERTeq(ret, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	size_t after;
+	ret = pmemobj_ctl_get(pop, "stats.heap.curr_allocated", &after);
+	UT_ASSERTeq(ret, 0);
+
+	return (ssize_t)after - (ssize_t)before;
+}
+
+/*
+ * do_tx_log_retain -- check that the undo log extensions are kept between
+ * transactions only if configured so and that they are freed once they are
+ * no longer needed
+ */
+static void
+do_tx_log_retain(PMEMobjpool *pop)
+{
+	PMEMoid obj;
+	int ret = pmemobj_zalloc(pop, &obj, RETAIN_SNAPSHOT_SIZE, 0);
+	UT_ASSERTeq(ret, 0);
+
+	int enabled = 1;
+	ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	/* the extensions past the second one are freed by default */
+	do_tx_add_range_retained(pop, obj, RETAIN_SNAPSHOT_SIZE);
+	UT_ASSERTeq(do_tx_add_range_retained(pop, obj,
+		RETAIN_SNAPSHOT_SIZE), 0);
+
+	ssize_t retain_size = 2 * RETAIN_SNAPSHOT_SIZE;
+	ret = pmemobj_ctl_set(pop, "tx.log.retain_size", &retain_size);
+	UT_ASSERTeq(ret, 0);
+
+	int period = 2;
+	ret = pmemobj_ctl_set(pop, "tx.log.retain_period", &period);
+	UT_ASSERTeq(ret, 0);
+
+	ssize_t retained = do_tx_add_range_retained(pop, obj,
+		RETAIN_SNAPSHOT_SIZE);
+	UT_ASSERT(retained > 0);
+
+	/* the next large transaction reuses the kept extensions */
+	UT_ASSERTeq(do_tx_add_range_retained(pop, obj,
+		RETAIN_SNAPSHOT_SIZE), 0);
+
+	/* the first small transaction of a period keeps them as well */
+	UT_ASSERTeq(do_tx_add_range_retained(pop, obj, VALUE_SIZE), 0);
+
+	/* but they are freed when the period ends without a need for them */
+	UT_ASSERTeq(do_tx_add_range_retained(pop, obj, VALUE_SIZE), -retained);
+
+	/* transactions that log nothing count toward the period as well */
+	retained = do_tx_add_range_retained(pop, obj, RETAIN_SNAPSHOT_SIZE);
+	UT_ASSERT(retained > 0);
+	for (int i = 0; i < 3; ++i) {
+		TX_BEGIN(pop) {
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+	}
+	UT_ASSERTeq(do_tx_add_range_retained(pop, obj, VALUE_SIZE), -retained);
+
+	period = 0;
+	ret = pmemobj_ctl_set(pop, "tx.log.retain_period", &period);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	retain_size = 0;
+	ret = pmemobj_ctl_set(pop, "tx.log.retain_size", &retain_size);
+	UT_ASSERTeq(ret, 0);
+
+	enabled = 0;
+	ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	pmemobj_free(&obj);
+}
+
 /*
  * do_tx_add_range_reopen -- check for persistent memory leak in undo log set
  */
@@ -1147,6 +1403,12 @@ main(int argc, char *argv[])
 		VALGRIND_WRITE_STATS;
 		do_tx_add_range_flag_merge_middle(pop);
 		VALGRIND_WRITE_STATS;
+		do_tx_add_range_flush_dedup(pop);
+		VALGRIND_WRITE_STATS;
+		do_tx_write(pop);
+		VALGRIND_WRITE_STATS;
+		do_tx_log_retain(pop);
+		VALGRIND_WRITE_STATS;
 		do_tx_xadd_range_no_flush_commit(pop);
 		pmemobj_close(pop);
 	}
@@ -15,6 +15,13 @@
 
 #define ALLOC_SIZE ((8191 * (256 * 1024)) - 16) /* must evenly divide a zone */
 
+/* the size of the chunks of a single zone, a zone is slightly larger */
+#define ZONE_CHUNKS_SIZE ((size_t)(UINT16_MAX - 7) * (256 * 1024))
+
+#define ARENA_ALLOCS 1000
+#define ARENA_SMALL_SIZE 128
+#define ARENA_HUGE_SIZE (1 << 20)
+
 /*
  * test_create -- allocate all possible objects and log the number. It should
  * exceed what would be possible on a single zone.
@@ -104,13 +111,88 @@ test_malloc_free(const char *path)
 	FREE(oid);
 }
 
+/*
+ * test_arena_zones -- binds an arena to the middle zones of the heap and
+ *	checks that its objects are allocated from these zones only
+ */
+static void
+test_arena_zones(const char *path)
+{
+	PMEMobjpool *pop = NULL;
+	if ((pop = pmemobj_create(path, LAYOUT_NAME,
+			0, S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	/* puts the first zone in use */
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, ARENA_SMALL_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	unsigned arena_id;
+	ret = pmemobj_ctl_exec(pop, "heap.arena.create", &arena_id);
+	UT_ASSERTeq(ret, 0);
+
+	char name[64];
+	SNPRINTF(name, sizeof(name), "heap.arena.%u.zones", arena_id);
+
+	struct pobj_arena_zones zones;
+	ret = pmemobj_ctl_get(pop, name, &zones);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(zones.count, 0);
+
+	/* the first zone is already in use */
+	zones.first = 0;
+	zones.count = 1;
+	ret = pmemobj_ctl_set(pop, name, &zones);
+	UT_ASSERTne(ret, 0);
+	UT_ASSERTeq(errno, EINVAL);
+
+	zones.first = 1;
+	zones.count = 2;
+	ret = pmemobj_ctl_set(pop, name, &zones);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, name, &zones);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(zones.first, 1);
+	UT_ASSERTeq(zones.count, 2);
+
+	ret = pmemobj_ctl_set(pop, name, &zones);
+	UT_ASSERTne(ret, 0);
+	UT_ASSERTeq(errno, EBUSY);
+
+	for (int i = 0; i < ARENA_ALLOCS; ++i) {
+		ret = pmemobj_xalloc(pop, &oid, ARENA_SMALL_SIZE, 0,
+			POBJ_ARENA_ID(arena_id), NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERT(oid.off > ZONE_CHUNKS_SIZE);
+
+		ret = pmemobj_alloc(pop, &oid, ARENA_SMALL_SIZE, 0,
+			NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERT(oid.off < ZONE_CHUNKS_SIZE);
+	}
+
+	ret = pmemobj_xalloc(pop, &oid, ARENA_HUGE_SIZE, 0,
+		POBJ_ARENA_ID(arena_id), NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(oid.off > ZONE_CHUNKS_SIZE);
+
+	ret = pmemobj_alloc(pop, &oid, ARENA_HUGE_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(oid.off < ZONE_CHUNKS_SIZE);
+
+	pmemobj_close(pop);
+}
+
 int
 main(int argc, char *argv[])
 {
 	START(argc, argv, "obj_zones");
 
 	if (argc != 3)
-		UT_FATAL("usage: %s file-name [open|create]", argv[0]);
+		UT_FATAL("usage: %s file-name [open|create|free|arena]",
+			argv[0]);
 
 	const char *path = argv[1];
 	char op = argv[2][0];
@@ -120,6 +202,8 @@ main(int argc, char *argv[])
 		test_open(path);
 	else if (op == 'f')
 		test_malloc_free(path);
+	else if (op == 'a')
+		test_arena_zones(path);
 	else
 		UT_FATAL("invalid operation");
 
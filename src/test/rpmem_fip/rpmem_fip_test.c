@@ -45,6 +45,8 @@ TEST_CASE_DECLARE(client_flush);
 TEST_CASE_DECLARE(client_flush_mt);
 TEST_CASE_DECLARE(client_persist);
 TEST_CASE_DECLARE(client_persist_mt);
+TEST_CASE_DECLARE(client_persist_v);
+TEST_CASE_DECLARE(client_persist_v_mt);
 TEST_CASE_DECLARE(client_read);
 TEST_CASE_DECLARE(client_wq_size);
 
@@ -199,6 +201,46 @@ client_persist_thread(void *arg)
 	return NULL;
 }
 
+/*
+ * client_persist_v_thread -- thread callback for vectored persist operation
+ */
+static void *
+client_persist_v_thread(void *arg)
+{
+	struct flush_arg *args = arg;
+	struct rpmem_range ranges[COUNT_PER_LANE];
+	int ret;
+
+	/* persist of empty ranges should always succeed */
+	ranges[0].offset = args->lane * TOTAL_PER_LANE;
+	ranges[0].length = 0;
+	ret = rpmem_fip_persist_v(args->fip, ranges, 1, args->lane,
+			RPMEM_FLUSH_WRITE);
+	UT_ASSERTeq(ret, 0);
+
+	/* the ranges are persisted in the reversed order */
+	for (unsigned i = 0; i < COUNT_PER_LANE; i++) {
+		size_t offset = args->lane * TOTAL_PER_LANE + i * SIZE_PER_LANE;
+		unsigned val = args->lane + i;
+		memset(&lpool[offset], (int)val, SIZE_PER_LANE);
+
+		ranges[COUNT_PER_LANE - 1 - i].offset = offset;
+		ranges[COUNT_PER_LANE - 1 - i].length = SIZE_PER_LANE;
+	}
+
+	/* half of the ranges inlined in the message, half using RMA WRITE */
+	unsigned half = COUNT_PER_LANE / 2;
+	ret = rpmem_fip_persist_v(args->fip, ranges, half, args->lane,
+			RPMEM_PERSIST_SEND);
+	UT_ASSERTeq(ret, 0);
+
+	ret = rpmem_fip_persist_v(args->fip, &ranges[half],
+			COUNT_PER_LANE - half, args->lane, RPMEM_FLUSH_WRITE);
+	UT_ASSERTeq(ret, 0);
+
+	return NULL;
+}
+
 /*
  * client_init -- test case for client initialization
  */
@@ -238,6 +280,7 @@ client_init(const struct test_case *tc, int argc, char *argv[])
 		.nlanes = resp.nlanes,
 		.raddr = (void *)resp.raddr,
 		.rkey = resp.rkey,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	ssize_t sret = SNPRINTF(fip_service, NI_MAXSERV, "%u", resp.port);
@@ -287,6 +330,7 @@ server_init(const struct test_case *tc, int argc, char *argv[])
 		.provider = provider,
 		.persist_method = persist_method,
 		.nthreads = NTHREADS,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	ret = rpmemd_apply_pm_policy(&attr.persist_method, &attr.persist,
@@ -352,6 +396,7 @@ client_connect(const struct test_case *tc, int argc, char *argv[])
 		.nlanes = resp.nlanes,
 		.raddr = (void *)resp.raddr,
 		.rkey = resp.rkey,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	ssize_t sret = SNPRINTF(fip_service, NI_MAXSERV, "%u", resp.port);
@@ -402,6 +447,7 @@ server_connect(const struct test_case *tc, int argc, char *argv[])
 		.provider = provider,
 		.persist_method = persist_method,
 		.nthreads = NTHREADS,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	int ret;
@@ -464,6 +510,7 @@ server_process(const struct test_case *tc, int argc, char *argv[])
 		.provider = provider,
 		.persist_method = persist_method,
 		.nthreads = NTHREADS,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	int ret;
@@ -544,6 +591,7 @@ flush_common(char *target, char *prov_name, char *persist_method,
 		.nlanes = resp.nlanes,
 		.raddr = (void *)resp.raddr,
 		.rkey = resp.rkey,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	ssize_t sret = SNPRINTF(fip_service, NI_MAXSERV, "%u", resp.port);
@@ -619,6 +667,7 @@ flush_common_mt(char *target, char *prov_name, char *persist_method,
 		.nlanes = resp.nlanes,
 		.raddr = (void *)resp.raddr,
 		.rkey = resp.rkey,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	ssize_t sret = SNPRINTF(fip_service, NI_MAXSERV, "%u", resp.port);
@@ -745,6 +794,47 @@ client_persist_mt(const struct test_case *tc, int argc, char *argv[])
 	return 3;
 }
 
+/*
+ * client_persist_v -- test case for single-threaded vectored persist operation
+ */
+int
+client_persist_v(const struct test_case *tc, int argc, char *argv[])
+{
+	if (argc < 3)
+		UT_FATAL("usage: %s <target> <provider> <persist method>",
+				tc->name);
+
+	char *target = argv[0];
+	char *prov_name = argv[1];
+	char *persist_method = argv[2];
+
+	flush_common(target, prov_name, persist_method,
+			client_persist_v_thread);
+
+	return 3;
+}
+
+/*
+ * client_persist_v_mt -- test case for multi-threaded vectored persist
+ * operation
+ */
+int
+client_persist_v_mt(const struct test_case *tc, int argc, char *argv[])
+{
+	if (argc < 3)
+		UT_FATAL("usage: %s <target> <provider> <persist method>",
+				tc->name);
+
+	char *target = argv[0];
+	char *prov_name = argv[1];
+	char *persist_method = argv[2];
+
+	flush_common_mt(target, prov_name, persist_method,
+			client_persist_v_thread);
+
+	return 3;
+}
+
 /*
  * client_read -- test case for read operation
  */
@@ -788,6 +878,7 @@ client_read(const struct test_case *tc, int argc, char *argv[])
 		.nlanes = resp.nlanes,
 		.raddr = (void *)resp.raddr,
 		.rkey = resp.rkey,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	ssize_t sret = SNPRINTF(fip_service, NI_MAXSERV, "%u", resp.port);
@@ -871,6 +962,7 @@ client_wq_size(const struct test_case *tc, int argc, char *argv[])
 		.nlanes = resp.nlanes,
 		.raddr = (void *)resp.raddr,
 		.rkey = resp.rkey,
+		.buff_size = RPMEM_DEF_BUFF_SIZE,
 	};
 
 	ssize_t sret = SNPRINTF(fip_service, NI_MAXSERV, "%u", resp.port);
@@ -953,6 +1045,8 @@ static struct test_case test_cases[] = {
 	TEST_CASE(client_flush_mt),
 	TEST_CASE(client_persist),
 	TEST_CASE(client_persist_mt),
+	TEST_CASE(client_persist_v),
+	TEST_CASE(client_persist_v_mt),
 	TEST_CASE(server_process),
 	TEST_CASE(client_read),
 	TEST_CASE(client_wq_size)
@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2016-2019, Intel Corporation */
+/* Copyright 2016-2020, Intel Corporation */
 
 /*
  * rpmem_obc_int.c -- integration test for rpmem_obc and rpmemd_obc modules
@@ -110,6 +110,7 @@ client_create(const struct test_case *tc, int argc, char *argv[])
 	UT_ASSERTeq(ex_res.raddr, res.raddr);
 	UT_ASSERTeq(ex_res.persist_method, res.persist_method);
 	UT_ASSERTeq(ex_res.nlanes, res.nlanes);
+	UT_ASSERTeq(res.caps, 0);
 
 	ret = rpmem_obc_monitor(rpc, 1);
 	UT_ASSERTeq(ret, 1);
@@ -145,6 +146,9 @@ client_open(const struct test_case *tc, int argc, char *argv[])
 	struct rpmem_resp_attr ex_res = RESP_ATTR_INIT;
 	struct rpmem_resp_attr res;
 
+	/* negotiate the capabilities only when opening the pool */
+	req.caps = RPMEM_CAPS_SUPPORTED;
+
 	info = rpmem_target_parse(target);
 	UT_ASSERTne(info, NULL);
 
@@ -166,6 +170,7 @@ client_open(const struct test_case *tc, int argc, char *argv[])
 	UT_ASSERTeq(ex_res.raddr, res.raddr);
 	UT_ASSERTeq(ex_res.persist_method, res.persist_method);
 	UT_ASSERTeq(ex_res.nlanes, res.nlanes);
+	UT_ASSERTeq(res.caps, RPMEM_CAPS_SUPPORTED);
 	UT_ASSERTeq(memcmp(&ex_pool_attr, &pool_attr,
 			sizeof(ex_pool_attr)), 0);
 
@@ -254,6 +259,7 @@ req_create(struct rpmemd_obc *obc, void *arg,
 	UT_ASSERTeq(ex_req.pool_size, req->pool_size);
 	UT_ASSERTeq(ex_req.nlanes, req->nlanes);
 	UT_ASSERTeq(strcmp(ex_req.pool_desc, req->pool_desc), 0);
+	UT_ASSERTeq(req->caps, 0);
 	UT_ASSERTeq(memcmp(&ex_pool_attr, pool_attr, sizeof(ex_pool_attr)), 0);
 
 	struct req_arg *args = arg;
@@ -274,6 +280,7 @@ req_open(struct rpmemd_obc *obc, void *arg,
 	UT_ASSERTeq(ex_req.pool_size, req->pool_size);
 	UT_ASSERTeq(ex_req.nlanes, req->nlanes);
 	UT_ASSERTeq(strcmp(ex_req.pool_desc, req->pool_desc), 0);
+	UT_ASSERTeq(req->caps, RPMEM_CAPS_SUPPORTED);
 
 	struct req_arg *args = arg;
 
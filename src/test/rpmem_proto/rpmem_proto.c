@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2016-2018, Intel Corporation */
+/* Copyright 2016-2020, Intel Corporation */
 
 /*
  * rpmem_proto.c -- unit test for rpmem_proto header
@@ -72,6 +72,10 @@ main(int argc, char *argv[])
 	ASSERT_ALIGNED_FIELD(struct rpmem_msg_common, buff_size);
 	ASSERT_ALIGNED_CHECK(struct rpmem_msg_common);
 
+	ASSERT_ALIGNED_BEGIN(struct rpmem_msg_caps);
+	ASSERT_ALIGNED_FIELD(struct rpmem_msg_caps, caps);
+	ASSERT_ALIGNED_CHECK(struct rpmem_msg_caps);
+
 	ASSERT_ALIGNED_BEGIN(struct rpmem_msg_pool_desc);
 	ASSERT_ALIGNED_FIELD(struct rpmem_msg_pool_desc, size);
 	ASSERT_ALIGNED_CHECK(struct rpmem_msg_pool_desc);
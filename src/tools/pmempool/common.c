@@ -29,6 +29,7 @@
 #include "libpmemblk.h"
 #include "libpmemlog.h"
 #include "libpmemobj.h"
+#include "libpmempool.h"
 #include "btt.h"
 #include "file.h"
 #include "os.h"
@@ -1380,3 +1381,28 @@ util_pool_clear_badblocks(const char *path, int create)
 
 	return 0;
 }
+
+#define MiB(bytes)	((double)(bytes) / (double)(1 << 20))
+
+/*
+ * util_print_progress -- print progress of copying the data reported by
+ *	libpmempool to stderr
+ */
+void
+util_print_progress(const struct pmempool_progress *p, void *arg)
+{
+	double sec = (double)p->elapsed_ns / 1e9;
+	double rate = sec > 0 ? MiB(p->done) / sec : 0;
+
+	if (p->final) {
+		fprintf(stderr, "%s: %.1f MiB done, %.1f MiB skipped in "
+			"%.2f s (%.1f MiB/s)\n",
+			p->desc, MiB(p->done), MiB(p->skipped), sec, rate);
+	} else {
+		fprintf(stderr, "%s: %.1f of %.1f MiB done (%u%%), "
+			"%.1f MiB skipped, %.1f MiB/s\n",
+			p->desc, MiB(p->done), MiB(p->total),
+			(unsigned)(p->total ? p->done * 100 / p->total : 100),
+			MiB(p->skipped), rate);
+	}
+}
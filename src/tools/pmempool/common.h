@@ -196,6 +196,9 @@ unsigned util_heap_max_zone(size_t size);
 
 int util_pool_clear_badblocks(const char *path, int create);
 
+struct pmempool_progress;
+void util_print_progress(const struct pmempool_progress *progress, void *arg);
+
 static const struct range ENTIRE_UINT64 = {
 	{ NULL, NULL },	/* range */
 	0,		/* first */
@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2016-2018, Intel Corporation */
+/* Copyright 2016-2020, Intel Corporation */
 
 /*
  * synchronize.c -- pmempool sync command source file
@@ -45,6 +45,7 @@ static const char * const help_str =
 "Common options:\n"
 "  -b, --bad-blocks     fix bad blocks - it requires creating or reading special recovery files\n"
 "  -d, --dry-run        do not apply changes, only check for viability of synchronization\n"
+"  -p, --progress       report progress and throughput of copying the data\n"
 "  -v, --verbose        increase verbosity level\n"
 "  -h, --help           display this help and exit\n"
 "\n"
@@ -58,6 +59,7 @@ static const struct option long_options[] = {
 	{"bad-blocks",	no_argument,		NULL,	'b'},
 	{"dry-run",	no_argument,		NULL,	'd'},
 	{"help",	no_argument,		NULL,	'h'},
+	{"progress",	no_argument,		NULL,	'p'},
 	{"verbose",	no_argument,		NULL,	'v'},
 	{NULL,		0,			NULL,	 0 },
 };
@@ -99,7 +101,7 @@ pmempool_sync_parse_args(struct pmempool_sync_context *ctx, const char *appname,
 		int argc, char *argv[])
 {
 	int opt;
-	while ((opt = getopt_long(argc, argv, "bdhv",
+	while ((opt = getopt_long(argc, argv, "bdhpv",
 			long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'd':
@@ -108,6 +110,10 @@ pmempool_sync_parse_args(struct pmempool_sync_context *ctx, const char *appname,
 		case 'b':
 			ctx->flags |= PMEMPOOL_SYNC_FIX_BAD_BLOCKS;
 			break;
+		case 'p':
+			ctx->flags |= PMEMPOOL_SYNC_PROGRESS;
+			pmempool_set_progress_func(util_print_progress, NULL);
+			break;
 		case 'h':
 			pmempool_sync_help(appname);
 			exit(EXIT_SUCCESS);
@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: BSD-3-Clause
-/* Copyright 2016-2018, Intel Corporation */
+/* Copyright 2016-2020, Intel Corporation */
 
 /*
  * transform.c -- pmempool transform command source file
@@ -46,6 +46,7 @@ static const char * const help_str =
 "Common options:\n"
 "  -d, --dry-run        do not apply changes, only check for viability of"
 " transformation\n"
+"  -p, --progress       report progress and throughput of copying the data\n"
 "  -v, --verbose        increase verbosity level\n"
 "  -h, --help           display this help and exit\n"
 "\n"
@@ -58,6 +59,7 @@ static const char * const help_str =
 static const struct option long_options[] = {
 	{"dry-run",	no_argument,		NULL,	'd'},
 	{"help",	no_argument,		NULL,	'h'},
+	{"progress",	no_argument,		NULL,	'p'},
 	{"verbose",	no_argument,		NULL,	'v'},
 	{NULL,		0,			NULL,	 0 },
 };
@@ -100,11 +102,15 @@ pmempool_transform_parse_args(struct pmempool_transform_context *ctx,
 		const char *appname, int argc, char *argv[])
 {
 	int opt;
-	while ((opt = getopt_long(argc, argv, "dhv",
+	while ((opt = getopt_long(argc, argv, "dhpv",
 			long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'd':
-			ctx->flags = PMEMPOOL_TRANSFORM_DRY_RUN;
+			ctx->flags |= PMEMPOOL_TRANSFORM_DRY_RUN;
+			break;
+		case 'p':
+			ctx->flags |= PMEMPOOL_TRANSFORM_PROGRESS;
+			pmempool_set_progress_func(util_print_progress, NULL);
 			break;
 		case 'h':
 			pmempool_transform_help(appname);
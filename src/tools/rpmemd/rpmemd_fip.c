@@ -569,6 +569,26 @@ rpmemd_fip_fini_common(struct rpmemd_fip *fip)
 	return lret;
 }
 
+/*
+ * rpmemd_fip_check_range -- verify range of persist operation
+ */
+static inline int
+rpmemd_fip_check_range(struct rpmemd_fip *fip, uint64_t addr, uint64_t size)
+{
+	uintptr_t raddr = addr;
+	uintptr_t laddr = (uintptr_t)fip->addr;
+
+	if (raddr < laddr || raddr - laddr > fip->size ||
+			size > fip->size - (raddr - laddr)) {
+		RPMEMD_LOG(ERR, "invalid address or size requested "
+			"for persist operation (0x%lx, %lu)",
+			raddr, size);
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * rpmemd_fip_check_pmsg -- verify persist message
  */
@@ -580,16 +600,63 @@ rpmemd_fip_check_pmsg(struct rpmemd_fip *fip, struct rpmem_msg_persist *pmsg)
 		return -1;
 	}
 
-	uintptr_t raddr = pmsg->addr;
-	uintptr_t laddr = (uintptr_t)fip->addr;
+	/* ranges of the vectored persist message are verified one by one */
+	if (pmsg->flags & RPMEM_PERSIST_VECTOR)
+		return 0;
 
-	if (raddr < laddr || raddr + pmsg->size > laddr + fip->size) {
-		RPMEMD_LOG(ERR, "invalid address or size requested "
-			"for persist operation (0x%lx, %lu)",
-			raddr, pmsg->size);
+	return rpmemd_fip_check_range(fip, pmsg->addr, pmsg->size);
+}
+
+/*
+ * rpmemd_fip_persist_vec -- persist all ranges of the vectored persist message
+ */
+static int
+rpmemd_fip_persist_vec(struct rpmemd_fip *fip, struct rpmem_msg_persist *pmsg)
+{
+	unsigned mode = pmsg->flags & RPMEM_FLUSH_PERSIST_MASK;
+	if (mode == RPMEM_DEEP_PERSIST) {
+		RPMEMD_LOG(ERR, "deep persist of multiple ranges "
+				"is not supported");
 		return -1;
 	}
 
+	size_t left = fip->pmsg_size - sizeof(*pmsg);
+	uintptr_t ptr = (uintptr_t)pmsg->data;
+
+	for (uint64_t i = 0; i < pmsg->size; i++) {
+		struct rpmem_msg_persist_range *range = (void *)ptr;
+
+		if (left < sizeof(*range)) {
+			RPMEMD_LOG(ERR, "invalid number of ranges requested "
+				"for persist operation -- %lu", pmsg->size);
+			return -1;
+		}
+		VALGRIND_DO_MAKE_MEM_DEFINED(range, sizeof(*range));
+
+		if (rpmemd_fip_check_range(fip, range->addr, range->size))
+			return -1;
+
+		size_t entry = sizeof(*range);
+		if (mode == RPMEM_PERSIST_SEND) {
+			if (range->size > left - entry) {
+				RPMEMD_LOG(ERR, "invalid size requested for "
+					"persist operation -- %lu",
+					range->size);
+				return -1;
+			}
+
+			fip->memcpy_persist((void *)range->addr, range->data,
+					range->size);
+		} else {
+			fip->persist((void *)range->addr, range->size);
+		}
+
+		entry = min(rpmem_msg_persist_range_size(mode, range->size),
+				left);
+		ptr += entry;
+		left -= entry;
+	}
+
 	return 0;
 }
 
@@ -646,7 +713,11 @@ rpmemd_fip_process_recv(struct rpmemd_fip *fip, struct rpmemd_fip_lane *lanep)
 		goto err;
 	unsigned mode = pmsg->flags & RPMEM_FLUSH_PERSIST_MASK;
 
-	if (mode == RPMEM_DEEP_PERSIST) {
+	if (pmsg->flags & RPMEM_PERSIST_VECTOR) {
+		ret = rpmemd_fip_persist_vec(fip, pmsg);
+		if (unlikely(ret))
+			goto err;
+	} else if (mode == RPMEM_DEEP_PERSIST) {
 		fip->deep_persist((void *)pmsg->addr, pmsg->size, fip->ctx);
 	} else if (mode == RPMEM_PERSIST_SEND) {
 		fip->memcpy_persist((void *)pmsg->addr, pmsg->data, pmsg->size);
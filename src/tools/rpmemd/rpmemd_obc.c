@@ -24,6 +24,8 @@
 struct rpmemd_obc {
 	int fd_in;
 	int fd_out;
+	int has_caps;	/* the last request contained the capabilities */
+	uint32_t caps;	/* capabilities negotiated by the last request */
 };
 
 /*
@@ -76,7 +78,8 @@ rpmemd_obc_check_pool_desc(struct rpmem_msg_hdr *hdrp, size_t msg_size,
 	struct rpmem_msg_pool_desc *pool_desc)
 {
 	size_t body_size = msg_size + pool_desc->size;
-	if (hdrp->size != body_size) {
+	if (hdrp->size != body_size &&
+	    hdrp->size != body_size + sizeof(struct rpmem_msg_caps)) {
 		RPMEMD_LOG(ERR, "message and pool descriptor size mismatch "
 			"-- is %lu should be %lu", hdrp->size, body_size);
 		return -1;
@@ -105,6 +108,50 @@ rpmemd_obc_check_pool_desc(struct rpmem_msg_hdr *hdrp, size_t msg_size,
 	return 0;
 }
 
+/*
+ * rpmemd_obc_msg_caps -- return the capabilities which follow the pool
+ * descriptor or NULL if the request does not contain them
+ */
+static struct rpmem_msg_caps *
+rpmemd_obc_msg_caps(struct rpmem_msg_hdr *hdrp, size_t msg_size,
+	struct rpmem_msg_pool_desc *pool_desc)
+{
+	if (hdrp->size == msg_size + pool_desc->size)
+		return NULL;
+
+	return (struct rpmem_msg_caps *)&pool_desc->desc[pool_desc->size];
+}
+
+/*
+ * rpmemd_obc_ntoh_msg_caps -- convert the capabilities of the request to
+ * host byte order
+ */
+static void
+rpmemd_obc_ntoh_msg_caps(struct rpmem_msg_hdr *hdrp, size_t msg_size,
+	struct rpmem_msg_pool_desc *pool_desc)
+{
+	struct rpmem_msg_caps *caps =
+		rpmemd_obc_msg_caps(hdrp, msg_size, pool_desc);
+	if (caps)
+		rpmem_ntoh_msg_caps(caps);
+}
+
+/*
+ * rpmemd_obc_set_caps -- negotiate the capabilities of the request
+ */
+static unsigned
+rpmemd_obc_set_caps(struct rpmemd_obc *obc, struct rpmem_msg_hdr *hdrp,
+	size_t msg_size, struct rpmem_msg_pool_desc *pool_desc)
+{
+	struct rpmem_msg_caps *caps =
+		rpmemd_obc_msg_caps(hdrp, msg_size, pool_desc);
+
+	obc->has_caps = caps != NULL;
+	obc->caps = caps ? caps->caps & RPMEM_CAPS_SUPPORTED : 0;
+
+	return obc->caps;
+}
+
 /*
  * rpmemd_obc_check_provider -- check provider value
  */
@@ -138,6 +185,8 @@ rpmemd_obc_ntoh_check_msg_create(struct rpmem_msg_hdr *hdrp)
 	if (ret)
 		return ret;
 
+	rpmemd_obc_ntoh_msg_caps(hdrp, sizeof(*msg), &msg->pool_desc);
+
 	ret = rpmemd_obc_check_provider(msg->c.provider);
 	if (ret)
 		return ret;
@@ -164,6 +213,8 @@ rpmemd_obc_ntoh_check_msg_open(struct rpmem_msg_hdr *hdrp)
 	if (ret)
 		return ret;
 
+	rpmemd_obc_ntoh_msg_caps(hdrp, sizeof(*msg), &msg->pool_desc);
+
 	ret = rpmemd_obc_check_provider(msg->c.provider);
 	if (ret)
 		return ret;
@@ -224,6 +275,8 @@ rpmemd_obc_process_create(struct rpmemd_obc *obc,
 		.pool_desc = (char *)msg->pool_desc.desc,
 		.provider = (enum rpmem_provider)msg->c.provider,
 		.buff_size = msg->c.buff_size,
+		.caps = rpmemd_obc_set_caps(obc, hdrp, sizeof(*msg),
+				&msg->pool_desc),
 	};
 
 	struct rpmem_pool_attr *rattr = NULL;
@@ -250,6 +303,8 @@ rpmemd_obc_process_open(struct rpmemd_obc *obc,
 		.pool_desc = (const char *)msg->pool_desc.desc,
 		.provider = (enum rpmem_provider)msg->c.provider,
 		.buff_size = msg->c.buff_size,
+		.caps = rpmemd_obc_set_caps(obc, hdrp, sizeof(*msg),
+				&msg->pool_desc),
 	};
 
 	return req_cb->open(obc, arg, &req);
@@ -452,6 +507,34 @@ rpmemd_obc_process(struct rpmemd_obc *obc,
 	return ret;
 }
 
+/*
+ * rpmemd_obc_caps_size -- size of the capabilities following the response
+ */
+static inline size_t
+rpmemd_obc_caps_size(struct rpmemd_obc *obc)
+{
+	return obc->has_caps ? sizeof(struct rpmem_msg_caps) : 0;
+}
+
+/*
+ * rpmemd_obc_send_caps -- send the negotiated capabilities following the
+ * response, if the request contained the capabilities
+ */
+static int
+rpmemd_obc_send_caps(struct rpmemd_obc *obc)
+{
+	if (!obc->has_caps)
+		return 0;
+
+	struct rpmem_msg_caps caps = {
+		.caps = obc->caps,
+	};
+
+	rpmem_hton_msg_caps(&caps);
+
+	return rpmemd_obc_send(obc, &caps, sizeof(caps));
+}
+
 /*
  * rpmemd_obc_create_resp -- send create request response message
  */
@@ -462,7 +545,8 @@ rpmemd_obc_create_resp(struct rpmemd_obc *obc,
 	struct rpmem_msg_create_resp resp = {
 		.hdr = {
 			.type	= RPMEM_MSG_TYPE_CREATE_RESP,
-			.size	= sizeof(struct rpmem_msg_create_resp),
+			.size	= sizeof(struct rpmem_msg_create_resp) +
+				rpmemd_obc_caps_size(obc),
 			.status	= (uint32_t)status,
 		},
 		.ibc = {
@@ -476,7 +560,11 @@ rpmemd_obc_create_resp(struct rpmemd_obc *obc,
 
 	rpmem_hton_msg_create_resp(&resp);
 
-	return rpmemd_obc_send(obc, &resp, sizeof(resp));
+	int ret = rpmemd_obc_send(obc, &resp, sizeof(resp));
+	if (ret)
+		return ret;
+
+	return rpmemd_obc_send_caps(obc);
 }
 
 /*
@@ -490,7 +578,8 @@ rpmemd_obc_open_resp(struct rpmemd_obc *obc,
 	struct rpmem_msg_open_resp resp = {
 		.hdr = {
 			.type	= RPMEM_MSG_TYPE_OPEN_RESP,
-			.size	= sizeof(struct rpmem_msg_open_resp),
+			.size	= sizeof(struct rpmem_msg_open_resp) +
+				rpmemd_obc_caps_size(obc),
 			.status	= (uint32_t)status,
 		},
 		.ibc = {
@@ -505,7 +594,11 @@ rpmemd_obc_open_resp(struct rpmemd_obc *obc,
 	pack_rpmem_pool_attr(pool_attr, &resp.pool_attr);
 	rpmem_hton_msg_open_resp(&resp);
 
-	return rpmemd_obc_send(obc, &resp, sizeof(resp));
+	int ret = rpmemd_obc_send(obc, &resp, sizeof(resp));
+	if (ret)
+		return ret;
+
+	return rpmemd_obc_send_caps(obc);
 }
 
 /*